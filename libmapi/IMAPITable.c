@@ -225,6 +225,10 @@ _PUBLIC_ enum MAPISTATUS QueryPosition(mapi_object_t *obj_table,
    - TBL_ADVANCE: index automatically increased from last rowcount
    - TBL_NOADVANCE: should be used for a single QueryRows call
    - TBL_ENABLEPACKEDBUFFERS: (not yet implemented)
+   - TBL_ARENA_ROWS: client side only, may be combined with the flags
+   above. Rows are decoded into a single allocation and PT_STRING8,
+   PT_CLSID and binary values point into the response buffer, which
+   stays allocated until rowSet->aRow is freed
 
    forward_read possible values:
    - TBL_FORWARD_READ: to read forwards
@@ -277,7 +281,7 @@ _PUBLIC_ enum MAPISTATUS QueryRows(mapi_object_t *obj_table,
 	size = 0;
 
 	/* Fill the QueryRows operation */
-	request.QueryRowsFlags = flags;
+	request.QueryRowsFlags = (enum QueryRowsFlags)(flags & ~TBL_ARENA_ROWS);
 	request.ForwardRead = forward_read;
 	request.RowCount = row_count;
 	size += 4;
@@ -314,7 +318,13 @@ _PUBLIC_ enum MAPISTATUS QueryRows(mapi_object_t *obj_table,
 	reply = &mapi_response->mapi_repl->u.mapi_QueryRows;
 	rowSet->cRows = reply->RowCount;
 	rowSet->aRow = talloc_array((TALLOC_CTX *)table, struct SRow, rowSet->cRows);
-	emsmdb_get_SRowSet((TALLOC_CTX *)rowSet->aRow, rowSet, &table->proptags, &reply->RowData);
+	if (flags & TBL_ARENA_ROWS) {
+		/* Decoded values point into the row data: keep it with the rows */
+		talloc_steal(rowSet->aRow, reply->RowData.data);
+		emsmdb_get_SRowSet_arena((TALLOC_CTX *)rowSet->aRow, rowSet, &table->proptags, &reply->RowData);
+	} else {
+		emsmdb_get_SRowSet((TALLOC_CTX *)rowSet->aRow, rowSet, &table->proptags, &reply->RowData);
+	}
 
 	talloc_free(mapi_response);
 	talloc_free(mem_ctx);
@@ -1182,6 +1182,402 @@ _PUBLIC_ void emsmdb_get_SRowSet(TALLOC_CTX *mem_ctx,
 }
 
 
+/**
+   Bump allocator backing emsmdb_get_SRowSet_arena(). Chunks are
+   talloc children of the row set memory context and are released
+   together with it. content and offset track the row data left to
+   decode, which sizes the overflow chunks.
+ */
+struct emsmdb_rows_arena {
+	TALLOC_CTX		*mem_ctx;
+	uint8_t			*chunk;
+	size_t			used;
+	size_t			size;
+	const DATA_BLOB		*content;
+	const uint32_t		*offset;
+};
+
+static void *emsmdb_rows_arena_alloc(struct emsmdb_rows_arena *arena, size_t size)
+{
+	size_t	used;
+	size_t	remaining;
+	size_t	chunk_size;
+
+	used = (arena->used + 7) & ~((size_t)7);
+	if (used > arena->size || size > arena->size - used) {
+		/* Start over in a chunk sized for the row data left */
+		remaining = (*arena->offset < arena->content->length) ? arena->content->length - *arena->offset : 0;
+		chunk_size = (size > remaining) ? size : remaining;
+		arena->chunk = (uint8_t *) talloc_size(arena->mem_ctx, chunk_size);
+		if (!arena->chunk) {
+			arena->used = arena->size = 0;
+			return NULL;
+		}
+		arena->size = chunk_size;
+		used = 0;
+	}
+	arena->used = used + size;
+
+	return arena->chunk + used;
+}
+
+static inline uint16_t emsmdb_pull_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t emsmdb_pull_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t emsmdb_pull_le64(const uint8_t *p)
+{
+	return emsmdb_pull_le32(p) | ((uint64_t)emsmdb_pull_le32(p + 4) << 32);
+}
+
+/**
+   \details Convert a NULL terminated UTF-16LE string into UTF-8
+   allocated from the arena
+
+   \param arena pointer to the row set arena
+   \param p pointer to the UTF-16LE string
+   \param left number of bytes available from p
+   \param consumed pointer to the number of bytes read, terminator
+   included
+
+   \return the UTF-8 string on success, NULL if the string is not
+   terminated or holds an unpaired surrogate
+ */
+static char *emsmdb_rows_arena_utf16(struct emsmdb_rows_arena *arena,
+				     const uint8_t *p, size_t left,
+				     size_t *consumed)
+{
+	size_t		i;
+	size_t		len = 0;
+	uint32_t	c;
+	uint32_t	c2;
+	uint8_t		*out;
+	uint8_t		*q;
+
+	for (i = 0;; i += 2) {
+		if (left - i < 2) return NULL;
+		c = emsmdb_pull_le16(p + i);
+		if (c == 0) break;
+		if (c < 0x80) {
+			len += 1;
+		} else if (c < 0x800) {
+			len += 2;
+		} else if (c >= 0xD800 && c <= 0xDBFF) {
+			if (left - i < 4) return NULL;
+			c2 = emsmdb_pull_le16(p + i + 2);
+			if (c2 < 0xDC00 || c2 > 0xDFFF) return NULL;
+			len += 4;
+			i += 2;
+		} else if (c >= 0xDC00 && c <= 0xDFFF) {
+			return NULL;
+		} else {
+			len += 3;
+		}
+	}
+	*consumed = i + 2;
+
+	out = (uint8_t *) emsmdb_rows_arena_alloc(arena, len + 1);
+	if (!out) return NULL;
+
+	for (i = 0, q = out; q < out + len; i += 2) {
+		c = emsmdb_pull_le16(p + i);
+		if (c < 0x80) {
+			*q++ = c;
+		} else if (c < 0x800) {
+			*q++ = 0xC0 | (c >> 6);
+			*q++ = 0x80 | (c & 0x3F);
+		} else if (c >= 0xD800 && c <= 0xDBFF) {
+			c = 0x10000 + ((c - 0xD800) << 10) + (emsmdb_pull_le16(p + i + 2) - 0xDC00);
+			*q++ = 0xF0 | (c >> 18);
+			*q++ = 0x80 | ((c >> 12) & 0x3F);
+			*q++ = 0x80 | ((c >> 6) & 0x3F);
+			*q++ = 0x80 | (c & 0x3F);
+			i += 2;
+		} else {
+			*q++ = 0xE0 | (c >> 12);
+			*q++ = 0x80 | ((c >> 6) & 0x3F);
+			*q++ = 0x80 | (c & 0x3F);
+		}
+	}
+	*q = '\0';
+
+	return (char *) out;
+}
+
+/**
+   \details Decode a property value in place without per value
+   allocations
+
+   Fixed size values are stored in the SPropValue itself, PT_STRING8,
+   PT_CLSID and binary values point into the content blob, converted
+   strings and multi-valued arrays are allocated from the arena.
+   Strings which cannot be converted fall back on
+   pull_emsmdb_property().
+
+   \param arena pointer to the row set arena
+   \param lpProp pointer to the SPropValue to fill, its property tag
+   must be set
+   \param offset pointer to the current offset in content
+   \param content pointer to the DATA blob content
+ */
+static void emsmdb_rows_arena_pull_property(struct emsmdb_rows_arena *arena,
+					    struct SPropValue *lpProp,
+					    uint32_t *offset,
+					    DATA_BLOB *content)
+{
+	const uint8_t	*p;
+	const uint8_t	*end;
+	size_t		left;
+	size_t		len;
+	uint32_t	count;
+	uint32_t	i;
+	const void	*data;
+
+	if (*offset >= content->length) goto corrupt;
+	p = content->data + *offset;
+	left = content->length - *offset;
+
+	switch (lpProp->ulPropTag & 0xFFFF) {
+	case PT_I2:
+		if (left < 2) goto corrupt;
+		lpProp->value.i = emsmdb_pull_le16(p);
+		*offset += 2;
+		return;
+	case PT_ERROR:
+		if (left < 4) goto corrupt;
+		lpProp->value.err = (enum MAPISTATUS) emsmdb_pull_le32(p);
+		*offset += 4;
+		return;
+	case PT_LONG:
+		if (left < 4) goto corrupt;
+		lpProp->value.l = emsmdb_pull_le32(p);
+		*offset += 4;
+		return;
+	case PT_BOOLEAN:
+		lpProp->value.b = p[0];
+		*offset += 1;
+		return;
+	case PT_I8:
+		if (left < 8) goto corrupt;
+		lpProp->value.d = emsmdb_pull_le64(p);
+		*offset += 8;
+		return;
+	case PT_DOUBLE: {
+		uint64_t	v;
+
+		if (left < 8) goto corrupt;
+		v = emsmdb_pull_le64(p);
+		memcpy(&lpProp->value.dbl, &v, sizeof (double));
+		*offset += 8;
+		return;
+	}
+	case PT_SYSTIME:
+		if (left < 8) goto corrupt;
+		lpProp->value.ft.dwLowDateTime = emsmdb_pull_le32(p);
+		lpProp->value.ft.dwHighDateTime = emsmdb_pull_le32(p + 4);
+		*offset += 8;
+		return;
+	case PT_CLSID:
+		if (left < 16) goto corrupt;
+		lpProp->value.lpguid = (struct FlatUID_r *) p;
+		*offset += 16;
+		return;
+	case PT_STRING8:
+		end = (const uint8_t *) memchr(p, 0, left);
+		if (!end) goto corrupt;
+		lpProp->value.lpszA = (uint8_t *) p;
+		*offset += end - p + 1;
+		return;
+	case PT_UNICODE:
+		lpProp->value.lpszW = emsmdb_rows_arena_utf16(arena, p, left, &len);
+		if (!lpProp->value.lpszW) goto fallback;
+		*offset += len;
+		return;
+	case PT_SVREID:
+	case PT_BINARY:
+		if (left < 2) goto corrupt;
+		len = emsmdb_pull_le16(p);
+		if (left - 2 < len) goto corrupt;
+		lpProp->value.bin.cb = len;
+		lpProp->value.bin.lpb = (uint8_t *) p + 2;
+		*offset += 2 + len;
+		return;
+	case PT_MV_LONG:
+		if (left < 4) goto corrupt;
+		count = emsmdb_pull_le32(p);
+		if (count > (left - 4) / 4) goto corrupt;
+		lpProp->value.MVl.lpl = (uint32_t *) emsmdb_rows_arena_alloc(arena, count * sizeof (uint32_t));
+		if (!lpProp->value.MVl.lpl) goto corrupt;
+		lpProp->value.MVl.cValues = count;
+		for (i = 0; i < count; i++) {
+			lpProp->value.MVl.lpl[i] = emsmdb_pull_le32(p + 4 + i * 4);
+		}
+		*offset += 4 + count * 4;
+		return;
+	case PT_MV_STRING8:
+		if (left < 4) goto corrupt;
+		count = emsmdb_pull_le32(p);
+		if (count > left - 4) goto corrupt;
+		lpProp->value.MVszA.lppszA = (uint8_t **) emsmdb_rows_arena_alloc(arena, count * sizeof (uint8_t *));
+		if (!lpProp->value.MVszA.lppszA) goto corrupt;
+		lpProp->value.MVszA.cValues = count;
+		for (i = 0, len = 4; i < count; i++) {
+			end = (const uint8_t *) memchr(p + len, 0, left - len);
+			if (!end) goto corrupt;
+			lpProp->value.MVszA.lppszA[i] = (uint8_t *) p + len;
+			len = end - p + 1;
+		}
+		*offset += len;
+		return;
+	case PT_MV_UNICODE: {
+		size_t	consumed;
+
+		if (left < 4) goto corrupt;
+		count = emsmdb_pull_le32(p);
+		if (count > (left - 4) / 2) goto corrupt;
+		lpProp->value.MVszW.lppszW = (const char **) emsmdb_rows_arena_alloc(arena, count * sizeof (const char *));
+		if (!lpProp->value.MVszW.lppszW) goto corrupt;
+		lpProp->value.MVszW.cValues = count;
+		for (i = 0, len = 4; i < count; i++) {
+			lpProp->value.MVszW.lppszW[i] = emsmdb_rows_arena_utf16(arena, p + len, left - len, &consumed);
+			if (!lpProp->value.MVszW.lppszW[i]) goto fallback;
+			len += consumed;
+		}
+		*offset += len;
+		return;
+	}
+	case PT_MV_BINARY:
+		if (left < 4) goto corrupt;
+		count = emsmdb_pull_le32(p);
+		if (count > (left - 4) / 2) goto corrupt;
+		lpProp->value.MVbin.lpbin = (struct Binary_r *) emsmdb_rows_arena_alloc(arena, count * sizeof (struct Binary_r));
+		if (!lpProp->value.MVbin.lpbin) goto corrupt;
+		lpProp->value.MVbin.cValues = count;
+		for (i = 0, len = 4; i < count; i++) {
+			if (left - len < 2) goto corrupt;
+			lpProp->value.MVbin.lpbin[i].cb = emsmdb_pull_le16(p + len);
+			len += 2;
+			if (left - len < lpProp->value.MVbin.lpbin[i].cb) goto corrupt;
+			lpProp->value.MVbin.lpbin[i].lpb = (uint8_t *) p + len;
+			len += lpProp->value.MVbin.lpbin[i].cb;
+		}
+		*offset += len;
+		return;
+	default:
+		OC_DEBUG(1, "unhandled type 0x%x", (lpProp->ulPropTag & 0xFFFF));
+		set_SPropValue(lpProp, NULL);
+		return;
+	}
+
+corrupt:
+	/* Truncated row data: nothing after this value can be trusted */
+	set_SPropValue(lpProp, NULL);
+	*offset = content->length;
+	return;
+
+fallback:
+	data = pull_emsmdb_property(arena->mem_ctx, offset, lpProp->ulPropTag, content);
+	set_SPropValue(lpProp, data);
+}
+
+
+/**
+   \details Get a SRowSet from a DATA blob, decoding all rows into a
+   single arena
+
+   This is the allocation-free counterpart of emsmdb_get_SRowSet():
+   the SPropValue arrays of all rows and every value needing storage
+   are carved out of one talloc chunk sized from the row data, instead
+   of being allocated, copied and freed one value at a time. PT_STRING8,
+   PT_CLSID and binary values are not copied but point into content.
+
+   \param mem_ctx pointer on the memory context
+   \param rowset pointer on the returned SRowSet
+   \param proptags pointer on a list of property tags to lookup
+   \param content pointer on the DATA blob content. It must remain
+   valid as long as mem_ctx, for instance by stealing it under
+   mem_ctx.
+
+   \note Values are decoded exactly as emsmdb_get_SRowSet() does,
+   except for truncated row data where the affected and following
+   values are returned as PT_ERROR properties.
+ */
+_PUBLIC_ void emsmdb_get_SRowSet_arena(TALLOC_CTX *mem_ctx,
+				       struct SRowSet *rowset,
+				       struct SPropTagArray *proptags,
+				       DATA_BLOB *content)
+{
+	struct emsmdb_rows_arena	arena;
+	struct SRow			*rows;
+	struct SPropValue		*lpProps;
+	uint32_t			idx;
+	uint32_t			prop;
+	uint32_t			offset = 0;
+	uint32_t			row_count;
+	size_t				props_size;
+	bool				is_FlaggedPropertyRow;
+	uint8_t				flag;
+
+	/* caller allocated */
+	rows = rowset->aRow;
+	row_count = rowset->cRows;
+
+	if (proptags->cValues && row_count > SIZE_MAX / sizeof (struct SPropValue) / proptags->cValues) {
+		emsmdb_get_SRowSet(mem_ctx, rowset, proptags, content);
+		return;
+	}
+
+	/* A single chunk holds the SPropValue arrays of all rows and,
+	 * as UTF-8 is never larger than the UTF-16 it is converted from
+	 * for BMP text up to U+07FF, most converted strings and arrays */
+	props_size = row_count * proptags->cValues * sizeof (struct SPropValue);
+	arena.mem_ctx = mem_ctx;
+	arena.content = content;
+	arena.offset = &offset;
+	arena.used = 0;
+	arena.size = props_size + content->length;
+	arena.chunk = (uint8_t *) talloc_size(mem_ctx, arena.size);
+	if (!arena.chunk) {
+		emsmdb_get_SRowSet(mem_ctx, rowset, proptags, content);
+		return;
+	}
+	lpProps = (struct SPropValue *) emsmdb_rows_arena_alloc(&arena, props_size);
+
+	for (idx = 0; idx < row_count; idx++) {
+		is_FlaggedPropertyRow = (offset < content->length && content->data[offset] == 0x1);
+		++offset;
+
+		for (prop = 0; prop < proptags->cValues; prop++) {
+			lpProps[prop].ulPropTag = proptags->aulPropTag[prop];
+			lpProps[prop].dwAlignPad = 0x0;
+			if (is_FlaggedPropertyRow) {
+				flag = (offset < content->length) ? content->data[offset] : 0x0;
+				++offset; /* advance offset for the flag */
+				if (flag == 0x1) {
+					/* Property Value is not present */
+					memset(&lpProps[prop].value, 0, sizeof (lpProps[prop].value));
+					continue;
+				} else if (flag == PT_ERROR) {
+					lpProps[prop].ulPropTag = (enum MAPITAGS) ((proptags->aulPropTag[prop] & 0xFFFF0000) | PT_ERROR);
+				}
+			}
+			emsmdb_rows_arena_pull_property(&arena, &lpProps[prop], &offset, content);
+		}
+
+		rows[idx].ulAdrEntryPad = 0;
+		rows[idx].cValues = proptags->cValues;
+		rows[idx].lpProps = lpProps;
+		lpProps += proptags->cValues;
+	}
+}
+
+
 /**
    \details Get a SRow from a DATA blob
 
@@ -418,6 +418,138 @@ static void check_idset(const struct idset *idset)
 #define check_idset(x) {}
 #endif
 
+static int IDSET_index_range_compar(const void *vap, const void *vbp)
+{
+	const struct idset_index_range *ap, *bp;
+
+	ap = (const struct idset_index_range *) vap;
+	bp = (const struct idset_index_range *) vbp;
+
+	if (ap->low < bp->low) {
+		return -1;
+	}
+	else if (ap->low > bp->low) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+  \details build the sorted range table of a single idset node so
+  lookups can be resolved with a binary search instead of walking the
+  ranges list. Invalid ranges (low > high) are never matched and are
+  therefore left out.
+*/
+static void IDSET_index_node(struct idset *idset)
+{
+	struct idset_index	*lookup;
+	struct globset_range	*range;
+	uint64_t		low, high;
+	uint32_t		i, j, count;
+
+	talloc_free(idset->index);
+	idset->index = NULL;
+
+	lookup = talloc_zero(idset, struct idset_index);
+	if (!lookup) return;
+
+	if (idset->range_count) {
+		lookup->ranges = talloc_array(lookup, struct idset_index_range, idset->range_count);
+		if (!lookup->ranges) {
+			talloc_free(lookup);
+			return;
+		}
+	}
+
+	count = 0;
+	range = idset->ranges;
+	for (i = 0; i < idset->range_count && range; i++) {
+		low = exchange_globcnt(range->low);
+		high = exchange_globcnt(range->high);
+		if (low <= high) {
+			lookup->ranges[count].low = low;
+			lookup->ranges[count].high = high;
+			count++;
+		}
+		range = range->next;
+	}
+
+	if (count > 1) {
+		qsort(lookup->ranges, count, sizeof(struct idset_index_range), IDSET_index_range_compar);
+
+		/* merge overlapping ranges so at most one range can match */
+		i = 0;
+		for (j = 1; j < count; j++) {
+			if (lookup->ranges[j].low <= lookup->ranges[i].high) {
+				if (lookup->ranges[j].high > lookup->ranges[i].high) {
+					lookup->ranges[i].high = lookup->ranges[j].high;
+				}
+			} else {
+				i++;
+				lookup->ranges[i] = lookup->ranges[j];
+			}
+		}
+		count = i + 1;
+	}
+	lookup->count = count;
+
+	idset->index = lookup;
+}
+
+/**
+  \details (re)build the range tables of every node of an idset list
+*/
+static void IDSET_index(struct idset *idset)
+{
+	while (idset) {
+		IDSET_index_node(idset);
+		idset = idset->next;
+	}
+}
+
+/**
+  \details tests whether a globcnt belongs to the ranges of a single
+  idset node, using the sorted range table when available
+*/
+static bool IDSET_node_includes_globcnt(const struct idset *idset, uint64_t globcnt)
+{
+	const struct idset_index_range	*ranges;
+	struct globset_range		*range;
+	uint64_t			work_globcnt;
+	uint32_t			low, high, middle;
+
+	work_globcnt = exchange_globcnt(globcnt);
+
+	if (idset->index) {
+		ranges = idset->index->ranges;
+		low = 0;
+		high = idset->index->count;
+		while (low < high) {
+			middle = low + (high - low) / 2;
+			if (ranges[middle].high < work_globcnt) {
+				low = middle + 1;
+			} else if (ranges[middle].low > work_globcnt) {
+				high = middle;
+			} else {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	range = idset->ranges;
+	while (range) {
+		if (exchange_globcnt(range->low) <= work_globcnt
+		    && exchange_globcnt(range->high) >= work_globcnt) {
+			return true;
+		}
+		range = range->next;
+	}
+
+	return false;
+}
+
 /**
   \details deserialize an IDSET following the format described in [OXCFXICS - 2.2.2.4]
 
@@ -469,6 +601,7 @@ _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool i
 		return NULL;
 	}
 
+	IDSET_index(idset);
 	IDSET_dump(idset, "freshly parsed");
 
 	return idset;
@@ -562,6 +695,7 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	idset->range_count = 1;
 
 	if (length == 0) {
+		IDSET_index_node(idset);
 		return idset;
 	}
 
@@ -597,6 +731,7 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	talloc_free(work_array);
 
 	check_idset(idset);
+	IDSET_index_node(idset);
 
 	return idset;
 }
@@ -854,6 +989,7 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 	}
 
 	check_idset(head_idset);
+	IDSET_index(head_idset);
 
 	return head_idset;
 }
@@ -941,6 +1077,7 @@ _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idse
 		while (current) {
 			IDSET_reorder_ranges(current);
 			IDSET_compact_ranges(current);
+			IDSET_index_node(current);
 			current = current->next;
 		}
 	}
@@ -993,7 +1130,6 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 */
 _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 {
-	struct globset_range *range;
 	uint16_t eid_id;
 	uint64_t eid_globcnt;
 
@@ -1005,15 +1141,8 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 	eid_globcnt = eid >> 16;
 
 	while (idset) {
-		if (idset->repl.id == eid_id) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(eid_globcnt)
-				    && exchange_globcnt(range->high) >= exchange_globcnt(eid_globcnt)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (idset->repl.id == eid_id && IDSET_node_includes_globcnt(idset, eid_globcnt)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -1026,8 +1155,6 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 */
 _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *replica_guid, uint64_t id)
 {
-	struct globset_range *range;
-
 	if (!idset || idset->idbased) {
 		return false;
 	}
@@ -1036,14 +1163,8 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	}
 
 	while (idset) {
-		if (GUID_equal(&idset->repl.guid, replica_guid)) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(id) && exchange_globcnt(range->high) >= exchange_globcnt(id)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (GUID_equal(&idset->repl.guid, replica_guid) && IDSET_node_includes_globcnt(idset, id)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -1130,6 +1251,7 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 		for (i = 0; i < rawidset->count; i++) {
 			IDSET_ranges_remove_globcnt(current_idset, rawidset->globcnts[i]);
 		}
+		IDSET_index_node(current_idset);
 	}
 
 	check_idset(idset);
@@ -31,9 +31,22 @@ struct idset {
 	bool			single; /* single range */
 	uint32_t		range_count;
 	struct globset_range	*ranges;
+	struct idset_index	*index; /* sorted lookup table, NULL when stale */
 	struct idset		*next;
 };
 
+/* Contiguous copy of the ranges of an idset, sorted and merged, with
+   bounds already converted through exchange_globcnt() */
+struct idset_index_range {
+	uint64_t		low;
+	uint64_t		high;
+};
+
+struct idset_index {
+	uint32_t			count;
+	struct idset_index_range	*ranges;
+};
+
 struct globset_range {
 	uint64_t		low;
 	uint64_t		high;
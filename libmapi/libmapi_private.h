@@ -61,10 +61,71 @@
 
 __BEGIN_DECLS
 
+/**
+   Perfect hash table generated by script/makepropslist.py for the
+   static property tables (property_tags.c, mapi_nameid_private.h,
+   openchangedb_property.c). Keys are first spread over seeds_count
+   buckets, each bucket seed then places its keys in distinct
+   slots. Slots store the table index + 1, 0 meaning empty.
+ */
+struct mapi_phash {
+	const uint32_t	*seeds;
+	uint32_t	seeds_count;
+	const uint16_t	*slots;
+	uint32_t	slots_count;
+};
+
+/**
+   \details Hash prefix||key with the given seed: FNV-1a seeded
+   through its offset basis, followed by the murmur3 finalizer. Must
+   match phash() in script/makepropslist.py.
+ */
+static inline uint32_t mapi_phash_data(uint32_t seed, const uint8_t *prefix, size_t prefix_len,
+				       const uint8_t *key, size_t key_len)
+{
+	uint32_t	h = 0x811C9DC5 ^ seed;
+	size_t		i;
+
+	for (i = 0; i < prefix_len; i++) {
+		h = (h ^ prefix[i]) * 0x01000193;
+	}
+	for (i = 0; i < key_len; i++) {
+		h = (h ^ key[i]) * 0x01000193;
+	}
+	h ^= h >> 16;
+	h *= 0x85EBCA6B;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/**
+   \details Look up prefix||key in a generated perfect hash table
+
+   \return the index + 1 of the candidate entry, 0 if there is none.
+   Any key hashes to some slot: callers must compare the entry
+   against the key they searched for.
+ */
+static inline uint32_t mapi_phash_find(const struct mapi_phash *table,
+				       const void *prefix, size_t prefix_len,
+				       const void *key, size_t key_len)
+{
+	uint32_t	seed;
+
+	seed = table->seeds[mapi_phash_data(0, (const uint8_t *)prefix, prefix_len,
+					    (const uint8_t *)key, key_len) % table->seeds_count];
+	return table->slots[mapi_phash_data(seed, (const uint8_t *)prefix, prefix_len,
+					    (const uint8_t *)key, key_len) % table->slots_count];
+}
+
 /* The following private definitions come from ndr_mapi.c */
 void obfuscate_data(uint8_t *, uint32_t, uint8_t);
 enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *, struct ndr_pull **, ssize_t);
 enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *, struct ndr_push *);
+bool lzxpress_probe(const uint8_t *, uint32_t);
+enum ndr_err_code ndr_push_mapi2k7_payload(struct ndr_push *, uint16_t, const uint8_t *, uint32_t);
 enum ndr_err_code ndr_push_ExtendedException(struct ndr_push *, int, uint16_t, const struct ExceptionInfo *, const struct ExtendedException *);
 enum ndr_err_code ndr_pull_ExtendedException(struct ndr_pull *, int, uint16_t, const struct ExceptionInfo *, struct ExtendedException *);
 enum ndr_err_code ndr_push_AppointmentRecurrencePattern(struct ndr_push *, int, const struct AppointmentRecurrencePattern *);
@@ -18,9 +18,9 @@
  */
 
 #include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
 #include "libmapi/mapi_nameid.h"
 #include "libmapi/mapi_nameid_private.h"
-#include "libmapi/libmapi_private.h"
 
 
 /**
@@ -58,6 +58,142 @@ _PUBLIC_ struct mapi_nameid *mapi_nameid_new(TALLOC_CTX *mem_ctx)
 }
 
 
+/**
+   \details Find a mapi_nameid_tags entry in one of the generated
+   (OLEGUID, key) perfect hash tables
+
+   \param table the mapi_nameid_private.h table to search
+   \param OLEGUID the property set string
+   \param key the lid (little-endian) or string following the GUID
+   \param key_len the length of key
+
+   \return the entry index + 1 when its OLEGUID matches, otherwise
+   0. Callers still have to compare the lid or string themselves.
+ */
+static uint32_t mapi_nameid_tags_find(const struct mapi_phash *table,
+				      const char *OLEGUID,
+				      const void *key, size_t key_len)
+{
+	struct GUID	guid;
+	uint8_t		guid_key[16];
+	uint32_t	idx;
+
+	if (!NT_STATUS_IS_OK(GUID_from_string(OLEGUID, &guid))) {
+		return 0;
+	}
+
+	/* The generator stores GUIDs in their little-endian wire format */
+	guid_key[0] = guid.time_low & 0xFF;
+	guid_key[1] = (guid.time_low >> 8) & 0xFF;
+	guid_key[2] = (guid.time_low >> 16) & 0xFF;
+	guid_key[3] = (guid.time_low >> 24) & 0xFF;
+	guid_key[4] = guid.time_mid & 0xFF;
+	guid_key[5] = (guid.time_mid >> 8) & 0xFF;
+	guid_key[6] = guid.time_hi_and_version & 0xFF;
+	guid_key[7] = (guid.time_hi_and_version >> 8) & 0xFF;
+	memcpy(&guid_key[8], guid.clock_seq, 2);
+	memcpy(&guid_key[10], guid.node, 6);
+
+	idx = mapi_phash_find(table, guid_key, sizeof (guid_key), key, key_len);
+	if (!idx || memcmp(mapi_nameid_oleguids[mapi_nameid_tags_oleguid[idx - 1]],
+			   guid_key, sizeof (guid_key))) {
+		return 0;
+	}
+
+	return idx;
+}
+
+static uint32_t mapi_nameid_tags_find_lid(uint16_t lid, const char *OLEGUID)
+{
+	uint8_t		key[2];
+	uint32_t	idx;
+
+	key[0] = lid & 0xFF;
+	key[1] = (lid >> 8) & 0xFF;
+
+	idx = mapi_nameid_tags_find(&mapi_nameid_tags_by_lid, OLEGUID, key, sizeof (key));
+	if (!idx || mapi_nameid_tags[idx - 1].lid != lid) {
+		return 0;
+	}
+	return idx;
+}
+
+static uint32_t mapi_nameid_tags_find_Name(const char *Name, const char *OLEGUID)
+{
+	uint32_t	idx;
+
+	idx = mapi_nameid_tags_find(&mapi_nameid_tags_by_name, OLEGUID, Name, strlen(Name));
+	if (!idx || strcmp(mapi_nameid_tags[idx - 1].Name, Name)) {
+		return 0;
+	}
+	return idx;
+}
+
+static uint32_t mapi_nameid_tags_find_OOM(const char *OOM, const char *OLEGUID)
+{
+	uint32_t	idx;
+
+	idx = mapi_nameid_tags_find(&mapi_nameid_tags_by_OOM, OLEGUID, OOM, strlen(OOM));
+	if (!idx || strcmp(mapi_nameid_tags[idx - 1].OOM, OOM)) {
+		return 0;
+	}
+	return idx;
+}
+
+static uint32_t mapi_nameid_tags_find_proptag(uint32_t proptag)
+{
+	uint8_t		key[4];
+	uint32_t	idx;
+
+	key[0] = proptag & 0xFF;
+	key[1] = (proptag >> 8) & 0xFF;
+	key[2] = (proptag >> 16) & 0xFF;
+	key[3] = (proptag >> 24) & 0xFF;
+
+	idx = mapi_phash_find(&mapi_nameid_tags_by_proptag, NULL, 0, key, sizeof (key));
+	if (!idx || mapi_nameid_tags[idx - 1].proptag != proptag) {
+		return 0;
+	}
+	return idx;
+}
+
+
+/**
+   \details Append a mapi_nameid_tags entry to a mapi_nameid structure
+
+   \param mapi_nameid the structure where results are stored
+   \param i the mapi_nameid_tags index of the entry
+ */
+static void mapi_nameid_tags_append(struct mapi_nameid *mapi_nameid, uint32_t i)
+{
+	uint16_t	count;
+
+	mapi_nameid->nameid = talloc_realloc(mapi_nameid,
+					     mapi_nameid->nameid, struct MAPINAMEID,
+					     mapi_nameid->count + 1);
+	mapi_nameid->entries = talloc_realloc(mapi_nameid,
+					      mapi_nameid->entries, struct mapi_nameid_tags,
+					      mapi_nameid->count + 1);
+	count = mapi_nameid->count;
+
+	mapi_nameid->entries[count] = mapi_nameid_tags[i];
+
+	mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
+	GUID_from_string(mapi_nameid_tags[i].OLEGUID,
+			 &(mapi_nameid->nameid[count].lpguid));
+	switch (mapi_nameid_tags[i].ulKind) {
+	case MNID_ID:
+		mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
+		break;
+	case MNID_STRING:
+		mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
+		mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
+		break;
+	}
+	mapi_nameid->count++;
+}
+
+
 /**
    \details Add a mapi_nameid entry given its OOM and OLEGUID
    (MNID_ID|MNID_STRING)
@@ -82,45 +218,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 					     const char *OLEGUID)
 {
 	uint32_t		i;
-	uint16_t		count;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(OOM, mapi_nameid_tags[i].OOM) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	i = mapi_nameid_tags_find_OOM(OOM, OLEGUID);
+	if (!i) return MAPI_E_NOT_FOUND;
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_tags_append(mapi_nameid, i - 1);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -148,44 +257,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_add(struct mapi_nameid *mapi_nameid,
 					     uint16_t lid, const char *OLEGUID)
 {
 	uint32_t		i;
-	uint16_t		count;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if ((lid == mapi_nameid_tags[i].lid) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (!i) return MAPI_E_NOT_FOUND;
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_tags_append(mapi_nameid, i - 1);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -214,45 +297,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_add(struct mapi_nameid *mapi_nameid,
 						const char *OLEGUID)
 {
 	uint32_t		i;
-	uint16_t		count;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(Name, mapi_nameid_tags[i].Name) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	i = mapi_nameid_tags_find_Name(Name, OLEGUID);
+	if (!i) return MAPI_E_NOT_FOUND;
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_tags_append(mapi_nameid, i - 1);
+
+	return MAPI_E_SUCCESS;
 }
 
 /**
@@ -381,42 +437,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
 						   uint32_t proptag)
 {
 	uint32_t	i;
-	uint16_t	count;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!proptag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							      mapi_nameid->entries, struct mapi_nameid_tags,
-							      mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	i = mapi_nameid_tags_find_proptag(proptag);
+	if (!i) return MAPI_E_NOT_FOUND;
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_tags_append(mapi_nameid, i - 1);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -430,12 +461,8 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
  */
 _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 {
-	uint32_t	i;
-
-	for (i = 0; mapi_nameid_tags[i].proptag; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			return MAPI_E_SUCCESS;
-		}
+	if (proptag && mapi_nameid_tags_find_proptag(proptag)) {
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -466,13 +493,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLE
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(mapi_nameid_tags[i].OOM, OOM) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_OOM(OOM, OLEGUID);
+	if (i) {
+		*propType = mapi_nameid_tags[i - 1].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -503,12 +527,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUI
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (i) {
+		*propType = mapi_nameid_tags[i - 1].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -540,12 +562,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup_canonical(uint16_t lid, const ch
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_lid(lid, OLEGUID);
+	if (i) {
+		*propTag = mapi_nameid_tags[i - 1].proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -577,13 +597,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup(const char *Name,
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_Name(Name, OLEGUID);
+	if (i) {
+		*propType = mapi_nameid_tags[i - 1].propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -616,13 +633,10 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup_canonical(const char *Name,
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	i = mapi_nameid_tags_find_Name(Name, OLEGUID);
+	if (i) {
+		*propTag = mapi_nameid_tags[i - 1].proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -503,6 +503,265 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 
 };
 
+static const uint8_t mapi_nameid_oleguids[16][16] = {
+	{ 0x04, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Address */
+	{ 0x02, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Appointment */
+	{ 0x7f, 0x7f, 0x35, 0x96, 0xe1, 0x59, 0xd0, 0x47, 0x99, 0xa7, 0x46, 0x51, 0x5c, 0x18, 0x3b, 0x54 }, /* PSETID_Attachment */
+	{ 0x07, 0x0e, 0x00, 0x11, 0x1b, 0xb5, 0xd6, 0x40, 0xaf, 0x21, 0xca, 0xa8, 0x5e, 0xda, 0xb1, 0xd0 }, /* PSETID_CalendarAssistant */
+	{ 0x08, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Common */
+	{ 0x0a, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Log */
+	{ 0x90, 0xda, 0xd8, 0x6e, 0x0b, 0x45, 0x1b, 0x10, 0x98, 0xda, 0x00, 0xaa, 0x00, 0x3f, 0x13, 0x05 }, /* PSETID_Meeting */
+	{ 0x0e, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Note */
+	{ 0x41, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_PostRss */
+	{ 0x14, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Remote */
+	{ 0x40, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Sharing */
+	{ 0x03, 0x20, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PSETID_Task */
+	{ 0x8e, 0x85, 0x42, 0x44, 0xe3, 0xa9, 0x80, 0x4e, 0xb9, 0x00, 0x31, 0x7a, 0x21, 0x0c, 0xc1, 0x5b }, /* PSETID_UnifiedMessaging */
+	{ 0x08, 0x96, 0x23, 0x23, 0x5d, 0x68, 0x32, 0x47, 0x9c, 0x55, 0x4c, 0x95, 0xcb, 0x4e, 0x8e, 0x33 }, /* PSETID_XmlExtractedEntities */
+	{ 0x86, 0x03, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PS_INTERNET_HEADERS */
+	{ 0x29, 0x03, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 }, /* PS_PUBLIC_STRINGS */
+};
+
+static const uint8_t mapi_nameid_tags_oleguid[495] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7,
+	7, 7, 8, 8, 8, 8, 8, 8, 8, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+	10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+	11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 15, 2, 2, 12,
+	12, 13, 13, 13, 13, 13, 13, 13, 14, 14, 14, 14, 14, 14, 14, 14,
+	14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+	14, 14, 14, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 9,
+};
+
+static const uint32_t mapi_nameid_tags_by_proptag_seeds[124] = {
+	74, 2, 0, 2, 2, 21, 35, 4, 26, 11, 16, 7,
+	1, 23, 3, 0, 30, 10, 6, 6, 3, 3, 16, 2,
+	30, 4, 2, 10, 21, 4, 8, 2, 1, 8, 9, 12,
+	17, 0, 52, 1, 14, 3, 7, 7, 2, 15, 1, 2,
+	27, 2, 6, 14, 10, 15, 14, 3, 5, 3, 4, 4,
+	30, 25, 2, 24, 55, 7, 2, 13, 14, 37, 3, 1,
+	3, 30, 3, 23, 7, 7, 25, 41, 2, 1, 3, 17,
+	10, 6, 11, 129, 5, 2, 2, 16, 13, 12, 14, 9,
+	16, 19, 96, 1, 6, 3, 6, 68, 31, 30, 3, 13,
+	4, 62, 37, 13, 19, 5, 15, 6, 49, 41, 94, 25,
+	4, 32, 6, 23,
+};
+static const uint16_t mapi_nameid_tags_by_proptag_slots[619] = {
+	419, 0, 415, 0, 221, 411, 42, 245, 453, 0, 451, 2,
+	204, 353, 95, 211, 65, 136, 0, 260, 119, 124, 325, 7,
+	480, 107, 0, 116, 365, 83, 214, 0, 44, 299, 481, 266,
+	296, 35, 0, 0, 4, 0, 0, 0, 0, 292, 175, 360,
+	397, 46, 154, 188, 27, 0, 444, 227, 12, 196, 201, 176,
+	0, 218, 41, 8, 123, 94, 421, 173, 485, 0, 275, 192,
+	6, 164, 234, 317, 29, 328, 0, 0, 141, 393, 404, 476,
+	494, 472, 320, 209, 416, 0, 462, 161, 262, 378, 471, 111,
+	0, 189, 80, 439, 0, 0, 50, 0, 40, 400, 0, 287,
+	0, 0, 250, 0, 289, 0, 25, 180, 263, 458, 332, 0,
+	177, 213, 16, 37, 187, 76, 235, 230, 294, 0, 160, 0,
+	301, 484, 30, 126, 0, 0, 108, 436, 129, 437, 246, 318,
+	478, 0, 183, 10, 182, 82, 219, 259, 298, 276, 185, 461,
+	282, 285, 0, 0, 269, 117, 338, 0, 341, 467, 457, 0,
+	440, 81, 412, 257, 354, 428, 0, 420, 0, 396, 232, 345,
+	0, 0, 36, 130, 145, 313, 0, 267, 0, 18, 0, 297,
+	100, 395, 0, 0, 0, 290, 248, 0, 0, 349, 0, 384,
+	487, 0, 445, 417, 264, 491, 438, 0, 469, 286, 389, 239,
+	91, 0, 359, 143, 45, 356, 302, 151, 489, 191, 343, 24,
+	153, 0, 326, 387, 493, 0, 0, 0, 475, 486, 337, 156,
+	357, 0, 329, 403, 242, 441, 413, 102, 0, 447, 288, 443,
+	408, 212, 103, 0, 283, 150, 0, 442, 407, 0, 492, 31,
+	152, 202, 144, 62, 336, 99, 131, 431, 0, 159, 375, 73,
+	468, 0, 381, 423, 0, 74, 401, 0, 186, 324, 330, 281,
+	139, 0, 133, 399, 21, 361, 495, 87, 368, 203, 105, 482,
+	128, 71, 88, 363, 406, 197, 140, 306, 115, 429, 84, 312,
+	43, 55, 0, 433, 5, 223, 373, 303, 358, 339, 0, 273,
+	0, 402, 311, 121, 405, 308, 166, 304, 0, 92, 383, 348,
+	135, 233, 448, 106, 162, 456, 174, 90, 86, 261, 300, 96,
+	78, 104, 0, 0, 0, 0, 93, 0, 32, 0, 310, 0,
+	17, 167, 382, 309, 0, 0, 112, 254, 66, 20, 432, 165,
+	61, 295, 473, 22, 377, 293, 70, 0, 238, 362, 0, 379,
+	256, 0, 0, 222, 194, 460, 98, 483, 424, 271, 0, 0,
+	77, 315, 101, 291, 120, 181, 270, 0, 0, 307, 195, 178,
+	113, 1, 0, 251, 258, 184, 26, 72, 243, 205, 0, 14,
+	331, 0, 226, 125, 3, 344, 380, 0, 0, 342, 386, 15,
+	0, 449, 236, 388, 334, 372, 193, 190, 0, 430, 0, 459,
+	314, 69, 122, 0, 394, 19, 157, 446, 0, 114, 137, 54,
+	198, 0, 179, 390, 240, 147, 247, 59, 127, 355, 488, 200,
+	376, 231, 479, 323, 225, 409, 155, 228, 351, 454, 57, 0,
+	280, 109, 364, 385, 374, 169, 206, 464, 168, 56, 346, 427,
+	138, 49, 0, 335, 370, 0, 89, 249, 237, 244, 255, 28,
+	0, 414, 33, 435, 366, 63, 67, 252, 224, 434, 52, 452,
+	327, 85, 51, 265, 319, 322, 0, 0, 0, 0, 158, 0,
+	229, 9, 97, 0, 199, 463, 0, 284, 367, 217, 210, 279,
+	455, 134, 39, 75, 477, 79, 216, 172, 391, 350, 149, 352,
+	38, 369, 142, 215, 148, 13, 241, 340, 274, 333, 34, 316,
+	11, 470, 64, 426, 0, 163, 68, 371, 0, 208, 47, 253,
+	410, 146, 53, 0, 110, 474, 48, 207, 0, 277, 268, 465,
+	60, 0, 305, 170, 425, 278, 58, 0, 23, 321, 0, 0,
+	118, 0, 450, 132, 347, 0, 0, 272, 490, 392, 220, 418,
+	398, 0, 0, 466, 171, 0, 422,
+};
+static const struct mapi_phash mapi_nameid_tags_by_proptag = {
+	mapi_nameid_tags_by_proptag_seeds, 124, mapi_nameid_tags_by_proptag_slots, 619
+};
+
+static const uint32_t mapi_nameid_tags_by_lid_seeds[92] = {
+	2, 1, 2, 10, 1, 1, 5, 6, 13, 1, 1, 6,
+	16, 26, 61, 0, 40, 2, 5, 14, 6, 17, 11, 9,
+	10, 19, 2, 3, 22, 1, 2, 5, 24, 31, 2, 53,
+	3, 9, 41, 27, 5, 5, 2, 10, 27, 4, 5, 25,
+	2, 4, 7, 7, 1, 1, 24, 10, 7, 6, 1, 26,
+	4, 53, 1, 5, 8, 11, 11, 69, 4, 42, 121, 77,
+	7, 16, 1, 29, 18, 1, 13, 0, 8, 65, 13, 23,
+	93, 1, 13, 3, 11, 7, 29, 9,
+};
+static const uint16_t mapi_nameid_tags_by_lid_slots[458] = {
+	44, 269, 120, 122, 301, 29, 274, 0, 0, 318, 144, 302,
+	277, 226, 0, 259, 357, 33, 0, 64, 139, 240, 352, 292,
+	0, 348, 317, 92, 0, 232, 331, 328, 72, 138, 60, 315,
+	351, 0, 0, 200, 85, 243, 311, 56, 289, 36, 13, 0,
+	20, 263, 183, 205, 196, 0, 9, 282, 62, 206, 178, 244,
+	329, 148, 0, 0, 130, 167, 0, 335, 233, 69, 0, 35,
+	49, 153, 89, 187, 251, 0, 86, 58, 256, 102, 0, 95,
+	143, 190, 71, 59, 260, 0, 347, 184, 253, 316, 21, 0,
+	115, 23, 76, 220, 185, 0, 155, 327, 0, 142, 294, 227,
+	234, 169, 79, 0, 30, 201, 0, 305, 108, 314, 0, 160,
+	1, 61, 288, 141, 354, 91, 280, 0, 360, 0, 0, 239,
+	182, 266, 171, 83, 0, 0, 106, 96, 307, 258, 42, 134,
+	0, 218, 0, 230, 0, 180, 177, 34, 0, 93, 285, 332,
+	257, 279, 0, 225, 199, 0, 249, 363, 0, 5, 216, 146,
+	221, 212, 0, 149, 24, 312, 133, 298, 26, 295, 12, 32,
+	0, 19, 51, 181, 117, 0, 297, 264, 215, 344, 173, 168,
+	0, 321, 345, 0, 80, 0, 275, 0, 0, 0, 0, 68,
+	128, 2, 46, 0, 67, 0, 281, 0, 31, 0, 326, 111,
+	0, 0, 330, 213, 214, 150, 88, 132, 0, 0, 342, 208,
+	127, 0, 52, 14, 192, 273, 70, 109, 0, 77, 250, 204,
+	300, 87, 126, 0, 309, 322, 0, 0, 151, 18, 119, 359,
+	156, 0, 101, 43, 286, 0, 172, 349, 0, 0, 0, 48,
+	174, 37, 276, 113, 271, 194, 241, 0, 355, 136, 356, 0,
+	125, 0, 137, 65, 10, 0, 45, 54, 0, 308, 252, 47,
+	246, 313, 242, 224, 140, 118, 341, 74, 283, 219, 7, 272,
+	123, 364, 340, 25, 0, 186, 255, 39, 0, 27, 145, 278,
+	163, 191, 0, 495, 0, 217, 98, 338, 41, 319, 334, 63,
+	159, 0, 110, 222, 0, 254, 296, 147, 268, 82, 121, 3,
+	193, 320, 0, 0, 129, 8, 0, 0, 57, 131, 0, 210,
+	188, 0, 197, 365, 299, 135, 6, 228, 207, 105, 158, 189,
+	291, 162, 209, 203, 157, 238, 17, 81, 211, 0, 306, 343,
+	0, 16, 152, 323, 0, 154, 0, 124, 265, 270, 11, 358,
+	22, 247, 50, 223, 4, 104, 66, 73, 229, 161, 303, 202,
+	337, 346, 267, 53, 248, 0, 0, 84, 40, 0, 350, 336,
+	293, 116, 99, 304, 353, 28, 90, 361, 170, 103, 261, 195,
+	164, 179, 166, 362, 284, 112, 165, 287, 176, 94, 333, 236,
+	114, 0, 310, 55, 231, 78, 75, 0, 0, 0, 198, 38,
+	290, 107, 235, 237, 262, 245, 324, 325, 339, 15, 0, 175,
+	100, 97,
+};
+static const struct mapi_phash mapi_nameid_tags_by_lid = {
+	mapi_nameid_tags_by_lid_seeds, 92, mapi_nameid_tags_by_lid_slots, 458
+};
+
+static const uint32_t mapi_nameid_tags_by_name_seeds[33] = {
+	1, 12, 26, 1, 1, 3, 1, 2, 4, 13, 2, 1,
+	22, 67, 3, 69, 19, 1, 1, 6, 5, 18, 9, 7,
+	117, 70, 3, 4, 1, 7, 56, 1, 1,
+};
+static const uint16_t mapi_nameid_tags_by_name_slots[162] = {
+	469, 435, 0, 457, 442, 429, 426, 379, 0, 373, 412, 382,
+	0, 430, 0, 0, 381, 424, 376, 0, 393, 402, 417, 374,
+	396, 485, 400, 428, 462, 438, 0, 479, 0, 375, 472, 425,
+	464, 0, 413, 0, 460, 450, 380, 384, 398, 411, 475, 441,
+	397, 448, 403, 0, 465, 456, 0, 378, 395, 419, 367, 386,
+	449, 416, 432, 468, 399, 459, 455, 447, 463, 409, 470, 392,
+	0, 427, 483, 388, 0, 385, 0, 0, 394, 453, 0, 451,
+	471, 461, 421, 404, 423, 366, 407, 389, 433, 391, 387, 439,
+	444, 489, 446, 383, 477, 473, 414, 0, 368, 440, 443, 487,
+	452, 0, 377, 0, 0, 390, 437, 0, 436, 454, 434, 492,
+	415, 467, 0, 418, 0, 0, 405, 410, 491, 458, 371, 370,
+	0, 486, 0, 422, 476, 406, 481, 0, 474, 0, 480, 490,
+	408, 482, 0, 431, 420, 0, 401, 484, 445, 0, 369, 488,
+	493, 494, 466, 372, 478, 0,
+};
+static const struct mapi_phash mapi_nameid_tags_by_name = {
+	mapi_nameid_tags_by_name_seeds, 33, mapi_nameid_tags_by_name_slots, 162
+};
+
+static const uint32_t mapi_nameid_tags_by_OOM_seeds[91] = {
+	8, 1, 0, 27, 6, 4, 7, 61, 7, 1, 4, 13,
+	21, 0, 7, 1, 11, 1, 20, 8, 23, 1, 21, 1,
+	3, 4, 4, 1, 34, 16, 4, 1, 47, 2, 9, 1,
+	30, 5, 2, 15, 4, 70, 43, 4, 10, 2, 1, 4,
+	48, 7, 51, 26, 8, 9, 3, 4, 43, 1, 14, 13,
+	6, 4, 4, 27, 1, 3, 42, 8, 6, 13, 4, 10,
+	1, 8, 41, 5, 16, 4, 14, 19, 2, 22, 8, 1,
+	43, 82, 61, 3, 4, 8, 24,
+};
+static const uint16_t mapi_nameid_tags_by_OOM_slots[453] = {
+	212, 308, 53, 216, 0, 0, 6, 68, 224, 81, 0, 270,
+	77, 334, 0, 329, 22, 43, 350, 89, 332, 291, 130, 60,
+	109, 0, 12, 0, 17, 269, 120, 172, 268, 337, 328, 25,
+	182, 243, 271, 98, 280, 266, 0, 345, 162, 286, 306, 48,
+	210, 127, 362, 301, 310, 0, 0, 293, 91, 151, 121, 0,
+	11, 3, 288, 233, 240, 295, 0, 0, 0, 70, 78, 0,
+	122, 169, 0, 41, 294, 180, 0, 0, 365, 235, 246, 150,
+	211, 0, 166, 0, 279, 20, 265, 214, 0, 152, 147, 344,
+	4, 341, 215, 29, 119, 320, 181, 360, 170, 284, 134, 8,
+	352, 0, 247, 283, 315, 218, 177, 324, 55, 203, 259, 281,
+	66, 205, 165, 232, 13, 192, 164, 0, 228, 35, 0, 255,
+	311, 0, 129, 23, 128, 331, 495, 0, 264, 88, 336, 47,
+	161, 0, 343, 168, 0, 326, 237, 67, 113, 0, 34, 0,
+	136, 213, 0, 206, 0, 0, 195, 31, 131, 133, 292, 319,
+	103, 37, 231, 236, 300, 290, 0, 234, 46, 0, 163, 199,
+	44, 143, 14, 124, 0, 201, 189, 262, 0, 0, 0, 327,
+	36, 0, 263, 257, 0, 335, 0, 230, 0, 322, 54, 0,
+	142, 19, 267, 0, 100, 0, 0, 348, 0, 0, 92, 249,
+	108, 260, 248, 93, 220, 0, 158, 338, 69, 110, 217, 0,
+	209, 102, 18, 64, 340, 141, 229, 198, 123, 299, 84, 0,
+	59, 0, 85, 0, 114, 125, 73, 0, 101, 276, 313, 99,
+	0, 0, 30, 49, 96, 242, 250, 222, 137, 0, 342, 358,
+	0, 160, 26, 184, 297, 112, 144, 361, 188, 302, 305, 278,
+	307, 58, 0, 191, 0, 241, 10, 227, 115, 118, 63, 82,
+	330, 0, 80, 7, 207, 285, 351, 117, 51, 132, 0, 193,
+	171, 353, 0, 52, 0, 9, 155, 146, 0, 357, 167, 0,
+	317, 57, 65, 187, 0, 0, 251, 256, 277, 104, 145, 139,
+	0, 347, 0, 354, 16, 321, 0, 244, 148, 364, 0, 90,
+	316, 0, 179, 38, 74, 42, 245, 303, 312, 238, 0, 258,
+	45, 287, 253, 2, 111, 24, 223, 204, 346, 304, 72, 239,
+	325, 0, 138, 0, 355, 0, 87, 97, 106, 79, 254, 75,
+	359, 0, 126, 157, 39, 105, 0, 61, 33, 298, 197, 140,
+	116, 173, 40, 32, 208, 196, 318, 0, 62, 159, 202, 356,
+	0, 71, 0, 83, 226, 225, 107, 200, 296, 289, 149, 50,
+	176, 282, 156, 0, 252, 194, 363, 323, 56, 5, 339, 94,
+	275, 95, 0, 261, 0, 86, 0, 309, 183, 219, 221, 174,
+	0, 76, 0, 349, 273, 135, 0, 272, 274, 0, 154, 21,
+	1, 0, 28, 314, 185, 153, 333, 15, 27,
+};
+static const struct mapi_phash mapi_nameid_tags_by_OOM = {
+	mapi_nameid_tags_by_OOM_seeds, 91, mapi_nameid_tags_by_OOM_slots, 453
+};
+
+
 static struct mapi_nameid_names mapi_nameid_names[] = {
 { PidLidAddressBookProviderArrayType                          , "PidLidAddressBookProviderArrayType" },
 { PidLidAddressBookProviderEmailList                          , "PidLidAddressBookProviderEmailList" },
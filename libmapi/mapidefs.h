@@ -143,6 +143,9 @@
 #define	TABLE_START		0x0
 #define	TABLE_CUR		0x1
 
+/* QueryRows client side flags, never sent to the server */
+#define	TBL_ARENA_ROWS		0x80
+
 /*
  * ENTRYID flags
  */
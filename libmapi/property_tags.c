@@ -1195,22 +1195,427 @@ static struct mapi_proptags canonical_property_tags[] = {
 	{ 0,                                                                  0,            "NULL"                                                              }
 };
 
+static const uint32_t canonical_property_tags_by_tag_seeds[287] = {
+	5, 2, 1, 12, 2, 2, 19, 14, 1, 1, 16, 15,
+	19, 22, 2, 2, 7, 9, 39, 1, 1, 1, 10, 4,
+	14, 1, 37, 2, 5, 1, 34, 4, 8, 2, 3, 10,
+	1, 16, 23, 3, 22, 2, 1, 7, 1, 5, 2, 10,
+	71, 8, 1, 12, 7, 60, 1, 29, 20, 0, 4, 1,
+	11, 3, 24, 5, 25, 2, 32, 5, 4, 32, 2, 6,
+	2, 9, 69, 1, 9, 3, 18, 10, 4, 2, 10, 3,
+	4, 5, 1, 11, 55, 3, 3, 3, 20, 16, 6, 7,
+	13, 20, 21, 38, 11, 1, 4, 62, 1, 1, 5, 2,
+	6, 8, 1, 1, 4, 7, 7, 3, 14, 17, 54, 6,
+	19, 1, 1, 5, 5, 6, 1, 35, 1, 56, 3, 5,
+	2, 7, 2, 3, 16, 19, 34, 5, 3, 10, 8, 6,
+	1, 2, 5, 1, 33, 9, 101, 2, 40, 10, 1, 5,
+	4, 1, 5, 2, 1, 15, 4, 21, 6, 0, 113, 10,
+	28, 5, 16, 37, 23, 21, 1, 26, 36, 1, 3, 4,
+	24, 1, 0, 9, 88, 27, 4, 7, 2, 1, 67, 11,
+	1, 3, 97, 20, 12, 7, 26, 34, 2, 18, 2, 23,
+	17, 15, 1, 6, 116, 14, 38, 37, 80, 1, 35, 28,
+	2, 5, 31, 5, 12, 5, 71, 39, 7, 14, 13, 25,
+	6, 6, 19, 12, 2, 11, 4, 7, 32, 16, 4, 7,
+	9, 17, 3, 65, 5, 10, 3, 50, 73, 17, 3, 11,
+	21, 5, 36, 11, 6, 46, 5, 26, 17, 30, 4, 257,
+	55, 55, 10, 2, 21, 46, 44, 1, 48, 2, 7, 26,
+	5, 46, 34, 3, 28, 5, 3, 75, 35, 5, 3,
+};
+static const uint16_t canonical_property_tags_by_tag_slots[1431] = {
+	637, 710, 669, 432, 1014, 914, 57, 608, 512, 1019, 0, 135,
+	331, 1176, 887, 335, 820, 0, 1062, 0, 1153, 738, 421, 1095,
+	832, 0, 847, 817, 731, 692, 861, 918, 515, 700, 389, 321,
+	0, 713, 278, 61, 404, 615, 863, 1042, 438, 322, 901, 1154,
+	1170, 58, 414, 684, 479, 216, 595, 0, 530, 299, 0, 0,
+	125, 483, 633, 376, 451, 0, 827, 0, 769, 903, 375, 444,
+	0, 0, 735, 330, 0, 924, 0, 890, 1147, 292, 940, 202,
+	197, 0, 850, 27, 851, 541, 0, 199, 120, 1024, 122, 849,
+	1126, 0, 905, 1116, 60, 0, 408, 645, 680, 0, 992, 802,
+	456, 0, 67, 506, 237, 0, 383, 0, 632, 103, 0, 0,
+	0, 663, 0, 0, 666, 380, 182, 270, 0, 831, 279, 977,
+	531, 1066, 0, 384, 1075, 1169, 689, 630, 0, 192, 248, 38,
+	810, 976, 461, 0, 1033, 241, 371, 980, 0, 324, 538, 999,
+	332, 70, 537, 927, 1022, 0, 0, 0, 173, 1086, 1058, 0,
+	0, 1123, 830, 564, 616, 379, 0, 470, 685, 187, 0, 165,
+	481, 347, 0, 1102, 422, 1003, 3, 928, 507, 670, 0, 843,
+	776, 1089, 1072, 73, 0, 0, 1073, 69, 0, 157, 0, 419,
+	0, 17, 1018, 681, 0, 636, 933, 428, 1157, 476, 74, 798,
+	683, 0, 834, 954, 1114, 0, 801, 426, 536, 449, 0, 931,
+	0, 424, 0, 0, 823, 652, 194, 18, 653, 750, 8, 881,
+	318, 963, 784, 0, 140, 690, 285, 589, 473, 175, 0, 770,
+	253, 0, 675, 835, 0, 1171, 0, 1013, 521, 1000, 917, 0,
+	701, 568, 66, 346, 0, 496, 351, 753, 0, 895, 0, 892,
+	78, 779, 208, 599, 272, 0, 902, 716, 134, 1078, 463, 973,
+	0, 966, 147, 0, 1074, 1056, 929, 24, 900, 915, 592, 529,
+	341, 407, 99, 719, 548, 0, 357, 153, 1158, 878, 7, 363,
+	401, 866, 97, 0, 912, 339, 373, 897, 896, 720, 813, 127,
+	1009, 0, 988, 656, 155, 0, 368, 482, 704, 0, 0, 551,
+	193, 0, 1008, 728, 430, 240, 166, 326, 405, 448, 602, 0,
+	0, 561, 724, 85, 41, 626, 445, 0, 909, 518, 846, 260,
+	116, 0, 868, 0, 824, 600, 726, 792, 872, 1036, 23, 0,
+	1092, 353, 0, 782, 845, 0, 614, 72, 1168, 1099, 0, 569,
+	1006, 290, 450, 0, 582, 891, 180, 0, 586, 490, 642, 0,
+	21, 672, 255, 435, 431, 594, 787, 420, 558, 50, 516, 1134,
+	12, 1002, 638, 308, 0, 990, 0, 273, 1079, 117, 960, 1175,
+	634, 0, 0, 757, 439, 1128, 563, 217, 452, 500, 585, 1071,
+	1061, 1029, 631, 96, 545, 265, 525, 1021, 610, 997, 1159, 968,
+	571, 156, 705, 0, 989, 195, 386, 0, 926, 718, 993, 547,
+	259, 0, 814, 143, 508, 112, 163, 1005, 302, 215, 0, 0,
+	555, 959, 899, 1044, 565, 338, 33, 0, 1046, 0, 394, 225,
+	0, 0, 0, 348, 0, 82, 210, 833, 396, 1173, 458, 517,
+	0, 811, 725, 320, 0, 0, 542, 709, 1096, 603, 305, 0,
+	423, 45, 101, 662, 706, 291, 0, 0, 0, 1053, 75, 333,
+	447, 0, 137, 937, 1007, 0, 691, 621, 48, 242, 469, 0,
+	107, 0, 436, 978, 393, 105, 271, 562, 650, 1124, 123, 0,
+	693, 159, 235, 0, 0, 0, 733, 293, 0, 200, 63, 0,
+	0, 410, 0, 746, 0, 524, 605, 619, 821, 232, 852, 0,
+	0, 505, 745, 1047, 591, 540, 0, 366, 204, 382, 0, 583,
+	301, 152, 730, 606, 504, 667, 946, 1070, 763, 142, 945, 1012,
+	1026, 108, 588, 0, 1178, 80, 0, 114, 86, 855, 593, 876,
+	427, 0, 628, 1064, 249, 1043, 460, 739, 874, 236, 0, 350,
+	91, 160, 239, 590, 46, 0, 43, 921, 889, 898, 0, 972,
+	462, 453, 804, 577, 0, 919, 995, 440, 893, 0, 624, 297,
+	0, 471, 556, 1179, 298, 828, 495, 0, 358, 1151, 6, 487,
+	943, 334, 777, 1059, 494, 1035, 625, 455, 743, 0, 1166, 0,
+	81, 688, 390, 294, 211, 1141, 0, 493, 712, 884, 708, 789,
+	286, 527, 499, 314, 313, 223, 212, 576, 885, 1030, 925, 1180,
+	871, 0, 0, 864, 337, 1115, 856, 825, 939, 429, 1067, 55,
+	668, 364, 311, 1100, 552, 0, 695, 287, 1177, 246, 0, 251,
+	678, 104, 951, 613, 87, 1010, 10, 111, 28, 59, 171, 0,
+	732, 737, 296, 355, 520, 511, 385, 126, 597, 1088, 0, 177,
+	196, 0, 340, 359, 0, 679, 1120, 176, 748, 752, 362, 932,
+	740, 84, 93, 553, 1112, 247, 986, 686, 1068, 961, 207, 480,
+	146, 674, 941, 136, 1155, 790, 0, 475, 676, 879, 906, 68,
+	94, 257, 1015, 0, 0, 149, 0, 0, 312, 759, 870, 934,
+	130, 936, 0, 859, 655, 267, 1, 295, 316, 0, 349, 22,
+	0, 221, 25, 206, 620, 765, 1144, 40, 938, 129, 115, 783,
+	0, 797, 31, 560, 1101, 780, 0, 534, 0, 1152, 110, 0,
+	1167, 0, 0, 158, 0, 167, 0, 300, 434, 183, 0, 0,
+	372, 860, 550, 190, 696, 472, 343, 0, 411, 252, 715, 281,
+	513, 374, 0, 181, 1094, 49, 0, 0, 4, 673, 151, 729,
+	702, 1023, 0, 766, 0, 303, 0, 1052, 0, 841, 1084, 0,
+	1130, 658, 0, 774, 952, 139, 65, 230, 0, 0, 0, 44,
+	1027, 747, 37, 0, 0, 1148, 53, 258, 0, 244, 365, 947,
+	803, 1054, 0, 1138, 604, 416, 0, 503, 497, 0, 1020, 1051,
+	0, 0, 523, 488, 0, 0, 767, 649, 0, 276, 580, 0,
+	0, 201, 1028, 908, 0, 557, 0, 0, 1105, 699, 567, 1098,
+	0, 794, 1016, 0, 819, 64, 1063, 92, 965, 869, 399, 250,
+	877, 0, 310, 121, 0, 233, 822, 526, 11, 345, 815, 309,
+	0, 0, 0, 641, 0, 457, 0, 0, 467, 0, 617, 0,
+	635, 186, 1160, 764, 788, 1050, 1132, 325, 1017, 723, 546, 570,
+	397, 0, 654, 1032, 640, 502, 736, 415, 1041, 1164, 991, 953,
+	1172, 910, 119, 722, 0, 0, 83, 0, 398, 622, 188, 9,
+	930, 387, 714, 958, 465, 920, 95, 485, 853, 283, 836, 306,
+	218, 677, 288, 131, 191, 234, 894, 533, 254, 1104, 755, 609,
+	54, 179, 1146, 1048, 0, 1156, 721, 224, 857, 0, 417, 0,
+	627, 174, 491, 0, 771, 0, 0, 361, 762, 1025, 148, 42,
+	671, 1055, 818, 543, 0, 0, 601, 277, 0, 772, 707, 256,
+	760, 751, 1118, 948, 829, 768, 498, 888, 317, 0, 781, 962,
+	1122, 1108, 805, 327, 665, 0, 598, 0, 0, 413, 76, 0,
+	370, 646, 1119, 77, 0, 0, 862, 0, 660, 808, 307, 873,
+	184, 0, 168, 443, 402, 1093, 935, 509, 0, 492, 144, 778,
+	0, 0, 219, 106, 0, 319, 220, 1150, 13, 0, 0, 697,
+	162, 996, 0, 944, 228, 0, 336, 354, 574, 0, 32, 974,
+	377, 775, 842, 1081, 0, 922, 213, 395, 848, 0, 323, 141,
+	687, 409, 454, 886, 522, 1049, 344, 651, 734, 102, 356, 796,
+	539, 858, 807, 639, 391, 1031, 26, 904, 466, 629, 315, 406,
+	793, 913, 284, 883, 994, 956, 0, 0, 128, 0, 578, 554,
+	812, 442, 36, 661, 659, 1065, 0, 169, 0, 0, 949, 0,
+	826, 544, 867, 468, 304, 15, 854, 20, 34, 109, 486, 1136,
+	882, 749, 198, 400, 245, 0, 703, 596, 694, 0, 118, 484,
+	0, 474, 1069, 559, 535, 0, 16, 785, 464, 838, 262, 957,
+	566, 1034, 756, 0, 581, 549, 942, 243, 369, 1001, 0, 124,
+	227, 773, 950, 30, 226, 611, 185, 145, 727, 51, 282, 5,
+	209, 1161, 618, 1106, 367, 0, 229, 412, 741, 1087, 1060, 791,
+	360, 1085, 0, 328, 205, 392, 711, 0, 161, 433, 1080, 132,
+	0, 1004, 418, 1125, 0, 742, 1165, 56, 1039, 0, 19, 47,
+	1037, 35, 584, 761, 911, 998, 88, 575, 71, 150, 1162, 289,
+	806, 0, 510, 1083, 98, 170, 264, 381, 758, 0, 178, 816,
+	14, 0, 280, 916, 744, 0, 0, 0, 1057, 0, 875, 138,
+	0, 501, 754, 203, 573, 0, 0, 446, 275, 329, 800, 79,
+	0, 0, 840, 0, 478, 113, 1091, 643, 0, 0, 0, 214,
+	437, 1140, 0, 786, 1107, 880, 133, 648, 865, 837, 1163, 839,
+	62, 532, 0, 2, 0, 579, 987, 388, 231, 0, 403, 717,
+	519, 0, 0, 39, 644, 1082, 477, 0, 266, 0, 1090, 1097,
+	799, 154, 1040, 964, 1038, 657, 52, 0, 89, 100, 844, 164,
+	572, 0, 342, 261, 1174, 425, 352, 612, 1076, 489, 189, 682,
+	0, 269, 0, 1045, 1103, 647, 222, 698, 0, 263, 514, 274,
+	0, 907, 0, 795, 607, 955, 1077, 528, 0, 1139, 29, 268,
+	664, 809, 378,
+};
+static const struct mapi_phash canonical_property_tags_by_tag = {
+	canonical_property_tags_by_tag_seeds, 287, canonical_property_tags_by_tag_slots, 1431
+};
+
+static const uint32_t canonical_property_tags_by_name_seeds[296] = {
+	1, 7, 45, 9, 7, 11, 1, 38, 7, 3, 11, 2,
+	2, 33, 2, 59, 8, 12, 2, 28, 37, 11, 24, 5,
+	2, 4, 2, 15, 6, 13, 3, 7, 6, 37, 1, 9,
+	9, 10, 1, 1, 16, 4, 4, 1, 11, 12, 1, 25,
+	1, 5, 2, 1, 2, 1, 2, 12, 37, 31, 12, 8,
+	1, 44, 10, 13, 12, 17, 14, 22, 3, 30, 2, 1,
+	2, 33, 20, 11, 6, 13, 0, 1, 8, 1, 6, 1,
+	8, 1, 10, 5, 3, 7, 6, 7, 2, 6, 26, 7,
+	10, 33, 24, 2, 7, 55, 20, 2, 2, 1, 13, 2,
+	1, 1, 24, 4, 11, 4, 8, 15, 43, 3, 6, 7,
+	3, 4, 1, 30, 12, 1, 3, 3, 1, 7, 17, 10,
+	33, 2, 9, 1, 1, 10, 8, 13, 19, 6, 0, 1,
+	9, 9, 15, 9, 10, 4, 18, 4, 34, 37, 1, 9,
+	13, 4, 1, 11, 15, 4, 20, 1, 1, 10, 2, 4,
+	2, 64, 4, 11, 25, 3, 10, 2, 10, 10, 9, 25,
+	3, 1, 25, 32, 7, 5, 7, 14, 96, 3, 49, 1,
+	4, 4, 6, 30, 56, 8, 31, 32, 44, 2, 16, 4,
+	1, 5, 40, 3, 0, 5, 37, 128, 12, 1, 5, 1,
+	40, 15, 22, 1, 14, 12, 1, 1, 14, 6, 11, 29,
+	6, 19, 5, 12, 9, 22, 2, 28, 2, 36, 1, 3,
+	33, 73, 100, 5, 3, 24, 8, 40, 2, 19, 4, 14,
+	2, 1, 3, 44, 32, 8, 37, 3, 20, 1, 9, 21,
+	22, 22, 36, 45, 2, 36, 5, 23, 5, 122, 1, 9,
+	2, 33, 43, 25, 39, 43, 161, 50, 3, 13, 12, 24,
+	78, 62, 6, 25, 3, 2, 3, 21,
+};
+static const uint16_t canonical_property_tags_by_name_slots[1476] = {
+	469, 0, 160, 450, 439, 436, 385, 493, 234, 1039, 0, 392,
+	1147, 978, 260, 460, 881, 888, 974, 276, 0, 0, 0, 965,
+	116, 288, 76, 571, 449, 1173, 0, 0, 1106, 699, 307, 245,
+	0, 847, 673, 387, 0, 1054, 656, 126, 0, 130, 727, 736,
+	0, 839, 755, 1040, 0, 0, 88, 825, 388, 1067, 977, 532,
+	0, 376, 595, 850, 463, 207, 117, 0, 244, 432, 664, 85,
+	0, 750, 0, 301, 289, 605, 800, 1041, 142, 336, 1136, 0,
+	73, 0, 0, 0, 1034, 861, 0, 910, 603, 0, 254, 133,
+	0, 650, 660, 0, 578, 52, 794, 548, 364, 411, 0, 1090,
+	165, 0, 14, 894, 682, 1060, 863, 494, 0, 452, 787, 302,
+	658, 467, 420, 1029, 0, 0, 751, 1179, 922, 0, 275, 313,
+	0, 514, 0, 780, 175, 0, 581, 0, 278, 338, 19, 1128,
+	588, 172, 899, 498, 693, 378, 857, 849, 144, 226, 1158, 1036,
+	0, 248, 0, 74, 778, 1169, 81, 929, 912, 210, 476, 1050,
+	399, 841, 689, 409, 0, 320, 1144, 317, 1159, 256, 1177, 0,
+	927, 0, 0, 963, 167, 1073, 429, 680, 0, 61, 520, 505,
+	0, 1103, 777, 1089, 816, 229, 99, 964, 327, 1152, 1161, 1155,
+	416, 937, 0, 661, 140, 176, 0, 0, 0, 971, 291, 437,
+	545, 1015, 459, 0, 0, 382, 594, 1175, 1005, 196, 688, 286,
+	203, 0, 285, 1162, 882, 401, 572, 0, 0, 351, 930, 0,
+	263, 0, 419, 330, 723, 438, 897, 1042, 0, 0, 182, 901,
+	591, 573, 0, 1141, 0, 119, 909, 1088, 0, 32, 836, 859,
+	1163, 551, 611, 287, 0, 383, 1180, 402, 902, 300, 1065, 568,
+	0, 1008, 874, 967, 0, 90, 710, 950, 187, 807, 716, 0,
+	1101, 647, 0, 446, 252, 558, 60, 92, 0, 776, 622, 1112,
+	1168, 412, 0, 46, 0, 826, 0, 195, 0, 795, 0, 97,
+	734, 957, 277, 45, 0, 717, 0, 379, 0, 0, 0, 0,
+	934, 262, 0, 1153, 913, 531, 360, 48, 761, 886, 456, 404,
+	655, 0, 711, 349, 0, 1095, 0, 0, 805, 742, 670, 0,
+	0, 106, 103, 781, 258, 923, 992, 544, 78, 644, 115, 515,
+	869, 108, 1111, 524, 1018, 1170, 553, 318, 374, 482, 1129, 1069,
+	138, 350, 178, 729, 582, 157, 0, 503, 373, 181, 0, 739,
+	0, 569, 714, 1167, 352, 243, 0, 579, 878, 161, 121, 784,
+	0, 981, 0, 712, 269, 345, 251, 53, 0, 995, 823, 686,
+	1012, 127, 0, 479, 0, 867, 690, 820, 828, 68, 1117, 310,
+	1044, 1055, 0, 0, 0, 1064, 748, 1009, 796, 932, 546, 616,
+	691, 33, 0, 1026, 735, 266, 651, 24, 464, 306, 98, 654,
+	341, 0, 199, 343, 0, 928, 79, 54, 525, 1001, 109, 238,
+	340, 0, 335, 1127, 949, 221, 0, 763, 0, 189, 632, 938,
+	143, 0, 1045, 989, 1096, 20, 490, 576, 519, 30, 614, 1062,
+	0, 1003, 0, 135, 297, 272, 657, 468, 0, 744, 145, 0,
+	706, 915, 294, 697, 754, 832, 1038, 1070, 1072, 322, 0, 911,
+	217, 486, 530, 0, 65, 0, 0, 0, 921, 0, 268, 959,
+	125, 0, 0, 0, 77, 891, 1107, 0, 0, 1119, 966, 918,
+	220, 695, 753, 1079, 1019, 0, 1146, 0, 0, 62, 141, 0,
+	395, 356, 200, 83, 5, 136, 721, 423, 154, 445, 31, 1137,
+	218, 770, 737, 1157, 733, 585, 715, 791, 782, 39, 562, 0,
+	612, 0, 1122, 153, 1142, 692, 0, 0, 752, 557, 0, 18,
+	94, 534, 29, 462, 0, 953, 819, 0, 0, 731, 0, 533,
+	1108, 325, 876, 489, 877, 1024, 164, 0, 316, 1121, 889, 16,
+	461, 0, 0, 979, 649, 0, 23, 1046, 570, 1053, 607, 70,
+	617, 403, 0, 1063, 194, 1151, 257, 821, 817, 728, 1016, 1085,
+	527, 42, 0, 772, 1013, 792, 962, 361, 628, 410, 36, 308,
+	0, 696, 312, 1028, 0, 50, 0, 0, 0, 609, 0, 418,
+	812, 555, 131, 499, 0, 855, 749, 996, 633, 1150, 0, 540,
+	390, 574, 1002, 1154, 1172, 0, 400, 0, 890, 1126, 477, 833,
+	1134, 641, 0, 236, 827, 0, 1131, 789, 0, 59, 854, 908,
+	332, 589, 892, 602, 227, 629, 342, 1092, 0, 732, 590, 0,
+	339, 864, 44, 0, 396, 0, 0, 0, 1082, 0, 858, 434,
+	1123, 250, 703, 765, 124, 233, 55, 663, 211, 543, 740, 0,
+	333, 1100, 37, 0, 508, 0, 1116, 1080, 225, 550, 21, 592,
+	943, 1027, 247, 955, 0, 638, 314, 0, 0, 1075, 940, 331,
+	1109, 357, 41, 630, 596, 0, 942, 282, 933, 986, 871, 71,
+	346, 1047, 975, 563, 0, 1097, 997, 887, 925, 0, 606, 984,
+	223, 618, 428, 371, 231, 51, 112, 1049, 708, 0, 945, 230,
+	1020, 0, 738, 1074, 430, 274, 149, 985, 667, 952, 122, 793,
+	0, 1068, 935, 840, 63, 421, 0, 0, 0, 0, 146, 0,
+	444, 10, 1118, 0, 0, 0, 636, 1174, 296, 1035, 363, 687,
+	998, 40, 620, 0, 895, 626, 838, 107, 137, 677, 1132, 987,
+	684, 17, 0, 326, 328, 448, 0, 0, 567, 907, 93, 830,
+	516, 1143, 1140, 273, 903, 564, 1176, 0, 1113, 1071, 1098, 713,
+	293, 675, 0, 0, 249, 186, 709, 623, 0, 0, 0, 86,
+	102, 0, 1160, 976, 580, 961, 458, 951, 1110, 831, 946, 1114,
+	1133, 920, 0, 0, 702, 0, 662, 613, 0, 993, 66, 529,
+	970, 484, 0, 972, 417, 1083, 668, 0, 764, 973, 619, 615,
+	958, 213, 1120, 0, 914, 1087, 802, 253, 1124, 237, 842, 0,
+	822, 398, 58, 466, 0, 0, 875, 9, 132, 758, 162, 1102,
+	0, 366, 241, 295, 707, 204, 0, 298, 35, 174, 495, 0,
+	798, 747, 323, 222, 0, 177, 123, 726, 150, 1048, 208, 0,
+	457, 0, 926, 0, 883, 216, 896, 790, 779, 100, 49, 455,
+	705, 0, 983, 678, 0, 536, 12, 447, 0, 228, 171, 759,
+	1037, 283, 0, 377, 0, 134, 936, 554, 610, 634, 746, 0,
+	0, 0, 0, 885, 315, 566, 304, 1, 879, 1084, 1078, 440,
+	1052, 639, 513, 64, 413, 835, 1051, 0, 0, 0, 0, 0,
+	948, 637, 427, 435, 488, 0, 156, 355, 522, 321, 809, 209,
+	151, 786, 259, 681, 344, 96, 773, 517, 219, 190, 722, 1139,
+	0, 0, 192, 0, 56, 785, 865, 246, 0, 0, 994, 954,
+	380, 893, 843, 523, 642, 818, 1135, 947, 359, 512, 0, 139,
+	118, 1056, 354, 0, 168, 0, 769, 774, 279, 0, 584, 0,
+	148, 311, 0, 470, 0, 0, 810, 329, 577, 319, 27, 745,
+	163, 1099, 265, 509, 299, 905, 906, 239, 939, 762, 640, 694,
+	760, 158, 1093, 280, 426, 872, 128, 844, 407, 1021, 803, 969,
+	597, 586, 718, 0, 1165, 271, 84, 491, 375, 757, 281, 679,
+	587, 391, 1004, 72, 89, 811, 173, 386, 931, 506, 956, 1077,
+	676, 538, 202, 526, 0, 0, 0, 292, 224, 183, 180, 868,
+	725, 0, 1145, 212, 198, 15, 999, 982, 511, 11, 0, 837,
+	1025, 1057, 601, 856, 111, 465, 0, 214, 552, 25, 1091, 846,
+	1164, 485, 0, 1156, 1061, 646, 487, 528, 0, 472, 26, 481,
+	483, 0, 1006, 0, 442, 155, 0, 719, 369, 1000, 698, 621,
+	1031, 1104, 665, 556, 1094, 87, 1033, 4, 496, 453, 1058, 801,
+	1105, 80, 880, 0, 598, 75, 184, 454, 242, 771, 659, 206,
+	147, 0, 166, 808, 0, 560, 7, 480, 0, 6, 960, 1030,
+	0, 95, 370, 0, 0, 671, 542, 990, 852, 500, 497, 853,
+	129, 666, 783, 1138, 406, 806, 0, 720, 414, 69, 685, 1023,
+	82, 1007, 405, 1166, 425, 834, 197, 1130, 205, 672, 384, 28,
+	797, 0, 924, 422, 362, 1017, 815, 0, 941, 0, 492, 851,
+	471, 635, 502, 441, 188, 898, 365, 904, 113, 0, 583, 988,
+	0, 518, 860, 575, 22, 0, 347, 1171, 424, 191, 873, 415,
+	743, 643, 669, 804, 604, 372, 255, 535, 0, 367, 104, 324,
+	593, 105, 521, 1010, 900, 507, 0, 13, 799, 159, 0, 917,
+	0, 433, 0, 1115, 397, 368, 348, 768, 1066, 179, 478, 652,
+	624, 0, 0, 608, 0, 474, 559, 38, 1125, 0, 120, 1059,
+	0, 0, 43, 235, 788, 683, 267, 334, 599, 0, 0, 539,
+	0, 0, 991, 201, 270, 393, 775, 870, 309, 101, 919, 1022,
+	261, 0, 824, 845, 475, 1149, 185, 1178, 600, 0, 0, 193,
+	504, 353, 0, 541, 110, 1086, 57, 627, 290, 170, 34, 215,
+	741, 305, 501, 0, 829, 284, 766, 473, 2, 648, 232, 561,
+	240, 1148, 0, 0, 3, 0, 394, 443, 653, 700, 169, 264,
+	0, 813, 381, 884, 337, 510, 537, 565, 0, 547, 980, 1076,
+	848, 724, 674, 0, 625, 862, 0, 1011, 0, 431, 645, 0,
+	8, 0, 303, 756, 152, 0, 968, 916, 0, 704, 730, 91,
+	47, 0, 631, 358, 0, 1014, 1081, 114, 814, 0, 389, 0,
+	701, 0, 0, 408, 549, 1032, 767, 866, 944, 67, 451, 1043,
+};
+static const struct mapi_phash canonical_property_tags_by_name = {
+	canonical_property_tags_by_name_seeds, 296, canonical_property_tags_by_name_slots, 1476
+};
+
+static const uint32_t canonical_property_tags_by_id_seeds[144] = {
+	181, 66, 18, 55, 43, 1, 42, 70, 35, 34, 19, 0,
+	56, 27, 15, 2, 94, 78, 32, 42, 0, 2, 3, 1,
+	130, 19, 1, 4, 1, 23, 33, 28, 1, 70, 79, 7,
+	12, 54, 46, 2, 139, 66, 8, 10, 3, 26, 147, 4,
+	47, 131, 1, 25, 42, 7, 167, 55, 183, 65, 33, 42,
+	269, 96, 27, 57, 12, 1, 80, 3, 102, 10, 81, 48,
+	1, 154, 12, 9, 104, 16, 13, 27, 7, 70, 24, 78,
+	69, 32, 177, 0, 110, 2, 1, 130, 107, 21, 32, 41,
+	48, 3, 57, 106, 38, 216, 1, 85, 130, 199, 22, 2,
+	0, 11, 41, 136, 3, 6, 263, 2, 1, 103, 35, 102,
+	55, 153, 171, 229, 30, 1, 8, 39, 5, 85, 172, 3,
+	15, 7, 15, 32, 75, 230, 118, 18, 61, 233, 15, 14,
+};
+static const uint16_t canonical_property_tags_by_id_slots[716] = {
+	856, 0, 309, 1004, 1167, 0, 151, 860, 0, 197, 1086, 0,
+	753, 0, 938, 704, 0, 149, 866, 430, 464, 389, 1030, 311,
+	568, 1154, 0, 27, 0, 828, 225, 1018, 0, 271, 1122, 0,
+	740, 53, 0, 153, 848, 1156, 1082, 854, 0, 0, 988, 205,
+	1094, 343, 117, 0, 0, 724, 868, 716, 105, 249, 448, 36,
+	776, 1124, 824, 1138, 207, 353, 0, 0, 1, 0, 1034, 788,
+	530, 179, 1106, 25, 394, 0, 1038, 317, 0, 786, 947, 0,
+	1000, 550, 0, 626, 19, 51, 0, 344, 0, 337, 0, 882,
+	1020, 588, 0, 0, 0, 890, 7, 1176, 0, 1024, 1076, 840,
+	185, 371, 596, 686, 375, 1165, 0, 0, 267, 373, 113, 0,
+	562, 558, 255, 831, 536, 870, 926, 1102, 436, 450, 0, 143,
+	297, 438, 0, 133, 165, 1048, 291, 0, 245, 61, 0, 123,
+	313, 0, 385, 528, 878, 135, 632, 0, 672, 486, 492, 668,
+	951, 91, 327, 594, 0, 67, 0, 614, 0, 1084, 38, 732,
+	830, 694, 213, 755, 1028, 155, 121, 1173, 0, 736, 325, 1088,
+	404, 379, 720, 790, 0, 910, 592, 367, 901, 480, 1080, 211,
+	1022, 898, 46, 880, 99, 95, 906, 1052, 0, 742, 1012, 263,
+	0, 408, 658, 0, 281, 0, 357, 289, 0, 751, 1057, 1014,
+	996, 710, 414, 1162, 2, 920, 1160, 1078, 606, 804, 998, 0,
+	992, 904, 193, 640, 696, 0, 662, 273, 494, 930, 542, 217,
+	718, 0, 572, 552, 0, 0, 139, 106, 670, 1168, 0, 644,
+	660, 602, 0, 702, 598, 0, 257, 0, 618, 361, 582, 402,
+	377, 452, 759, 1026, 778, 1170, 0, 0, 564, 1006, 962, 1096,
+	1150, 456, 0, 478, 876, 1174, 774, 109, 0, 1036, 0, 0,
+	0, 544, 201, 81, 826, 0, 858, 0, 15, 1098, 462, 87,
+	125, 730, 945, 243, 666, 1180, 391, 0, 508, 359, 556, 1114,
+	490, 1044, 0, 228, 630, 834, 604, 175, 738, 223, 191, 319,
+	303, 301, 844, 814, 331, 1040, 764, 219, 934, 0, 728, 0,
+	884, 940, 862, 872, 265, 93, 400, 0, 0, 682, 40, 0,
+	524, 181, 363, 794, 846, 0, 159, 63, 420, 636, 0, 852,
+	73, 0, 650, 396, 994, 0, 757, 347, 269, 799, 548, 0,
+	392, 0, 600, 818, 275, 762, 9, 612, 638, 295, 0, 1092,
+	428, 446, 101, 137, 664, 241, 534, 1140, 42, 0, 0, 874,
+	805, 518, 69, 772, 1064, 0, 398, 0, 972, 0, 115, 0,
+	0, 468, 576, 167, 1164, 656, 0, 333, 913, 0, 239, 145,
+	141, 0, 474, 329, 749, 822, 65, 520, 472, 1050, 0, 1152,
+	323, 1166, 0, 1146, 0, 1060, 381, 482, 355, 189, 131, 642,
+	0, 424, 692, 931, 924, 842, 321, 251, 0, 608, 349, 0,
+	0, 1172, 580, 526, 634, 782, 0, 712, 928, 1158, 1169, 129,
+	900, 1153, 307, 77, 850, 964, 55, 624, 770, 1118, 706, 0,
+	383, 744, 1090, 0, 365, 797, 726, 199, 13, 0, 0, 554,
+	566, 444, 187, 616, 514, 341, 350, 161, 836, 85, 0, 0,
+	678, 652, 369, 230, 35, 502, 747, 0, 412, 476, 21, 0,
+	0, 4, 690, 734, 1046, 0, 838, 522, 1008, 496, 0, 0,
+	0, 277, 512, 646, 0, 506, 894, 498, 209, 688, 169, 916,
+	31, 1177, 173, 0, 1159, 33, 610, 816, 1066, 648, 918, 540,
+	418, 119, 0, 1062, 466, 221, 442, 259, 680, 1179, 510, 820,
+	0, 0, 936, 434, 0, 780, 676, 23, 768, 1175, 410, 195,
+	1032, 1151, 796, 0, 484, 299, 315, 1068, 177, 0, 0, 1157,
+	261, 387, 584, 0, 1070, 422, 1163, 714, 335, 454, 416, 287,
+	888, 488, 279, 0, 0, 0, 1104, 0, 560, 956, 203, 674,
+	892, 1178, 812, 537, 1161, 292, 183, 1002, 0, 29, 127, 103,
+	0, 886, 339, 1171, 1074, 504, 0, 97, 0, 942, 922, 896,
+	215, 305, 0, 578, 0, 235, 57, 0, 722, 990, 156, 500,
+	71, 111, 283, 247, 406, 708, 426, 17, 808, 10, 0, 0,
+	0, 654, 1041, 949, 546, 59, 792, 784, 516, 954, 960, 0,
+	0, 684, 746, 0, 944, 532, 253, 470, 285, 698, 232, 0,
+	766, 1155, 0, 908, 986, 147, 163, 0, 700, 1056, 0, 1016,
+	570, 227, 0, 460, 574, 810, 432, 976, 0, 912, 590, 1054,
+	1072, 802, 864, 1100, 628, 958, 44, 49,
+};
+static const struct mapi_phash canonical_property_tags_by_id = {
+	canonical_property_tags_by_id_seeds, 144, canonical_property_tags_by_id_slots, 716
+};
+
+static uint32_t canonical_property_tags_find_tag(uint32_t proptag)
+{
+	uint8_t		key[4];
+	uint32_t	idx;
+
+	key[0] = proptag & 0xFF;
+	key[1] = (proptag >> 8) & 0xFF;
+	key[2] = (proptag >> 16) & 0xFF;
+	key[3] = (proptag >> 24) & 0xFF;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_tag, NULL, 0, key, sizeof (key));
+	if (!idx || canonical_property_tags[idx - 1].proptag != proptag) {
+		return 0;
+	}
+	return idx;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
 	uint32_t idx;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	if (!proptag) return NULL;
+
+	idx = canonical_property_tags_find_tag(proptag);
+	if (idx) {
+		return canonical_property_tags[idx - 1].propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
 		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		idx = canonical_property_tags_find_tag(proptag);
+		if (idx) {
+			return canonical_property_tags[idx - 1].propname;
 		}
 	}
 	return NULL;
@@ -1220,10 +1625,11 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
 	uint32_t idx;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
+	if (!propname) return 0;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_name, NULL, 0, propname, strlen(propname));
+	if (idx && !strcmp(canonical_property_tags[idx - 1].propname, propname)) {
+		return canonical_property_tags[idx - 1].proptag;
 	}
 
 	return 0;
@@ -1231,16 +1637,15 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint8_t		key[2];
 	uint32_t	idx;
-	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
-		}
+	key[0] = untypedtag & 0xFF;
+	key[1] = (untypedtag >> 8) & 0xFF;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_id, NULL, 0, key, sizeof (key));
+	if (idx && (canonical_property_tags[idx - 1].proptag >> 16) == untypedtag) {
+		return canonical_property_tags[idx - 1].proptype;
 	}
 
 	OC_DEBUG(5, "type for property '%x' could not be deduced", untypedtag);
@@ -27,10 +27,49 @@
 #include <talloc.h>
 #include <gen_ndr/exchange.h>
 
+struct openchangedb_context;
+
+/**
+   Change numbers reserved in advance for a mailbox. Values are handed
+   out from cns->lpui8[index] onwards.
+ */
+struct openchangedb_cn_lease {
+	struct openchangedb_context	*oc_ctx;
+	char				*username;
+	struct UI8Array_r		*cns;
+	uint32_t			index;
+	struct openchangedb_cn_lease	*prev;
+	struct openchangedb_cn_lease	*next;
+};
+
+/**
+   Lookups served by the openchangedb folder metadata cache
+ */
+enum openchangedb_cache_kind {
+	OPENCHANGEDB_CACHE_SYSTEM_FOLDER_ID,
+	OPENCHANGEDB_CACHE_PARENT_FID,
+	OPENCHANGEDB_CACHE_MAPISTORE_URI,
+	OPENCHANGEDB_CACHE_FOLDER_PROPERTY
+};
+
+#define OPENCHANGEDB_CACHE_DEFAULT_SIZE	1024
+#define OPENCHANGEDB_CACHE_DEFAULT_TTL	30
+
+struct openchangedb_cache_stats {
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	invalidations;
+	uint64_t	evictions;
+	uint32_t	entries;
+};
+
+struct openchangedb_cache;
+
 struct openchangedb_context {
 	enum MAPISTATUS (*get_new_changeNumber)(struct openchangedb_context *, const char *, uint64_t *);
 	enum MAPISTATUS (*get_new_changeNumbers)(struct openchangedb_context *, TALLOC_CTX *, const char *, uint64_t, struct UI8Array_r **);
 	enum MAPISTATUS (*get_next_changeNumber)(struct openchangedb_context *, const char *, uint64_t *);
+	enum MAPISTATUS (*release_changeNumbers)(struct openchangedb_context *, const char *, uint64_t, uint64_t);
 	enum MAPISTATUS (*get_SpecialFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 	enum MAPISTATUS (*get_SystemFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 	enum MAPISTATUS (*get_PublicFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
@@ -66,6 +105,7 @@ struct openchangedb_context {
 	enum MAPISTATUS (*table_init)(TALLOC_CTX *, struct openchangedb_context *, const char *, uint8_t, uint64_t, void **);
 	enum MAPISTATUS (*table_set_sort_order)(struct openchangedb_context *, void *, struct SSortOrderSet *);
 	enum MAPISTATUS (*table_set_restrictions)(struct openchangedb_context *, void *, struct mapi_SRestriction *);
+	enum MAPISTATUS (*table_set_columns)(struct openchangedb_context *, void *, uint16_t, enum MAPITAGS *);
 	enum MAPISTATUS (*table_get_property)(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
 
 	enum MAPISTATUS (*message_create)(TALLOC_CTX *, struct openchangedb_context *, const char *, uint64_t, uint64_t, bool, void **);
@@ -92,10 +132,24 @@ struct openchangedb_context {
 
 	const char *backend_type;
 	void *data;
+
+	/* Change number leases, disabled when cn_lease_size <= 1 */
+	uint64_t cn_lease_size;
+	struct openchangedb_cn_lease *cn_leases;
+
+	/* Folder metadata cache, disabled when NULL */
+	struct openchangedb_cache *cache;
+	void (*cache_event)(struct openchangedb_context *, const char *, const char *, const struct openchangedb_cache_stats *);
 };
 
 const char *nil_string;
 
+/* definitions from openchangedb_cache.c */
+bool openchangedb_cache_get_id(struct openchangedb_context *, enum openchangedb_cache_kind, const char *, uint64_t, uint32_t, uint64_t *);
+void openchangedb_cache_set_id(struct openchangedb_context *, enum openchangedb_cache_kind, const char *, uint64_t, uint32_t, uint64_t);
+bool openchangedb_cache_get_data(TALLOC_CTX *, struct openchangedb_context *, enum openchangedb_cache_kind, const char *, uint64_t, uint32_t, void **);
+void openchangedb_cache_set_data(struct openchangedb_context *, enum openchangedb_cache_kind, const char *, uint64_t, uint32_t, const void *);
+
 #define TRANSPORT_FOLDER_SYSTEM_IDX 14
 #define FIRST_REPL_ID 0x03
 
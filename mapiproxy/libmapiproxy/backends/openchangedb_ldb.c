@@ -760,6 +760,16 @@ static struct LongArray_r *decode_mv_long(TALLOC_CTX *mem_ctx, const char *str)
 	return long_array;
 }
 
+/**
+   \details Decode a property value from the text form of an LDB record
+
+   Unlike the MySQL backend, no typed copy of the values is kept. LDB
+   records are written as a whole by every writer, so a typed copy
+   would have to be stored in the record itself and updated by all of
+   them, while the MySQL backend can ignore stale copies on read by
+   joining on the text value. This backend mostly serves provisioning
+   and small deployments, where the decoding cost does not matter.
+ */
 static void *get_property_data_message(TALLOC_CTX *mem_ctx, struct ldb_message *msg,
 				       uint32_t proptag, const char *PidTagAttr)
 {
@@ -1054,6 +1064,45 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Lower the ChangeNumber counter back to first, provided it
+   still holds end. Deleting the old value and adding the new one in
+   a single modify fails when another process changed the counter.
+ */
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	TALLOC_CTX		*mem_ctx;
+	int			ret;
+	struct ldb_result	*res;
+	struct ldb_message	*msg;
+	const char * const	attrs[] = { "ChangeNumber", NULL };
+	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;
+
+	OPENCHANGE_RETVAL_IF(!first || first >= end, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "release_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	ret = ldb_search(ldb_ctx, mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_NOT_FOUND, mem_ctx);
+
+	msg = ldb_msg_new(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!msg, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	msg->dn = ldb_dn_copy(msg, res->msgs[0]->dn);
+	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, end);
+	msg->elements[0].flags = LDB_FLAG_MOD_DELETE;
+	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, first);
+	msg->elements[1].flags = LDB_FLAG_MOD_ADD;
+	ret = ldb_modify(ldb_ctx, msg);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_NOT_FOUND, mem_ctx);
+
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
@@ -2671,6 +2720,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_ldb_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
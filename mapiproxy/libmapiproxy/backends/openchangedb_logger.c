@@ -390,6 +390,26 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return retval;
 }
 
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	enum MAPISTATUS retval;
+	struct ocdb_logger_data *priv_data = _ocdb_logger_data_get(self);
+
+	OC_DEBUG(priv_data->log_level, "%s[in]: username=[%s], first=[%"PRIu64"], end=[%"PRIu64"]",
+				     priv_data->log_prefix, username, first, end);
+	if (priv_data->backend->release_changeNumbers) {
+		retval = priv_data->backend->release_changeNumbers(priv_data->backend, username, first, end);
+	} else {
+		retval = MAPI_E_NO_SUPPORT;
+	}
+	OC_DEBUG(priv_data->log_level, "%s[out]: retval=[%s]",
+				     priv_data->log_prefix, mapi_get_errstr(retval));
+
+	return retval;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
@@ -800,6 +820,21 @@ static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
 	return retval;
 }
 
+static enum MAPISTATUS table_set_columns(struct openchangedb_context *self,
+					 void *table_object,
+					 uint16_t count,
+					 enum MAPITAGS *properties)
+{
+	enum MAPISTATUS retval = MAPI_E_SUCCESS;
+	struct ocdb_logger_data *priv_data = _ocdb_logger_data_get(self);
+
+	if (priv_data->backend->table_set_columns) {
+		retval = priv_data->backend->table_set_columns(priv_data->backend, table_object, count, properties);
+	}
+
+	return retval;
+}
+
 static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
 					  struct openchangedb_context *self,
 					  void *table_object,
@@ -897,6 +932,22 @@ static enum MAPISTATUS message_set_properties(TALLOC_CTX *mem_ctx,
 
 // ^ openchangedb message -----------------------------------------------------
 
+// v openchangedb cache -------------------------------------------------------
+
+static void cache_event(struct openchangedb_context *self,
+			const char *function, const char *event,
+			const struct openchangedb_cache_stats *stats)
+{
+	struct ocdb_logger_data *priv_data = _ocdb_logger_data_get(self);
+
+	OC_DEBUG(priv_data->log_level, "%s[cache]: %s %s: hits=[%"PRIu64"], misses=[%"PRIu64"], "
+		 "invalidations=[%"PRIu64"], evictions=[%"PRIu64"], entries=[%"PRIu32"]",
+		 priv_data->log_prefix, function, event, stats->hits, stats->misses,
+		 stats->invalidations, stats->evictions, stats->entries);
+}
+
+// ^ openchangedb cache -------------------------------------------------------
+
 _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 							int log_level,
 							const char *log_prefix,
@@ -923,6 +974,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -958,6 +1010,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_init = table_init;
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
+	oc_ctx->table_set_columns = table_set_columns;
 	oc_ctx->table_get_property = table_get_property;
 
 	oc_ctx->message_create = message_create;
@@ -979,6 +1032,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->replica_mapping_guid_to_replid = replica_mapping_guid_to_replid;
 	oc_ctx->replica_mapping_replid_to_guid = replica_mapping_replid_to_guid;
 
+	oc_ctx->cache_event = cache_event;
+
 	*ctx = oc_ctx;
 
 	return MAPI_E_SUCCESS;
@@ -27,6 +27,7 @@
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
 #include <mysql/mysql.h>
+#include <mysql/mysqld_error.h>
 #include <inttypes.h>
 #include <time.h>
 #include "../../util/mysql.h"
@@ -36,6 +37,11 @@
 #define SYSTEM_FOLDER	"system"
 
 #define THRESHOLD_SLOW_QUERIES 0.25
+#define TABLE_WINDOW_SIZE 128
+
+/* Bumped by every write to folders and messages, table windows loaded
+   before the last write are stale and read again */
+static uint64_t table_window_generation;
 
 
 static enum MAPISTATUS _not_implemented(const char *caller) {
@@ -95,36 +101,25 @@ static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
 					  uint32_t SystemIdx,
 					  uint64_t *FolderId)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_SystemFolderId");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (SystemIdx == 0x1) {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT folder_id FROM mailboxes WHERE name = '%s'",
-			_sql(mem_ctx, recipient));
-	} else {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f.folder_id FROM folders f "
-			"JOIN mailboxes m ON f.mailbox_id = m.id "
-			"  AND m.name = '%s' "
-			"WHERE f.SystemIdx = %"PRIu32
-			"  AND f.folder_class = '"SYSTEM_FOLDER"' "
-			"ORDER BY parent_folder_id",
-			_sql(mem_ctx, recipient), SystemIdx);
+		return status(stmt_select_first_uint(conn,
+			"SELECT folder_id FROM mailboxes WHERE name = ?",
+			FolderId, "s", recipient));
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 
-	retval = status(select_first_uint(conn, sql, FolderId));
-
-	talloc_free(mem_ctx);
-	return retval;
+	return status(stmt_select_first_uint(conn,
+		"SELECT f.folder_id FROM folders f "
+		"JOIN mailboxes m ON f.mailbox_id = m.id "
+		"  AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
+		"  AND f.folder_class = '"SYSTEM_FOLDER"' "
+		"ORDER BY parent_folder_id",
+		FolderId, "si", recipient, SystemIdx));
 }
 
 static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
@@ -292,32 +287,21 @@ static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
 				        const char *username, uint64_t fid,
 				        char **mapistoreURL, bool mailboxstore)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_mapistoreURI");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (!mailboxstore) {
-		talloc_free(mem_ctx);
 		// TODO is it possible?
 		return _not_implemented("get_mapistoreURI with mailboxstore=false");
 	}
 
-	sql = talloc_asprintf(mem_ctx,
+	return status(stmt_select_first_string(parent_ctx, conn,
 		"SELECT MAPIStoreURI FROM folders f "
-		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = '%s' "
-		"WHERE f.folder_id = %"PRIu64, _sql(mem_ctx, username), fid);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_string(parent_ctx, conn, sql, (const char **)mapistoreURL));
-
-	talloc_free(mem_ctx);
-	return retval;
+		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = ? "
+		"WHERE f.folder_id = ?",
+		(const char **)mapistoreURL, "su", username, fid));
 }
 
 static enum MAPISTATUS get_fid(struct openchangedb_context *self,
@@ -367,6 +351,7 @@ static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	sql = talloc_asprintf(mem_ctx,
 		"UPDATE folders f "
@@ -655,56 +640,23 @@ static enum MAPISTATUS get_mailbox_ids_by_name(MYSQL *conn,
 					       uint64_t *mailbox_folder_id,
 					       uint64_t *ou_id)
 {
-	TALLOC_CTX	*mem_ctx;
 	enum MAPISTATUS	retval;
-	char		*sql;
-	MYSQL_RES	*res;
-	MYSQL_ROW	row;
+	uint64_t	ids[3];
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "get_mailbox_ids_by_name");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
-
-	sql = talloc_asprintf(mem_ctx,
+	retval = status(stmt_select_first_uints(conn,
 		"SELECT m.id, m.folder_id, m.ou_id FROM mailboxes m "
-		"WHERE m.name = '%s'", _sql(mem_ctx, username));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+		"WHERE m.name = ?", ids, 3, "s", username));
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
-	retval = status(select_without_fetch(conn, sql, &res));
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
-	row = mysql_fetch_row(res);
-	if (row == NULL) {
-		OC_DEBUG(0, "Error getting user's mailbox `%s`: %s", sql,
-			  mysql_error(conn));
-		retval = MAPI_E_NOT_FOUND;
-		goto end;
-	}
+	if (mailbox_id) *mailbox_id = ids[0];
+	if (mailbox_folder_id) *mailbox_folder_id = ids[1];
+	if (ou_id) *ou_id = ids[2];
 
-	if (mailbox_id) {
-		if (!convert_string_to_ull(row[0], mailbox_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-	if (mailbox_folder_id) {
-		if (!convert_string_to_ull(row[1], mailbox_folder_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-	if (ou_id) {
-		if (!convert_string_to_ull(row[2], ou_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-end:
-	mysql_free_result(res);
-	talloc_free(mem_ctx);
-	return retval;
+	return MAPI_E_SUCCESS;
 }
 
 #define is_public_folder(id) is_public_folder_id(NULL, id)
@@ -913,6 +865,41 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return retval;
 }
 
+/**
+   \details Lower the change number counter back to first, provided
+   it still holds end, i.e. nobody allocated change numbers since.
+ */
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn;
+	char		*sql;
+
+	conn = self->data;
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
+	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!first || first >= end, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "release_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	sql = talloc_asprintf(mem_ctx,
+		"UPDATE servers s "
+		"JOIN mailboxes m ON m.ou_id = s.ou_id AND m.name = '%s' "
+		"SET s.change_number=%"PRIu64" "
+		"WHERE s.change_number=%"PRIu64,
+		_sql(mem_ctx, username), first, end);
+	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	OPENCHANGE_RETVAL_IF(execute_query(conn, sql) != MYSQL_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
+	OPENCHANGE_RETVAL_IF(mysql_affected_rows(conn) != 1, MAPI_E_NOT_FOUND, mem_ctx);
+
+	talloc_free(mem_ctx);
+	return MAPI_E_SUCCESS;
+}
+
 static char *_unknown_property(TALLOC_CTX *mem_ctx, uint32_t proptag)
 {
 	return talloc_asprintf(mem_ctx, "Unknown%.8x", proptag);
@@ -1105,19 +1092,189 @@ static void *get_property_data(TALLOC_CTX *mem_ctx, uint32_t proptag, const char
 	return data;
 }
 
+/* Tables keeping the typed form of the values of a properties table.
+   A typed value is only valid while value still is the text it was
+   built from, so property writers do not need to know about them */
+struct typed_properties_table {
+	const char	*name;
+	const char	*id_column;
+};
+
+static const struct typed_properties_table typed_folders_properties = {
+	"folders_properties_typed", "folder_id"
+};
+static const struct typed_properties_table typed_messages_properties = {
+	"messages_properties_typed", "message_id"
+};
+static const struct typed_properties_table typed_mailboxes_properties = {
+	"mailboxes_properties_typed", "mailbox_id"
+};
+
+/* Readers store the typed form of the values they had to decode, at
+   most once per value. A write failing on a missing typed table or
+   column turns this off for the rest of the process, the text value
+   remaining the reference */
+static bool typed_backfill = true;
+
+/**
+   \details Enable or disable storing the typed form of property values
+   decoded from their text form
+
+   \param enable whether readers store typed values
+ */
+_PUBLIC_ void openchangedb_mysql_set_typed_backfill(bool enable)
+{
+	typed_backfill = enable;
+}
+
+/**
+   \details Build the SQL row storing the typed form of a property value
+
+   \param mem_ctx pointer to the memory context
+   \param owner_id the database id of the folder, message or mailbox
+   \param proptag the MAPI property tag
+   \param name the property name in the properties table
+   \param value the text value, as stored in the properties table
+   \param data the decoded value
+   \param blob pointer to the packed value to return
+
+   \return the row on success, NULL if the value has no typed form
+ */
+static char *_typed_property_row(TALLOC_CTX *mem_ctx, uint64_t owner_id,
+				 uint32_t proptag, const char *name,
+				 const char *value, const void *data,
+				 DATA_BLOB *blob)
+{
+	char	*hex, *row;
+	size_t	i;
+
+	if (!name || !value || !data) return NULL;
+	if (!openchangedb_property_is_packable(proptag)) return NULL;
+	/* Keep within the columns of the typed tables */
+	if (strlen(name) >= 128 || strlen(value) > 512) return NULL;
+
+	if (openchangedb_property_pack(mem_ctx, proptag, data, blob) != MAPI_E_SUCCESS) {
+		return NULL;
+	}
+
+	hex = talloc_array(mem_ctx, char, blob->length * 2 + 1);
+	if (!hex) return NULL;
+	for (i = 0; i < blob->length; i++) {
+		snprintf(hex + i * 2, 3, "%.2X", blob->data[i]);
+	}
+	hex[blob->length * 2] = '\0';
+
+	row = talloc_asprintf(mem_ctx, "(%"PRIu64", '%s', '%s', X'%s')", owner_id,
+			      _sql(mem_ctx, name), _sql(mem_ctx, value), hex);
+	talloc_free(hex);
+
+	return row;
+}
+
+/**
+   \details Store rows built with _typed_property_row
+
+   Failures are logged and ignored. A missing typed table or column
+   disables any further attempt, so a database not migrated yet does
+   not turn every read into a failed write. Other errors, such as a
+   lock wait timeout, only skip this write.
+
+   \param conn pointer to the MySQL connection
+   \param table the typed properties table
+   \param rows comma separated rows
+ */
+static void _store_typed_properties(MYSQL *conn,
+				    const struct typed_properties_table *table,
+				    const char *rows)
+{
+	char	*sql;
+
+	if (!typed_backfill || !rows || !rows[0]) return;
+
+	sql = talloc_asprintf(NULL, "REPLACE INTO %s (%s, name, value, typed_value) VALUES %s",
+			      table->name, table->id_column, rows);
+	if (!sql) return;
+	if (execute_query(conn, sql) != MYSQL_SUCCESS) {
+		switch (mysql_errno(conn)) {
+		case ER_NO_SUCH_TABLE:
+		case ER_BAD_FIELD_ERROR:
+			OC_DEBUG(1, "Failed to store typed property values in %s, "
+				 "reading text values only from now on", table->name);
+			typed_backfill = false;
+			break;
+		default:
+			OC_DEBUG(3, "Failed to store typed property values in %s: %s",
+				 table->name, mysql_error(conn));
+			break;
+		}
+	}
+	talloc_free(sql);
+}
+
+/**
+   \details Transform a stored property into the expected data type
+
+   The typed form is used when there is one. Otherwise the text value is
+   decoded and, if table is given and backfill is enabled, its typed
+   form is stored so next reads skip the decoding.
+
+   \param mem_ctx pointer to the memory context
+   \param conn pointer to the MySQL connection
+   \param table the typed properties table to store into, or NULL
+   \param owner_id the database id of the property owner
+   \param proptag the MAPI property tag
+   \param name the property name in the properties table
+   \param value the text value
+   \param typed the typed value, or NULL
+
+   \return valid data pointer on success, otherwise NULL
+ */
+static void *get_stored_property_data(TALLOC_CTX *mem_ctx, MYSQL *conn,
+				      const struct typed_properties_table *table,
+				      uint64_t owner_id, uint32_t proptag,
+				      const char *name, const char *value,
+				      const DATA_BLOB *typed)
+{
+	TALLOC_CTX	*local_mem_ctx;
+	DATA_BLOB	blob;
+	void		*data;
+	char		*row;
+
+	if (typed && typed->data) {
+		data = openchangedb_property_unpack(mem_ctx, proptag, typed);
+		if (data) return data;
+	}
+	if (!value) return NULL;
+
+	data = get_property_data(mem_ctx, proptag, value);
+	if (!data || !table || !typed_backfill || !openchangedb_property_is_packable(proptag)) {
+		return data;
+	}
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) return data;
+	row = _typed_property_row(local_mem_ctx, owner_id, proptag, name, value, data, &blob);
+	_store_typed_properties(conn, table, row);
+	talloc_free(local_mem_ctx);
+
+	return data;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
 					   uint32_t proptag, uint64_t fid,
 					   void **data)
 {
-	TALLOC_CTX	*mem_ctx;
-	MYSQL		*conn;
-	enum MAPISTATUS	retval = MAPI_E_SUCCESS;
-	char		*sql = NULL;
-	uint64_t	mailbox_id = 0, mailbox_folder_id = 0;
-	uint64_t	*n = NULL;
-	const char	*attr, *value;
+	TALLOC_CTX		*mem_ctx;
+	MYSQL			*conn;
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	enum MYSQLRESULT	ret;
+	uint64_t		mailbox_id = 0, mailbox_folder_id = 0, owner_id = 0;
+	uint64_t		*n = NULL;
+	const char		*attr;
+	const struct typed_properties_table	*typed_table = &typed_folders_properties;
+	DATA_BLOB		row[3];
 
 	mem_ctx = talloc_named(NULL, 0, "get_folder_property");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
@@ -1150,25 +1307,30 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			goto end;
 		}
 
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT fp.value FROM folders_properties fp "
+		ret = stmt_select_first_blobs(mem_ctx, conn,
+			"SELECT fp.value, t.typed_value, fp.folder_id FROM folders_properties fp "
 			"JOIN folders f ON f.id = fp.folder_id "
 			"  AND f.folder_class = '"PUBLIC_FOLDER"'"
-			"  AND f.folder_id = %"PRIu64" "
+			"  AND f.folder_id = ? "
 			"JOIN mailboxes m ON m.ou_id = f.ou_id"
-			"  AND m.name = '%s' "
-			"WHERE fp.name = '%s'",
-			fid, _sql(mem_ctx, username), _sql(mem_ctx, attr));
+			"  AND m.name = ? "
+			"LEFT JOIN folders_properties_typed t ON t.folder_id = fp.folder_id"
+			"  AND t.name = fp.name AND t.value = BINARY fp.value "
+			"WHERE fp.name = ?",
+			row, 3, "uss", fid, username, attr);
 	} else {
 		// system folder
 		retval = get_mailbox_ids_by_name(conn, username, &mailbox_id, &mailbox_folder_id, NULL);
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		if (mailbox_folder_id == fid) {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT mp.value FROM mailboxes_properties mp "
-				"WHERE mp.mailbox_id = %"PRIu64" AND mp.name = '%s'",
-				mailbox_id, _sql(mem_ctx, attr));
+			typed_table = &typed_mailboxes_properties;
+			ret = stmt_select_first_blobs(mem_ctx, conn,
+				"SELECT mp.value, t.typed_value, mp.mailbox_id FROM mailboxes_properties mp "
+				"LEFT JOIN mailboxes_properties_typed t ON t.mailbox_id = mp.mailbox_id"
+				"  AND t.name = mp.name AND t.value = BINARY mp.value "
+				"WHERE mp.mailbox_id = ? AND mp.name = ?",
+				row, 3, "us", mailbox_id, attr);
 		} else if (proptag == PidTagParentFolderId) {
 			n = talloc_zero(parent_ctx, uint64_t);
 			OPENCHANGE_RETVAL_IF(!n, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
@@ -1177,20 +1339,26 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			*data = (void *) n;
 			goto end;
 		} else {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT fp.value FROM folders_properties fp "
+			ret = stmt_select_first_blobs(mem_ctx, conn,
+				"SELECT fp.value, t.typed_value, fp.folder_id FROM folders_properties fp "
 				"JOIN folders f ON f.id = fp.folder_id "
-				"  AND f.mailbox_id = %"PRIu64" "
-				"  AND f.folder_id = %"PRIu64" "
-				"WHERE fp.name = '%s'",
-				mailbox_id, fid, _sql(mem_ctx, attr));
+				"  AND f.mailbox_id = ? "
+				"  AND f.folder_id = ? "
+				"LEFT JOIN folders_properties_typed t ON t.folder_id = fp.folder_id"
+				"  AND t.name = fp.name AND t.value = BINARY fp.value "
+				"WHERE fp.name = ?",
+				row, 3, "uus", mailbox_id, fid, attr);
 		}
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-	retval = status(select_first_string(mem_ctx, conn, sql, &value));
+	retval = status(ret);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!row[0].data, MAPI_E_NOT_FOUND, mem_ctx);
+	if (!row[2].data || !convert_string_to_ull((const char *)row[2].data, &owner_id)) {
+		typed_table = NULL;
+	}
 	// Transform string into the expected data type
-	*data = get_property_data(parent_ctx, proptag, value);
+	*data = get_stored_property_data(parent_ctx, conn, typed_table, owner_id, proptag,
+					 attr, (const char *)row[0].data, &row[1]);
 	OPENCHANGE_RETVAL_IF(*data == NULL, MAPI_E_NOT_FOUND, mem_ctx);
 end:
 	talloc_free(mem_ctx);
@@ -1239,6 +1407,7 @@ static enum MAPISTATUS set_folder_properties(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	if (is_public_folder(fid)) {
 		// Updating public folder
@@ -1405,60 +1574,51 @@ static enum MAPISTATUS get_fid_by_name(struct openchangedb_context *self,
 				       uint64_t parent_fid,
 				       const char *foldername, uint64_t *fid)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS retval;
-	char		*sql = NULL;
 	uint64_t	mailbox_id = 0, mailbox_folder_id = 0, ou_id = 0;
 	bool		is_public;
 
-	mem_ctx = talloc_named(NULL, 0, "get_fid_by_name");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	is_public = is_public_folder(parent_fid);
 
 	retval = get_mailbox_ids_by_name(conn, username, &mailbox_id, &mailbox_folder_id, &ou_id);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	if (!is_public && mailbox_folder_id == parent_fid) {
 		// The parent folder is the mailbox itself
-		sql = talloc_asprintf(mem_ctx,
+		return status(stmt_select_first_uint(conn,
 			"SELECT f.folder_id FROM folders f "
 			"JOIN folders_properties p ON p.folder_id = f.id"
 			"  AND p.name = 'PidTagDisplayName'"
-			"  AND p.value = '%s' "
-			"WHERE f.mailbox_id = %"PRIu64,
-			_sql(mem_ctx, foldername), mailbox_id);
+			"  AND p.value = ? "
+			"WHERE f.mailbox_id = ?",
+			fid, "su", foldername, mailbox_id));
 	} else if (is_public) {
 		// public folder
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f1.folder_id FROM folders f1 "
-			"JOIN folders_properties p ON p.folder_id = f1.id"
-			"  AND p.name = 'PidTagDisplayName'"
-			"  AND p.value = '%s' "
-			"JOIN folders f2 ON f2.id = f1.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64
-			"  AND f2.ou_id = %"PRIu64,
-			_sql(mem_ctx, foldername), parent_fid, ou_id);
-	} else {
-		// system folder
-		sql = talloc_asprintf(mem_ctx,
+		return status(stmt_select_first_uint(conn,
 			"SELECT f1.folder_id FROM folders f1 "
 			"JOIN folders_properties p ON p.folder_id = f1.id"
 			"  AND p.name = 'PidTagDisplayName'"
-			"  AND p.value = '%s' "
+			"  AND p.value = ? "
 			"JOIN folders f2 ON f2.id = f1.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64" "
-			"WHERE f1.mailbox_id = %"PRIu64,
-			_sql(mem_ctx, foldername), parent_fid, mailbox_id);
-	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-	retval = status(select_first_uint(conn, sql, fid));
-
-	talloc_free(mem_ctx);
-	return retval;
+			"  AND f2.folder_id = ?"
+			"  AND f2.ou_id = ?",
+			fid, "suu", foldername, parent_fid, ou_id));
+	}
+
+	// system folder
+	return status(stmt_select_first_uint(conn,
+		"SELECT f1.folder_id FROM folders f1 "
+		"JOIN folders_properties p ON p.folder_id = f1.id"
+		"  AND p.name = 'PidTagDisplayName'"
+		"  AND p.value = ? "
+		"JOIN folders f2 ON f2.id = f1.parent_folder_id"
+		"  AND f2.folder_id = ? "
+		"WHERE f1.mailbox_id = ?",
+		fid, "suu", foldername, parent_fid, mailbox_id));
 }
 
 static enum MAPISTATUS get_mid_by_subject_from_public_folder(struct openchangedb_context *self,
@@ -1570,6 +1730,7 @@ static enum MAPISTATUS delete_folder(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	if (is_public_folder(fid)) {
 		sql = talloc_asprintf(mem_ctx,
@@ -1698,6 +1859,7 @@ static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	unix_time = time(NULL);
 	if (unix_time == -1) {
@@ -1803,6 +1965,7 @@ static enum MAPISTATUS create_folder(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	unix_time = time(NULL);
 	if (unix_time == -1) {
@@ -2066,6 +2229,7 @@ static enum MAPISTATUS set_system_idx(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	sql = talloc_asprintf(mem_ctx,
 		"UPDATE folders f "
@@ -2423,12 +2587,30 @@ struct openchangedb_table_folder_row {
 	uint64_t	fid;
 };
 
+/* Column values and restriction matches of up to TABLE_WINDOW_SIZE
+   consecutive rows, loaded by a single query */
+struct openchangedb_table_window {
+	uint64_t	generation;	/* table_window_generation when loaded */
+	uint32_t	start;
+	uint32_t	count;
+	const char	**values;	/* count rows of columns->count values */
+	DATA_BLOB	*typed;		/* typed form of values, when known */
+	bool		*matches;
+};
+
 struct openchangedb_table_results {
-	size_t		count;
+	size_t					count;
 	union {
 		struct openchangedb_table_folder_row	**folders;
 		struct openchangedb_table_message_row	**messages;
 	};
+	struct openchangedb_table_window	*window;
+};
+
+struct openchangedb_table_columns {
+	uint16_t	count;
+	enum MAPITAGS	*proptags;
+	const char	**attrs;
 };
 
 struct openchangedb_table {
@@ -2438,6 +2620,7 @@ struct openchangedb_table {
 	uint8_t					table_type;
 	struct SSortOrderSet			*lpSortCriteria;
 	struct mapi_SRestriction		*restrictions;
+	struct openchangedb_table_columns	*columns;
 	struct openchangedb_table_results	*res;
 };
 
@@ -2464,6 +2647,7 @@ static enum MAPISTATUS table_init(TALLOC_CTX *mem_ctx,
 	table->table_type = table_type;
 	table->lpSortCriteria = NULL;
 	table->restrictions = NULL;
+	table->columns = NULL;
 	table->res = NULL;
 
 	*table_object = (void *)table;
@@ -2550,6 +2734,57 @@ static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
 	return MAPI_E_SUCCESS;
 }
 
+static enum MAPISTATUS table_set_columns(struct openchangedb_context *self,
+					 void *_table,
+					 uint16_t count,
+					 enum MAPITAGS *properties)
+{
+	struct openchangedb_table		*table = (struct openchangedb_table *)_table;
+	struct openchangedb_table_columns	*columns;
+	const char				*attr;
+	bool					is_message;
+	uint16_t				i;
+
+	if (table->res) {
+		TALLOC_FREE(table->res->window);
+	}
+	TALLOC_FREE(table->columns);
+
+	columns = talloc_zero(table, struct openchangedb_table_columns);
+	OPENCHANGE_RETVAL_IF(!columns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	columns->proptags = talloc_array(columns, enum MAPITAGS, count);
+	OPENCHANGE_RETVAL_IF(!columns->proptags, MAPI_E_NOT_ENOUGH_MEMORY, columns);
+	columns->attrs = talloc_array(columns, const char *, count);
+	OPENCHANGE_RETVAL_IF(!columns->attrs, MAPI_E_NOT_ENOUGH_MEMORY, columns);
+
+	is_message = table->table_type == 0x3 || table->table_type == 0x2;
+	for (i = 0; i < count; i++) {
+		/* Skip what table_get_property serves without reading the
+		   properties tables */
+		switch ((uint32_t)properties[i]) {
+		case PidTagFolderId:
+		case PR_INST_ID:
+		case PR_INSTANCE_NUM:
+		case PR_DEPTH:
+			continue;
+		case PidTagMid:
+		case PidTagNormalizedSubject:
+			if (is_message) continue;
+			break;
+		}
+
+		attr = openchangedb_property_get_attribute(properties[i]);
+		if (!attr) continue;
+
+		columns->proptags[columns->count] = properties[i];
+		columns->attrs[columns->count] = attr;
+		columns->count++;
+	}
+	table->columns = columns;
+
+	return MAPI_E_SUCCESS;
+}
+
 static enum MAPISTATUS _table_get_attr_and_value_from_restrictions(
 	TALLOC_CTX *mem_ctx, struct mapi_SRestriction *restrictions,
 	const char **attr, const char **value)
@@ -2923,26 +3158,232 @@ static enum MAPISTATUS _table_fetch_results(MYSQL *conn,
 	}
 }
 
+struct openchangedb_table_row_ref {
+	uint64_t	id;
+	uint32_t	idx;
+};
+
+static int _table_row_ref_cmp(const void *a, const void *b)
+{
+	const struct openchangedb_table_row_ref	*ra = a;
+	const struct openchangedb_table_row_ref	*rb = b;
+
+	if (ra->id < rb->id) return -1;
+	return ra->id > rb->id;
+}
+
+static bool _table_restriction_needs_lookup(struct openchangedb_table *table)
+{
+	uint32_t	proptag;
+
+	if (!table->restrictions) return false;
+
+	proptag = table->restrictions->res.resProperty.ulPropTag;
+	if (table->table_type == 0x3 || table->table_type == 0x2) {
+		return proptag != PidTagMid && proptag != PidTagNormalizedSubject;
+	}
+	return proptag != PidTagFolderId;
+}
+
+/**
+   \details Return the window of rows holding pos, loading it if needed
+
+   The values of every column set with table_set_columns and whether
+   each row matches the table restriction are read for the next
+   TABLE_WINDOW_SIZE rows with a single query, instead of one query
+   per row and column.
+
+   The window is read again once folders or messages have been written
+   since it was loaded.
+
+   \param conn pointer to the MySQL connection
+   \param table pointer to the table object
+   \param pos the row to return the window for
+
+   \return pointer to the window on success, otherwise NULL
+ */
+static struct openchangedb_table_window *_table_get_window(MYSQL *conn,
+							   struct openchangedb_table *table,
+							   uint32_t pos)
+{
+	TALLOC_CTX				*mem_ctx;
+	struct openchangedb_table_results	*res = table->res;
+	struct openchangedb_table_window	*window;
+	struct openchangedb_table_row_ref	*refs, *ref, key;
+	const struct typed_properties_table	*typed_table;
+	const char				*attr = NULL, *value = NULL;
+	const char				*prop_table;
+	char					*ids, *names, *match, *sql, *typed_rows, *typed_row;
+	bool					is_message, lookup;
+	uint16_t				column_count;
+	uint32_t				i, j;
+	enum MYSQLRESULT			ret;
+	MYSQL_RES				*sql_res = NULL;
+	MYSQL_ROW				row;
+	unsigned long				*lengths;
+	void					*data;
+
+	if (!res) return NULL;
+
+	window = res->window;
+	if (window && window->generation == table_window_generation &&
+	    pos >= window->start && pos < window->start + window->count) {
+		return window;
+	}
+	TALLOC_FREE(res->window);
+	if (pos >= res->count) return NULL;
+
+	mem_ctx = talloc_named(NULL, 0, "_table_get_window");
+	if (!mem_ctx) return NULL;
+
+	is_message = table->table_type == 0x3 || table->table_type == 0x2;
+	column_count = table->columns ? table->columns->count : 0;
+
+	window = talloc_zero(mem_ctx, struct openchangedb_table_window);
+	if (!window) goto fail;
+	window->generation = table_window_generation;
+	window->start = pos;
+	window->count = MIN(TABLE_WINDOW_SIZE, res->count - pos);
+	window->values = talloc_zero_array(window, const char *, window->count * column_count);
+	window->typed = talloc_zero_array(window, DATA_BLOB, window->count * column_count);
+	window->matches = talloc_zero_array(window, bool, window->count);
+	refs = talloc_array(mem_ctx, struct openchangedb_table_row_ref, window->count);
+	ids = talloc_strdup(mem_ctx, "");
+	names = talloc_strdup(mem_ctx, "");
+	typed_rows = talloc_strdup(mem_ctx, "");
+	if (!window->values || !window->typed || !window->matches || !refs ||
+	    !ids || !names || !typed_rows) goto fail;
+
+	for (i = 0; i < window->count; i++) {
+		refs[i].id = is_message ? res->messages[pos + i]->id : res->folders[pos + i]->id;
+		refs[i].idx = i;
+		ids = talloc_asprintf_append_buffer(ids, "%s%"PRIu64, i ? "," : "", refs[i].id);
+		if (!ids) goto fail;
+	}
+	qsort(refs, window->count, sizeof (*refs), _table_row_ref_cmp);
+
+	for (j = 0; j < column_count; j++) {
+		names = talloc_asprintf_append_buffer(names, "%s'%s'", j ? "," : "",
+						      table->columns->attrs[j]);
+		if (!names) goto fail;
+	}
+
+	/* Evaluate the restriction with the same comparison the table
+	   fetch queries use */
+	lookup = _table_restriction_needs_lookup(table);
+	if (lookup) {
+		if (_table_get_attr_and_value_from_restrictions(mem_ctx, table->restrictions,
+								&attr, &value) != MAPI_E_SUCCESS || !attr) {
+			lookup = false;
+		} else {
+			names = talloc_asprintf_append_buffer(names, "%s'%s'", column_count ? "," : "", attr);
+			if (!names) goto fail;
+		}
+	}
+	if (!names[0]) goto done;
+
+	if (lookup) {
+		match = talloc_asprintf(mem_ctx, "p.name = '%s' AND p.value = '%s'", attr, value);
+	} else {
+		match = talloc_strdup(mem_ctx, "0");
+	}
+	if (!match) goto fail;
+
+	prop_table = is_message ? "messages_properties" : "folders_properties";
+	typed_table = is_message ? &typed_messages_properties : &typed_folders_properties;
+	sql = talloc_asprintf(mem_ctx,
+		"SELECT p.%s, p.name, p.value, %s, t.typed_value FROM %s p "
+		"LEFT JOIN %s t ON t.%s = p.%s AND t.name = p.name AND t.value = BINARY p.value "
+		"WHERE p.%s IN (%s) AND p.name IN (%s)",
+		typed_table->id_column, match, prop_table,
+		typed_table->name, typed_table->id_column, typed_table->id_column,
+		typed_table->id_column, ids, names);
+	if (!sql) goto fail;
+
+	ret = select_without_fetch(conn, sql, &sql_res);
+	if (ret == MYSQL_NOT_FOUND) goto done;
+	if (ret != MYSQL_SUCCESS) goto fail;
+
+	while ((row = mysql_fetch_row(sql_res)) != NULL) {
+		if (!row[0] || !row[1] || !convert_string_to_ull(row[0], &key.id)) continue;
+		ref = bsearch(&key, refs, window->count, sizeof (*refs), _table_row_ref_cmp);
+		if (!ref) continue;
+
+		if (row[3] && strcmp(row[3], "1") == 0) {
+			window->matches[ref->idx] = true;
+		}
+		if (!row[2]) continue;
+		lengths = mysql_fetch_lengths(sql_res);
+
+		for (j = 0; j < column_count; j++) {
+			const char	**cell = &window->values[ref->idx * column_count + j];
+			DATA_BLOB	*typed = &window->typed[ref->idx * column_count + j];
+
+			if (*cell || strcmp(row[1], table->columns->attrs[j]) != 0) continue;
+			*cell = talloc_strdup(window, row[2]);
+			if (!*cell) goto fail;
+
+			if (row[4]) {
+				typed->data = talloc_memdup(window, row[4], lengths[4]);
+				if (!typed->data) goto fail;
+				typed->length = lengths[4];
+				continue;
+			}
+
+			/* Not migrated yet: decode it once and store the
+			   typed form of the whole window in one go */
+			if (!typed_backfill) continue;
+			if (!openchangedb_property_is_packable(table->columns->proptags[j])) continue;
+			data = get_property_data(mem_ctx, table->columns->proptags[j], *cell);
+			typed_row = _typed_property_row(window, key.id, table->columns->proptags[j],
+							row[1], *cell, data, typed);
+			if (!typed_row) {
+				typed->data = NULL;
+				typed->length = 0;
+				continue;
+			}
+			typed_rows = talloc_asprintf_append_buffer(typed_rows, "%s%s",
+								   typed_rows[0] ? "," : "", typed_row);
+			if (!typed_rows) goto fail;
+			talloc_free(typed_row);
+		}
+	}
+	_store_typed_properties(conn, typed_table, typed_rows);
+
+done:
+	if (sql_res) mysql_free_result(sql_res);
+	res->window = talloc_steal(res, window);
+	talloc_free(mem_ctx);
+	return window;
+fail:
+	OC_DEBUG(0, "Failed to load table rows %"PRIu32" and following", pos);
+	if (sql_res) mysql_free_result(sql_res);
+	talloc_free(mem_ctx);
+	return NULL;
+}
+
 static bool _table_check_message_match_restrictions(MYSQL *conn,
 						    struct openchangedb_table *table,
-						    bool fai,
-						    struct openchangedb_table_message_row *row)
+						    uint32_t pos)
 {
-	TALLOC_CTX			*mem_ctx;
-	char				*sql = NULL, *msg_type = NULL;
-	const char			*attr, *value;
-	struct mapi_SRestriction	*restrictions;
-	uint64_t			id = 0;
-	bool				ret = false;
+	TALLOC_CTX				*mem_ctx;
+	const char				*attr, *value;
+	struct mapi_SRestriction		*restrictions;
+	struct openchangedb_table_message_row	*row;
+	struct openchangedb_table_window	*window;
+	uint64_t				id = 0;
+	bool					ret = false;
 
 	mem_ctx = talloc_named(NULL, 0, "_table_check_message_match_restrictions");
 	if (!mem_ctx) return false;
 
-	if (!conn || !table || !row) goto end;
+	if (!conn || !table || !table->res) goto end;
 	restrictions = table->restrictions;
+	row = table->res->messages[pos];
 
-	ret = _table_get_attr_and_value_from_restrictions(mem_ctx, restrictions, &attr, &value);
-	if (ret != MAPI_E_SUCCESS) goto end;
+	if (_table_get_attr_and_value_from_restrictions(mem_ctx, restrictions, &attr, &value) != MAPI_E_SUCCESS) {
+		goto end;
+	}
 
 	if (restrictions->res.resProperty.ulPropTag == PidTagMid) {
 		if (convert_string_to_ull(value, &id)) {
@@ -2950,53 +3391,12 @@ static bool _table_check_message_match_restrictions(MYSQL *conn,
 		} else {
 			OC_DEBUG(0, "Invalid TagMid, conversion failed\n");
 		}
-		goto end;
 	} else if (restrictions->res.resProperty.ulPropTag == PidTagNormalizedSubject) {
 		ret = strcmp(row->normalized_subject, value) == 0;
-		goto end;
+	} else {
+		window = _table_get_window(conn, table, pos);
+		ret = window && window->matches[pos - window->start];
 	}
-
-	msg_type = talloc_strdup(mem_ctx, fai ? "faiMessage" : "systemMessage");
-	if (!msg_type) goto end;
-
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT m1.id FROM messages m1 "
-		"JOIN mailboxes mb1 ON mb1.id = m1.mailbox_id "
-		"  AND mb1.folder_id = %"PRIu64" AND mb1.name = '%s' "
-		"WHERE m1.message_type = '%s' "
-		"  AND EXISTS ("
-		"     SELECT mp.message_id FROM messages_properties mp "
-		"     WHERE mp.message_id = m1.id "
-		"       AND mp.name = '%s' AND mp.value = '%s') "
-		"  AND m1.id = %"PRIu64" "
-		"UNION "
-		"SELECT m2.id FROM messages m2 "
-		"JOIN folders f ON f.id = m2.folder_id "
-		"  AND f.folder_id = %"PRIu64" "
-		"JOIN mailboxes mb2 ON mb2.id = f.mailbox_id AND mb2.name = '%s' "
-		"WHERE m2.message_type = '%s'"
-		"  AND EXISTS ("
-		"     SELECT mp.message_id FROM messages_properties mp "
-		"     WHERE mp.message_id = m2.id "
-		"       AND mp.name = '%s' AND mp.value = '%s') "
-		"  AND m2.id = %"PRIu64" "
-		"UNION "
-		"SELECT m.id FROM messages m "
-		"JOIN folders f ON f.id = m.folder_id "
-		"  AND f.folder_id = %"PRIu64
-		"  AND f.ou_id = %"PRIu64
-		"  AND f.folder_class = '"PUBLIC_FOLDER"' "
-		"WHERE m.message_type = '%s'"
-		"  AND EXISTS ("
-		"     SELECT mp.message_id FROM messages_properties mp "
-		"     WHERE mp.message_id = m.id "
-		"       AND mp.name = '%s' AND mp.value = '%s') "
-		"  AND m.id = %"PRIu64,
-		table->folder_id, table->username, msg_type, attr, value, row->id,
-		table->folder_id, table->username, msg_type, attr, value, row->id,
-		table->folder_id, table->ou_id, msg_type, attr, value, row->id);
-	if (!sql) goto end;
-	ret = status(select_first_uint(conn, sql, &id)) == MAPI_E_SUCCESS;
 end:
 	talloc_free(mem_ctx);
 	return ret;
@@ -3004,23 +3404,26 @@ end:
 
 static bool _table_check_folder_match_restrictions(MYSQL *conn,
 						   struct openchangedb_table *table,
-						   struct openchangedb_table_folder_row *row)
+						   uint32_t pos)
 {
-	TALLOC_CTX			*mem_ctx;
-	char				*sql;
-	const char			*attr, *value;
-	struct mapi_SRestriction	*restrictions;
-	uint64_t			id;
-	bool				ret = false;
+	TALLOC_CTX				*mem_ctx;
+	const char				*attr, *value;
+	struct mapi_SRestriction		*restrictions;
+	struct openchangedb_table_folder_row	*row;
+	struct openchangedb_table_window	*window;
+	uint64_t				id;
+	bool					ret = false;
 
 	mem_ctx = talloc_named(NULL, 0, "_table_check_folder_match_restrictions");
 	if (!mem_ctx) return false;
 
-	if (!conn || !table || !row) goto end;
+	if (!conn || !table || !table->res) goto end;
 	restrictions = table->restrictions;
+	row = table->res->folders[pos];
 
-	ret = _table_get_attr_and_value_from_restrictions(mem_ctx, restrictions, &attr, &value);
-	if (ret != MAPI_E_SUCCESS) goto end;
+	if (_table_get_attr_and_value_from_restrictions(mem_ctx, restrictions, &attr, &value) != MAPI_E_SUCCESS) {
+		goto end;
+	}
 
 	if (restrictions->res.resProperty.ulPropTag == PidTagFolderId) {
 		if (convert_string_to_ull(value, &id)) {
@@ -3028,45 +3431,10 @@ static bool _table_check_folder_match_restrictions(MYSQL *conn,
 		} else {
 			OC_DEBUG(0, "Invalid TagFolderId, conversion failed\n");
 		}
-		goto end;
+	} else {
+		window = _table_get_window(conn, table, pos);
+		ret = window && window->matches[pos - window->start];
 	}
-
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT f1.id FROM folders f1 "
-		"JOIN folders f2 ON f2.id = f1.parent_folder_id "
-		"   AND f2.folder_id = %"PRIu64" "
-		"JOIN mailboxes mb1 ON mb1.id = f1.mailbox_id "
-		"   AND mb1.name = '%s' "
-		"WHERE EXISTS ("
-		"     SELECT fp.folder_id FROM folders_properties fp "
-		"     WHERE fp.folder_id = f1.id "
-		"       AND fp.name = '%s' AND fp.value = '%s') "
-		"   AND f1.id = %"PRIu64" "
-		"UNION "
-		"SELECT f3.id FROM folders f3 "
-		"JOIN mailboxes mb2 ON mb2.id = f3.mailbox_id "
-		"   AND mb2.folder_id = %"PRIu64" AND mb2.name = '%s' "
-		"WHERE f3.parent_folder_id IS NULL"
-		"  AND EXISTS ("
-		"     SELECT fp.folder_id FROM folders_properties fp "
-		"     WHERE fp.folder_id = f3.id "
-		"       AND fp.name = '%s' AND fp.value = '%s') "
-		"   AND f3.id = %"PRIu64" "
-		"UNION "
-		"SELECT f1.id FROM folders f1 "
-		"JOIN folders f2 ON f2.id = f1.parent_folder_id "
-		"   AND f2.folder_id = %"PRIu64" "
-		"WHERE f1.ou_id = %"PRIu64
-		"   AND f1.folder_class = '"PUBLIC_FOLDER"' AND EXISTS ("
-		"     SELECT fp.folder_id FROM folders_properties fp "
-		"     WHERE fp.folder_id = f1.id "
-		"       AND fp.name = '%s' AND fp.value = '%s') "
-		"   AND f1.id = %"PRIu64" ",
-		table->folder_id, table->username, attr, value, row->id,
-		table->folder_id, table->username, attr, value, row->id,
-		table->folder_id, table->ou_id, attr, value, row->id);
-	if (!sql) goto end;
-	ret = status(select_first_uint(conn, sql, &id)) == MAPI_E_SUCCESS;
 end:
 	talloc_free(mem_ctx);
 	return ret;
@@ -3084,10 +3452,9 @@ static bool _table_check_match_restrictions(MYSQL *conn,
 
 	is_message = table->table_type == 0x3 || table->table_type == 0x2;
 	if (is_message) {
-		bool fai = table->table_type == 0x3;
-		return _table_check_message_match_restrictions(conn, table, fai, table->res->messages[pos]);
+		return _table_check_message_match_restrictions(conn, table, pos);
 	} else {
-		return _table_check_folder_match_restrictions(conn, table, table->res->folders[pos]);
+		return _table_check_folder_match_restrictions(conn, table, pos);
 	}
 }
 
@@ -3169,12 +3536,30 @@ static const char *_table_fetch_folder_attribute(MYSQL *conn,
 
 static const char *_table_fetch_attribute(MYSQL *conn,
 					  struct openchangedb_table *table,
-					  uint32_t pos, enum MAPITAGS proptag)
+					  uint32_t pos, enum MAPITAGS proptag,
+					  const DATA_BLOB **typed)
 {
-	bool is_message;
+	struct openchangedb_table_window	*window;
+	uint32_t				cell;
+	uint16_t				i;
+	bool					is_message;
 
+	*typed = NULL;
 	if (!conn || !table) return NULL;
 
+	/* Columns set on the table are read from the window of rows */
+	for (i = 0; table->columns && i < table->columns->count; i++) {
+		if (table->columns->proptags[i] != proptag) continue;
+
+		window = _table_get_window(conn, table, pos);
+		if (window) {
+			cell = (pos - window->start) * table->columns->count + i;
+			*typed = &window->typed[cell];
+			return window->values[cell];
+		}
+		break;
+	}
+
 	is_message = table->table_type == 0x3 || table->table_type == 0x2;
 
 	if (is_message) {
@@ -3192,6 +3577,7 @@ static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
 {
 	struct openchangedb_table		*table = (struct openchangedb_table *)_table;
 	const char				*value;
+	const DATA_BLOB				*typed;
 	enum MAPISTATUS				retval;
 	MYSQL					*conn;
 	struct openchangedb_table_results	*res;
@@ -3239,10 +3625,10 @@ static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
 	*data = _get_special_property(mem_ctx, proptag);
 	if (*data) goto end;
 
-	value = _table_fetch_attribute(conn, table, pos, proptag);
+	value = _table_fetch_attribute(conn, table, pos, proptag, &typed);
 	OPENCHANGE_RETVAL_IF(value == NULL, MAPI_E_NOT_FOUND, NULL);
 
-	*data = get_property_data(mem_ctx, proptag, value);
+	*data = get_stored_property_data(mem_ctx, conn, NULL, 0, proptag, NULL, value, typed);
 	OPENCHANGE_RETVAL_IF(*data == NULL, MAPI_E_NOT_FOUND, NULL);
 end:
 	return MAPI_E_SUCCESS;
@@ -3260,6 +3646,8 @@ enum openchangedb_message_type {
 struct openchangedb_message_properties {
 	const char 	**names;
 	const char 	**values;
+	DATA_BLOB	*typed;		/* typed form of values, when known */
+	bool		*stored;	/* value is the one in messages_properties */
 	size_t 		size;
 };
 
@@ -3354,6 +3742,10 @@ static enum MAPISTATUS message_create(TALLOC_CTX *parent_ctx,
 	OPENCHANGE_RETVAL_IF(!msg->properties.names, MAPI_E_NOT_ENOUGH_MEMORY, msg);
 	msg->properties.values = (const char **)talloc_zero_array(msg, char *, msg->properties.size);
 	OPENCHANGE_RETVAL_IF(!msg->properties.values, MAPI_E_NOT_ENOUGH_MEMORY, msg);
+	msg->properties.typed = talloc_zero_array(msg, DATA_BLOB, msg->properties.size);
+	OPENCHANGE_RETVAL_IF(!msg->properties.typed, MAPI_E_NOT_ENOUGH_MEMORY, msg);
+	msg->properties.stored = talloc_zero_array(msg, bool, msg->properties.size);
+	OPENCHANGE_RETVAL_IF(!msg->properties.stored, MAPI_E_NOT_ENOUGH_MEMORY, msg);
 	// Add required properties as described in [MS_OXCMSG] 3.2.5.2
 	msg->properties.names[0] = talloc_strdup(msg, "PidTagDisplayBcc");
 	OPENCHANGE_RETVAL_IF(!msg->properties.names[0], MAPI_E_NOT_ENOUGH_MEMORY, msg);
@@ -3404,6 +3796,7 @@ static enum MAPISTATUS message_save(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	table_window_generation++;
 
 	fields = (const char **)str_list_make_empty(mem_ctx);
 	OPENCHANGE_RETVAL_IF(!fields, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
@@ -3550,6 +3943,7 @@ static enum MAPISTATUS message_open(TALLOC_CTX *parent_ctx,
 	char				*sql;
 	MYSQL_RES			*res;
 	MYSQL_ROW			row;
+	unsigned long			*lengths;
 	size_t				i;
 	uint64_t			mailbox_id = 0, mailbox_folder_id;
 
@@ -3629,8 +4023,10 @@ static enum MAPISTATUS message_open(TALLOC_CTX *parent_ctx,
 
 	// Now fetch all properties
 	sql = talloc_asprintf(mem_ctx,
-		"SELECT name, value FROM messages_properties "
-		"WHERE message_id = %"PRIu64, msg->id);
+		"SELECT p.name, p.value, t.typed_value FROM messages_properties p "
+		"LEFT JOIN messages_properties_typed t ON t.message_id = p.message_id "
+		"  AND t.name = p.name AND t.value = BINARY p.value "
+		"WHERE p.message_id = %"PRIu64, msg->id);
 	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 	retval = status(select_without_fetch(conn, sql, &res));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
@@ -3646,8 +4042,15 @@ static enum MAPISTATUS message_open(TALLOC_CTX *parent_ctx,
 		mysql_free_result(res);
 		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 	}
+	msg->properties.typed = talloc_zero_array(msg, DATA_BLOB, msg->properties.size);
+	msg->properties.stored = talloc_zero_array(msg, bool, msg->properties.size);
+	if (!msg->properties.typed || !msg->properties.stored) {
+		mysql_free_result(res);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	}
 	for (i = 0; i < msg->properties.size; i++) {
 		row = mysql_fetch_row(res);
+		lengths = mysql_fetch_lengths(res);
 		msg->properties.names[i] = talloc_strdup(msg, row[0]);
 		if (!msg->properties.names[i]) {
 			mysql_free_result(res);
@@ -3658,6 +4061,15 @@ static enum MAPISTATUS message_open(TALLOC_CTX *parent_ctx,
 			mysql_free_result(res);
 			OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 		}
+		msg->properties.stored[i] = true;
+		if (row[2]) {
+			msg->properties.typed[i].data = talloc_memdup(msg, row[2], lengths[2]);
+			if (!msg->properties.typed[i].data) {
+				mysql_free_result(res);
+				OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+			}
+			msg->properties.typed[i].length = lengths[2];
+		}
 	}
 	mysql_free_result(res);
 	*message_object = (void *) talloc_steal(parent_ctx, msg);
@@ -3691,6 +4103,8 @@ static enum MAPISTATUS message_get_property(TALLOC_CTX *parent_ctx,
 	char				*sql;
 	size_t				attr_len;
 	const char			*attr, *value = NULL;
+	const DATA_BLOB			*typed = NULL;
+	const struct typed_properties_table	*typed_table = NULL;
 	uint64_t			*id;
 	size_t				i;
 
@@ -3751,13 +4165,18 @@ static enum MAPISTATUS message_get_property(TALLOC_CTX *parent_ctx,
 	for (i = 0; i < msg->properties.size; i++) {
 		if (strncmp(msg->properties.names[i], attr, attr_len) == 0) {
 			value = msg->properties.values[i];
+			typed = &msg->properties.typed[i];
+			if (msg->properties.stored[i]) {
+				typed_table = &typed_messages_properties;
+			}
 			break;
 		}
 	}
 	// check if we have a value for proptag requested
 	if (value != NULL) {
 		// Transform string into the expected data type
-		*data = get_property_data(parent_ctx, proptag, value);
+		*data = get_stored_property_data(parent_ctx, conn, typed_table, msg->id, proptag,
+						 msg->properties.names[i], value, typed);
 		OPENCHANGE_RETVAL_IF(*data == NULL, MAPI_E_NOT_FOUND, mem_ctx);
 		retval = MAPI_E_SUCCESS;
 	}
@@ -3815,6 +4234,9 @@ static enum MAPISTATUS message_set_properties(TALLOC_CTX *parent_ctx,
 			if (strncmp(attr, msg->properties.names[j], strlen(attr)) == 0) {
 				msg->properties.values[j] = talloc_strdup(msg, str_value);
 				OPENCHANGE_RETVAL_IF(!msg->properties.values[j], MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+				msg->properties.typed[j].data = NULL;
+				msg->properties.typed[j].length = 0;
+				msg->properties.stored[j] = false;
 				found = true;
 			}
 		}
@@ -3825,6 +4247,13 @@ static enum MAPISTATUS message_set_properties(TALLOC_CTX *parent_ctx,
 			OPENCHANGE_RETVAL_IF(!msg->properties.names, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 			msg->properties.values = (const char **)talloc_realloc(msg, msg->properties.values, char *, msg->properties.size);
 			OPENCHANGE_RETVAL_IF(!msg->properties.values, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+			msg->properties.typed = talloc_realloc(msg, msg->properties.typed, DATA_BLOB, msg->properties.size);
+			OPENCHANGE_RETVAL_IF(!msg->properties.typed, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+			msg->properties.stored = talloc_realloc(msg, msg->properties.stored, bool, msg->properties.size);
+			OPENCHANGE_RETVAL_IF(!msg->properties.stored, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+			msg->properties.typed[msg->properties.size-1].data = NULL;
+			msg->properties.typed[msg->properties.size-1].length = 0;
+			msg->properties.stored[msg->properties.size-1] = false;
 			msg->properties.names[msg->properties.size-1] = talloc_strdup(msg, attr);
 			OPENCHANGE_RETVAL_IF(!msg->properties.names[msg->properties.size-1], MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 			msg->properties.values[msg->properties.size-1] = talloc_strdup(msg, str_value);
@@ -3844,6 +4273,7 @@ static int openchangedb_mysql_destructor(struct openchangedb_context *self)
 	OC_DEBUG(5, "Destroying openchangedb mysql context\n");
 	if (self && self->data) {
 		MYSQL *conn = self->data;
+		openchangedb_cn_leases_return(self);
 		release_connection(conn);
 	} else {
 		OC_DEBUG(0, "Error: tried to destroy corrupted openchangedb mysql context\n");
@@ -3868,6 +4298,7 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -3903,6 +4334,7 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_init = table_init;
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
+	oc_ctx->table_set_columns = table_set_columns;
 	oc_ctx->table_get_property = table_get_property;
 
 	oc_ctx->message_create = message_create;
@@ -3934,7 +4366,12 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_NOT_INITIALIZED, oc_ctx);
 	oc_ctx->data = conn;
 	talloc_set_destructor(oc_ctx, openchangedb_mysql_destructor);
-	if (!table_exists(oc_ctx->data, "folders")) {
+	openchangedb_mysql_set_typed_backfill(lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy",
+							      "openchangedb_typed_backfill", true));
+	/* Databases created before the typed property tables get them
+	   through the same migrations */
+	if (!table_exists(oc_ctx->data, "folders") ||
+	    !table_exists(oc_ctx->data, "folders_properties_typed")) {
 		OC_DEBUG(3, "Creating schema for openchangedb on mysql %s\n",
 			  connection_string);
 		schema_created_ret = migrate_openchangedb_schema(connection_string);
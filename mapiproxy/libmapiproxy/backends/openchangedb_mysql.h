@@ -27,5 +27,6 @@
 #define MAX_PUBLIC_FOLDER_ID 1000
 
 enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *, struct loadparm_context *, struct openchangedb_context **);
+void openchangedb_mysql_set_typed_backfill(bool);
 
 #endif /* __OPENCHANGEDB_MYSQL_H__ */
@@ -120,25 +120,49 @@ struct auth_serversupplied_info
 };
 
 
+/**
+   MAPI handle record. prev/next link the handle into its parent's
+   children list, or into the context root list when it has no
+   (known) parent.
+ */
 struct mapi_handles {
 	uint32_t	       	handle;
 	uint32_t		parent_handle;
 	void		       	*private_data;
 	struct mapi_handles	*prev;
 	struct mapi_handles	*next;
+	struct mapi_handles	*parent;
+	struct mapi_handles	*children;
+};
+
+
+/**
+   Slot of the MAPI handles table. A slot either points to a live
+   record or is chained in the free list through next_free.
+ */
+struct mapi_handles_slot {
+	struct mapi_handles	*rec;
+	uint32_t		generation;
+	uint32_t		next_free;
 };
 
 
 struct mapi_handles_context {
-	TDB_CONTEXT	       	*tdb_ctx;
-	uint32_t		last_handle;
-	struct mapi_handles    	*handles;
+	struct mapi_handles_slot	*slots;
+	uint32_t			slots_size;
+	uint32_t			last_handle;
+	uint32_t			free_slot;
+	uint32_t			count;
+	struct mapi_handles    		*handles;
 };
 
 
-#define	MAPI_HANDLES_RESERVED	0xFFFFFFFF
-#define	MAPI_HANDLES_ROOT	"root"
-#define	MAPI_HANDLES_NULL	"null"
+#define	MAPI_HANDLES_RESERVED		0xFFFFFFFF
+#define	MAPI_HANDLES_INDEX_BITS		20
+#define	MAPI_HANDLES_INDEX_MASK		((1 << MAPI_HANDLES_INDEX_BITS) - 1)
+#define	MAPI_HANDLES_GENERATION_MASK	(0xFFFFFFFF >> MAPI_HANDLES_INDEX_BITS)
+#define	MAPI_HANDLES_MAX_SLOTS		MAPI_HANDLES_INDEX_MASK
+#define	MAPI_HANDLES_INITIAL_SLOTS	64
 
 /**
    Logon map
@@ -232,6 +256,7 @@ struct openchangedb_context;
 enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *, struct loadparm_context *, struct openchangedb_context **oc_ctx);
 enum MAPISTATUS openchangedb_get_new_changeNumber(struct openchangedb_context *, const char *, uint64_t *);
 enum MAPISTATUS openchangedb_get_new_changeNumbers(struct openchangedb_context *, TALLOC_CTX *, const char *, uint64_t, struct UI8Array_r **);
+void		openchangedb_cn_leases_return(struct openchangedb_context *);
 enum MAPISTATUS openchangedb_get_next_changeNumber(struct openchangedb_context *, const char *, uint64_t *);
 enum MAPISTATUS openchangedb_get_SystemFolderID(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 enum MAPISTATUS openchangedb_get_SpecialFolderID(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
@@ -251,6 +276,9 @@ enum MAPISTATUS openchangedb_get_TransportFolder(struct openchangedb_context *,
 enum MAPISTATUS openchangedb_lookup_folder_property(struct openchangedb_context *, uint32_t, uint64_t);
 enum MAPISTATUS openchangedb_set_folder_properties(struct openchangedb_context *, const char *, uint64_t, struct SRow *);
 char *          openchangedb_set_folder_property_data(TALLOC_CTX *, struct SPropValue *);
+bool		openchangedb_property_is_packable(uint32_t);
+enum MAPISTATUS openchangedb_property_pack(TALLOC_CTX *, uint32_t, const void *, DATA_BLOB *);
+void *		openchangedb_property_unpack(TALLOC_CTX *, uint32_t, const DATA_BLOB *);
 enum MAPISTATUS openchangedb_get_folder_property(TALLOC_CTX *, struct openchangedb_context *, const char *, uint32_t, uint64_t, void **);
 enum MAPISTATUS openchangedb_get_folder_count(struct openchangedb_context *, const char *, uint64_t, uint32_t *);
 enum MAPISTATUS openchangedb_get_message_count(struct openchangedb_context *, const char *, uint64_t, uint32_t *, bool);
@@ -279,10 +307,17 @@ const char **	openchangedb_get_folders_names(TALLOC_CTX *, struct openchangedb_c
 enum MAPISTATUS openchangedb_replica_mapping_guid_to_replid(struct openchangedb_context *, const char *, const struct GUID *, uint16_t *);
 enum MAPISTATUS openchangedb_replica_mapping_replid_to_guid(struct openchangedb_context *, const char *, uint16_t, struct GUID *);
 
+/* definitions from openchangedb_cache.c */
+struct openchangedb_cache_stats;
+enum MAPISTATUS openchangedb_cache_init(struct openchangedb_context *, uint32_t, uint32_t);
+void		openchangedb_cache_invalidate(struct openchangedb_context *, const char *);
+enum MAPISTATUS openchangedb_cache_get_stats(struct openchangedb_context *, struct openchangedb_cache_stats *);
+
 /* definitions from openchangedb_table.c */
 enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *, struct openchangedb_context *, const char *, uint8_t, uint64_t, void **);
 enum MAPISTATUS openchangedb_table_set_sort_order(struct openchangedb_context *, void *, struct SSortOrderSet *);
 enum MAPISTATUS openchangedb_table_set_restrictions(struct openchangedb_context *, void *, struct mapi_SRestriction *);
+enum MAPISTATUS openchangedb_table_set_columns(struct openchangedb_context *, void *, uint16_t, enum MAPITAGS *);
 enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
 
 /* definitions from openchangedb_message.c */
@@ -45,13 +45,21 @@ _PUBLIC_ struct mapi_handles_context *mapi_handles_init(TALLOC_CTX *mem_ctx)
 	handles_ctx = talloc_zero(mem_ctx, struct mapi_handles_context);
 	if (!handles_ctx) return NULL;
 
-	/* Step 2. Initialize the TDB context */
-	handles_ctx->tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	/* Step 2. Initialize the slots table */
+	handles_ctx->slots = talloc_zero_array(handles_ctx, struct mapi_handles_slot,
+					       MAPI_HANDLES_INITIAL_SLOTS);
+	if (!handles_ctx->slots) {
+		talloc_free(handles_ctx);
+		return NULL;
+	}
+	handles_ctx->slots_size = MAPI_HANDLES_INITIAL_SLOTS;
 
-	/* Step 3. Initialize the handles list */
+	/* Step 3. Initialize the handles list and the free list */
 	handles_ctx->handles = NULL;
+	handles_ctx->free_slot = 0;
+	handles_ctx->count = 0;
 
-	/* Step 4. Set last_handle to the first valid value */
+	/* Step 4. Set last_handle to the first valid slot index */
 	handles_ctx->last_handle = 1;
 
 	return handles_ctx;
@@ -70,7 +78,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	tdb_close(handles_ctx->tdb_ctx);
 	talloc_free(handles_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -78,186 +85,118 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 
 
 /**
-   \details Search for a record in the TDB database
+   \details Return the slot a MAPI handle refers to
+
+   The handle value encodes the slot index in its lower bits and the
+   slot generation in the upper bits, so a handle released and
+   allocated again by a different object is not matched anymore.
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle MAPI handle to lookup
-   \param rec pointer to the MAPI handle structure the function
-   returns
-   
-   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+   \param handle the MAPI handle to resolve
+
+   \return pointer to the slot on success, otherwise NULL
  */
-_PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle, struct mapi_handles **rec)
+static struct mapi_handles_slot *mapi_handles_get_slot(struct mapi_handles_context *handles_ctx,
+						       uint32_t handle)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	struct mapi_handles	*el;
+	struct mapi_handles_slot	*slot;
+	uint32_t			idx;
 
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
-	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_search");
-
-	/* Step 1. Search for the handle within TDB database */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	dbuf = tdb_fetch(handles_ctx->tdb_ctx, key);
-	talloc_free(key.dptr);
-	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, mem_ctx);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, mem_ctx);
-
-	talloc_free(mem_ctx);
-	/* Ensure this is not a free'd record */
-	if (dbuf.dsize == (sizeof(MAPI_HANDLES_NULL) - 1) && !strncmp((char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize)) {
-		free(dbuf.dptr);
-		return MAPI_E_NOT_FOUND;
+	idx = handle & MAPI_HANDLES_INDEX_MASK;
+	if (idx == 0 || idx >= handles_ctx->last_handle) {
+		return NULL;
 	}
-	free(dbuf.dptr);
 
-	/* Step 2. Return the record within the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			*rec = el;
-			return MAPI_E_SUCCESS;
-		}
+	slot = &handles_ctx->slots[idx];
+	if (!slot->rec || slot->rec->handle != handle) {
+		return NULL;
 	}
 
-	return MAPI_E_CORRUPT_STORE;
+	return slot;
 }
 
 
 /**
-   \details Set a TDB record data as null meaning it can be reused in
-   the future.
+   \details Search for a MAPI handle record
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle handle key value to free
-
+   \param handle MAPI handle to lookup
+   \param rec pointer to the MAPI handle structure the function
+   returns
+   
    \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_free(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle)
+_PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
+					     uint32_t handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	int			ret;
+	struct mapi_handles_slot	*slot;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_free");
-	
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update existing record */
-	dbuf.dptr = (unsigned char *)MAPI_HANDLES_NULL;
-	dbuf.dsize = sizeof(MAPI_HANDLES_NULL) - 1;
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to create 0x%x record: %s\n",
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx));
-		return MAPI_E_CORRUPT_STORE;
-	}
+	slot = mapi_handles_get_slot(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!slot, MAPI_E_NOT_FOUND, NULL);
+
+	*rec = slot->rec;
 
 	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Update a TDB record
+   \details Pick a slot for a new MAPI handle, reusing the most
+   recently released one when available
 
-   
+   \param handles_ctx pointer to the MAPI handles context
+   \param idx pointer to the slot index the function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_update(struct mapi_handles_context *handles_ctx,
-					       uint32_t handle, uint32_t container_handle)
+static enum MAPISTATUS mapi_handles_alloc_slot(struct mapi_handles_context *handles_ctx,
+					       uint32_t *idx)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	int		ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handle, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_update");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update record */
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to update 0x%x record: %s\n",
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx));
-
-		return MAPI_E_CORRUPT_STORE;
+	struct mapi_handles_slot	*slots;
+	uint32_t			size;
+
+	/* Step 1. Pop the free list */
+	if (handles_ctx->free_slot) {
+		*idx = handles_ctx->free_slot;
+		handles_ctx->free_slot = handles_ctx->slots[*idx].next_free;
+		handles_ctx->slots[*idx].next_free = 0;
+		return MAPI_E_SUCCESS;
 	}
 
-	return MAPI_E_SUCCESS;
-}
-
-
-/**
-   \details Traverse TDB database and search for the first record
-   which dbuf value is "null" string.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key
-   \param dbuf the current TDB value
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	TALLOC_CTX	*mem_ctx;
-	uint32_t	*handle = (uint32_t *) state;
-	char		*handle_str = NULL;
+	/* Step 2. Otherwise use a never used slot, growing the table if needed */
+	OPENCHANGE_RETVAL_IF(handles_ctx->last_handle >= MAPI_HANDLES_MAX_SLOTS,
+			     MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
 
-	if (dbuf.dptr && (dbuf.dsize == sizeof(MAPI_HANDLES_NULL) - 1) && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize) == 0) {
-		mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_null");
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		*handle = strtol((const char *) handle_str, NULL, 16);
-		talloc_free(mem_ctx);
-
-		return 1;
+	if (handles_ctx->last_handle >= handles_ctx->slots_size) {
+		size = handles_ctx->slots_size * 2;
+		if (size > MAPI_HANDLES_MAX_SLOTS) {
+			size = MAPI_HANDLES_MAX_SLOTS;
+		}
+		slots = talloc_realloc(handles_ctx, handles_ctx->slots,
+				       struct mapi_handles_slot, size);
+		OPENCHANGE_RETVAL_IF(!slots, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+		memset(&slots[handles_ctx->slots_size], 0,
+		       (size - handles_ctx->slots_size) * sizeof (struct mapi_handles_slot));
+		handles_ctx->slots = slots;
+		handles_ctx->slots_size = size;
 	}
 
-	return 0;
+	*idx = handles_ctx->last_handle;
+	handles_ctx->last_handle += 1;
+
+	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Add a handles to the database and return a pointer on
-   created record
+   \details Add a handle to the handles table and return a pointer
+   on created record
 
    \param handles_ctx pointer to the MAPI handles context
    \param container_handle the container handle if available
@@ -269,84 +208,52 @@ static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_ctx,
 					  uint32_t container_handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	enum MAPISTATUS		retval;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	uint32_t		handle = 0;
-	struct mapi_handles	*el;
-	int			ret;
+	enum MAPISTATUS			retval;
+	struct mapi_handles_slot	*slot;
+	struct mapi_handles_slot	*parent_slot = NULL;
+	struct mapi_handles		*el;
+	uint32_t			idx = 0;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_add");
-
-	/* Step 1. Seek the TDB database for the first free record */
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_null, (void *)&handle);
-	if (ret > -1 && handle > 0) {
-		OC_DEBUG(5, "We have found free record 0x%x", handle);
-		retval = mapi_handles_tdb_update(handles_ctx, handle, container_handle);
-		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-		
-		el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-		if (!el) {
-			mapi_handles_tdb_free(handles_ctx, handle);
-			talloc_free(mem_ctx);
-			return MAPI_E_NOT_ENOUGH_RESOURCES;
-		}
-
-		el->handle = handle;
-		el->parent_handle = container_handle;
-		el->private_data = NULL;
-		*rec = el;
-		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
-		talloc_free(mem_ctx);
-
-		return MAPI_E_SUCCESS;
+	/* Step 1. Allocate the record */
+	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
+	OPENCHANGE_RETVAL_IF(!el, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+
+	/* Step 2. Find a slot for it */
+	retval = mapi_handles_alloc_slot(handles_ctx, &idx);
+	if (retval != MAPI_E_SUCCESS) {
+		OC_DEBUG(3, "Unable to allocate a new handle: %s", mapi_get_errstr(retval));
+		talloc_free(el);
+		return retval;
 	}
 
-	/* Step 2. If no record is available, create a new one */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handles_ctx->last_handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	if (container_handle) {
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
-	} else {
-		dbuf.dptr = (unsigned char *) MAPI_HANDLES_ROOT;
-		dbuf.dsize = strlen(MAPI_HANDLES_ROOT);
-	}
+	slot = &handles_ctx->slots[idx];
+	slot->rec = el;
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to create 0x%x record: %s",
-			  handles_ctx->last_handle, tdb_errorstr(handles_ctx->tdb_ctx));
-		talloc_free(mem_ctx);
+	el->handle = (slot->generation << MAPI_HANDLES_INDEX_BITS) | idx;
+	el->parent_handle = container_handle;
+	el->private_data = NULL;
+	el->parent = NULL;
+	el->children = NULL;
 
-		return MAPI_E_CORRUPT_STORE;
+	/* Step 3. Link the record to its parent children list */
+	if (container_handle && container_handle != MAPI_HANDLES_RESERVED) {
+		parent_slot = mapi_handles_get_slot(handles_ctx, container_handle);
 	}
-
-	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-	if (!el) {
-		mapi_handles_tdb_free(handles_ctx, handles_ctx->last_handle);
-		talloc_free(mem_ctx);
-		return MAPI_E_NOT_ENOUGH_RESOURCES;
+	if (parent_slot) {
+		el->parent = parent_slot->rec;
+		DLIST_ADD_END(el->parent->children, el, struct mapi_handles *);
+	} else {
+		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 	}
-
-	el->handle = handles_ctx->last_handle;
-	el->parent_handle = container_handle;
-	el->private_data = NULL;
+	handles_ctx->count += 1;
 	*rec = el;
-	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 
 	OC_DEBUG(5, "handle 0x%.2x is a father of 0x%.2x", container_handle, el->handle);
-	handles_ctx->last_handle += 1;
-	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -395,55 +302,10 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_set_private_data(struct mapi_handles *hand
 }
 
 
-struct mapi_handles_private {
-	struct mapi_handles_context	*handles_ctx;
-	uint32_t			container_handle;
-};
-
-/**
-   \details Traverse TDB database and search for records
-   which dbuf value is set to state.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key (potential child handle)
-   \param dbuf the current TDB value (parent handle)
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
-					TDB_DATA key, TDB_DATA dbuf,
-					void *state)
-{
-	TALLOC_CTX			*mem_ctx;
-	struct mapi_handles_private	*handles_private = (struct mapi_handles_private *) state;
-	uint32_t			handle;
-	char				*container_handle_str = NULL;
-	char				*handle_str = NULL;
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_delete");
-	container_handle_str = talloc_asprintf(mem_ctx, "0x%x", handles_private->container_handle);
-
-	if (dbuf.dptr && strlen(container_handle_str) == dbuf.dsize && strncmp((const char *)dbuf.dptr, container_handle_str, dbuf.dsize) == 0) {
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		OC_DEBUG(5, "handles being released must NOT have child handles attached to them (%s is a child of %s)", handle_str, container_handle_str);
-		handle = strtol((const char *) handle_str, NULL, 16);
-		/* abort(); */
-		/* DEBUG(5, ("deleting child handle: %d, %s\n", handle, handle_str)); */
-		mapi_handles_delete(handles_private->handles_ctx, handle);
-	}
-
-	talloc_free(mem_ctx);
-
-	return 0;
-}
-
-
-
 /**
    \details Remove the MAPI handle referenced by the handle parameter
-   from the double chained list and mark its associated TDB record as
-   null
+   and its hierarchy of children from the handles table. Released
+   slots are pushed on the free list with a bumped generation.
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle the handle to delete
@@ -453,56 +315,45 @@ static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_delete(struct mapi_handles_context *handles_ctx, 
 					     uint32_t handle)
 {
-	TALLOC_CTX			*mem_ctx;
-	enum MAPISTATUS			retval;
-	TDB_DATA			key;
+	struct mapi_handles_slot	*slot;
 	struct mapi_handles		*el;
-	struct mapi_handles_private	handles_private;
-	int				ret;
-	bool				found = false;
+	uint32_t			idx;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 
-	OC_DEBUG(4, "Deleting MAPI handle 0x%x (handles_ctx: %p, tdb_ctx: %p)",
-		  handle, handles_ctx, handles_ctx->tdb_ctx);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_delete");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	OC_DEBUG(4, "Deleting MAPI handle 0x%x (handles_ctx: %p)", handle, handles_ctx);
 
 	/* Step 1. Make sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Delete this record from the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			DLIST_REMOVE(handles_ctx->handles, el);
-			talloc_free(el);
-			found = true;
-			break;
-		}
+	slot = mapi_handles_get_slot(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!slot, MAPI_E_NOT_FOUND, NULL);
+	el = slot->rec;
+
+	/* Step 2. Delete hierarchy of children */
+	while (el->children) {
+		OC_DEBUG(5, "handles being released must NOT have child handles attached to them (0x%x is a child of 0x%x)",
+			 el->children->handle, handle);
+		mapi_handles_delete(handles_ctx, el->children->handle);
+	}
+
+	/* Step 3. Unlink this record from its parent children list */
+	if (el->parent) {
+		DLIST_REMOVE(el->parent->children, el);
+	} else {
+		DLIST_REMOVE(handles_ctx->handles, el);
 	}
-	/* This case should never occur */
-	OPENCHANGE_RETVAL_IF(found == false, MAPI_E_CORRUPT_STORE, mem_ctx);
-
-	/* Step 3. Free this record within the TDB database */
-	retval = mapi_handles_tdb_free(handles_ctx, handle);
-	/* if (retval) { */
-	/* 	abort(); */
-	/* } */
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-
-	/* Step 4. Delete hierarchy of children */
-	handles_private.handles_ctx = handles_ctx;
-	handles_private.container_handle = handle;
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_delete, (void *)&handles_private);
-
-	talloc_free(mem_ctx);
+
+	/* Step 4. Release the slot and push it on the free list */
+	idx = handle & MAPI_HANDLES_INDEX_MASK;
+	slot->rec = NULL;
+	slot->generation = (slot->generation + 1) & MAPI_HANDLES_GENERATION_MASK;
+	slot->next_free = handles_ctx->free_slot;
+	handles_ctx->free_slot = idx;
+	handles_ctx->count -= 1;
+
+	talloc_free(el);
 
 	OC_DEBUG(4, "Deleting MAPI handle 0x%x COMPLETE", handle);
 
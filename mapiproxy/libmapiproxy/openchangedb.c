@@ -33,6 +33,8 @@
 #include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
+#include "mapiproxy/util/oc_rop_stats.h"
+#include "utils/dlinklist.h"
 
 #include "mapiproxy/libmapiproxy/backends/openchangedb_mysql.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_ldb.h"
@@ -74,8 +76,22 @@ _PUBLIC_ enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *mem_ctx,
 						       "openchangedb_logger_prefix");
 		OC_DEBUG(0, "Loading OpenchangeDB logger module\n");
 		retval = openchangedb_logger_initialize(mem_ctx, 0, prefix, *oc_ctx, oc_ctx);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
 	}
 
+	(*oc_ctx)->cn_lease_size = lpcfg_parm_int(lp_ctx, NULL, "mapiproxy",
+						  "openchangedb_cn_lease", 0);
+
+	retval = openchangedb_cache_init(*oc_ctx,
+					 lpcfg_parm_int(lp_ctx, NULL, "mapiproxy",
+							"openchangedb_cache_size",
+							OPENCHANGEDB_CACHE_DEFAULT_SIZE),
+					 lpcfg_parm_int(lp_ctx, NULL, "mapiproxy",
+							"openchangedb_cache_ttl",
+							OPENCHANGEDB_CACHE_DEFAULT_TTL));
+
 	return retval;
 }
 
@@ -98,7 +114,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_SpecialFolderID(struct openchangedb_co
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!FolderId, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_SpecialFolderID(oc_ctx, recipient, SystemIdx, FolderId);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_SpecialFolderID(oc_ctx, recipient, SystemIdx, FolderId));
 }
 
 /**
@@ -116,11 +132,25 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_SystemFolderID(struct openchangedb_con
 							 const char *recipient, uint32_t SystemIdx,
 							 uint64_t *FolderId)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!FolderId, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_SystemFolderID(oc_ctx, recipient, SystemIdx, FolderId);
+	if (openchangedb_cache_get_id(oc_ctx, OPENCHANGEDB_CACHE_SYSTEM_FOLDER_ID,
+				      recipient, SystemIdx, 0, FolderId)) {
+		return MAPI_E_SUCCESS;
+	}
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->get_SystemFolderID(oc_ctx, recipient, SystemIdx, FolderId));
+	if (retval == MAPI_E_SUCCESS) {
+		openchangedb_cache_set_id(oc_ctx, OPENCHANGEDB_CACHE_SYSTEM_FOLDER_ID,
+					  recipient, SystemIdx, 0, *FolderId);
+	}
+
+	return retval;
 }
 
 /**
@@ -141,7 +171,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_PublicFolderID(struct openchangedb_con
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!FolderId, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_PublicFolderID(oc_ctx, username, SystemIdx, FolderId);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_PublicFolderID(oc_ctx, username, SystemIdx, FolderId));
 }
 
 /**
@@ -164,7 +194,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_distinguishedName(TALLOC_CTX *parent_c
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!distinguishedName, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_distinguishedName(parent_ctx, oc_ctx, fid, distinguishedName);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_distinguishedName(parent_ctx, oc_ctx, fid, distinguishedName));
 }
 
 /**
@@ -184,7 +214,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_MailboxGuid(struct openchangedb_contex
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!MailboxGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_MailboxGuid(oc_ctx, recipient, MailboxGUID);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_MailboxGuid(oc_ctx, recipient, MailboxGUID));
 }
 
 /**
@@ -205,7 +235,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_MailboxReplica(struct openchangedb_con
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_MailboxReplica(oc_ctx, recipient, ReplID, ReplGUID);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_MailboxReplica(oc_ctx, recipient, ReplID, ReplGUID));
 }
 
 /**
@@ -226,7 +256,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_PublicFolderReplica(struct openchanged
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_PublicFolderReplica(oc_ctx, username, ReplID, ReplGUID);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_PublicFolderReplica(oc_ctx, username, ReplID, ReplGUID));
 }
 
 /**
@@ -251,12 +281,26 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_mapistoreURI(TALLOC_CTX *parent_ctx,
 						       char **mapistoreURL,
 						       bool mailboxstore)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!mapistoreURL, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_mapistoreURI(parent_ctx, oc_ctx, username, fid,
-					mapistoreURL, mailboxstore);
+	if (openchangedb_cache_get_data(parent_ctx, oc_ctx, OPENCHANGEDB_CACHE_MAPISTORE_URI,
+					username, fid, mailboxstore, (void **)mapistoreURL)) {
+		return MAPI_E_SUCCESS;
+	}
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->get_mapistoreURI(parent_ctx, oc_ctx, username, fid,
+								    mapistoreURL, mailboxstore));
+	if (retval == MAPI_E_SUCCESS) {
+		openchangedb_cache_set_data(oc_ctx, OPENCHANGEDB_CACHE_MAPISTORE_URI,
+					    username, fid, mailboxstore, *mapistoreURL);
+	}
+
+	return retval;
 }
 
 /**
@@ -274,11 +318,17 @@ _PUBLIC_ enum MAPISTATUS openchangedb_set_mapistoreURI(struct openchangedb_conte
 						       uint64_t fid,
 						       const char *mapistoreURL)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!mapistoreURL, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->set_mapistoreURI(oc_ctx, username, fid, mapistoreURL);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->set_mapistoreURI(oc_ctx, username, fid, mapistoreURL));
+	openchangedb_cache_invalidate(oc_ctx, "set_mapistoreURI");
+
+	return retval;
 }
 
 /**
@@ -296,12 +346,18 @@ _PUBLIC_ enum MAPISTATUS openchangedb_set_system_idx(struct openchangedb_context
                                                      uint64_t fid,
                                                      int system_idx)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(system_idx < -1, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->set_system_idx(oc_ctx, username, fid, system_idx);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->set_system_idx(oc_ctx, username, fid, system_idx));
+	openchangedb_cache_invalidate(oc_ctx, "set_system_idx");
+
+	return retval;
 }
 
 /**
@@ -323,12 +379,26 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_parent_fid(struct openchangedb_context
 						     uint64_t *parent_fidp,
 						     bool mailboxstore)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!parent_fidp, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_parent_fid(oc_ctx, username, fid, parent_fidp,
-				      mailboxstore);
+	if (openchangedb_cache_get_id(oc_ctx, OPENCHANGEDB_CACHE_PARENT_FID,
+				      username, fid, mailboxstore, parent_fidp)) {
+		return MAPI_E_SUCCESS;
+	}
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->get_parent_fid(oc_ctx, username, fid, parent_fidp,
+								  mailboxstore));
+	if (retval == MAPI_E_SUCCESS) {
+		openchangedb_cache_set_id(oc_ctx, OPENCHANGEDB_CACHE_PARENT_FID,
+					  username, fid, mailboxstore, *parent_fidp);
+	}
+
+	return retval;
 }
 
 /**
@@ -348,7 +418,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_fid(struct openchangedb_context *oc_ct
 	OPENCHANGE_RETVAL_IF(!mapistoreURL, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fidp, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_fid(oc_ctx, mapistoreURL, fidp);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_fid(oc_ctx, mapistoreURL, fidp));
 }
 
 /**
@@ -369,7 +439,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_MAPIStoreURIs(struct openchangedb_cont
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!urisP, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_MAPIStoreURIs(oc_ctx, username, mem_ctx, urisP);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_MAPIStoreURIs(oc_ctx, username, mem_ctx, urisP));
 }
 
 /**
@@ -399,8 +469,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_ReceiveFolder(TALLOC_CTX *parent_ctx,
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!ExplicitMessageClass, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_ReceiveFolder(parent_ctx, oc_ctx, recipient,
-					 MessageClass, fid, ExplicitMessageClass);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_ReceiveFolder(parent_ctx, oc_ctx, recipient,
+								   MessageClass, fid, ExplicitMessageClass));
 }
 
 
@@ -431,8 +501,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_ReceiveFolderTable(TALLOC_CTX *mem_ctx
 	OPENCHANGE_RETVAL_IF(!cValues, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!entries, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_ReceiveFolderTable(mem_ctx, oc_ctx, recipient,
-					      cValues, entries);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_ReceiveFolderTable(mem_ctx, oc_ctx, recipient,
+									cValues, entries));
 }
 
 /**
@@ -452,7 +522,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_TransportFolder(struct openchangedb_co
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!FolderId, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_TransportFolder(oc_ctx, recipient, FolderId);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_TransportFolder(oc_ctx, recipient, FolderId));
 }
 
 /**
@@ -474,7 +544,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_folder_count(struct openchangedb_conte
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!RowCount, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_folder_count(oc_ctx, username, fid, RowCount);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_folder_count(oc_ctx, username, fid, RowCount));
 }
 
 /**
@@ -493,7 +563,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_lookup_folder_property(struct openchangedb
 {
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return oc_ctx->lookup_folder_property(oc_ctx, proptag, fid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->lookup_folder_property(oc_ctx, proptag, fid));
 }
 
 /**
@@ -567,6 +637,387 @@ _PUBLIC_ char *openchangedb_set_folder_property_data(TALLOC_CTX *mem_ctx,
 	return data;
 }
 
+/**
+   \details Tell whether a property type has a typed (packed) form
+
+   Strings are left out: their text form already is their value.
+
+   \param proptag the MAPI property tag
+
+   \return true if openchangedb_property_pack supports the type
+ */
+_PUBLIC_ bool openchangedb_property_is_packable(uint32_t proptag)
+{
+	switch (proptag & 0xFFFF) {
+	case PT_BOOLEAN:
+	case PT_LONG:
+	case PT_I8:
+	case PT_SYSTIME:
+	case PT_BINARY:
+	case PT_MV_BINARY:
+	case PT_MV_LONG:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static enum ndr_err_code openchangedb_property_push(struct ndr_push *ndr, uint32_t proptag,
+						    const void *data)
+{
+	const struct FILETIME		*ft;
+	const struct Binary_r		*bin;
+	const struct BinaryArray_r	*bin_array;
+	const struct LongArray_r	*long_array;
+	uint32_t			i;
+
+	NDR_CHECK(ndr_push_uint16(ndr, NDR_SCALARS, proptag & 0xFFFF));
+
+	switch (proptag & 0xFFFF) {
+	case PT_BOOLEAN:
+		NDR_CHECK(ndr_push_uint8(ndr, NDR_SCALARS, *(const int *)data ? 1 : 0));
+		break;
+	case PT_LONG:
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, *(const uint32_t *)data));
+		break;
+	case PT_I8:
+		NDR_CHECK(ndr_push_hyper(ndr, NDR_SCALARS, *(const uint64_t *)data));
+		break;
+	case PT_SYSTIME:
+		ft = (const struct FILETIME *)data;
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, ft->dwLowDateTime));
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, ft->dwHighDateTime));
+		break;
+	case PT_BINARY:
+		bin = (const struct Binary_r *)data;
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, bin->cb));
+		NDR_CHECK(ndr_push_bytes(ndr, bin->lpb, bin->cb));
+		break;
+	case PT_MV_BINARY:
+		bin_array = (const struct BinaryArray_r *)data;
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, bin_array->cValues));
+		for (i = 0; i < bin_array->cValues; i++) {
+			NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, bin_array->lpbin[i].cb));
+			NDR_CHECK(ndr_push_bytes(ndr, bin_array->lpbin[i].lpb, bin_array->lpbin[i].cb));
+		}
+		break;
+	case PT_MV_LONG:
+		long_array = (const struct LongArray_r *)data;
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, long_array->cValues));
+		for (i = 0; i < long_array->cValues; i++) {
+			NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, long_array->lpl[i]));
+		}
+		break;
+	default:
+		return NDR_ERR_BAD_SWITCH;
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
+static enum ndr_err_code openchangedb_property_pull_bin(struct ndr_pull *ndr, TALLOC_CTX *mem_ctx,
+							struct Binary_r *bin)
+{
+	NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &bin->cb));
+	NDR_PULL_NEED_BYTES(ndr, bin->cb);
+	bin->lpb = talloc_array(mem_ctx, uint8_t, bin->cb ? bin->cb : 1);
+	NDR_ERR_HAVE_NO_MEMORY(bin->lpb);
+	NDR_CHECK(ndr_pull_bytes(ndr, bin->lpb, bin->cb));
+
+	return NDR_ERR_SUCCESS;
+}
+
+static enum ndr_err_code openchangedb_property_pull(struct ndr_pull *ndr, TALLOC_CTX *mem_ctx,
+						    uint32_t proptag, void **datap)
+{
+	uint16_t		type;
+	uint8_t			b8;
+	int			*b;
+	uint32_t		*l;
+	uint64_t		*ll;
+	struct FILETIME		*ft;
+	struct Binary_r		*bin;
+	struct BinaryArray_r	*bin_array;
+	struct LongArray_r	*long_array;
+	uint32_t		i;
+
+	NDR_CHECK(ndr_pull_uint16(ndr, NDR_SCALARS, &type));
+	if (type != (proptag & 0xFFFF)) {
+		return NDR_ERR_BAD_SWITCH;
+	}
+
+	switch (type) {
+	case PT_BOOLEAN:
+		b = talloc_zero(mem_ctx, int);
+		NDR_ERR_HAVE_NO_MEMORY(b);
+		NDR_CHECK(ndr_pull_uint8(ndr, NDR_SCALARS, &b8));
+		*b = b8 ? 1 : 0;
+		*datap = b;
+		break;
+	case PT_LONG:
+		l = talloc_zero(mem_ctx, uint32_t);
+		NDR_ERR_HAVE_NO_MEMORY(l);
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, l));
+		*datap = l;
+		break;
+	case PT_I8:
+		ll = talloc_zero(mem_ctx, uint64_t);
+		NDR_ERR_HAVE_NO_MEMORY(ll);
+		NDR_CHECK(ndr_pull_hyper(ndr, NDR_SCALARS, ll));
+		*datap = ll;
+		break;
+	case PT_SYSTIME:
+		ft = talloc_zero(mem_ctx, struct FILETIME);
+		NDR_ERR_HAVE_NO_MEMORY(ft);
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &ft->dwLowDateTime));
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &ft->dwHighDateTime));
+		*datap = ft;
+		break;
+	case PT_BINARY:
+		bin = talloc_zero(mem_ctx, struct Binary_r);
+		NDR_ERR_HAVE_NO_MEMORY(bin);
+		*datap = bin;
+		NDR_CHECK(openchangedb_property_pull_bin(ndr, bin, bin));
+		break;
+	case PT_MV_BINARY:
+		bin_array = talloc_zero(mem_ctx, struct BinaryArray_r);
+		NDR_ERR_HAVE_NO_MEMORY(bin_array);
+		*datap = bin_array;
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &bin_array->cValues));
+		/* Every value takes at least its 4 bytes length */
+		if (bin_array->cValues > (ndr->data_size - ndr->offset) / 4) {
+			return NDR_ERR_ARRAY_SIZE;
+		}
+		bin_array->lpbin = talloc_zero_array(bin_array, struct Binary_r, bin_array->cValues);
+		NDR_ERR_HAVE_NO_MEMORY(bin_array->lpbin);
+		for (i = 0; i < bin_array->cValues; i++) {
+			NDR_CHECK(openchangedb_property_pull_bin(ndr, bin_array->lpbin, &bin_array->lpbin[i]));
+		}
+		break;
+	case PT_MV_LONG:
+		long_array = talloc_zero(mem_ctx, struct LongArray_r);
+		NDR_ERR_HAVE_NO_MEMORY(long_array);
+		*datap = long_array;
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &long_array->cValues));
+		if (long_array->cValues > (ndr->data_size - ndr->offset) / 4) {
+			return NDR_ERR_ARRAY_SIZE;
+		}
+		long_array->lpl = talloc_array(long_array, uint32_t, long_array->cValues);
+		NDR_ERR_HAVE_NO_MEMORY(long_array->lpl);
+		for (i = 0; i < long_array->cValues; i++) {
+			NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &long_array->lpl[i]));
+		}
+		break;
+	default:
+		return NDR_ERR_BAD_SWITCH;
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
+/**
+   \details Pack a property value into its typed form
+
+   The typed form is the property type followed by the NDR encoded
+   value. Reading it back needs neither base64 decoding nor string
+   parsing, unlike the text form built by
+   openchangedb_set_folder_property_data.
+
+   \param mem_ctx pointer to the memory context
+   \param proptag the MAPI property tag
+   \param data the value, laid out as openchangedb property getters
+   return it
+   \param blob pointer to the packed value to return
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NO_SUPPORT if the type has
+   no typed form, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_property_pack(TALLOC_CTX *mem_ctx, uint32_t proptag,
+						    const void *data, DATA_BLOB *blob)
+{
+	struct ndr_push		*ndr;
+
+	OPENCHANGE_RETVAL_IF(!data || !blob, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!openchangedb_property_is_packable(proptag), MAPI_E_NO_SUPPORT, NULL);
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!ndr, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	if (openchangedb_property_push(ndr, proptag, data) != NDR_ERR_SUCCESS) {
+		talloc_free(ndr);
+		return MAPI_E_NOT_ENOUGH_MEMORY;
+	}
+
+	blob->data = talloc_steal(mem_ctx, ndr->data);
+	blob->length = ndr->offset;
+	talloc_free(ndr);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Unpack a property value packed with openchangedb_property_pack
+
+   \param mem_ctx pointer to the memory context
+   \param proptag the MAPI property tag
+   \param blob the packed value
+
+   \return the value on success, NULL if the blob is not a valid typed
+   form of proptag
+ */
+_PUBLIC_ void *openchangedb_property_unpack(TALLOC_CTX *mem_ctx, uint32_t proptag,
+					    const DATA_BLOB *blob)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	struct ndr_pull		*ndr;
+	void			*data = NULL;
+
+	if (!blob || !blob->data || !openchangedb_property_is_packable(proptag)) {
+		return NULL;
+	}
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) return NULL;
+
+	ndr = ndr_pull_init_blob(blob, local_mem_ctx);
+	if (!ndr) goto end;
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	if (openchangedb_property_pull(ndr, local_mem_ctx, proptag, &data) != NDR_ERR_SUCCESS ||
+	    ndr->offset != ndr->data_size) {
+		OC_DEBUG(3, "Invalid typed value for property 0x%.8x", proptag);
+		data = NULL;
+		goto end;
+	}
+	data = talloc_steal(mem_ctx, data);
+end:
+	talloc_free(local_mem_ctx);
+	return data;
+}
+
+/**
+   \details Give the unused part of a change number lease back to the
+   backend. This is only possible while nobody else allocated change
+   numbers after us, otherwise the remaining values are simply lost
+   and leave a gap in the sequence.
+
+   \param lease pointer to the change number lease
+ */
+static void openchangedb_cn_lease_return(struct openchangedb_cn_lease *lease)
+{
+	struct openchangedb_context	*oc_ctx = lease->oc_ctx;
+	enum MAPISTATUS			retval;
+	uint64_t			first;
+	uint64_t			end;
+
+	if (!lease->cns || lease->index >= lease->cns->cValues) return;
+
+	/* Back to the raw counter values stored by the backend */
+	first = exchange_globcnt(lease->cns->lpui8[lease->index] >> 16);
+	end = exchange_globcnt(lease->cns->lpui8[lease->cns->cValues - 1] >> 16) + 1;
+
+	if (oc_ctx->release_changeNumbers) {
+		retval = oc_ctx->release_changeNumbers(oc_ctx, lease->username, first, end);
+	} else {
+		retval = MAPI_E_NO_SUPPORT;
+	}
+	if (retval == MAPI_E_SUCCESS) {
+		OC_DEBUG(5, "returned %"PRIu64" unused change numbers of %s",
+			 end - first, lease->username);
+	} else {
+		OC_DEBUG(5, "%"PRIu64" unused change numbers of %s are lost",
+			 end - first, lease->username);
+	}
+	lease->index = lease->cns->cValues;
+}
+
+static int openchangedb_cn_lease_destructor(struct openchangedb_cn_lease *lease)
+{
+	openchangedb_cn_lease_return(lease);
+	return 0;
+}
+
+/**
+   \details Give the unused part of every change number lease back to
+   the backend. Backends which tear down their connection in a talloc
+   destructor call this first, since the leases are only freed after
+   the context destructor has run.
+
+   \param oc_ctx pointer to the openchange DB context
+ */
+_PUBLIC_ void openchangedb_cn_leases_return(struct openchangedb_context *oc_ctx)
+{
+	struct openchangedb_cn_lease	*lease;
+
+	if (!oc_ctx) return;
+
+	for (lease = oc_ctx->cn_leases; lease; lease = lease->next) {
+		openchangedb_cn_lease_return(lease);
+	}
+}
+
+/**
+   \details Find the change number lease of a mailbox
+
+   \param oc_ctx pointer to the openchange DB context
+   \param username the mailbox name
+
+   \return the lease if any, otherwise NULL
+ */
+static struct openchangedb_cn_lease *openchangedb_cn_lease_search(struct openchangedb_context *oc_ctx,
+								  const char *username)
+{
+	struct openchangedb_cn_lease	*lease;
+
+	for (lease = oc_ctx->cn_leases; lease; lease = lease->next) {
+		if (!strcmp(lease->username, username)) {
+			return lease;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+   \details Find or create the change number lease of a mailbox
+
+   Change numbers are reserved by batches of oc_ctx->cn_lease_size
+   when leasing is enabled. Both single and batch allocations are
+   served from the lease first, so the values handed out by a process
+   keep increasing. Unused change numbers are given back when the
+   context is freed, unless another process allocated change numbers
+   in the meantime. Since another process may allocate higher change
+   numbers while we still hand out lower ones from our lease, leasing
+   is disabled by default.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param username the mailbox name
+
+   \return the lease on success, otherwise NULL
+ */
+static struct openchangedb_cn_lease *openchangedb_cn_lease_get(struct openchangedb_context *oc_ctx,
+							       const char *username)
+{
+	struct openchangedb_cn_lease	*lease;
+
+	lease = openchangedb_cn_lease_search(oc_ctx, username);
+	if (lease) return lease;
+
+	lease = talloc_zero(oc_ctx, struct openchangedb_cn_lease);
+	if (!lease) return NULL;
+	lease->username = talloc_strdup(lease, username);
+	if (!lease->username) {
+		talloc_free(lease);
+		return NULL;
+	}
+	lease->oc_ctx = oc_ctx;
+	DLIST_ADD(oc_ctx->cn_leases, lease);
+	talloc_set_destructor(lease, openchangedb_cn_lease_destructor);
+
+	return lease;
+}
+
 /**
    \details Allocates a new change number and returns it
    
@@ -578,15 +1029,42 @@ _PUBLIC_ char *openchangedb_set_folder_property_data(TALLOC_CTX *mem_ctx,
  */
 _PUBLIC_ enum MAPISTATUS openchangedb_get_new_changeNumber(struct openchangedb_context *oc_ctx, const char *username, uint64_t *cn)
 {
+	enum MAPISTATUS			retval;
+	struct openchangedb_cn_lease	*lease;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cn, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_new_changeNumber(oc_ctx, username, cn);
+	if (oc_ctx->cn_lease_size <= 1) {
+		OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_new_changeNumber(oc_ctx, username, cn));
+	}
+
+	lease = openchangedb_cn_lease_get(oc_ctx, username);
+	OPENCHANGE_RETVAL_IF(!lease, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	if (!lease->cns || lease->index >= lease->cns->cValues) {
+		if (lease->cns) {
+			talloc_unlink(lease, lease->cns);
+			lease->cns = NULL;
+		}
+		lease->index = 0;
+		OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+					  retval = oc_ctx->get_new_changeNumbers(oc_ctx, lease, username,
+									         oc_ctx->cn_lease_size, &lease->cns));
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+	}
+
+	*cn = lease->cns->lpui8[lease->index++];
+
+	return MAPI_E_SUCCESS;
 }
 
 /**
    \details Allocates a batch of new change numbers and returns them
+
+   When leasing is enabled, the values left in the lease are handed
+   out first and the remaining ones are allocated from the backend.
    
    \param oc_ctx pointer to the openchange DB context
    \param mem_ctx memory context where the change numbers will be allocated
@@ -603,11 +1081,49 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_new_changeNumbers(struct openchangedb_
 							    uint64_t max,
 							    struct UI8Array_r **cns_p)
 {
+	enum MAPISTATUS			retval;
+	struct openchangedb_cn_lease	*lease;
+	struct UI8Array_r		*cns;
+	struct UI8Array_r		*rest = NULL;
+	uint64_t			count = 0;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cns_p, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_new_changeNumbers(oc_ctx, mem_ctx, username, max, cns_p);
+	lease = NULL;
+	if (oc_ctx->cn_lease_size > 1) {
+		lease = openchangedb_cn_lease_get(oc_ctx, username);
+		OPENCHANGE_RETVAL_IF(!lease, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	if (!lease || !lease->cns || lease->index >= lease->cns->cValues) {
+		OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_new_changeNumbers(oc_ctx, mem_ctx, username, max, cns_p));
+	}
+
+	cns = talloc_zero(mem_ctx, struct UI8Array_r);
+	OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	cns->cValues = max;
+	cns->lpui8 = talloc_array(cns, uint64_t, max);
+	OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
+
+	/* Leased values are lower than anything the backend returns now */
+	while (count < max && lease->index < lease->cns->cValues) {
+		cns->lpui8[count++] = lease->cns->lpui8[lease->index++];
+	}
+
+	if (count < max) {
+		OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+					  retval = oc_ctx->get_new_changeNumbers(oc_ctx, cns, username,
+										 max - count, &rest));
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, cns);
+		memcpy(cns->lpui8 + count, rest->lpui8, (max - count) * sizeof (uint64_t));
+		talloc_unlink(cns, rest);
+	}
+
+	*cns_p = cns;
+
+	return MAPI_E_SUCCESS;
 }
 
 /**
@@ -626,7 +1142,17 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_next_changeNumber(struct openchangedb_
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cn, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_next_changeNumber(oc_ctx, username, cn);
+	if (oc_ctx->cn_lease_size > 1) {
+		struct openchangedb_cn_lease *lease;
+
+		lease = openchangedb_cn_lease_search(oc_ctx, username);
+		if (lease && lease->cns && lease->index < lease->cns->cValues) {
+			*cn = lease->cns->lpui8[lease->index];
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_next_changeNumber(oc_ctx, username, cn));
 }
 
 /**
@@ -648,12 +1174,26 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_folder_property(TALLOC_CTX *parent_ctx
 							  uint64_t fid,
 							  void **data)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!data, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_folder_property(parent_ctx, oc_ctx, username,
-					   proptag, fid, data);
+	if (openchangedb_cache_get_data(parent_ctx, oc_ctx, OPENCHANGEDB_CACHE_FOLDER_PROPERTY,
+					username, fid, proptag, data)) {
+		return MAPI_E_SUCCESS;
+	}
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->get_folder_property(parent_ctx, oc_ctx, username,
+								       proptag, fid, data));
+	if (retval == MAPI_E_SUCCESS) {
+		openchangedb_cache_set_data(oc_ctx, OPENCHANGEDB_CACHE_FOLDER_PROPERTY,
+					    username, fid, proptag, *data);
+	}
+
+	return retval;
 }
 
 /**
@@ -671,11 +1211,17 @@ _PUBLIC_ enum MAPISTATUS openchangedb_set_folder_properties(struct openchangedb_
 							    uint64_t fid,
 							    struct SRow *row)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!row, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->set_folder_properties(oc_ctx, username, fid, row);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->set_folder_properties(oc_ctx, username, fid, row));
+	openchangedb_cache_invalidate(oc_ctx, "set_folder_properties");
+
+	return retval;
 }
 
 /**
@@ -702,7 +1248,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_table_property(TALLOC_CTX *parent_ctx,
 	OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!data, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_table_property(parent_ctx, oc_ctx, ldb_filter, proptag, pos, data);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_table_property(parent_ctx, oc_ctx, ldb_filter, proptag, pos, data));
 }
 
 /**
@@ -732,7 +1278,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_fid_by_name(struct openchangedb_contex
 	OPENCHANGE_RETVAL_IF(!foldername, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 	
-	return oc_ctx->get_fid_by_name(oc_ctx, username, parent_fid, foldername, fid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_fid_by_name(oc_ctx, username, parent_fid, foldername, fid));
 }
 
 /**
@@ -759,8 +1305,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_mid_by_subject(struct openchangedb_con
 	OPENCHANGE_RETVAL_IF(!subject, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!mid, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_mid_by_subject(oc_ctx, username, parent_fid, subject,
-					  mailboxstore, mid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_mid_by_subject(oc_ctx, username, parent_fid, subject,
+								    mailboxstore, mid));
 }
 
 /**
@@ -776,10 +1322,16 @@ _PUBLIC_ enum MAPISTATUS openchangedb_delete_folder(struct openchangedb_context
 						    const char *username,
 						    uint64_t fid)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
-	
-	return oc_ctx->delete_folder(oc_ctx, username, fid);
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->delete_folder(oc_ctx, username, fid));
+	openchangedb_cache_invalidate(oc_ctx, "delete_folder");
+
+	return retval;
 }
 
 /**
@@ -796,11 +1348,17 @@ _PUBLIC_ enum MAPISTATUS openchangedb_set_ReceiveFolder(struct openchangedb_cont
 							const char *recipient,
 							const char *MessageClass, uint64_t fid)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!recipient, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!MessageClass, MAPI_E_INVALID_PARAMETER, NULL);
-	
-	return oc_ctx->set_ReceiveFolder(oc_ctx, recipient, MessageClass, fid);
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->set_ReceiveFolder(oc_ctx, recipient, MessageClass, fid));
+	openchangedb_cache_invalidate(oc_ctx, "set_ReceiveFolder");
+
+	return retval;
 }
 
 /**
@@ -821,7 +1379,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_fid_from_partial_uri(struct openchange
 	OPENCHANGE_RETVAL_IF(!partialURI, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 	
-	return oc_ctx->get_fid_from_partial_uri(oc_ctx, partialURI, fid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_fid_from_partial_uri(oc_ctx, partialURI, fid));
 }
 
 /**
@@ -851,8 +1409,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_users_from_partial_uri(TALLOC_CTX *par
 	OPENCHANGE_RETVAL_IF(!MAPIStoreURI, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!users, MAPI_E_INVALID_PARAMETER, NULL);
 	
-	return oc_ctx->get_users_from_partial_uri(parent_ctx, oc_ctx, partialURI,
-						  count, MAPIStoreURI, users);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_users_from_partial_uri(parent_ctx, oc_ctx, partialURI,
+									    count, MAPIStoreURI, users));
 
 }
 
@@ -875,15 +1433,21 @@ _PUBLIC_ enum MAPISTATUS openchangedb_create_mailbox(struct openchangedb_context
 						     uint64_t fid,
 						     const char *display_name)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!organization_name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!group_name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!display_name, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->create_mailbox(oc_ctx, username, organization_name,
-				      group_name, EMSMDBP_MAILBOX_ROOT, fid,
-				      display_name);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->create_mailbox(oc_ctx, username, organization_name,
+								  group_name, EMSMDBP_MAILBOX_ROOT, fid,
+								  display_name));
+	openchangedb_cache_invalidate(oc_ctx, "create_mailbox");
+
+	return retval;
 }
 
 /**
@@ -907,14 +1471,20 @@ _PUBLIC_ enum MAPISTATUS openchangedb_create_folder(struct openchangedb_context
 						    const char *MAPIStoreURI,
 						    int systemIdx)
 {
+	enum MAPISTATUS	retval;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!parentFolderID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!changeNumber, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->create_folder(oc_ctx, username, parentFolderID, fid,
-				     changeNumber, MAPIStoreURI, systemIdx);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->create_folder(oc_ctx, username, parentFolderID, fid,
+							         changeNumber, MAPIStoreURI, systemIdx));
+	openchangedb_cache_invalidate(oc_ctx, "create_folder");
+
+	return retval;
 }
 
 /**
@@ -938,7 +1508,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_message_count(struct openchangedb_cont
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!RowCount, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_message_count(oc_ctx, username, fid, RowCount, fai);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_message_count(oc_ctx, username, fid, RowCount, fai));
 }
 
 /**
@@ -960,21 +1530,21 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_system_idx(struct openchangedb_context
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!system_idx_p, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_system_idx(oc_ctx, username, fid, system_idx_p);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_system_idx(oc_ctx, username, fid, system_idx_p));
 }
 
 _PUBLIC_ enum MAPISTATUS openchangedb_transaction_start(struct openchangedb_context *oc_ctx)
 {
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return oc_ctx->transaction_start(oc_ctx);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->transaction_start(oc_ctx));
 }
 
 _PUBLIC_ enum MAPISTATUS openchangedb_transaction_commit(struct openchangedb_context *oc_ctx)
 {
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return oc_ctx->transaction_commit(oc_ctx);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->transaction_commit(oc_ctx));
 }
 
 /**
@@ -995,7 +1565,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_new_public_folderID(struct openchanged
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!fid, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->get_new_public_folderID(oc_ctx, username, fid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->get_new_public_folderID(oc_ctx, username, fid));
 }
 
 /**
@@ -1014,7 +1584,8 @@ _PUBLIC_ bool openchangedb_is_public_folder_id(struct openchangedb_context *oc_c
 		OC_DEBUG(0, "Bad parameters when calling openchangedb_is_public_folder_id");
 		return false;
 	}
-	return oc_ctx->is_public_folder_id(oc_ctx, fid);
+	OC_ROP_STATS_BACKEND_RETURN(OC_ROP_STATS_OPENCHANGEDB, bool,
+				    oc_ctx->is_public_folder_id(oc_ctx, fid));
 }
 
 /**
@@ -1037,7 +1608,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_indexing_url(struct openchangedb_conte
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!indexing_url, MAPI_E_INVALID_PARAMETER, NULL);
 
-	retval = oc_ctx->get_indexing_url(oc_ctx, username, indexing_url);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  retval = oc_ctx->get_indexing_url(oc_ctx, username, indexing_url));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	/* check indexing_url we are about to return */
@@ -1063,11 +1635,20 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_indexing_url(struct openchangedb_conte
 _PUBLIC_ bool openchangedb_set_locale(struct openchangedb_context *oc_ctx,
 				      const char *username, uint32_t lcid)
 {
+	bool	ret;
+
 	if (!oc_ctx || !username) {
 		OC_DEBUG(0, "Bad parameters when calling openchangedb_set_locale");
 		return false;
 	}
-	return oc_ctx->set_locale(oc_ctx, username, lcid);
+
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+				  ret = oc_ctx->set_locale(oc_ctx, username, lcid));
+	if (ret) {
+		openchangedb_cache_invalidate(oc_ctx, "set_locale");
+	}
+
+	return ret;
 }
 
 /**
@@ -1095,7 +1676,8 @@ _PUBLIC_ const char **openchangedb_get_folders_names(TALLOC_CTX *mem_ctx,
 		OC_DEBUG(0, "Bad type parameter (%s) for openchangedb_get_folders_names", type);
 		return NULL;
 	}
-	return oc_ctx->get_folders_names(mem_ctx, oc_ctx, locale, type);
+	OC_ROP_STATS_BACKEND_RETURN(OC_ROP_STATS_OPENCHANGEDB, const char **,
+				    oc_ctx->get_folders_names(mem_ctx, oc_ctx, locale, type));
 }
 
 /**
@@ -1117,7 +1699,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_replica_mapping_guid_to_replid(struct open
 	OPENCHANGE_RETVAL_IF(!guid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!replid_p, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->replica_mapping_guid_to_replid(oc_ctx, username, guid, replid_p);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->replica_mapping_guid_to_replid(oc_ctx, username, guid, replid_p));
 }
 
 /**
@@ -1137,5 +1719,5 @@ _PUBLIC_ enum MAPISTATUS openchangedb_replica_mapping_replid_to_guid(struct open
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!guid, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return oc_ctx->replica_mapping_replid_to_guid(oc_ctx, username, replid, guid);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(oc_ctx->replica_mapping_replid_to_guid(oc_ctx, username, replid, guid));
 }
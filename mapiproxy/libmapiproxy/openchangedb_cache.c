@@ -0,0 +1,499 @@
+/*
+   OpenChange Server implementation
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file openchangedb_cache.c
+
+   \brief Read-through cache for openchangedb folder metadata
+
+   The openchangedb frontend keeps recently read folder identifiers,
+   mapistore URIs and scalar folder properties in a bounded LRU cache
+   so the hot lookups performed on every logon and folder open do not
+   hit the backend. Every write going through the frontend drops the
+   whole cache; entries also expire after a configurable TTL so
+   changes committed by other processes are eventually picked up.
+ */
+
+#include <time.h>
+
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_backends.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include "utils/dlinklist.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+struct openchangedb_cache_entry {
+	struct openchangedb_cache_entry	*prev;
+	struct openchangedb_cache_entry	*next;
+	enum openchangedb_cache_kind	kind;
+	char				*username;
+	uint64_t			id;
+	uint32_t			tag;
+	size_t				key_hash;
+	time_t				expires;
+	uint64_t			value;
+	void				*data;
+};
+
+struct openchangedb_cache {
+	struct htable			entries_ht;
+	struct openchangedb_cache_entry	*entries;
+	uint32_t			max_entries;
+	uint32_t			ttl;
+	struct openchangedb_cache_stats	stats;
+};
+
+struct openchangedb_cache_key {
+	enum openchangedb_cache_kind	kind;
+	const char			*username;
+	uint64_t			id;
+	uint32_t			tag;
+};
+
+static const char *openchangedb_cache_kind_name(enum openchangedb_cache_kind kind)
+{
+	switch (kind) {
+	case OPENCHANGEDB_CACHE_SYSTEM_FOLDER_ID:
+		return "get_SystemFolderID";
+	case OPENCHANGEDB_CACHE_PARENT_FID:
+		return "get_parent_fid";
+	case OPENCHANGEDB_CACHE_MAPISTORE_URI:
+		return "get_mapistoreURI";
+	case OPENCHANGEDB_CACHE_FOLDER_PROPERTY:
+		return "get_folder_property";
+	}
+
+	return "unknown";
+}
+
+static size_t openchangedb_cache_key_hash(const struct openchangedb_cache_key *key)
+{
+	uint32_t	h;
+	uint32_t	kind = key->kind;
+
+	h = hash_string(key->username);
+	h = hash(&key->id, 1, h);
+	h = hash(&key->tag, 1, h);
+
+	return hash(&kind, 1, h);
+}
+
+static size_t _entry_rehash(const void *e, void *unused)
+{
+	return ((const struct openchangedb_cache_entry *)e)->key_hash;
+}
+
+static bool _entry_cmp(const void *e, void *k)
+{
+	const struct openchangedb_cache_entry	*entry = e;
+	const struct openchangedb_cache_key	*key = k;
+
+	return (entry->kind == key->kind && entry->id == key->id &&
+		entry->tag == key->tag && !strcmp(entry->username, key->username));
+}
+
+static void openchangedb_cache_event(struct openchangedb_context *oc_ctx,
+				     const char *function, const char *event)
+{
+	if (oc_ctx->cache_event) {
+		oc_ctx->cache_event(oc_ctx, function, event, &oc_ctx->cache->stats);
+	}
+}
+
+static void openchangedb_cache_remove(struct openchangedb_cache *cache,
+				      struct openchangedb_cache_entry *entry)
+{
+	htable_del(&cache->entries_ht, entry->key_hash, entry);
+	DLIST_REMOVE(cache->entries, entry);
+	cache->stats.entries--;
+	talloc_free(entry);
+}
+
+static void openchangedb_cache_clear(struct openchangedb_cache *cache)
+{
+	struct openchangedb_cache_entry	*entry;
+
+	while ((entry = cache->entries) != NULL) {
+		openchangedb_cache_remove(cache, entry);
+	}
+}
+
+static int openchangedb_cache_destructor(struct openchangedb_cache *cache)
+{
+	OC_DEBUG(5, "[openchangedb] cache released: %"PRIu64" hits, %"PRIu64" misses, "
+		 "%"PRIu64" invalidations, %"PRIu64" evictions", cache->stats.hits,
+		 cache->stats.misses, cache->stats.invalidations, cache->stats.evictions);
+
+	openchangedb_cache_clear(cache);
+	htable_clear(&cache->entries_ht);
+
+	return 0;
+}
+
+/**
+   \details Enable, resize or disable the folder metadata cache of an
+   openchangedb context. Any previously cached data is dropped.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param size the maximum number of cached entries, 0 disables the cache
+   \param ttl the number of seconds an entry stays valid, 0 means
+   entries only go away when invalidated or evicted
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_init(struct openchangedb_context *oc_ctx,
+						 uint32_t size, uint32_t ttl)
+{
+	struct openchangedb_cache	*cache;
+
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	talloc_free(oc_ctx->cache);
+	oc_ctx->cache = NULL;
+
+	if (size == 0) {
+		return MAPI_E_SUCCESS;
+	}
+
+	cache = talloc_zero(oc_ctx, struct openchangedb_cache);
+	OPENCHANGE_RETVAL_IF(!cache, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	cache->max_entries = size;
+	cache->ttl = ttl;
+	htable_init(&cache->entries_ht, _entry_rehash, NULL);
+	talloc_set_destructor(cache, openchangedb_cache_destructor);
+
+	oc_ctx->cache = cache;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Drop every entry from the folder metadata cache. This is
+   called by the openchangedb frontend after any write.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param reason name of the operation the cache is invalidated for
+ */
+_PUBLIC_ void openchangedb_cache_invalidate(struct openchangedb_context *oc_ctx,
+					    const char *reason)
+{
+	if (!oc_ctx || !oc_ctx->cache) return;
+
+	openchangedb_cache_clear(oc_ctx->cache);
+	oc_ctx->cache->stats.invalidations++;
+	openchangedb_cache_event(oc_ctx, reason, "invalidate");
+}
+
+/**
+   \details Retrieve the folder metadata cache counters
+
+   \param oc_ctx pointer to the openchange DB context
+   \param stats pointer to the counters the function fills
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_INITIALIZED if the
+   cache is disabled, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_get_stats(struct openchangedb_context *oc_ctx,
+						      struct openchangedb_cache_stats *stats)
+{
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!oc_ctx->cache, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*stats = oc_ctx->cache->stats;
+
+	return MAPI_E_SUCCESS;
+}
+
+static bool openchangedb_cache_supported(enum openchangedb_cache_kind kind, uint32_t tag)
+{
+	if (kind != OPENCHANGEDB_CACHE_FOLDER_PROPERTY) {
+		return true;
+	}
+
+	switch (tag & 0xFFFF) {
+	case PT_BOOLEAN:
+	case PT_LONG:
+	case PT_I8:
+	case PT_SYSTIME:
+	case PT_STRING8:
+	case PT_UNICODE:
+	case PT_BINARY:
+		return true;
+	}
+
+	return false;
+}
+
+/**
+   \details Duplicate a cached value. Only the scalar property types
+   returned by openchangedb backends are supported, see
+   openchangedb_cache_supported.
+
+   \return the allocated copy, NULL if the type can't be cached
+ */
+static void *openchangedb_cache_dup(TALLOC_CTX *mem_ctx,
+				    enum openchangedb_cache_kind kind,
+				    uint32_t tag, const void *data)
+{
+	const struct Binary_r	*bin;
+	struct Binary_r		*copy;
+
+	if (kind == OPENCHANGEDB_CACHE_MAPISTORE_URI) {
+		return talloc_strdup(mem_ctx, (const char *)data);
+	}
+
+	switch (tag & 0xFFFF) {
+	case PT_BOOLEAN:
+		return talloc_memdup(mem_ctx, data, sizeof(int));
+	case PT_LONG:
+		return talloc_memdup(mem_ctx, data, sizeof(uint32_t));
+	case PT_I8:
+		return talloc_memdup(mem_ctx, data, sizeof(uint64_t));
+	case PT_SYSTIME:
+		return talloc_memdup(mem_ctx, data, sizeof(struct FILETIME));
+	case PT_STRING8:
+	case PT_UNICODE:
+		return talloc_strdup(mem_ctx, (const char *)data);
+	case PT_BINARY:
+		bin = (const struct Binary_r *)data;
+		copy = talloc_zero(mem_ctx, struct Binary_r);
+		if (!copy) return NULL;
+		copy->cb = bin->cb;
+		if (bin->cb) {
+			copy->lpb = talloc_memdup(copy, bin->lpb, bin->cb);
+			if (!copy->lpb) {
+				talloc_free(copy);
+				return NULL;
+			}
+		}
+		return copy;
+	}
+
+	return NULL;
+}
+
+static struct openchangedb_cache_entry *openchangedb_cache_lookup(struct openchangedb_context *oc_ctx,
+								  enum openchangedb_cache_kind kind,
+								  const char *username,
+								  uint64_t id, uint32_t tag)
+{
+	struct openchangedb_cache		*cache = oc_ctx->cache;
+	struct openchangedb_cache_entry		*entry;
+	struct openchangedb_cache_key		key;
+
+	key.kind = kind;
+	key.username = username;
+	key.id = id;
+	key.tag = tag;
+
+	entry = htable_get(&cache->entries_ht, openchangedb_cache_key_hash(&key), _entry_cmp, &key);
+	if (entry && cache->ttl && entry->expires <= time(NULL)) {
+		openchangedb_cache_remove(cache, entry);
+		entry = NULL;
+	}
+
+	if (!entry) {
+		cache->stats.misses++;
+		openchangedb_cache_event(oc_ctx, openchangedb_cache_kind_name(kind), "miss");
+		return NULL;
+	}
+
+	DLIST_PROMOTE(cache->entries, entry);
+	cache->stats.hits++;
+	openchangedb_cache_event(oc_ctx, openchangedb_cache_kind_name(kind), "hit");
+
+	return entry;
+}
+
+static struct openchangedb_cache_entry *openchangedb_cache_add(struct openchangedb_cache *cache,
+							       enum openchangedb_cache_kind kind,
+							       const char *username,
+							       uint64_t id, uint32_t tag)
+{
+	struct openchangedb_cache_entry		*entry;
+	struct openchangedb_cache_key		key;
+	size_t					key_hash;
+
+	key.kind = kind;
+	key.username = username;
+	key.id = id;
+	key.tag = tag;
+	key_hash = openchangedb_cache_key_hash(&key);
+
+	entry = htable_get(&cache->entries_ht, key_hash, _entry_cmp, &key);
+	if (entry) {
+		openchangedb_cache_remove(cache, entry);
+	}
+
+	if (cache->stats.entries >= cache->max_entries) {
+		openchangedb_cache_remove(cache, DLIST_TAIL(cache->entries));
+		cache->stats.evictions++;
+	}
+
+	entry = talloc_zero(cache, struct openchangedb_cache_entry);
+	if (!entry) return NULL;
+	entry->username = talloc_strdup(entry, username);
+	if (!entry->username) {
+		talloc_free(entry);
+		return NULL;
+	}
+	entry->kind = kind;
+	entry->id = id;
+	entry->tag = tag;
+	entry->key_hash = key_hash;
+	entry->expires = time(NULL) + cache->ttl;
+
+	if (!htable_add(&cache->entries_ht, key_hash, entry)) {
+		talloc_free(entry);
+		return NULL;
+	}
+	DLIST_ADD(cache->entries, entry);
+	cache->stats.entries++;
+
+	return entry;
+}
+
+/**
+   \details Look up a cached folder identifier
+
+   \param oc_ctx pointer to the openchange DB context
+   \param kind the kind of lookup
+   \param username the mailbox name
+   \param id the key of the lookup (folder identifier or system index)
+   \param tag secondary key (mailboxstore flag or property tag)
+   \param valuep pointer to the returned value
+
+   \return true on hit, otherwise false
+ */
+bool openchangedb_cache_get_id(struct openchangedb_context *oc_ctx,
+			       enum openchangedb_cache_kind kind,
+			       const char *username, uint64_t id, uint32_t tag,
+			       uint64_t *valuep)
+{
+	struct openchangedb_cache_entry	*entry;
+
+	if (!oc_ctx->cache) return false;
+
+	entry = openchangedb_cache_lookup(oc_ctx, kind, username, id, tag);
+	if (!entry) return false;
+
+	*valuep = entry->value;
+
+	return true;
+}
+
+/**
+   \details Store a folder identifier in the cache
+
+   \param oc_ctx pointer to the openchange DB context
+   \param kind the kind of lookup
+   \param username the mailbox name
+   \param id the key of the lookup (folder identifier or system index)
+   \param tag secondary key (mailboxstore flag or property tag)
+   \param value the value returned by the backend
+ */
+void openchangedb_cache_set_id(struct openchangedb_context *oc_ctx,
+			       enum openchangedb_cache_kind kind,
+			       const char *username, uint64_t id, uint32_t tag,
+			       uint64_t value)
+{
+	struct openchangedb_cache_entry	*entry;
+
+	if (!oc_ctx->cache) return;
+
+	entry = openchangedb_cache_add(oc_ctx->cache, kind, username, id, tag);
+	if (entry) {
+		entry->value = value;
+	}
+}
+
+/**
+   \details Look up a cached mapistore URI or folder property
+
+   \param mem_ctx pointer to the memory context the copy is allocated in
+   \param oc_ctx pointer to the openchange DB context
+   \param kind the kind of lookup
+   \param username the mailbox name
+   \param id the folder identifier
+   \param tag secondary key (mailboxstore flag or property tag)
+   \param datap pointer on pointer to the returned copy
+
+   \return true on hit, otherwise false
+ */
+bool openchangedb_cache_get_data(TALLOC_CTX *mem_ctx,
+				 struct openchangedb_context *oc_ctx,
+				 enum openchangedb_cache_kind kind,
+				 const char *username, uint64_t id, uint32_t tag,
+				 void **datap)
+{
+	struct openchangedb_cache_entry	*entry;
+	void				*data;
+
+	if (!oc_ctx->cache) return false;
+	if (!openchangedb_cache_supported(kind, tag)) return false;
+
+	entry = openchangedb_cache_lookup(oc_ctx, kind, username, id, tag);
+	if (!entry) return false;
+
+	data = openchangedb_cache_dup(mem_ctx, kind, tag, entry->data);
+	if (!data) return false;
+
+	*datap = data;
+
+	return true;
+}
+
+/**
+   \details Store a mapistore URI or a folder property in the cache.
+   Values of types that can't be cached are silently ignored.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param kind the kind of lookup
+   \param username the mailbox name
+   \param id the folder identifier
+   \param tag secondary key (mailboxstore flag or property tag)
+   \param data the value returned by the backend
+ */
+void openchangedb_cache_set_data(struct openchangedb_context *oc_ctx,
+				 enum openchangedb_cache_kind kind,
+				 const char *username, uint64_t id, uint32_t tag,
+				 const void *data)
+{
+	struct openchangedb_cache_entry	*entry;
+	void				*copy;
+
+	if (!oc_ctx->cache || !data) return;
+	if (!openchangedb_cache_supported(kind, tag)) return;
+
+	copy = openchangedb_cache_dup(oc_ctx->cache, kind, tag, data);
+	if (!copy) return;
+
+	entry = openchangedb_cache_add(oc_ctx->cache, kind, username, id, tag);
+	if (!entry) {
+		talloc_free(copy);
+		return;
+	}
+	entry->data = talloc_steal(entry, copy);
+}
@@ -583,15 +583,175 @@ static struct pidtags pidtags[] = {
 	{ 0,                                                                   NULL         }
 };
 
+static const uint32_t pidtags_by_tag_seeds[143] = {
+	16, 2, 2, 4, 9, 2, 4, 5, 1, 14, 2, 6,
+	2, 1, 5, 3, 1, 11, 11, 2, 10, 5, 29, 10,
+	13, 8, 4, 44, 3, 18, 1, 22, 45, 17, 1, 11,
+	22, 10, 4, 11, 4, 14, 4, 10, 12, 4, 1, 14,
+	9, 1, 14, 3, 19, 2, 11, 2, 49, 2, 10, 3,
+	3, 19, 1, 3, 9, 1, 24, 30, 9, 61, 9, 1,
+	6, 16, 64, 5, 28, 5, 30, 15, 24, 1, 6, 8,
+	30, 1, 42, 30, 1, 4, 45, 2, 42, 58, 30, 16,
+	1, 9, 2, 1, 11, 2, 29, 12, 1, 60, 2, 2,
+	1, 26, 1, 18, 5, 1, 2, 43, 62, 57, 46, 13,
+	10, 29, 5, 33, 22, 12, 20, 10, 8, 3, 19, 51,
+	8, 3, 2, 11, 4, 23, 1, 40, 1, 29, 14,
+};
+static const uint16_t pidtags_by_tag_slots[712] = {
+	0, 491, 226, 156, 524, 143, 0, 333, 0, 102, 428, 0,
+	91, 347, 84, 166, 294, 451, 1, 0, 0, 310, 176, 297,
+	27, 0, 262, 140, 462, 180, 0, 343, 258, 337, 0, 0,
+	109, 366, 415, 212, 406, 146, 505, 53, 0, 68, 0, 455,
+	514, 0, 447, 0, 0, 327, 368, 475, 0, 0, 0, 460,
+	0, 52, 446, 0, 58, 386, 423, 379, 62, 482, 520, 301,
+	338, 86, 476, 353, 167, 553, 172, 472, 407, 74, 200, 314,
+	217, 501, 323, 145, 0, 286, 525, 542, 125, 168, 334, 129,
+	434, 395, 498, 321, 3, 202, 196, 437, 356, 75, 213, 67,
+	467, 194, 0, 0, 115, 55, 359, 247, 112, 396, 0, 503,
+	186, 531, 309, 9, 438, 248, 559, 0, 274, 292, 328, 181,
+	331, 95, 463, 532, 0, 81, 424, 0, 231, 104, 450, 0,
+	365, 137, 369, 562, 2, 215, 563, 107, 29, 171, 430, 252,
+	26, 0, 153, 141, 0, 161, 32, 555, 0, 568, 0, 220,
+	311, 106, 0, 241, 486, 408, 540, 513, 558, 57, 381, 289,
+	377, 0, 398, 0, 510, 0, 183, 0, 0, 0, 305, 0,
+	566, 285, 162, 0, 351, 459, 0, 228, 0, 0, 354, 49,
+	277, 0, 384, 293, 299, 0, 302, 0, 179, 273, 266, 82,
+	0, 260, 0, 495, 561, 0, 374, 522, 0, 345, 425, 0,
+	315, 132, 318, 416, 0, 493, 0, 257, 0, 0, 0, 557,
+	19, 35, 499, 0, 250, 246, 394, 199, 287, 229, 0, 518,
+	324, 33, 0, 0, 295, 70, 155, 346, 370, 0, 16, 457,
+	547, 205, 422, 0, 7, 378, 452, 60, 534, 367, 0, 0,
+	36, 0, 352, 330, 349, 144, 0, 0, 552, 0, 225, 567,
+	0, 494, 326, 545, 409, 341, 0, 0, 61, 410, 402, 551,
+	429, 387, 371, 78, 197, 453, 39, 71, 421, 488, 536, 440,
+	538, 0, 439, 372, 48, 385, 414, 0, 549, 280, 458, 147,
+	0, 529, 89, 0, 0, 117, 0, 79, 0, 303, 230, 120,
+	0, 461, 116, 539, 22, 535, 306, 0, 124, 413, 442, 0,
+	336, 187, 504, 339, 397, 564, 487, 0, 43, 284, 130, 23,
+	388, 178, 376, 340, 255, 44, 0, 484, 239, 500, 279, 40,
+	0, 0, 360, 329, 375, 242, 113, 511, 240, 427, 221, 28,
+	322, 554, 471, 210, 468, 131, 182, 72, 515, 5, 56, 278,
+	405, 300, 272, 148, 0, 0, 441, 399, 517, 0, 473, 42,
+	282, 198, 0, 100, 361, 304, 435, 34, 0, 85, 489, 288,
+	123, 45, 436, 0, 207, 0, 51, 271, 0, 512, 237, 214,
+	335, 527, 15, 431, 443, 0, 485, 105, 290, 76, 12, 316,
+	312, 412, 201, 0, 18, 236, 0, 195, 193, 0, 218, 313,
+	477, 419, 0, 259, 165, 0, 492, 307, 432, 190, 0, 94,
+	103, 245, 0, 114, 480, 149, 169, 50, 357, 448, 0, 204,
+	174, 227, 519, 470, 358, 0, 17, 283, 454, 0, 348, 265,
+	254, 0, 0, 0, 502, 203, 466, 219, 550, 417, 216, 0,
+	111, 264, 256, 382, 134, 0, 344, 418, 560, 0, 0, 154,
+	0, 332, 235, 400, 83, 364, 497, 30, 173, 238, 0, 108,
+	90, 66, 0, 391, 177, 556, 136, 516, 383, 63, 164, 362,
+	233, 0, 119, 565, 546, 64, 0, 267, 0, 47, 25, 20,
+	128, 69, 0, 46, 121, 59, 0, 118, 8, 0, 150, 449,
+	222, 544, 21, 390, 185, 253, 0, 350, 93, 537, 0, 77,
+	296, 97, 0, 0, 96, 184, 11, 464, 110, 433, 249, 269,
+	373, 126, 92, 281, 496, 138, 521, 152, 170, 31, 426, 507,
+	275, 483, 54, 88, 0, 320, 0, 541, 99, 206, 474, 445,
+	133, 444, 98, 10, 263, 490, 404, 192, 234, 223, 244, 158,
+	523, 509, 151, 478, 13, 0, 139, 317, 319, 380, 191, 530,
+	0, 0, 411, 0, 479, 508, 65, 465, 261, 533, 308, 389,
+	142, 209, 506, 543, 569, 393, 548, 4, 0, 243, 0, 526,
+	456, 87, 276, 0, 41, 127, 363, 157, 268, 14, 0, 24,
+	528, 392, 481, 420, 403, 211, 291, 80, 342, 251, 0, 122,
+	160, 188, 469, 0, 0, 73, 163, 6, 224, 0, 38, 270,
+	37, 355, 101, 0, 232, 298, 0, 401, 325, 135, 189, 175,
+	0, 159, 208, 0,
+};
+static const struct mapi_phash pidtags_by_tag = {
+	pidtags_by_tag_seeds, 143, pidtags_by_tag_slots, 712
+};
+
+static const uint32_t pidtags_by_id_seeds[136] = {
+	1, 1, 5, 3, 3, 38, 3, 66, 54, 24, 52, 77,
+	89, 2, 1, 1, 13, 19, 52, 16, 11, 4, 12, 12,
+	4, 0, 81, 16, 66, 23, 31, 4, 71, 22, 131, 55,
+	26, 6, 14, 78, 7, 21, 42, 10, 98, 107, 87, 5,
+	26, 1, 12, 10, 86, 50, 65, 73, 64, 48, 21, 134,
+	1, 14, 40, 192, 119, 44, 1, 1, 0, 70, 22, 45,
+	25, 18, 1, 2, 55, 140, 4, 199, 74, 51, 1, 1,
+	30, 26, 1, 128, 139, 29, 122, 4, 22, 193, 47, 3,
+	56, 115, 10, 0, 31, 120, 5, 9, 3, 37, 69, 8,
+	39, 168, 117, 171, 2, 82, 1, 11, 111, 116, 7, 2,
+	1, 5, 35, 139, 1, 253, 156, 2, 47, 13, 7, 73,
+	145, 8, 79, 39,
+};
+static const uint16_t pidtags_by_id_slots[679] = {
+	415, 0, 0, 510, 82, 164, 43, 372, 0, 0, 404, 201,
+	301, 452, 188, 422, 88, 123, 130, 0, 0, 0, 355, 0,
+	0, 0, 142, 227, 167, 0, 55, 529, 400, 455, 548, 362,
+	0, 236, 0, 512, 354, 95, 182, 481, 496, 0, 12, 368,
+	371, 530, 79, 346, 367, 128, 392, 207, 147, 546, 0, 536,
+	463, 0, 513, 456, 0, 162, 426, 199, 136, 0, 345, 104,
+	0, 320, 403, 395, 112, 0, 416, 62, 161, 443, 0, 226,
+	57, 471, 328, 121, 60, 0, 0, 193, 0, 0, 424, 237,
+	432, 332, 0, 183, 129, 393, 69, 0, 275, 566, 385, 366,
+	90, 70, 66, 523, 41, 10, 141, 369, 214, 0, 379, 447,
+	0, 433, 376, 0, 449, 408, 92, 465, 264, 132, 0, 149,
+	413, 0, 374, 477, 308, 135, 278, 270, 15, 101, 144, 223,
+	40, 478, 143, 538, 0, 476, 0, 525, 0, 249, 348, 0,
+	325, 213, 0, 0, 427, 494, 168, 470, 18, 250, 7, 497,
+	516, 296, 495, 163, 515, 0, 0, 265, 303, 0, 0, 219,
+	285, 24, 26, 91, 459, 0, 0, 0, 501, 0, 511, 363,
+	0, 0, 281, 349, 205, 0, 0, 173, 0, 1, 221, 210,
+	5, 509, 0, 0, 0, 446, 198, 457, 100, 14, 152, 441,
+	154, 0, 514, 469, 230, 255, 0, 122, 155, 63, 370, 0,
+	467, 22, 451, 0, 0, 215, 340, 418, 284, 231, 184, 0,
+	179, 448, 330, 545, 166, 259, 297, 0, 225, 156, 172, 171,
+	19, 287, 534, 505, 23, 271, 68, 0, 127, 410, 244, 71,
+	0, 0, 417, 532, 218, 333, 54, 277, 0, 235, 339, 540,
+	550, 35, 160, 217, 406, 106, 482, 398, 107, 541, 327, 0,
+	116, 336, 211, 109, 382, 387, 21, 318, 414, 421, 4, 89,
+	186, 315, 352, 0, 295, 50, 518, 0, 337, 547, 2, 16,
+	391, 298, 0, 157, 0, 329, 420, 151, 228, 48, 0, 0,
+	159, 30, 272, 51, 539, 64, 124, 31, 97, 113, 209, 222,
+	203, 474, 138, 498, 200, 108, 0, 412, 53, 322, 125, 252,
+	289, 261, 535, 283, 178, 381, 120, 0, 292, 153, 0, 0,
+	80, 300, 312, 304, 52, 197, 0, 94, 0, 396, 0, 464,
+	114, 394, 170, 365, 243, 0, 44, 558, 169, 49, 0, 0,
+	314, 118, 177, 99, 436, 500, 0, 93, 0, 521, 438, 0,
+	316, 429, 20, 126, 351, 0, 0, 0, 0, 503, 146, 38,
+	542, 175, 309, 267, 206, 479, 0, 36, 98, 423, 526, 134,
+	253, 204, 0, 75, 358, 165, 0, 0, 435, 56, 0, 373,
+	338, 73, 28, 0, 0, 294, 212, 341, 389, 187, 274, 307,
+	543, 506, 0, 242, 0, 310, 388, 0, 380, 375, 453, 0,
+	37, 111, 67, 0, 17, 0, 279, 273, 96, 189, 256, 321,
+	148, 326, 317, 0, 33, 434, 508, 0, 331, 299, 276, 0,
+	282, 192, 9, 0, 65, 59, 0, 288, 195, 251, 531, 555,
+	291, 139, 84, 263, 150, 176, 0, 390, 405, 268, 181, 462,
+	208, 266, 196, 234, 357, 102, 58, 519, 472, 544, 140, 306,
+	468, 0, 133, 137, 0, 0, 460, 258, 517, 34, 568, 383,
+	260, 353, 334, 313, 224, 3, 262, 507, 233, 0, 0, 0,
+	239, 445, 245, 290, 401, 0, 335, 437, 302, 240, 257, 0,
+	520, 493, 216, 342, 528, 0, 0, 6, 269, 386, 72, 504,
+	553, 411, 78, 110, 47, 0, 76, 0, 0, 241, 359, 305,
+	458, 0, 557, 450, 0, 11, 428, 487, 444, 286, 190, 0,
+	425, 254, 324, 105, 397, 533, 0, 522, 360, 185, 0, 454,
+	280, 485, 350, 0, 238, 347, 0, 87, 319, 565, 0, 524,
+	402, 440, 466, 25, 356, 409, 407, 492, 537, 549, 77, 0,
+	29, 430, 364, 13, 343, 323, 32, 0, 384, 490, 39, 344,
+	74, 83, 377, 475, 247, 85, 419, 378, 46, 27, 42, 61,
+	117, 115, 431, 473, 527, 232, 0, 0, 0, 0, 158, 442,
+	180, 103, 499, 491, 194, 81, 480, 174, 191, 202, 8, 361,
+	145, 399, 246, 439, 248, 131, 0,
+};
+static const struct mapi_phash pidtags_by_id = {
+	pidtags_by_id_seeds, 136, pidtags_by_id_slots, 679
+};
+
 static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t tag_id = (proptag >> 16);
+	uint8_t		key[2];
+	uint32_t	idx;
+	uint16_t	tag_id = (proptag >> 16);
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (tag_id == (pidtags[i].proptag >> 16)) {
-			return pidtags[i].pidtag;
-		}
+	key[0] = tag_id & 0xFF;
+	key[1] = (tag_id >> 8) & 0xFF;
+
+	idx = mapi_phash_find(&pidtags_by_id, NULL, 0, key, sizeof (key));
+	if (idx && (pidtags[idx - 1].proptag >> 16) == tag_id) {
+		return pidtags[idx - 1].pidtag;
 	}
 
 	return NULL;
@@ -599,17 +759,22 @@ static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 
 _PUBLIC_ const char *openchangedb_property_get_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t prop_type = proptag & 0x0FFF;
+	uint8_t		key[4];
+	uint32_t	idx;
+	uint32_t	prop_type = proptag & 0x0FFF;
 
 	if (prop_type == PT_UNICODE || prop_type == PT_STRING8) {
 		return _openchangedb_property_get_string_attribute(proptag);
 	}
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (pidtags[i].proptag == proptag) {
-			return pidtags[i].pidtag;
-		}
+	key[0] = proptag & 0xFF;
+	key[1] = (proptag >> 8) & 0xFF;
+	key[2] = (proptag >> 16) & 0xFF;
+	key[3] = (proptag >> 24) & 0xFF;
+
+	idx = mapi_phash_find(&pidtags_by_tag, NULL, 0, key, sizeof (key));
+	if (idx && pidtags[idx - 1].proptag == proptag) {
+		return pidtags[idx - 1].pidtag;
 	}
 	OC_DEBUG(0, "Unsupported property tag '0x%.8x'", proptag);
 
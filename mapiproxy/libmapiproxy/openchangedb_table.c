@@ -32,6 +32,7 @@
 #include "libmapiproxy.h"
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
+#include "mapiproxy/util/oc_rop_stats.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_backends.h"
 
 /**
@@ -55,8 +56,8 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *mem_ctx,
 	MAPI_RETVAL_IF(!self, MAPI_E_NOT_INITIALIZED, NULL);
 	MAPI_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return self->table_init(mem_ctx, self, username, table_type, folderID,
-				table_object);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(self->table_init(mem_ctx, self, username, table_type, folderID,
+							  table_object));
 }
 
 
@@ -76,7 +77,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_sort_order(struct openchangedb_c
 	MAPI_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
 	MAPI_RETVAL_IF(!lpSortCriteria, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return self->table_set_sort_order(self, table_object, lpSortCriteria);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(self->table_set_sort_order(self, table_object, lpSortCriteria));
 }
 
 
@@ -88,7 +89,37 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_set_restrictions(struct openchangedb
 	MAPI_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
 	MAPI_RETVAL_IF(!res, MAPI_E_INVALID_PARAMETER, NULL);
 
-	return self->table_set_restrictions(self, table_object, res);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(self->table_set_restrictions(self, table_object, res));
+}
+
+
+/**
+   \details Set the columns the caller will read from an openchangedb
+   table object
+
+   Backends may use the column set to fetch the properties of several
+   rows at once. Backends without such support ignore it.
+
+   \param table_object pointer to the table object
+   \param count number of properties in properties
+   \param properties array of property tags
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_table_set_columns(struct openchangedb_context *self,
+							void *table_object,
+							uint16_t count,
+							enum MAPITAGS *properties)
+{
+	MAPI_RETVAL_IF(!self, MAPI_E_NOT_INITIALIZED, NULL);
+	MAPI_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
+	MAPI_RETVAL_IF(count && !properties, MAPI_E_INVALID_PARAMETER, NULL);
+
+	if (!self->table_set_columns) {
+		return MAPI_E_SUCCESS;
+	}
+
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(self->table_set_columns(self, table_object, count, properties));
 }
 
 _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
@@ -103,5 +134,5 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!data, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return self->table_get_property(mem_ctx, self, table_object, proptag, pos, live_filtered, data);
+	OC_ROP_STATS_OPENCHANGEDB_RETURN(self->table_get_property(mem_ctx, self, table_object, proptag, pos, live_filtered, data));
 }
@@ -44,6 +44,19 @@
 /* 250 (max memcached key size) - strlen("indexing::") - strlen(hash64(...)) */
 #define MAX_ALLOWED_USERNAME_SIZE_FOR_PREFIXED_KEY 224
 
+static uint32_t default_fmid_lease_size = MAPISTORE_INDEXING_LEASE_DEFAULT_SIZE;
+
+/**
+   \details Set the number of FMIDs indexing contexts created from now
+   on reserve at once. A size of 0 or 1 disables leasing.
+
+   \param size the number of FMIDs to lease
+ */
+_PUBLIC_ void mapistore_set_default_indexing_lease_size(uint32_t size)
+{
+	default_fmid_lease_size = size;
+}
+
 /**
    \details Generate key for FMID cache
 
@@ -507,6 +520,7 @@ static enum mapistore_error mysql_record_add(struct indexing_context *ictx,
 		OC_DEBUG(0, "[indexing] Failed to add record `%s: %"PRIu64"` on memcached (%s)",
 			 mapistore_URI, fmid, mapistore_errstr(retval));
 	}
+	mapistore_indexing_cache_add(ictx->lru, fmid, mapistore_URI);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -567,6 +581,8 @@ static enum mapistore_error mysql_record_update(struct indexing_context *ictx,
 		OC_DEBUG(0, "[indexing] Failed to update record `%s` with `%"PRIu64"` on memcached (%s)",
 			 mapistore_URI, fmid, mapistore_errstr(retval));
 	}
+	/* The row may be soft deleted, let the next lookup refill the cache */
+	mapistore_indexing_cache_del(ictx->lru, fmid);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -606,6 +622,11 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!urip, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
+	/* Cached records are never soft deleted */
+	if (mapistore_indexing_cache_get_uri(ictx->lru, mem_ctx, fmid, urip) == MAPISTORE_SUCCESS) {
+		*soft_deletedp = false;
+		return MAPISTORE_SUCCESS;
+	}
 
 	sql = talloc_asprintf(mem_ctx,
 		"SELECT url, soft_deleted FROM %s "
@@ -621,6 +642,9 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 
 	*urip = talloc_strdup(mem_ctx, row[0]);
 	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
+	if (*soft_deletedp == false) {
+		mapistore_indexing_cache_add(ictx->lru, fmid, *urip);
+	}
 
 	mysql_free_result(res);
 	talloc_free(sql);
@@ -694,6 +718,8 @@ static enum mapistore_error mysql_record_del(struct indexing_context *ictx,
 	ret = execute_query(MYSQL(ictx), sql);
 	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
 
+	mapistore_indexing_cache_del(ictx->lru, fmid);
+
 	retval = _memcached_delete_record(ictx, username, uri);
 	if (retval != MAPISTORE_SUCCESS) {
 		OC_DEBUG(0, "[indexing] Failed to delete record `%s` on memcached (%s)",
@@ -742,6 +768,13 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
+	/* Exact lookups are served from the per-process cache first */
+	if (partial == false &&
+	    mapistore_indexing_cache_get_fmid(ictx->lru, uri, fmidp) == MAPISTORE_SUCCESS) {
+		*soft_deletedp = false;
+		return MAPISTORE_SUCCESS;
+	}
+
 	retval = _memcached_get_record(ictx, username, uri, &fmid);
 	if (retval == MAPISTORE_SUCCESS) {
 		*fmidp = fmid;
@@ -752,7 +785,7 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 	mem_ctx = talloc_named(NULL, 0, "mysql_record_get_fmid");
 
 	sql = talloc_asprintf(mem_ctx,
-		"SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
+		"SELECT fmid, soft_deleted, url FROM "INDEXING_TABLE" "
 		"WHERE username = '%s'", _sql(mem_ctx, username));
 
 	if (partial) {
@@ -773,6 +806,9 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 
 	*fmidp = strtoull(row[0], NULL, 0);
 	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
+	if (*soft_deletedp == false) {
+		mapistore_indexing_cache_add(ictx->lru, *fmidp, row[2]);
+	}
 
 	mysql_free_result(res);
 	talloc_free(mem_ctx);
@@ -781,10 +817,15 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 }
 
 
-static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context *ictx,
-						      const char *username,
-						      int count,
-						      uint64_t *fmidp)
+/**
+   \details Reserve FMIDs with a SELECT/UPDATE transaction. This is
+   only needed for the first allocation of a mailbox, when there is
+   no counter to update yet.
+ */
+static enum mapistore_error mysql_reserve_fmids_transaction(struct indexing_context *ictx,
+							    const char *username,
+							    uint64_t count,
+							    uint64_t *fmidp)
 {
 	int		ret;
 	uint64_t	next_fmid;
@@ -795,8 +836,6 @@ static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(count < 0, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(count == 0, MAPISTORE_SUCCESS, NULL);
 
 	/* Retrieve and increment the counter */
 	ret = execute_query(MYSQL(ictx), "START TRANSACTION");
@@ -856,6 +895,151 @@ static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Reserve a range of consecutive FMIDs in the database
+
+   The counter is read and moved forward in a single statement: the
+   value it had before the update is returned through LAST_INSERT_ID()
+   so no explicit transaction is needed.
+
+   \param ictx pointer to the indexing context
+   \param username the mailbox the FMIDs are reserved for
+   \param count number of FMIDs to reserve
+   \param fmidp pointer to the first reserved FMID
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mysql_reserve_fmids(struct indexing_context *ictx,
+						const char *username,
+						uint64_t count,
+						uint64_t *fmidp)
+{
+	int		ret;
+	char		*sql;
+	TALLOC_CTX	*mem_ctx;
+	my_ulonglong	affected;
+	uint64_t	end;
+
+	mem_ctx = talloc_new(NULL);
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	sql = talloc_asprintf(mem_ctx,
+		"UPDATE %s SET next_fmid = LAST_INSERT_ID("
+		"GREATEST(CAST(next_fmid AS UNSIGNED), %d) + %"PRIu64") "
+		"WHERE username = '%s'",
+		INDEXING_ALLOC_TABLE, MAX_PUBLIC_FOLDER_ID + 1, count,
+		_sql(mem_ctx, username));
+	MAPISTORE_RETVAL_IF(!sql, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+	ret = execute_query(MYSQL(ictx), sql);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	talloc_free(mem_ctx);
+
+	affected = mysql_affected_rows(MYSQL(ictx));
+	if (affected == 0) {
+		/* First allocation for this mailbox */
+		return mysql_reserve_fmids_transaction(ictx, username, count, fmidp);
+	}
+	MAPISTORE_RETVAL_IF(affected != 1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	end = mysql_insert_id(MYSQL(ictx));
+	MAPISTORE_RETVAL_IF(end < count, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	*fmidp = end - count;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Give the unused part of the FMID lease back to the
+   database. This is only possible while nobody else reserved FMIDs
+   after us, otherwise the remaining FMIDs are simply lost.
+
+   \param ictx pointer to the indexing context
+ */
+static void mysql_return_fmid_lease(struct indexing_context *ictx)
+{
+	struct indexing_fmid_lease	*lease = ictx->lease;
+	TALLOC_CTX			*mem_ctx;
+	char				*sql;
+	int				ret;
+
+	if (!lease || lease->next >= lease->end) return;
+
+	mem_ctx = talloc_new(NULL);
+	if (!mem_ctx) return;
+
+	sql = talloc_asprintf(mem_ctx,
+		"UPDATE %s SET next_fmid = '%"PRIu64"' "
+		"WHERE username = '%s' AND CAST(next_fmid AS UNSIGNED) = %"PRIu64,
+		INDEXING_ALLOC_TABLE, lease->next,
+		_sql(mem_ctx, lease->username), lease->end);
+	if (sql) {
+		ret = execute_query(MYSQL(ictx), sql);
+		if (ret == MYSQL_SUCCESS && mysql_affected_rows(MYSQL(ictx)) == 1) {
+			OC_DEBUG(5, "[indexing] returned %"PRIu64" unused FMIDs of %s",
+				 lease->end - lease->next, lease->username);
+		} else {
+			OC_DEBUG(5, "[indexing] %"PRIu64" unused FMIDs of %s are lost",
+				 lease->end - lease->next, lease->username);
+		}
+	}
+	lease->next = lease->end;
+
+	talloc_free(mem_ctx);
+}
+
+/**
+   \details Allocate consecutive FMIDs
+
+   Small requests are served from a range leased in advance, so bulk
+   imports only hit the database once every lease->size FMIDs.
+   Requests that would not fit into a lease go to the database.
+
+   \param ictx pointer to the indexing context
+   \param username the mailbox the FMIDs are allocated for
+   \param count number of FMIDs to allocate
+   \param fmidp pointer to the first allocated FMID
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context *ictx,
+						      const char *username,
+						      int count,
+						      uint64_t *fmidp)
+{
+	enum mapistore_error		retval;
+	struct indexing_fmid_lease	*lease;
+	uint64_t			first;
+
+	/* SANITY checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(count < 0, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(count == 0, MAPISTORE_SUCCESS, NULL);
+
+	lease = ictx->lease;
+	if (!lease || count >= lease->size || strcmp(lease->username, username)) {
+		return mysql_reserve_fmids(ictx, username, count, fmidp);
+	}
+
+	if (lease->end - lease->next < count) {
+		retval = mysql_reserve_fmids(ictx, username, lease->size, &first);
+		MAPISTORE_RETVAL_IF(retval != MAPISTORE_SUCCESS, retval, NULL);
+
+		/* Keep the leftover when the new range follows it */
+		if (first != lease->end) {
+			lease->next = first;
+		}
+		lease->end = first + lease->size;
+	}
+
+	*fmidp = lease->next;
+	lease->next += count;
+
+	return MAPISTORE_SUCCESS;
+}
+
 static enum mapistore_error mysql_record_allocate_fmid(struct indexing_context *ictx,
 						     const char *username,
 						     uint64_t *fmidp)
@@ -868,6 +1052,7 @@ static int mapistore_indexing_mysql_destructor(struct indexing_context *ictx)
 {
 	if (ictx && ictx->data) {
 		MYSQL *conn = ictx->data;
+		mysql_return_fmid_lease(ictx);
 		if (ictx->cache) {
 			oc_memcached_release_connection((memcached_st *)ictx->cache, true);
 		}
@@ -948,6 +1133,14 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_mysql_init(struct mapistore_con
 	/* Data pointers */
 	cache_url = mapistore_get_default_cache_url();
 	ictx->cache = _memcached_setup(ictx, cache_url, username);
+	ictx->lru = mapistore_indexing_cache_init(ictx);
+	if (default_fmid_lease_size > 1) {
+		ictx->lease = talloc_zero(ictx, struct indexing_fmid_lease);
+		MAPISTORE_RETVAL_IF(!ictx->lease, MAPISTORE_ERR_NO_MEMORY, ictx);
+		ictx->lease->username = talloc_strdup(ictx->lease, username);
+		MAPISTORE_RETVAL_IF(!ictx->lease->username, MAPISTORE_ERR_NO_MEMORY, ictx);
+		ictx->lease->size = default_fmid_lease_size;
+	}
 
 	*ictxp = ictx;
 
@@ -34,6 +34,423 @@
 
 #define	TDB_WRAP(context)	((struct tdb_wrap*)context->data)
 
+/**
+   URI index
+
+   Next to the FMID -> URI records, the database stores:
+   - a reverse record per URI: MAPISTORE_URI_TAG + URI -> primary key
+     of the FMID record (either 0x... or SOFT_DELETED:0x...)
+   - a prefix record per parent URI: MAPISTORE_URI_PREFIX_TAG + parent
+     URI (up to and including its last slash) -> NUL separated list
+     of the leaf names stored under it
+
+   URIs are indexed without their trailing slash, the same way lookups
+   have always compared them.
+ */
+
+static char *tdb_uri_normalise(TALLOC_CTX *mem_ctx, const char *uri, size_t len)
+{
+	char	*norm;
+
+	norm = talloc_strndup(mem_ctx, uri, len);
+	if (norm && *norm && norm[strlen(norm) - 1] == '/') {
+		norm[strlen(norm) - 1] = '\0';
+	}
+
+	return norm;
+}
+
+static TDB_DATA tdb_uri_key(TALLOC_CTX *mem_ctx, const char *norm)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_TAG, norm);
+	key.dsize = key.dptr ? strlen((const char *) key.dptr) : 0;
+
+	return key;
+}
+
+static TDB_DATA tdb_uri_prefix_key(TALLOC_CTX *mem_ctx, const char *norm, const char **leafp)
+{
+	TDB_DATA	key;
+	const char	*slash;
+
+	slash = strrchr(norm, '/');
+	*leafp = slash ? slash + 1 : norm;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%.*s", MAPISTORE_URI_PREFIX_TAG,
+						     (int)(*leafp - norm), norm);
+	key.dsize = key.dptr ? strlen((const char *) key.dptr) : 0;
+
+	return key;
+}
+
+static uint64_t tdb_pkey_to_fmid(const char *pkey, bool *soft_deletedp)
+{
+	size_t	taglen = strlen(MAPISTORE_SOFT_DELETED_TAG);
+
+	*soft_deletedp = (strncmp(pkey, MAPISTORE_SOFT_DELETED_TAG, taglen) == 0);
+
+	return strtoull(*soft_deletedp ? pkey + taglen : pkey, NULL, 16);
+}
+
+static bool tdb_uri_match(const char *norm, const char *startswith, const char *endswith)
+{
+	size_t	len = strlen(norm);
+	size_t	start_len = strlen(startswith);
+	size_t	end_len = strlen(endswith);
+
+	if (len < start_len || len < end_len) {
+		return false;
+	}
+
+	return (!strncmp(norm, startswith, start_len) &&
+		!strncmp(norm + len - end_len, endswith, end_len));
+}
+
+/**
+   \details Retrieve the primary key referenced by a normalised URI
+
+   \return talloc'ed primary key on success, otherwise NULL
+ */
+static char *tdb_uri_index_lookup(struct tdb_context *tdb, TALLOC_CTX *mem_ctx, const char *norm)
+{
+	TDB_DATA	key, dbuf;
+	char		*pkey;
+
+	if (!norm) return NULL;
+
+	key = tdb_uri_key(mem_ctx, norm);
+	if (!key.dptr) return NULL;
+
+	dbuf = tdb_fetch(tdb, key);
+	talloc_free(key.dptr);
+	if (!dbuf.dptr) return NULL;
+
+	pkey = talloc_strndup(mem_ctx, (const char *) dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+
+	return pkey;
+}
+
+/**
+   \details Index a URI against the primary key of its FMID record
+
+   \param tdb pointer to the indexing database
+   \param uri the mapistore URI
+   \param pkey the primary key of the FMID record
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_uri_index_add(struct tdb_context *tdb, const char *uri, const char *pkey)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key, prefix, dbuf;
+	const char	*norm, *leaf;
+	int		exists;
+	int		ret;
+
+	mem_ctx = talloc_new(NULL);
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	norm = tdb_uri_normalise(mem_ctx, uri, strlen(uri));
+	MAPISTORE_RETVAL_IF(!norm, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	key = tdb_uri_key(mem_ctx, norm);
+	MAPISTORE_RETVAL_IF(!key.dptr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+	dbuf.dptr = (unsigned char *) pkey;
+	dbuf.dsize = strlen(pkey);
+
+	exists = tdb_exists(tdb, key);
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	/* When another record already used this URI its leaf is listed */
+	if (!exists) {
+		prefix = tdb_uri_prefix_key(mem_ctx, norm, &leaf);
+		MAPISTORE_RETVAL_IF(!prefix.dptr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+		dbuf.dptr = (unsigned char *) leaf;
+		dbuf.dsize = strlen(leaf) + 1;
+		ret = tdb_append(tdb, prefix, dbuf);
+		MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	}
+
+	talloc_free(mem_ctx);
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Remove a URI from the index or point it to another primary
+   key. Nothing happens if the URI is not indexed against old_pkey:
+   it has been reused by another record since.
+
+   \param tdb pointer to the indexing database
+   \param uri the mapistore URI
+   \param old_pkey the primary key the URI is expected to reference
+   \param new_pkey the new primary key, NULL to remove the URI
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_uri_index_update(struct tdb_context *tdb, const char *uri,
+						 const char *old_pkey, const char *new_pkey)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key, prefix, dbuf, list;
+	const char	*norm, *leaf, *entry;
+	size_t		offset, len, leaf_len;
+	bool		removed = false;
+	bool		same;
+	int		ret;
+
+	mem_ctx = talloc_new(NULL);
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	norm = tdb_uri_normalise(mem_ctx, uri, strlen(uri));
+	MAPISTORE_RETVAL_IF(!norm, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	key = tdb_uri_key(mem_ctx, norm);
+	MAPISTORE_RETVAL_IF(!key.dptr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+	dbuf = tdb_fetch(tdb, key);
+	MAPISTORE_RETVAL_IF(!dbuf.dptr, MAPISTORE_SUCCESS, mem_ctx);
+	same = (dbuf.dsize == strlen(old_pkey) && !memcmp(dbuf.dptr, old_pkey, dbuf.dsize));
+	free(dbuf.dptr);
+	MAPISTORE_RETVAL_IF(!same, MAPISTORE_SUCCESS, mem_ctx);
+
+	if (new_pkey) {
+		dbuf.dptr = (unsigned char *) new_pkey;
+		dbuf.dsize = strlen(new_pkey);
+		ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+		MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+		talloc_free(mem_ctx);
+		return MAPISTORE_SUCCESS;
+	}
+
+	ret = tdb_delete(tdb, key);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	/* Rewrite the leaf list of the parent without this entry */
+	prefix = tdb_uri_prefix_key(mem_ctx, norm, &leaf);
+	MAPISTORE_RETVAL_IF(!prefix.dptr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	dbuf = tdb_fetch(tdb, prefix);
+	MAPISTORE_RETVAL_IF(!dbuf.dptr, MAPISTORE_SUCCESS, mem_ctx);
+
+	list.dptr = talloc_size(mem_ctx, dbuf.dsize);
+	list.dsize = 0;
+	if (!list.dptr) {
+		free(dbuf.dptr);
+		MAPISTORE_RETVAL_ERR(MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	}
+
+	leaf_len = strlen(leaf);
+	for (offset = 0; offset < dbuf.dsize; offset += len + 1) {
+		entry = (const char *) dbuf.dptr + offset;
+		len = strnlen(entry, dbuf.dsize - offset);
+		if (offset + len == dbuf.dsize) break;
+		if (!removed && len == leaf_len && !memcmp(entry, leaf, len)) {
+			removed = true;
+			continue;
+		}
+		memcpy(list.dptr + list.dsize, entry, len + 1);
+		list.dsize += len + 1;
+	}
+	free(dbuf.dptr);
+
+	if (list.dsize) {
+		ret = tdb_store(tdb, prefix, list, TDB_REPLACE);
+	} else {
+		ret = tdb_delete(tdb, prefix);
+	}
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	talloc_free(mem_ctx);
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Look for a URI matching startswith*endswith among the
+   leaves stored right under the parent of startswith
+
+   \return talloc'ed primary key of the first match, otherwise NULL
+ */
+static char *tdb_uri_prefix_search(struct tdb_context *tdb, TALLOC_CTX *mem_ctx,
+				   const char *startswith, const char *endswith)
+{
+	TDB_DATA	prefix, dbuf;
+	const char	*slash, *entry;
+	char		*parent, *norm;
+	char		*pkey = NULL;
+	size_t		offset, len;
+
+	slash = strrchr(startswith, '/');
+	if (!slash) return NULL;
+
+	parent = talloc_strndup(mem_ctx, startswith, slash - startswith + 1);
+	if (!parent) return NULL;
+
+	prefix.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_PREFIX_TAG, parent);
+	if (!prefix.dptr) return NULL;
+	prefix.dsize = strlen((const char *) prefix.dptr);
+
+	dbuf = tdb_fetch(tdb, prefix);
+	talloc_free(prefix.dptr);
+	if (!dbuf.dptr) return NULL;
+
+	for (offset = 0; offset < dbuf.dsize && !pkey; offset += len + 1) {
+		entry = (const char *) dbuf.dptr + offset;
+		len = strnlen(entry, dbuf.dsize - offset);
+		if (offset + len == dbuf.dsize) break;
+
+		norm = talloc_asprintf(mem_ctx, "%s%s", parent, entry);
+		if (norm && tdb_uri_match(norm, startswith, endswith)) {
+			pkey = tdb_uri_index_lookup(tdb, mem_ctx, norm);
+		}
+		talloc_free(norm);
+	}
+	free(dbuf.dptr);
+
+	return pkey;
+}
+
+struct tdb_upgrade_record {
+	char	*pkey;
+	char	*uri;
+};
+
+struct tdb_upgrade_data {
+	TALLOC_CTX			*mem_ctx;
+	struct tdb_upgrade_record	*records;
+	uint32_t			count;
+	uint32_t			size;
+};
+
+static int tdb_upgrade_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct tdb_upgrade_data	*upgrade = data;
+	size_t			taglen = strlen(MAPISTORE_SOFT_DELETED_TAG);
+
+	/* Only FMID records: 0x... and SOFT_DELETED:0x... */
+	if (!(key.dsize > 2 && !memcmp(key.dptr, "0x", 2)) &&
+	    !(key.dsize > taglen && !memcmp(key.dptr, MAPISTORE_SOFT_DELETED_TAG, taglen))) {
+		return 0;
+	}
+
+	if (upgrade->count == upgrade->size) {
+		upgrade->size = upgrade->size ? upgrade->size * 2 : 1024;
+		upgrade->records = talloc_realloc(upgrade->mem_ctx, upgrade->records,
+						  struct tdb_upgrade_record, upgrade->size);
+		if (!upgrade->records) return -1;
+	}
+
+	upgrade->records[upgrade->count].pkey = talloc_strndup(upgrade->records, (const char *) key.dptr, key.dsize);
+	upgrade->records[upgrade->count].uri = talloc_strndup(upgrade->records, (const char *) value.dptr, value.dsize);
+	if (!upgrade->records[upgrade->count].pkey || !upgrade->records[upgrade->count].uri) {
+		return -1;
+	}
+	upgrade->count++;
+
+	return 0;
+}
+
+/**
+   \details Retrieve the layout version of an indexing database
+
+   \param tdb pointer to the indexing database
+
+   \return the version stored in the database, 0 if none was stored
+ */
+static uint32_t tdb_indexing_version(struct tdb_context *tdb)
+{
+	TDB_DATA	key, dbuf;
+	char		*value;
+	uint32_t	version = 0;
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		value = talloc_strndup(NULL, (const char *) dbuf.dptr, dbuf.dsize);
+		version = value ? strtoul(value, NULL, 10) : 0;
+		talloc_free(value);
+		free(dbuf.dptr);
+	}
+
+	return version;
+}
+
+/**
+   \details Build the URI index of a database created before it
+   existed. This runs once per database, within a transaction.
+
+   \param tdb pointer to the indexing database
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_indexing_upgrade(struct tdb_context *tdb)
+{
+	enum mapistore_error	retval = MAPISTORE_SUCCESS;
+	struct tdb_upgrade_data	upgrade;
+	TDB_DATA		key, dbuf;
+	uint32_t		i;
+	int			ret;
+
+	if (tdb_indexing_version(tdb) >= MAPISTORE_INDEXING_VERSION) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	/* Serialise concurrent upgrades of the same database */
+	ret = tdb_transaction_start(tdb);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	if (tdb_indexing_version(tdb) >= MAPISTORE_INDEXING_VERSION) {
+		tdb_transaction_cancel(tdb);
+		return MAPISTORE_SUCCESS;
+	}
+
+	upgrade.mem_ctx = talloc_named(NULL, 0, "tdb_indexing_upgrade");
+	upgrade.records = NULL;
+	upgrade.count = 0;
+	upgrade.size = 0;
+	if (!upgrade.mem_ctx) {
+		tdb_transaction_cancel(tdb);
+		return MAPISTORE_ERR_NO_MEMORY;
+	}
+
+	ret = tdb_traverse_read(tdb, tdb_upgrade_traverse, &upgrade);
+	if (ret == -1) {
+		retval = MAPISTORE_ERR_DATABASE_OPS;
+		goto end;
+	}
+
+	for (i = 0; i < upgrade.count; i++) {
+		retval = tdb_uri_index_add(tdb, upgrade.records[i].uri, upgrade.records[i].pkey);
+		if (retval != MAPISTORE_SUCCESS) goto end;
+	}
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+	dbuf.dptr = (unsigned char *) talloc_asprintf(upgrade.mem_ctx, "%d", MAPISTORE_INDEXING_VERSION);
+	dbuf.dsize = strlen((const char *) dbuf.dptr);
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	if (ret == -1) {
+		retval = MAPISTORE_ERR_DATABASE_OPS;
+		goto end;
+	}
+
+	ret = tdb_transaction_commit(tdb);
+	talloc_free(upgrade.mem_ctx);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	OC_DEBUG(3, "[indexing] %s: URI index built for %u records", tdb_name(tdb), upgrade.count);
+	return MAPISTORE_SUCCESS;
+
+end:
+	OC_DEBUG(0, "[indexing] %s: unable to build URI index: %s", tdb_name(tdb), mapistore_errstr(retval));
+	tdb_transaction_cancel(tdb);
+	talloc_free(upgrade.mem_ctx);
+	return retval;
+}
 
 
 static enum mapistore_error tdb_search_existing_fmid(struct indexing_context *ictx,
@@ -101,15 +518,21 @@ static enum mapistore_error tdb_record_add(struct indexing_context *ictx,
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
 	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_INSERT);
-	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
 
 	if (ret == -1) {
 		OC_DEBUG(3, "Unable to create 0x%.16"PRIx64" record: %s\n", fmid,
 				 mapistore_URI);
+		talloc_free(key.dptr);
 		return MAPISTORE_ERR_DATABASE_OPS;
 	}
 
+	ret = tdb_uri_index_add(TDB_WRAP(ictx)->tdb, mapistore_URI, (const char *) key.dptr);
+	talloc_free(key.dptr);
+	MAPISTORE_RETVAL_IF(ret, ret, NULL);
+
+	mapistore_indexing_cache_add(ictx->lru, fmid, mapistore_URI);
+
 	return MAPISTORE_SUCCESS;
 }
 
@@ -121,6 +544,8 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	int		ret;
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
+	TDB_DATA	old_dbuf;
+	char		*old_uri = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -132,19 +557,37 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	key.dptr = (unsigned char *) talloc_asprintf(ictx, "0x%.16"PRIx64, fmid);
 	key.dsize = strlen((const char *) key.dptr);
 
+	/* Retrieve the previous URI to update the URI index */
+	old_dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+	if (old_dbuf.dptr) {
+		old_uri = talloc_strndup(key.dptr, (const char *) old_dbuf.dptr, old_dbuf.dsize);
+		free(old_dbuf.dptr);
+	}
+
 	dbuf.dptr = (unsigned char *) talloc_strdup(ictx, mapistore_URI);
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
 	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_MODIFY);
-	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
 
 	if (ret == -1) {
 		OC_DEBUG(3, "Unable to update 0x%.16"PRIx64" record: %s\n",
 			  fmid, mapistore_URI);
+		talloc_free(key.dptr);
 		return MAPISTORE_ERR_NOT_FOUND;
 	}
 
+	if (old_uri) {
+		ret = tdb_uri_index_update(TDB_WRAP(ictx)->tdb, old_uri, (const char *) key.dptr, NULL);
+		MAPISTORE_RETVAL_IF(ret, ret, key.dptr);
+	}
+	ret = tdb_uri_index_add(TDB_WRAP(ictx)->tdb, mapistore_URI, (const char *) key.dptr);
+	talloc_free(key.dptr);
+	MAPISTORE_RETVAL_IF(ret, ret, NULL);
+
+	/* Same as the MySQL backend: let the next lookup refill the cache */
+	mapistore_indexing_cache_del(ictx->lru, fmid);
+
 	return MAPISTORE_SUCCESS;
 }
 
@@ -158,6 +601,7 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 	TDB_DATA			newkey;
 	TDB_DATA			dbuf;
 	bool				IsSoftDeleted = false;
+	char				*uri;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -168,6 +612,8 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 	ret = tdb_search_existing_fmid(ictx, username, fmid, &IsSoftDeleted);
 	MAPISTORE_RETVAL_IF(!ret, ret, NULL);
 
+	mapistore_indexing_cache_del(ictx->lru, fmid);
+
 	if (IsSoftDeleted == true) {
 		key.dptr = (unsigned char *) talloc_asprintf(ictx, "%s0x%.16"PRIx64,
 							     MAPISTORE_SOFT_DELETED_TAG, fmid);
@@ -179,27 +625,41 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 	switch (flags) {
 	case MAPISTORE_SOFT_DELETE:
 		/* nothing to do if the record is already soft deleted */
-		MAPISTORE_RETVAL_IF(IsSoftDeleted == true, MAPISTORE_SUCCESS, NULL);
-		newkey.dptr = (unsigned char *) talloc_asprintf(ictx, "%s0x%.16"PRIx64,
+		MAPISTORE_RETVAL_IF(IsSoftDeleted == true, MAPISTORE_SUCCESS, key.dptr);
+		newkey.dptr = (unsigned char *) talloc_asprintf(key.dptr, "%s0x%.16"PRIx64,
 								MAPISTORE_SOFT_DELETED_TAG,
 								fmid);
 		newkey.dsize = strlen ((const char *)newkey.dptr);
 		/* Retrieve previous value */
 		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		uri = talloc_strndup(key.dptr, (const char *) dbuf.dptr, dbuf.dsize);
 		/* Add new record */
 		ret = tdb_store(TDB_WRAP(ictx)->tdb, newkey, dbuf, TDB_INSERT);
 		free(dbuf.dptr);
 		/* Delete previous record */
 		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+		/* The URI now references the soft deleted record */
+		if (uri) {
+			ret = tdb_uri_index_update(TDB_WRAP(ictx)->tdb, uri, (const char *) key.dptr,
+						   (const char *) newkey.dptr);
+			MAPISTORE_RETVAL_IF(ret, ret, key.dptr);
+		}
 		talloc_free(key.dptr);
-		talloc_free(newkey.dptr);
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		uri = talloc_strndup(key.dptr, (const char *) dbuf.dptr, dbuf.dsize);
+		free(dbuf.dptr);
 		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, key.dptr);
+		if (uri) {
+			ret = tdb_uri_index_update(TDB_WRAP(ictx)->tdb, uri, (const char *) key.dptr, NULL);
+			MAPISTORE_RETVAL_IF(ret, ret, key.dptr);
+		}
 		talloc_free(key.dptr);
-		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
 		break;
 	default:
+		talloc_free(key.dptr);
 		return MAPISTORE_ERR_INVALID_PARAMETER;
 	}
 
@@ -223,6 +683,12 @@ static enum mapistore_error tdb_record_get_uri(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!urip, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
+	/* Cached records are never soft deleted */
+	if (mapistore_indexing_cache_get_uri(ictx->lru, mem_ctx, fmid, urip) == MAPISTORE_SUCCESS) {
+		*soft_deletedp = false;
+		return MAPISTORE_SUCCESS;
+	}
+
 	/* Check if the fmid exists within the database */
 	key.dptr = (unsigned char *) talloc_asprintf(ictx, "0x%.16"PRIx64, fmid);
 	key.dsize = strlen((const char *) key.dptr);
@@ -252,85 +718,41 @@ static enum mapistore_error tdb_record_get_uri(struct indexing_context *ictx,
 	free(dbuf.dptr);
 	talloc_free(key.dptr);
 
+	if (*soft_deletedp == false) {
+		mapistore_indexing_cache_add(ictx->lru, fmid, *urip);
+	}
+
 	return MAPISTORE_SUCCESS;
 }
 
 /**
-   \details A slow but effective way to retrieve an fmid from a uri
-
-   \param mstore_ctx pointer to the mapistore context
-   \param mem_ctx pointer to the talloc context
-   \param fmid the fmid/key to the record
-   \param urip pointer to the uri pointer
-   \param soft_deletedp pointer to the soft deleted pointer
-
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+   \details Fallback for wildcard lookups the prefix index can't
+   answer: scan the URI index records
  */
 struct tdb_get_fid_data {
-	bool		found;
-	uint64_t	fmid;
-	char		*uri;
-	size_t		uri_len;
-	uint32_t	wildcard_count;
-	char		*startswith;
-	char		*endswith;
+	TALLOC_CTX	*mem_ctx;
+	char		*pkey;
+	const char	*startswith;
+	const char	*endswith;
 };
 
-static int tdb_get_fid_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
 {
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
+	struct tdb_get_fid_data	*tdb_data = data;
+	size_t			taglen = strlen(MAPISTORE_URI_TAG);
+	char			*cmp_uri;
 	int			ret = 0;
 
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-	if (strcmp(cmp_uri, tdb_data->uri) == 0) {
-		key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		tdb_data->fmid = strtoull(key_str, NULL, 16);
-		tdb_data->found = true;
-		ret = 1;
+	if (key.dsize < taglen || memcmp(key.dptr, MAPISTORE_URI_TAG, taglen)) {
+		return 0;
 	}
-	
-	talloc_free(mem_ctx);
-
-	return ret;
-}
 
-static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-
-	if (!strncmp(cmp_uri, tdb_data->startswith, strlen(tdb_data->startswith)) &&
-	    !strncmp(cmp_uri + (strlen(cmp_uri) - strlen(tdb_data->endswith)), tdb_data->endswith, 
-		     strlen(tdb_data->endswith))) {
-		    key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		    tdb_data->fmid = strtoull(key_str, NULL, 16);
-		    tdb_data->found = true;
-		    ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
+	cmp_uri = talloc_strndup(tdb_data->mem_ctx, (const char *) key.dptr + taglen, key.dsize - taglen);
+	if (cmp_uri && tdb_uri_match(cmp_uri, tdb_data->startswith, tdb_data->endswith)) {
+		tdb_data->pkey = talloc_strndup(tdb_data->mem_ctx, (const char *) value.dptr, value.dsize);
+		ret = 1;
+	}
+	talloc_free(cmp_uri);
 
 	return ret;
 }
@@ -340,9 +762,13 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 					        const char *uri, bool partial,
 					        uint64_t *fmidp, bool *soft_deletedp)
 {
-	int				ret;
+	TALLOC_CTX			*mem_ctx;
 	struct tdb_get_fid_data		tdb_data;
-	char				*slash_ptr;
+	TDB_DATA			key, dbuf;
+	const char			*wildcard;
+	char				*pkey = NULL;
+	char				*stored_uri;
+	uint32_t			wildcard_count = 0;
 	uint32_t			i;
 
 	/* SANITY checks */
@@ -352,60 +778,65 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Check if the fmid exists within the database */
-	tdb_data.found = false;
-	tdb_data.uri = talloc_strdup(NULL, uri);
-	tdb_data.uri_len = strlen(uri);
-
-	tdb_data.startswith = NULL;
-	tdb_data.endswith = NULL;
-	tdb_data.wildcard_count = 0;
-
-	slash_ptr = tdb_data.uri + tdb_data.uri_len - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-		tdb_data.uri_len--;
+	/* Exact lookups are served from the cache when possible */
+	if (partial == false &&
+	    mapistore_indexing_cache_get_fmid(ictx->lru, uri, fmidp) == MAPISTORE_SUCCESS) {
+		*soft_deletedp = false;
+		return MAPISTORE_SUCCESS;
 	}
-	if (partial == false) {
-		tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
-	} else {
-		for (tdb_data.wildcard_count = 0, i = 0; i < strlen(uri); i++) {
-			if (uri[i] == '*') tdb_data.wildcard_count += 1;
-		}
 
-		switch (tdb_data.wildcard_count) {
-		case 0: /* complete URI */
-			partial = true;
-			break;
-		case 1: /* start and end only */
-			tdb_data.endswith = strchr(uri, '*') + 1;
-			tdb_data.startswith = talloc_strndup(NULL, uri, strlen(uri) - strlen(tdb_data.endswith) - 1);
-			break;
-		default:
+	if (partial == true) {
+		for (i = 0; uri[i]; i++) {
+			if (uri[i] == '*') wildcard_count += 1;
+		}
+		if (wildcard_count > 1) {
 			OC_DEBUG(0, "Too many wildcards found (1 maximum)\n");
-			talloc_free(tdb_data.uri);
 			return MAPISTORE_ERR_NOT_FOUND;
 		}
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_get_fmid");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
 
-		if (partial == true) {
+	if (wildcard_count == 0) {
+		/* complete URI */
+		pkey = tdb_uri_index_lookup(TDB_WRAP(ictx)->tdb, mem_ctx,
+					    tdb_uri_normalise(mem_ctx, uri, strlen(uri)));
+	} else {
+		/* start and end only */
+		wildcard = strchr(uri, '*');
+		tdb_data.mem_ctx = mem_ctx;
+		tdb_data.pkey = NULL;
+		tdb_data.endswith = wildcard + 1;
+		tdb_data.startswith = talloc_strndup(mem_ctx, uri, wildcard - uri);
+		MAPISTORE_RETVAL_IF(!tdb_data.startswith, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+		pkey = tdb_uri_prefix_search(TDB_WRAP(ictx)->tdb, mem_ctx,
+					     tdb_data.startswith, tdb_data.endswith);
+		if (!pkey) {
+			/* The match may be deeper in the hierarchy */
 			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
-			talloc_free(tdb_data.startswith);
-		} else {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
+			pkey = tdb_data.pkey;
 		}
 	}
+	MAPISTORE_RETVAL_IF(!pkey, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
 
-	talloc_free(tdb_data.uri);
-	if (tdb_data.found) {
-		*fmidp = tdb_data.fmid;
-		*soft_deletedp = false; /* TODO: implement the feature */
-		ret = MAPISTORE_SUCCESS;
-	}
-	else {
-		ret = MAPISTORE_ERR_NOT_FOUND;
+	*fmidp = tdb_pkey_to_fmid(pkey, soft_deletedp);
+
+	/* Cache the URI as stored, it may differ by its trailing slash */
+	if (*soft_deletedp == false) {
+		key.dptr = (unsigned char *) pkey;
+		key.dsize = strlen(pkey);
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		if (dbuf.dptr) {
+			stored_uri = talloc_strndup(mem_ctx, (const char *) dbuf.dptr, dbuf.dsize);
+			mapistore_indexing_cache_add(ictx->lru, *fmidp, stored_uri);
+			free(dbuf.dptr);
+		}
 	}
 
-	return ret;
+	talloc_free(mem_ctx);
+	return MAPISTORE_SUCCESS;
 }
 
 
@@ -497,7 +928,7 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 	dbpath = talloc_asprintf(mem_ctx, "%s/%s/indexing.tdb",
 				 mapistore_get_mapping_path(), username);
 
-	ictx->data = mapistore_tdb_wrap_open(ictx, dbpath, 0, 0, O_RDWR|O_CREAT, 0600);
+	ictx->data = mapistore_tdb_wrap_open(ictx, dbpath, MAPISTORE_DB_INDEXING_HASH_SIZE, 0, O_RDWR|O_CREAT, 0600);
 	talloc_free(dbpath);
 	if (!TDB_WRAP(ictx)) {
 		OC_DEBUG(3, "%s\n", strerror(errno));
@@ -506,6 +937,13 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 
+	/* Step 2. Build the URI index of databases created without it */
+	if (tdb_indexing_upgrade(TDB_WRAP(ictx)->tdb) != MAPISTORE_SUCCESS) {
+		talloc_free(ictx);
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_DATABASE_INIT;
+	}
+
 	/* TODO: extract url from backend mapping, by the moment we use the username */
 	ictx->url = talloc_strdup(ictx, username);
 
@@ -518,6 +956,9 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 	ictx->allocate_fmid = tdb_record_allocate_fmid;
 	ictx->allocate_fmids = tdb_record_allocate_fmids;
 
+	/* Per-process URI <-> FMID cache */
+	ictx->lru = mapistore_indexing_cache_init(ictx);
+
 	*ictxp = ictx;
 
 	talloc_free(mem_ctx);
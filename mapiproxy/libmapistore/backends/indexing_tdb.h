@@ -26,6 +26,11 @@
 
 #define	MAPISTORE_DB_INDEXING		"indexing.tdb"
 #define	MAPISTORE_SOFT_DELETED_TAG	"SOFT_DELETED:"
+#define	MAPISTORE_URI_TAG		"URI:"
+#define	MAPISTORE_URI_PREFIX_TAG	"URIPREFIX:"
+#define	MAPISTORE_INDEXING_VERSION_KEY	"IndexingVersion"
+#define	MAPISTORE_INDEXING_VERSION	2
+#define	MAPISTORE_DB_INDEXING_HASH_SIZE	10007
 
 
 enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_context *,
@@ -30,6 +30,17 @@
 #include <param.h>
 
 struct MAPINAMEID;
+struct namedprops_cache;
+
+/**
+   A name to mapped id record, as listed by the backends to warm the
+   named properties cache
+ */
+struct namedprops_mapping {
+	struct MAPINAMEID	*nameid;
+	uint16_t		mapped_id;
+	uint16_t		prop_type;
+};
 
 struct namedprops_context {
 	enum mapistore_error (*get_mapped_id)(struct namedprops_context *, struct MAPINAMEID, uint16_t *);
@@ -39,8 +50,12 @@ struct namedprops_context {
 	enum mapistore_error (*get_nameid_type)(struct namedprops_context *, uint16_t, uint16_t *);
 	enum mapistore_error (*transaction_start)(struct namedprops_context *);
 	enum mapistore_error (*transaction_commit)(struct namedprops_context *);
+	enum mapistore_error (*list_mappings)(struct namedprops_context *, TALLOC_CTX *, struct namedprops_mapping **, uint32_t *);
+	enum mapistore_error (*get_generation)(struct namedprops_context *, uint64_t *);
 
 	const char *backend_type;
+	const char *location;
+	struct namedprops_cache *cache;
 	void *data;
 };
 
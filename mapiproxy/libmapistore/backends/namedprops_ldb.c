@@ -352,6 +352,116 @@ static enum mapistore_error get_nameid_type(struct namedprops_context *self,
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details List all the named properties mappings
+
+   \param self pointer to the namedprops context
+   \param mem_ctx pointer to the memory context
+   \param mappingsp pointer on pointer to the mappings array to return
+   \param countp pointer to the number of mappings to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error list_mappings(struct namedprops_context *self,
+					  TALLOC_CTX *mem_ctx,
+					  struct namedprops_mapping **mappingsp,
+					  uint32_t *countp)
+{
+	TALLOC_CTX			*local_mem_ctx;
+	struct ldb_context		*ldb_ctx = self->data;
+	struct ldb_result		*res = NULL;
+	const char * const		attrs[] = { "objectClass", "cn", "oleguid", "mappedId", "propType", NULL };
+	struct namedprops_mapping	*mappings;
+	struct MAPINAMEID		*nameid;
+	const char			*guid, *oClass, *cn, *val;
+	uint32_t			count = 0;
+	uint16_t			mapped_id;
+	int				prop_type;
+	int				ret;
+	int				i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ldb_ctx, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	MAPISTORE_RETVAL_IF(!mappingsp || !countp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	local_mem_ctx = talloc_named(NULL, 0, "list_mappings");
+	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	ret = ldb_search(ldb_ctx, local_mem_ctx, &res, ldb_get_default_basedn(ldb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "(mappedId=*)");
+	MAPISTORE_RETVAL_IF(ret != LDB_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, local_mem_ctx);
+
+	mappings = talloc_array(mem_ctx, struct namedprops_mapping, res->count);
+	MAPISTORE_RETVAL_IF(!mappings, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+
+	for (i = 0; i < res->count; i++) {
+		guid = ldb_msg_find_attr_as_string(res->msgs[i], "oleguid", NULL);
+		cn = ldb_msg_find_attr_as_string(res->msgs[i], "cn", NULL);
+		oClass = ldb_msg_find_attr_as_string(res->msgs[i], "objectClass", NULL);
+		mapped_id = ldb_msg_find_attr_as_uint(res->msgs[i], "mappedId", 0);
+		if (!guid || !cn || !oClass || !mapped_id) continue;
+
+		/* Same propType handling as get_nameid_type */
+		prop_type = ldb_msg_find_attr_as_int(res->msgs[i], "propType", 0);
+		if (!prop_type) {
+			val = ldb_msg_find_attr_as_string(res->msgs[i], "propType", "");
+			prop_type = mapistore_namedprops_prop_type_from_string(val);
+		}
+
+		nameid = talloc_zero(mappings, struct MAPINAMEID);
+		MAPISTORE_RETVAL_IF(!nameid, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+		GUID_from_string(guid, &nameid->lpguid);
+		if (strcmp(oClass, "MNID_ID") == 0) {
+			nameid->ulKind = MNID_ID;
+			nameid->kind.lid = strtol(cn, NULL, 16);
+		} else if (strcmp(oClass, "MNID_STRING") == 0) {
+			nameid->ulKind = MNID_STRING;
+			nameid->kind.lpwstr.NameSize = strlen(cn) * 2 + 2;
+			nameid->kind.lpwstr.Name = talloc_strdup(nameid, cn);
+		} else {
+			talloc_free(nameid);
+			continue;
+		}
+
+		mappings[count].nameid = nameid;
+		mappings[count].mapped_id = mapped_id;
+		mappings[count].prop_type = prop_type;
+		count++;
+	}
+
+	talloc_free(local_mem_ctx);
+
+	*mappingsp = mappings;
+	*countp = count;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Return the generation of the named properties database: the
+   LDB sequence number, increased by any modification
+
+   \param self pointer to the namedprops context
+   \param generationp pointer to the generation to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_generation(struct namedprops_context *self,
+					   uint64_t *generationp)
+{
+	struct ldb_context	*ldb_ctx = self->data;
+	int			ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ldb_ctx, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	MAPISTORE_RETVAL_IF(!generationp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	ret = ldb_sequence_number(ldb_ctx, LDB_SEQ_HIGHEST_SEQ, generationp);
+	MAPISTORE_RETVAL_IF(ret != LDB_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
 static enum mapistore_error transaction_start(struct namedprops_context *self)
 {
 	struct ldb_context *ldb_ctx = self->data;
@@ -467,6 +577,9 @@ enum mapistore_error mapistore_namedprops_ldb_init(TALLOC_CTX *mem_ctx,
 	nprops->next_unused_id = next_unused_id;
 	nprops->transaction_commit = transaction_commit;
 	nprops->transaction_start = transaction_start;
+	nprops->list_mappings = list_mappings;
+	nprops->get_generation = get_generation;
+	nprops->location = talloc_strdup(nprops, database);
 	nprops->data = ldb_ctx;
 
 	*nprops_ctx = nprops;
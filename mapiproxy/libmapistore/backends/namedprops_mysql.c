@@ -170,6 +170,12 @@ static enum mapistore_error create_id(struct namedprops_context *self,
 		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
 	}
 
+	/* Let the caches of other processes know there is a new mapping */
+	if (mysql_query(conn, "UPDATE " NAMEDPROPS_MYSQL_GENERATION " "
+			"SET generation=generation+1 WHERE id=1") != 0) {
+		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	}
+
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
@@ -248,6 +254,108 @@ static enum mapistore_error get_nameid_type(struct namedprops_context *self,
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details List all the named properties mappings
+
+   \param self pointer to the namedprops context
+   \param mem_ctx pointer to the memory context
+   \param mappingsp pointer on pointer to the mappings array to return
+   \param countp pointer to the number of mappings to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error list_mappings(struct namedprops_context *self,
+					  TALLOC_CTX *mem_ctx,
+					  struct namedprops_mapping **mappingsp,
+					  uint32_t *countp)
+{
+	MYSQL				*conn = self->data;
+	MYSQL_RES			*res;
+	MYSQL_ROW			row;
+	struct namedprops_mapping	*mappings;
+	struct MAPINAMEID		*nameid;
+	uint32_t			count = 0;
+	int				type;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!conn, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	MAPISTORE_RETVAL_IF(!mappingsp || !countp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Rows are listed in insertion order so the first mapping of a
+	   shared mappedId wins, as with get_nameid */
+	if (mysql_query(conn, "SELECT type, oleguid, propName, propId, mappedId, propType "
+			"FROM " NAMEDPROPS_MYSQL_TABLE " ORDER BY id") != 0) {
+		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	}
+	res = mysql_store_result(conn);
+	MAPISTORE_RETVAL_IF(!res, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	mappings = talloc_array(mem_ctx, struct namedprops_mapping, mysql_num_rows(res));
+	if (!mappings) {
+		mysql_free_result(res);
+		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+
+	while ((row = mysql_fetch_row(res))) {
+		if (!row[0] || !row[1] || !row[4] || !row[5]) continue;
+
+		type = strtol(row[0], NULL, 10);
+		if (type == MNID_ID && !row[3]) continue;
+		if (type == MNID_STRING && !row[2]) continue;
+		if (type != MNID_ID && type != MNID_STRING) continue;
+
+		nameid = talloc_zero(mappings, struct MAPINAMEID);
+		if (!nameid) {
+			mysql_free_result(res);
+			MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_NO_MEMORY, mappings);
+		}
+		GUID_from_string(row[1], &nameid->lpguid);
+		nameid->ulKind = type;
+		if (type == MNID_ID) {
+			nameid->kind.lid = strtol(row[3], NULL, 10);
+		} else {
+			nameid->kind.lpwstr.NameSize = strlen(row[2]) * 2 + 2;
+			nameid->kind.lpwstr.Name = talloc_strdup(nameid, row[2]);
+		}
+
+		mappings[count].nameid = nameid;
+		mappings[count].mapped_id = strtol(row[4], NULL, 10);
+		mappings[count].prop_type = strtol(row[5], NULL, 10);
+		count++;
+	}
+	mysql_free_result(res);
+
+	*mappingsp = mappings;
+	*countp = count;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Return the generation of the named properties table. It is
+   increased each time a mapping is created.
+
+   \param self pointer to the namedprops context
+   \param generationp pointer to the generation to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_generation(struct namedprops_context *self,
+					   uint64_t *generationp)
+{
+	enum MYSQLRESULT	ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self->data, MAPISTORE_ERR_DATABASE_OPS, NULL);
+	MAPISTORE_RETVAL_IF(!generationp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	ret = select_first_uint(self->data, "SELECT generation FROM "
+				NAMEDPROPS_MYSQL_GENERATION " WHERE id=1", generationp);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
 static enum mapistore_error transaction_start(struct namedprops_context *self)
 {
 	MYSQL *conn = self->data;
@@ -376,7 +484,8 @@ enum mapistore_error mapistore_namedprops_mysql_init(TALLOC_CTX *mem_ctx,
 	MAPISTORE_RETVAL_IF(!conn, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
 	/* Initialize the database */
-	if (!table_exists(conn, NAMEDPROPS_MYSQL_TABLE)) {
+	if (!table_exists(conn, NAMEDPROPS_MYSQL_TABLE) ||
+	    !table_exists(conn, NAMEDPROPS_MYSQL_GENERATION)) {
 		OC_DEBUG(3, "Creating schema for named_properties on mysql %s\n",
 			 connection_string);
 		schema_created_ret = migrate_named_properties_schema(connection_string);
@@ -387,13 +496,12 @@ enum mapistore_error mapistore_namedprops_mysql_init(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-	talloc_free(connection_string);
-
 	/* Create context */
 	nprops = talloc_zero(mem_ctx, struct namedprops_context);
-	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_NO_MEMORY, NULL);
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_NO_MEMORY, connection_string);
 
 	nprops->backend_type = NAMEDPROPS_BACKEND_MYSQL;
+	nprops->location = talloc_steal(nprops, connection_string);
 
 	nprops->create_id = create_id;
 	nprops->get_mapped_id = get_mapped_id;
@@ -402,6 +510,8 @@ enum mapistore_error mapistore_namedprops_mysql_init(TALLOC_CTX *mem_ctx,
 	nprops->next_unused_id = next_unused_id;
 	nprops->transaction_commit = transaction_commit;
 	nprops->transaction_start = transaction_start;
+	nprops->list_mappings = list_mappings;
+	nprops->get_generation = get_generation;
 
 	nprops->data = conn;
 	talloc_set_destructor(nprops, mapistore_namedprops_mysql_destructor);
@@ -28,6 +28,7 @@
 
 #define	NAMEDPROPS_BACKEND_MYSQL	"mysql"
 #define	NAMEDPROPS_MYSQL_TABLE		"named_properties"
+#define	NAMEDPROPS_MYSQL_GENERATION	"named_properties_generation"
 
 struct namedprops_mysql_params {
 	const char	*data;
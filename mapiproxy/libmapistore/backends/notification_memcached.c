@@ -0,0 +1,186 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) Julien Kerihuel 2015
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "notification_memcached.h"
+#include "../mapistore_private.h"
+#include "mapiproxy/util/oc_memcached.h"
+
+#define	MEMC(context)	((memcached_st *)context->data)
+
+/**
+   \details Map memcached to mapistore error mapping
+
+   \param rc memcached_return error
+
+   \return matching MAPISTORE error
+ */
+static enum mapistore_error ret_to_mapistore(memcached_return rc)
+{
+	switch (rc) {
+	case MEMCACHED_SUCCESS:
+	case MEMCACHED_STORED:
+		return MAPISTORE_SUCCESS;
+	case MEMCACHED_FAILURE:
+	case MEMCACHED_NOTSTORED:
+		return MAPISTORE_ERROR;
+	case MEMCACHED_HOST_LOOKUP_FAILURE:
+	case MEMCACHED_CONNECTION_FAILURE:
+		return MAPISTORE_ERR_CONN_REFUSED;
+	case MEMCACHED_WRITE_FAILURE:
+	case MEMCACHED_READ_FAILURE:
+	case MEMCACHED_UNKNOWN_READ_FAILURE:
+		return MAPISTORE_ERR_INVALID_DATA;
+	case MEMCACHED_NOTFOUND:
+		return MAPISTORE_ERR_NOT_FOUND;
+	case MEMCACHED_ERROR:
+		return MAPISTORE_ERROR;
+	case MEMCACHED_DATA_EXISTS:
+		return MAPISTORE_ERR_EXIST;
+	default:
+		oc_log(OC_LOG_WARNING, "memcached return valud %d (%s) is not mapped", rc, memcached_strerror(NULL, rc));
+		return MAPISTORE_ERROR;
+	};
+}
+
+static enum mapistore_error notification_memcached_add(struct mapistore_notification_context *self,
+						       const char *key, const uint8_t *value,
+						       size_t length)
+{
+	return ret_to_mapistore(memcached_add(MEMC(self), key, strlen(key),
+					      (const char *)value, length, 0, 0));
+}
+
+static enum mapistore_error notification_memcached_set(struct mapistore_notification_context *self,
+						       const char *key, const uint8_t *value,
+						       size_t length)
+{
+	return ret_to_mapistore(memcached_set(MEMC(self), key, strlen(key),
+					      (const char *)value, length, 0, 0));
+}
+
+/**
+   \details Append data to a record, creating it if needed
+
+   \note A single add is issued when the record does not exist yet,
+   which is the common case for deliveries. If another process created
+   it in between, fall back on append. The add is retried once if the
+   record disappeared before the append.
+ */
+static enum mapistore_error notification_memcached_append(struct mapistore_notification_context *self,
+							  const char *key, const uint8_t *value,
+							  size_t length)
+{
+	memcached_return	rc = MEMCACHED_NOTSTORED;
+	int			i;
+
+	for (i = 0; i < 2 && rc == MEMCACHED_NOTSTORED; i++) {
+		rc = memcached_add(MEMC(self), key, strlen(key), (const char *)value, length, 0, 0);
+		if (rc != MEMCACHED_NOTSTORED && rc != MEMCACHED_DATA_EXISTS) break;
+
+		rc = memcached_append(MEMC(self), key, strlen(key), (const char *)value, length, 0, 0);
+	}
+
+	return ret_to_mapistore(rc);
+}
+
+static enum mapistore_error notification_memcached_get(TALLOC_CTX *mem_ctx,
+						       struct mapistore_notification_context *self,
+						       const char *key, uint8_t **valuep,
+						       size_t *lengthp)
+{
+	memcached_return_t	rc;
+	char			*value;
+	size_t			value_len = 0;
+	uint32_t		flags;
+
+	value = memcached_get(MEMC(self), key, strlen(key), &value_len, &flags, &rc);
+	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), NULL);
+
+	*valuep = talloc_memdup(mem_ctx, value, value_len);
+	free(value);
+	MAPISTORE_RETVAL_IF(!*valuep, MAPISTORE_ERR_NO_MEMORY, NULL);
+	*lengthp = value_len;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_memcached_exist(struct mapistore_notification_context *self,
+							 const char *key)
+{
+	return ret_to_mapistore(memcached_exist(MEMC(self), key, strlen(key)));
+}
+
+static enum mapistore_error notification_memcached_del(struct mapistore_notification_context *self,
+						       const char *key)
+{
+	return ret_to_mapistore(memcached_delete(MEMC(self), key, strlen(key), 0));
+}
+
+static int notification_memcached_destructor(struct mapistore_notification_context *self)
+{
+	if (self->data) {
+		oc_memcached_release_connection(MEMC(self), !self->threading);
+	}
+
+	return 0;
+}
+
+/**
+   \details Initialize the memcached notification backend
+
+   \param mem_ctx pointer to the memory context
+   \param lp_ctx loadparm_context to get smb.conf options
+   \param url the memcached configuration string, or NULL for the
+   default server
+   \param _ctx pointer on pointer to the notification context to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_notification_memcached_init(TALLOC_CTX *mem_ctx,
+							   struct loadparm_context *lp_ctx,
+							   const char *url,
+							   struct mapistore_notification_context **_ctx)
+{
+	struct mapistore_notification_context	*ctx;
+
+	ctx = talloc_zero(mem_ctx, struct mapistore_notification_context);
+	MAPISTORE_RETVAL_IF(!ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	ctx->threading = lpcfg_parm_bool(lp_ctx, NULL, "mapistore", "threading", false);
+	ctx->data = oc_memcached_new_connection(url, !ctx->threading);
+	MAPISTORE_RETVAL_IF(!ctx->data, MAPISTORE_ERR_CONTEXT_FAILED, ctx);
+	talloc_set_destructor(ctx, notification_memcached_destructor);
+
+	ctx->add = notification_memcached_add;
+	ctx->set = notification_memcached_set;
+	ctx->append = notification_memcached_append;
+	ctx->get = notification_memcached_get;
+	ctx->exist = notification_memcached_exist;
+	ctx->del = notification_memcached_del;
+	ctx->backend_type = NOTIFICATION_BACKEND_MEMCACHED;
+
+	*_ctx = ctx;
+	return MAPISTORE_SUCCESS;
+}
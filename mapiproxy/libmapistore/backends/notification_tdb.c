@@ -0,0 +1,219 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file notification_tdb.c
+
+   \brief Local notification store for single host deployments
+
+   Records are kept in a TDB database shared by every openchange
+   process of the host. The database is wiped when the first process
+   opens it, the same way memcached content is lost on restart.
+   Robust mutexes are used for locking when the platform supports
+   them. Appending to a record is atomic.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "notification_tdb.h"
+#include "../mapistore_private.h"
+
+#include <tdb.h>
+
+#define	TDB_WRAP(context)	((struct tdb_wrap *)context->data)
+
+static TDB_DATA notification_tdb_key(const char *key)
+{
+	TDB_DATA	k;
+
+	k.dptr = (unsigned char *) key;
+	k.dsize = strlen(key);
+
+	return k;
+}
+
+static enum mapistore_error notification_tdb_error(struct mapistore_notification_context *self)
+{
+	switch (tdb_error(TDB_WRAP(self)->tdb)) {
+	case TDB_SUCCESS:
+		return MAPISTORE_SUCCESS;
+	case TDB_ERR_EXISTS:
+		/* Match memcached behavior for add on existing record */
+		return MAPISTORE_ERROR;
+	case TDB_ERR_NOEXIST:
+		return MAPISTORE_ERR_NOT_FOUND;
+	case TDB_ERR_OOM:
+		return MAPISTORE_ERR_NO_MEMORY;
+	case TDB_ERR_CORRUPT:
+		return MAPISTORE_ERR_CORRUPTED;
+	default:
+		OC_DEBUG(1, "tdb error: %s", tdb_errorstr(TDB_WRAP(self)->tdb));
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+}
+
+static enum mapistore_error notification_tdb_add(struct mapistore_notification_context *self,
+						 const char *key, const uint8_t *value,
+						 size_t length)
+{
+	TDB_DATA	dbuf;
+
+	dbuf.dptr = (unsigned char *) value;
+	dbuf.dsize = length;
+
+	if (tdb_store(TDB_WRAP(self)->tdb, notification_tdb_key(key), dbuf, TDB_INSERT)) {
+		return notification_tdb_error(self);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_tdb_set(struct mapistore_notification_context *self,
+						 const char *key, const uint8_t *value,
+						 size_t length)
+{
+	TDB_DATA	dbuf;
+
+	dbuf.dptr = (unsigned char *) value;
+	dbuf.dsize = length;
+
+	if (tdb_store(TDB_WRAP(self)->tdb, notification_tdb_key(key), dbuf, TDB_REPLACE)) {
+		return notification_tdb_error(self);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_tdb_append(struct mapistore_notification_context *self,
+						    const char *key, const uint8_t *value,
+						    size_t length)
+{
+	TDB_DATA	dbuf;
+
+	dbuf.dptr = (unsigned char *) value;
+	dbuf.dsize = length;
+
+	/* tdb_append creates the record if needed under the chain lock */
+	if (tdb_append(TDB_WRAP(self)->tdb, notification_tdb_key(key), dbuf)) {
+		return notification_tdb_error(self);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_tdb_get(TALLOC_CTX *mem_ctx,
+						 struct mapistore_notification_context *self,
+						 const char *key, uint8_t **valuep,
+						 size_t *lengthp)
+{
+	TDB_DATA	dbuf;
+
+	dbuf = tdb_fetch(TDB_WRAP(self)->tdb, notification_tdb_key(key));
+	MAPISTORE_RETVAL_IF(!dbuf.dptr, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	*valuep = talloc_memdup(mem_ctx, dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+	MAPISTORE_RETVAL_IF(!*valuep, MAPISTORE_ERR_NO_MEMORY, NULL);
+	*lengthp = dbuf.dsize;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_tdb_exist(struct mapistore_notification_context *self,
+						   const char *key)
+{
+	if (!tdb_exists(TDB_WRAP(self)->tdb, notification_tdb_key(key))) {
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error notification_tdb_del(struct mapistore_notification_context *self,
+						 const char *key)
+{
+	if (tdb_delete(TDB_WRAP(self)->tdb, notification_tdb_key(key))) {
+		return notification_tdb_error(self);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Initialize the TDB notification backend
+
+   \param mem_ctx pointer to the memory context
+   \param lp_ctx loadparm_context to get smb.conf options
+   \param url the notification store URL (tdb:///path/to/file.tdb). If
+   the path is empty, the database is created in the private directory
+   \param _ctx pointer on pointer to the notification context to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_notification_tdb_init(TALLOC_CTX *mem_ctx,
+						     struct loadparm_context *lp_ctx,
+						     const char *url,
+						     struct mapistore_notification_context **_ctx)
+{
+	struct mapistore_notification_context	*ctx;
+	const char				*path;
+	int					tdb_flags = TDB_CLEAR_IF_FIRST;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!url, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(strncmp(url, NOTIFICATION_BACKEND_TDB, strlen(NOTIFICATION_BACKEND_TDB)),
+			    MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	ctx = talloc_zero(mem_ctx, struct mapistore_notification_context);
+	MAPISTORE_RETVAL_IF(!ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	path = url + strlen(NOTIFICATION_BACKEND_TDB);
+	if (!*path) {
+		path = talloc_asprintf(ctx, "%s/%s", lpcfg_private_dir(lp_ctx), NOTIFICATION_TDB_DEFAULT);
+		MAPISTORE_RETVAL_IF(!path, MAPISTORE_ERR_NO_MEMORY, ctx);
+	}
+
+#ifdef TDB_MUTEX_LOCKING
+	if (tdb_runtime_check_for_robust_mutexes()) {
+		tdb_flags |= TDB_MUTEX_LOCKING | TDB_INCOMPATIBLE_HASH;
+	}
+#endif
+
+	ctx->data = mapistore_tdb_wrap_open(ctx, path, 0, tdb_flags, O_RDWR|O_CREAT, 0600);
+	if (!ctx->data) {
+		OC_DEBUG(0, "Unable to open notification database '%s'", path);
+		talloc_free(ctx);
+		return MAPISTORE_ERR_CONTEXT_FAILED;
+	}
+
+	ctx->add = notification_tdb_add;
+	ctx->set = notification_tdb_set;
+	ctx->append = notification_tdb_append;
+	ctx->get = notification_tdb_get;
+	ctx->exist = notification_tdb_exist;
+	ctx->del = notification_tdb_del;
+	ctx->backend_type = NOTIFICATION_BACKEND_TDB;
+
+	*_ctx = ctx;
+	return MAPISTORE_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NOTIFICATION_TDB_H_
+#define __NOTIFICATION_TDB_H_
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+
+#define	NOTIFICATION_BACKEND_TDB	"tdb://"
+#define	NOTIFICATION_TDB_DEFAULT	"notification.tdb"
+
+#ifndef __BEGIN_DECLS
+#ifdef __cplusplus
+#define __BEGIN_DECLS		extern "C" {
+#define __END_DECLS		}
+#else
+#define __BEGIN_DECLS
+#define __END_DECLS
+#endif
+#endif
+
+__BEGIN_DECLS
+enum mapistore_error mapistore_notification_tdb_init(TALLOC_CTX *, struct loadparm_context *, const char *, struct mapistore_notification_context **);
+__END_DECLS
+
+#endif /* __NOTIFICATION_TDB_H_ */
@@ -54,6 +54,9 @@
 
 /* forward declarations */
 struct mapistore_mgmt_notif;
+struct indexing_cache;
+struct indexing_fmid_lease;
+struct htable;
 
 typedef	int (*init_backend_fn) (void);
 
@@ -164,6 +167,12 @@ struct indexing_context {
 
 	/* Custom backend cache */
 	void *cache;
+
+	/* Per-process URI <-> FMID cache */
+	struct indexing_cache *lru;
+
+	/* FMIDs reserved ahead by this process */
+	struct indexing_fmid_lease *lease;
 };
 
 struct mapistore_backend {
@@ -263,14 +272,23 @@ struct backend_context_list {
 struct processing_context;
 
 struct mapistore_notification_context {
-	memcached_st				*memc_ctx;
+	enum mapistore_error (*add)(struct mapistore_notification_context *, const char *, const uint8_t *, size_t);
+	enum mapistore_error (*set)(struct mapistore_notification_context *, const char *, const uint8_t *, size_t);
+	enum mapistore_error (*append)(struct mapistore_notification_context *, const char *, const uint8_t *, size_t);
+	enum mapistore_error (*get)(TALLOC_CTX *, struct mapistore_notification_context *, const char *, uint8_t **, size_t *);
+	enum mapistore_error (*exist)(struct mapistore_notification_context *, const char *);
+	enum mapistore_error (*del)(struct mapistore_notification_context *, const char *);
+
+	const char				*backend_type;
 	bool					threading;
+	void					*data;
 };
 
 struct mapistore_context {
 	struct processing_context		*processing_ctx;
 	struct backend_context_list		*context_list;
 	struct indexing_context_list		*indexing_list;
+	struct htable				*indexing_table;
 	struct replica_mapping_context_list	*replica_mapping_list;
 	struct mapistore_subscription_list	*subscriptions;
 	struct mapistore_notification_list	*notifications;
@@ -404,9 +422,11 @@ struct namedprops_context;
 
 /* definitions from mapistore_namedprops.c */
 enum mapistore_error mapistore_namedprops_get_mapped_id(struct namedprops_context *, struct MAPINAMEID, uint16_t *);
+enum mapistore_error mapistore_namedprops_get_mapped_ids(struct namedprops_context *, uint16_t, const struct MAPINAMEID *, uint16_t *);
 enum mapistore_error mapistore_namedprops_next_unused_id(struct namedprops_context *, uint16_t *);
 enum mapistore_error mapistore_namedprops_create_id(struct namedprops_context *, struct MAPINAMEID, uint16_t);
 enum mapistore_error mapistore_namedprops_get_nameid(struct namedprops_context *, uint16_t, TALLOC_CTX *mem_ctx, struct MAPINAMEID **);
+enum mapistore_error mapistore_namedprops_get_nameids(struct namedprops_context *, uint16_t, const uint16_t *, TALLOC_CTX *, struct MAPINAMEID *);
 enum mapistore_error mapistore_namedprops_get_nameid_type(struct namedprops_context *, uint16_t, uint16_t *);
 enum mapistore_error mapistore_namedprops_transaction_start(struct namedprops_context *);
 enum mapistore_error mapistore_namedprops_transaction_commit(struct namedprops_context *);
@@ -32,6 +32,7 @@
 #include "mapistore_errors.h"
 #include "mapistore_private.h"
 #include "utils/dlinklist.h"
+#include "mapiproxy/util/oc_rop_stats.h"
 
 
 /**
@@ -530,7 +531,8 @@ enum mapistore_error mapistore_backend_get_path(struct backend_context *bctx, TA
 	enum mapistore_error	ret;
 	char			*bpath = NULL;
 
-	ret = bctx->backend->context.get_path(bctx->backend_object, mem_ctx, fmid, &bpath);
+	OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_MAPISTORE,
+				  ret = bctx->backend->context.get_path(bctx->backend_object, mem_ctx, fmid, &bpath));
 
 	if (ret == MAPISTORE_SUCCESS) {
 		if (!bpath) {
@@ -549,59 +551,59 @@ enum mapistore_error mapistore_backend_get_path(struct backend_context *bctx, TA
 
 enum mapistore_error mapistore_backend_folder_open_folder(struct backend_context *bctx, void *folder, TALLOC_CTX *mem_ctx, uint64_t fid, void **child_folder)
 {
-	return bctx->backend->folder.open_folder(folder, mem_ctx, fid, child_folder);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.open_folder(folder, mem_ctx, fid, child_folder));
 }
 
 enum mapistore_error mapistore_backend_folder_create_folder(struct backend_context *bctx, void *folder,
 					   TALLOC_CTX *mem_ctx, uint64_t fid, struct SRow *aRow, void **child_folder)
 {
-	return bctx->backend->folder.create_folder(folder, mem_ctx, fid, aRow, child_folder);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.create_folder(folder, mem_ctx, fid, aRow, child_folder));
 }
 
 enum mapistore_error mapistore_backend_folder_delete(struct backend_context *bctx, void *folder)
 {
-	return bctx->backend->folder.delete(folder);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.delete(folder));
 }
 
 enum mapistore_error mapistore_backend_folder_open_message(struct backend_context *bctx, void *folder,
 					  TALLOC_CTX *mem_ctx, uint64_t mid, bool read_write, void **messagep)
 {
-	return bctx->backend->folder.open_message(folder, mem_ctx, mid, read_write, messagep);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.open_message(folder, mem_ctx, mid, read_write, messagep));
 }
 
 enum mapistore_error mapistore_backend_folder_create_message(struct backend_context *bctx, void *folder, TALLOC_CTX *mem_ctx, uint64_t mid, uint8_t associated, void **messagep)
 {
-	return bctx->backend->folder.create_message(folder, mem_ctx, mid, associated, messagep);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.create_message(folder, mem_ctx, mid, associated, messagep));
 }
 
 enum mapistore_error mapistore_backend_folder_delete_message(struct backend_context *bctx, void *folder, uint64_t mid, uint8_t flags)
 {
-        return bctx->backend->folder.delete_message(folder, mid, flags);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.delete_message(folder, mid, flags));
 }
 
 enum mapistore_error mapistore_backend_folder_move_copy_messages(struct backend_context *bctx, void *target_folder, void *source_folder, TALLOC_CTX *mem_ctx, uint32_t mid_count, uint64_t *source_mids, uint64_t *target_mids, struct Binary_r **target_change_keys, struct Binary_r **target_predecessor_change_lists, uint8_t want_copy)
 {
-	return bctx->backend->folder.move_copy_messages(target_folder, source_folder, mem_ctx, mid_count, source_mids, target_mids, target_change_keys, target_predecessor_change_lists, want_copy);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.move_copy_messages(target_folder, source_folder, mem_ctx, mid_count, source_mids, target_mids, target_change_keys, target_predecessor_change_lists, want_copy));
 }
 
 enum mapistore_error mapistore_backend_folder_move_folder(struct backend_context *bctx, void *move_folder, void *target_folder, TALLOC_CTX *mem_ctx, const char *new_folder_name)
 {
-        return bctx->backend->folder.move_folder(move_folder, target_folder, mem_ctx, new_folder_name);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.move_folder(move_folder, target_folder, mem_ctx, new_folder_name));
 }
 
 enum mapistore_error mapistore_backend_folder_copy_folder(struct backend_context *bctx, void *move_folder, void *target_folder, TALLOC_CTX *mem_ctx, bool recursive, const char *new_folder_name)
 {
-        return bctx->backend->folder.copy_folder(move_folder, target_folder, mem_ctx, recursive, new_folder_name);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.copy_folder(move_folder, target_folder, mem_ctx, recursive, new_folder_name));
 }
 
 enum mapistore_error mapistore_backend_folder_get_deleted_fmids(struct backend_context *bctx, void *folder, TALLOC_CTX *mem_ctx, enum mapistore_table_type table_type, uint64_t change_num, struct UI8Array_r **fmidsp, uint64_t *cnp)
 {
-        return bctx->backend->folder.get_deleted_fmids(folder, mem_ctx, table_type, change_num, fmidsp, cnp);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.get_deleted_fmids(folder, mem_ctx, table_type, change_num, fmidsp, cnp));
 }
 
 enum mapistore_error mapistore_backend_folder_get_child_count(struct backend_context *bctx, void *folder, enum mapistore_table_type table_type, uint32_t *RowCount)
 {
-	return bctx->backend->folder.get_child_count(folder, table_type, RowCount);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.get_child_count(folder, table_type, RowCount));
 }
 
 enum mapistore_error mapistore_backend_folder_get_child_fid_by_name(struct backend_context *bctx, void *folder, const char *name, uint64_t *fidp)
@@ -649,110 +651,110 @@ enum mapistore_error mapistore_backend_folder_get_child_fid_by_name(struct backe
 enum mapistore_error mapistore_backend_folder_open_table(struct backend_context *bctx, void *folder,
 							 TALLOC_CTX *mem_ctx, enum mapistore_table_type table_type, uint32_t handle_id, void **table, uint32_t *row_count)
 {
-        return bctx->backend->folder.open_table(folder, mem_ctx, table_type, handle_id, table, row_count);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.open_table(folder, mem_ctx, table_type, handle_id, table, row_count));
 }
 
 enum mapistore_error mapistore_backend_folder_modify_permissions(struct backend_context *bctx, void *folder,
 						uint8_t flags, uint16_t pcount, struct PermissionData *permissions)
 {
-        return bctx->backend->folder.modify_permissions(folder, flags, pcount, permissions);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.modify_permissions(folder, flags, pcount, permissions));
 }
 
 enum mapistore_error mapistore_backend_folder_preload_message_bodies(struct backend_context *bctx, void *folder, enum mapistore_table_type table_type, const struct UI8Array_r *mids)
 {
-        return bctx->backend->folder.preload_message_bodies(folder, table_type, mids);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->folder.preload_message_bodies(folder, table_type, mids));
 }
 
 enum mapistore_error mapistore_backend_message_get_message_data(struct backend_context *bctx, void *message, TALLOC_CTX *mem_ctx, struct mapistore_message **msg)
 {
-	return bctx->backend->message.get_message_data(message, mem_ctx, msg);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.get_message_data(message, mem_ctx, msg));
 }
 
 enum mapistore_error mapistore_backend_message_modify_recipients(struct backend_context *bctx, void *message, struct SPropTagArray *columns, uint16_t count, struct mapistore_message_recipient *recipients)
 {
-	return bctx->backend->message.modify_recipients(message, columns, count, recipients);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.modify_recipients(message, columns, count, recipients));
 }
 
 enum mapistore_error mapistore_backend_message_set_read_flag(struct backend_context *bctx, void *message, uint8_t flag)
 {
-	return bctx->backend->message.set_read_flag(message, flag);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.set_read_flag(message, flag));
 }
 
 enum mapistore_error mapistore_backend_message_save(struct backend_context *bctx, void *message, TALLOC_CTX *mem_ctx)
 {
-	return bctx->backend->message.save(message, mem_ctx);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.save(message, mem_ctx));
 }
 
 enum mapistore_error mapistore_backend_message_submit(struct backend_context *bctx, void *message, enum SubmitFlags flags)
 {
-	return bctx->backend->message.submit(message, flags);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.submit(message, flags));
 }
 
 enum mapistore_error mapistore_backend_message_open_attachment(struct backend_context *bctx, void *message, TALLOC_CTX *mem_ctx, uint32_t aid, void **attachment)
 {
-        return bctx->backend->message.open_attachment(message, mem_ctx, aid, attachment);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.open_attachment(message, mem_ctx, aid, attachment));
 }
 
 enum mapistore_error mapistore_backend_message_create_attachment(struct backend_context *bctx, void *message, TALLOC_CTX *mem_ctx, void **attachment, uint32_t *aid)
 {
-        return bctx->backend->message.create_attachment(message, mem_ctx, attachment, aid);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.create_attachment(message, mem_ctx, attachment, aid));
 }
 
 enum mapistore_error mapistore_backend_message_get_attachment_table(struct backend_context *bctx, void *message, TALLOC_CTX *mem_ctx, void **table, uint32_t *row_count)
 {
-        return bctx->backend->message.get_attachment_table(message, mem_ctx, table, row_count);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.get_attachment_table(message, mem_ctx, table, row_count));
 }
 
 enum mapistore_error mapistore_backend_message_attachment_open_embedded_message(struct backend_context *bctx, void *attachment, TALLOC_CTX *mem_ctx, void **embedded_message, uint64_t *mid, struct mapistore_message **msg)
 {
-        return bctx->backend->message.open_embedded_message(attachment, mem_ctx, embedded_message, mid, msg);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.open_embedded_message(attachment, mem_ctx, embedded_message, mid, msg));
 }
 
 enum mapistore_error mapistore_backend_message_attachment_create_embedded_message(struct backend_context *bctx, void *attachment, TALLOC_CTX *mem_ctx, void **embedded_message, struct mapistore_message **msg)
 {
-        return bctx->backend->message.create_embedded_message(attachment, mem_ctx, embedded_message, msg);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->message.create_embedded_message(attachment, mem_ctx, embedded_message, msg));
 }
 
 enum mapistore_error mapistore_backend_table_get_available_properties(struct backend_context *bctx, void *table, TALLOC_CTX *mem_ctx, struct SPropTagArray **propertiesp)
 {
-        return bctx->backend->table.get_available_properties(table, mem_ctx, propertiesp);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.get_available_properties(table, mem_ctx, propertiesp));
 }
 
 enum mapistore_error mapistore_backend_table_set_columns(struct backend_context *bctx, void *table, uint16_t count, enum MAPITAGS *properties)
 {
-        return bctx->backend->table.set_columns(table, count, properties);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.set_columns(table, count, properties));
 }
 
 enum mapistore_error mapistore_backend_table_set_restrictions(struct backend_context *bctx, void *table, struct mapi_SRestriction *restrictions, uint8_t *table_status)
 {
-        return bctx->backend->table.set_restrictions(table, restrictions, table_status);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.set_restrictions(table, restrictions, table_status));
 }
 
 enum mapistore_error mapistore_backend_table_set_sort_order(struct backend_context *bctx, void *table, struct SSortOrderSet *sort_order, uint8_t *table_status)
 {
-        return bctx->backend->table.set_sort_order(table, sort_order, table_status);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.set_sort_order(table, sort_order, table_status));
 }
 
 enum mapistore_error mapistore_backend_table_get_row(struct backend_context *bctx, void *table, TALLOC_CTX *mem_ctx,
 						     enum mapistore_query_type query_type, uint32_t rowid,
 						     struct mapistore_property_data **data)
 {
-        return bctx->backend->table.get_row(table, mem_ctx, query_type, rowid, data);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.get_row(table, mem_ctx, query_type, rowid, data));
 }
 
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *bctx, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
-        return bctx->backend->table.get_row_count(table, query_type, row_countp);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.get_row_count(table, query_type, row_countp));
 }
 
 enum mapistore_error mapistore_backend_table_handle_destructor(struct backend_context *bctx, void *table, uint32_t handle_id)
 {
-        return bctx->backend->table.handle_destructor(table, handle_id);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->table.handle_destructor(table, handle_id));
 }
 
 enum mapistore_error mapistore_backend_properties_get_available_properties(struct backend_context *bctx, void *object, TALLOC_CTX *mem_ctx, struct SPropTagArray **propertiesp)
 {
-        return bctx->backend->properties.get_available_properties(object, mem_ctx, propertiesp);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->properties.get_available_properties(object, mem_ctx, propertiesp));
 }
 
 enum mapistore_error mapistore_backend_properties_get_properties(struct backend_context *bctx,
@@ -761,17 +763,17 @@ enum mapistore_error mapistore_backend_properties_get_properties(struct backend_
 						*properties,
 						struct mapistore_property_data *data)
 {
-        return bctx->backend->properties.get_properties(object, mem_ctx, count, properties, data);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->properties.get_properties(object, mem_ctx, count, properties, data));
 }
 
 enum mapistore_error mapistore_backend_properties_set_properties(struct backend_context *bctx, void *object, struct SRow *aRow)
 {
-        return bctx->backend->properties.set_properties(object, aRow);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->properties.set_properties(object, aRow));
 }
 
 enum mapistore_error mapistore_backend_manager_generate_uri(struct backend_context *bctx, TALLOC_CTX *mem_ctx, 
 					   const char *username, const char *folder, 
 					   const char *message, const char *root_uri, char **uri)
 {
-	return bctx->backend->manager.generate_uri(mem_ctx, username, folder, message, root_uri, uri);
+	OC_ROP_STATS_MAPISTORE_RETURN(bctx->backend->manager.generate_uri(mem_ctx, username, folder, message, root_uri, uri));
 }
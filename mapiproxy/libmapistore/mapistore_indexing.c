@@ -35,6 +35,8 @@
 #include "backends/indexing_tdb.h"
 #include "backends/indexing_mysql.h"
 #include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
 
 
 char *default_indexing_url = NULL;
@@ -85,13 +87,31 @@ _PUBLIC_ char *mapistore_get_default_cache_url(void)
 	return default_cache_url;
 }
 
+/* Rehash function for the indexing contexts table */
+static size_t _ht_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct indexing_context_list *)e)->ctx->url);
+}
+
+/* Comparison function to get items from the indexing contexts table */
+static bool _ht_cmp(const void *e, void *username)
+{
+	return !strcmp(((const struct indexing_context_list *)e)->ctx->url, (const char *)username);
+}
+
+static int mapistore_indexing_table_destructor(struct htable *ht)
+{
+	htable_clear(ht);
+	return 0;
+}
+
 /**
    \details Search the indexing record matching the username
 
    \param mstore_ctx pointer to the mapistore context
    \param username the username to lookup
 
-   \return pointer to the tdb_wrap structure on success, otherwise NULL
+   \return pointer to the indexing context on success, otherwise NULL
  */
 struct indexing_context *mapistore_indexing_search(struct mapistore_context *mstore_ctx,
 						   const char *username)
@@ -100,14 +120,13 @@ struct indexing_context *mapistore_indexing_search(struct mapistore_context *mst
 
 	/* Sanity checks */
 	if (!mstore_ctx) return NULL;
-	if (!mstore_ctx->indexing_list) return NULL;
+	if (!mstore_ctx->indexing_table) return NULL;
 	if (!username) return NULL;
 
-	for (el = mstore_ctx->indexing_list; el; el = el->next) {
-		/* TODO: extract url from backend mapping, by the moment we use the username */
-		if (el && el->ctx && !strcmp(el->ctx->url, username)) {
-			return el->ctx;
-		}
+	/* TODO: extract url from backend mapping, by the moment we use the username */
+	el = htable_get(mstore_ctx->indexing_table, hash_string(username), _ht_cmp, username);
+	if (el) {
+		return el->ctx;
 	}
 
 	return NULL;
@@ -129,6 +148,7 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	struct indexing_context_list	*ictx;
 	const char			*indexing_url;
 	enum MAPISTATUS			retval;
+	enum mapistore_error		ret;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -147,15 +167,32 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	// indexing_url NULL means to use the default backend: tdb
 	if (indexing_url == NULL) {
 		ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
-		mapistore_indexing_tdb_init(mstore_ctx, username, &ictx->ctx);
+		MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NO_MEMORY, NULL);
+		ret = mapistore_indexing_tdb_init(mstore_ctx, username, &ictx->ctx);
 	} else if (strncmp(indexing_url, "mysql://", strlen("mysql://")) == 0) {
 		ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
-		mapistore_indexing_mysql_init(mstore_ctx, username, indexing_url,
-					      &ictx->ctx);
+		MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NO_MEMORY, NULL);
+		ret = mapistore_indexing_mysql_init(mstore_ctx, username, indexing_url,
+						    &ictx->ctx);
 	} else {
 		OC_DEBUG(0, "ERROR unknown indexing url %s", indexing_url);
 		return MAPISTORE_ERROR;
 	}
+	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, ictx);
+
+	/* Step 2. Register the context so further lookups are O(1) */
+	if (!mstore_ctx->indexing_table) {
+		mstore_ctx->indexing_table = talloc_zero(mstore_ctx, struct htable);
+		MAPISTORE_RETVAL_IF(!mstore_ctx->indexing_table, MAPISTORE_ERR_NO_MEMORY, ictx);
+		htable_init(mstore_ctx->indexing_table, _ht_rehash, NULL);
+		talloc_set_destructor(mstore_ctx->indexing_table, mapistore_indexing_table_destructor);
+	}
+
+	if (!htable_add(mstore_ctx->indexing_table, hash_string(ictx->ctx->url), ictx)) {
+		talloc_free(ictx->ctx);
+		talloc_free(ictx);
+		return MAPISTORE_ERR_NO_MEMORY;
+	}
 
 	/* ictx->ref_count = 0; */
 	DLIST_ADD_END(mstore_ctx->indexing_list, ictx, struct indexing_context_list *);
@@ -0,0 +1,306 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_indexing_cache.c
+
+   \brief Bounded URI <-> FMID LRU cache for indexing backends
+
+   Every indexing backend keeps one of these caches in front of its
+   database. Entries are indexed both by FMID and by URI so lookups in
+   either direction are O(1). Only live (not soft-deleted) records
+   are cached: backends are expected to evict an FMID when it is
+   deleted or when its URI is updated.
+
+   The cache is private to the process: records are only trusted for
+   a limited number of seconds, so changes made by another process
+   are picked up once the record expires.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "mapistore.h"
+#include "mapistore_errors.h"
+#include "mapistore_private.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+static uint32_t default_indexing_cache_size = MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE;
+static uint32_t default_indexing_cache_ttl = MAPISTORE_INDEXING_CACHE_DEFAULT_TTL;
+
+/**
+   \details Set the maximum number of records indexing caches created
+   from now on will hold. A size of 0 disables the cache.
+
+   \param size the maximum number of records
+ */
+_PUBLIC_ void mapistore_set_default_indexing_cache_size(uint32_t size)
+{
+	default_indexing_cache_size = size;
+}
+
+/**
+   \details Set the number of seconds records of indexing caches
+   created from now on are trusted. A TTL of 0 keeps records until
+   they are evicted.
+
+   \param ttl the number of seconds
+ */
+_PUBLIC_ void mapistore_set_default_indexing_cache_ttl(uint32_t ttl)
+{
+	default_indexing_cache_ttl = ttl;
+}
+
+static size_t _fmid_rehash(const void *e, void *unused)
+{
+	return hash(&((const struct indexing_cache_entry *)e)->fmid, 1, 0);
+}
+
+static size_t _uri_rehash(const void *e, void *unused)
+{
+	return ((const struct indexing_cache_entry *)e)->uri_hash;
+}
+
+static bool _fmid_cmp(const void *e, void *fmid)
+{
+	return ((const struct indexing_cache_entry *)e)->fmid == *(uint64_t *)fmid;
+}
+
+static bool _uri_cmp(const void *e, void *uri)
+{
+	return !strcmp(((const struct indexing_cache_entry *)e)->uri, (const char *)uri);
+}
+
+static int mapistore_indexing_cache_destructor(struct indexing_cache *cache)
+{
+	OC_DEBUG(5, "[indexing] cache released: %"PRIu64" hits, %"PRIu64" misses, "
+		 "%"PRIu64" evictions, %u entries", cache->hits, cache->misses,
+		 cache->evictions, cache->count);
+
+	htable_clear(&cache->by_fmid);
+	htable_clear(&cache->by_uri);
+
+	return 0;
+}
+
+/**
+   \details Create a new URI <-> FMID cache
+
+   \param mem_ctx pointer to the memory context
+
+   \return Allocated cache on success, otherwise NULL. NULL is also
+   returned when caching has been disabled with a size of 0.
+ */
+struct indexing_cache *mapistore_indexing_cache_init(TALLOC_CTX *mem_ctx)
+{
+	struct indexing_cache	*cache;
+
+	if (default_indexing_cache_size == 0) {
+		return NULL;
+	}
+
+	cache = talloc_zero(mem_ctx, struct indexing_cache);
+	if (!cache) {
+		return NULL;
+	}
+
+	cache->max_entries = default_indexing_cache_size;
+	cache->ttl = default_indexing_cache_ttl;
+	htable_init(&cache->by_fmid, _fmid_rehash, NULL);
+	htable_init(&cache->by_uri, _uri_rehash, NULL);
+	talloc_set_destructor(cache, mapistore_indexing_cache_destructor);
+
+	return cache;
+}
+
+static void mapistore_indexing_cache_remove(struct indexing_cache *cache,
+					    struct indexing_cache_entry *entry)
+{
+	htable_del(&cache->by_fmid, hash(&entry->fmid, 1, 0), entry);
+	htable_del(&cache->by_uri, entry->uri_hash, entry);
+	DLIST_REMOVE(cache->entries, entry);
+	cache->count--;
+	talloc_free(entry);
+}
+
+/**
+   \details Drop a record which outlived the cache TTL
+
+   \param cache pointer to the indexing cache
+   \param entry the record returned by the lookup, may be NULL
+
+   \return entry if it is still valid, otherwise NULL
+ */
+static struct indexing_cache_entry *mapistore_indexing_cache_check(struct indexing_cache *cache,
+								   struct indexing_cache_entry *entry)
+{
+	if (entry && cache->ttl && entry->expires <= time(NULL)) {
+		mapistore_indexing_cache_remove(cache, entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/**
+   \details Remove the record associated to a FMID from the cache
+
+   \param cache pointer to the indexing cache
+   \param fmid the folder or message identifier to evict
+ */
+void mapistore_indexing_cache_del(struct indexing_cache *cache, uint64_t fmid)
+{
+	struct indexing_cache_entry	*entry;
+
+	if (!cache) return;
+
+	entry = htable_get(&cache->by_fmid, hash(&fmid, 1, 0), _fmid_cmp, &fmid);
+	if (entry) {
+		mapistore_indexing_cache_remove(cache, entry);
+	}
+}
+
+/**
+   \details Add or refresh a URI <-> FMID record. Any previous record
+   using either the FMID or the URI is replaced and the least recently
+   used record is evicted when the cache is full.
+
+   \param cache pointer to the indexing cache
+   \param fmid the folder or message identifier
+   \param uri the mapistore URI as stored by the backend
+ */
+void mapistore_indexing_cache_add(struct indexing_cache *cache, uint64_t fmid, const char *uri)
+{
+	struct indexing_cache_entry	*entry;
+	uint32_t			uri_hash;
+
+	if (!cache || !fmid || !uri) return;
+
+	mapistore_indexing_cache_del(cache, fmid);
+
+	uri_hash = hash_string(uri);
+	entry = htable_get(&cache->by_uri, uri_hash, _uri_cmp, uri);
+	if (entry) {
+		mapistore_indexing_cache_remove(cache, entry);
+	}
+
+	if (cache->count >= cache->max_entries) {
+		mapistore_indexing_cache_remove(cache, DLIST_TAIL(cache->entries));
+		cache->evictions++;
+	}
+
+	entry = talloc_zero(cache, struct indexing_cache_entry);
+	if (!entry) return;
+	entry->uri = talloc_strdup(entry, uri);
+	if (!entry->uri) {
+		talloc_free(entry);
+		return;
+	}
+	entry->fmid = fmid;
+	entry->uri_hash = uri_hash;
+	entry->expires = time(NULL) + cache->ttl;
+
+	if (!htable_add(&cache->by_fmid, hash(&fmid, 1, 0), entry)) {
+		talloc_free(entry);
+		return;
+	}
+	if (!htable_add(&cache->by_uri, uri_hash, entry)) {
+		htable_del(&cache->by_fmid, hash(&fmid, 1, 0), entry);
+		talloc_free(entry);
+		return;
+	}
+	DLIST_ADD(cache->entries, entry);
+	cache->count++;
+}
+
+/**
+   \details Retrieve the URI associated to a FMID
+
+   \param cache pointer to the indexing cache
+   \param mem_ctx pointer to the memory context the URI is allocated in
+   \param fmid the folder or message identifier to look up
+   \param urip pointer on pointer to the returned URI
+
+   \return MAPISTORE_SUCCESS on hit, MAPISTORE_ERR_NOT_FOUND on miss,
+   otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_indexing_cache_get_uri(struct indexing_cache *cache,
+						      TALLOC_CTX *mem_ctx,
+						      uint64_t fmid, char **urip)
+{
+	struct indexing_cache_entry	*entry;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(!urip, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	entry = htable_get(&cache->by_fmid, hash(&fmid, 1, 0), _fmid_cmp, &fmid);
+	entry = mapistore_indexing_cache_check(cache, entry);
+	if (!entry) {
+		cache->misses++;
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	*urip = talloc_strdup(mem_ctx, entry->uri);
+	MAPISTORE_RETVAL_IF(!*urip, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	DLIST_PROMOTE(cache->entries, entry);
+	cache->hits++;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Retrieve the FMID associated to an exact URI
+
+   \param cache pointer to the indexing cache
+   \param uri the mapistore URI to look up
+   \param fmidp pointer to the returned FMID
+
+   \return MAPISTORE_SUCCESS on hit, MAPISTORE_ERR_NOT_FOUND on miss,
+   otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_indexing_cache_get_fmid(struct indexing_cache *cache,
+						       const char *uri, uint64_t *fmidp)
+{
+	struct indexing_cache_entry	*entry;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(!uri, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	entry = htable_get(&cache->by_uri, hash_string(uri), _uri_cmp, uri);
+	entry = mapistore_indexing_cache_check(cache, entry);
+	if (!entry) {
+		cache->misses++;
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	*fmidp = entry->fmid;
+
+	DLIST_PROMOTE(cache->entries, entry);
+	cache->hits++;
+
+	return MAPISTORE_SUCCESS;
+}
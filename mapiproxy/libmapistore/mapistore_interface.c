@@ -92,6 +92,7 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 
 	mstore_ctx->context_list = NULL;
 	mstore_ctx->indexing_list = talloc_zero(mstore_ctx, struct indexing_context_list);
+	mstore_ctx->indexing_table = NULL;
 	mstore_ctx->replica_mapping_list = talloc_zero(mstore_ctx, struct replica_mapping_context_list);
 	mstore_ctx->notifications = NULL;
 	mstore_ctx->subscriptions = NULL;
@@ -100,6 +101,12 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 
 	indexing_url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "indexing_backend");
 	mapistore_set_default_indexing_url(indexing_url);
+	mapistore_set_default_indexing_cache_size(lpcfg_parm_int(lp_ctx, NULL, "mapistore", "indexing_lru_size",
+								 MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE));
+	mapistore_set_default_indexing_cache_ttl(lpcfg_parm_int(lp_ctx, NULL, "mapistore", "indexing_lru_ttl",
+								MAPISTORE_INDEXING_CACHE_DEFAULT_TTL));
+	mapistore_set_default_indexing_lease_size(lpcfg_parm_int(lp_ctx, NULL, "mapistore", "indexing_fmid_lease",
+								 MAPISTORE_INDEXING_LEASE_DEFAULT_SIZE));
 
 	mstore_ctx->nprops_ctx = NULL;
 	retval = mapistore_namedprops_init(mstore_ctx, lp_ctx, &(mstore_ctx->nprops_ctx));
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include "mapistore.h"
+#include "mapistore_private.h"
 
 #include "backends/namedprops_ldb.h"
 #include "backends/namedprops_mysql.h"
@@ -55,7 +56,8 @@ enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *mem_ctx,
 					       struct loadparm_context *lp_ctx,
 					       struct namedprops_context **nprops)
 {
-	const char	*backend;
+	enum mapistore_error	retval;
+	const char		*backend;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
@@ -69,14 +71,97 @@ enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *mem_ctx,
 		backend = NAMEDPROPS_BACKEND_LDB;
 	}
 	if (!strncmp(backend, NAMEDPROPS_BACKEND_LDB, strlen(NAMEDPROPS_BACKEND_LDB))) {
-		return mapistore_namedprops_ldb_init(mem_ctx, lp_ctx, nprops);
+		retval = mapistore_namedprops_ldb_init(mem_ctx, lp_ctx, nprops);
 	} else if (!strncmp(backend, NAMEDPROPS_BACKEND_MYSQL, strlen(NAMEDPROPS_BACKEND_MYSQL))) {
-		return mapistore_namedprops_mysql_init(mem_ctx, lp_ctx, nprops);
+		retval = mapistore_namedprops_mysql_init(mem_ctx, lp_ctx, nprops);
 	} else {
 		oc_log(OC_LOG_ERROR, "Invalid namedproperties backend type '%s'", backend);
+		return MAPISTORE_ERR_INVALID_PARAMETER;
+	}
+	MAPISTORE_RETVAL_IF(retval, retval, NULL);
+
+	/* Warm up the mappings cache, lookups go to the backend without it */
+	(*nprops)->cache = mapistore_namedprops_cache_init(*nprops);
+	if (!(*nprops)->cache) {
+		OC_DEBUG(1, "named properties cache unavailable for %s backend",
+			 (*nprops)->backend_type);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Check the cache against the backend after a miss
+
+   \param nprops pointer to the namedprops context
+
+   \return true if the cache is up to date and its misses can be
+   trusted, false if lookups must go to the backend
+ */
+static bool mapistore_namedprops_cache_trusted(struct namedprops_context *nprops)
+{
+	enum mapistore_error	retval;
+
+	retval = mapistore_namedprops_cache_refresh(nprops->cache, nprops, NULL);
+	if (retval != MAPISTORE_SUCCESS) {
+		OC_DEBUG(3, "named properties cache refresh failed: %s",
+			 mapistore_errstr(retval));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+   \details Copy a cached property name
+
+   \param mem_ctx pointer to the memory context
+   \param entry the cache entry to copy the name from
+   \param nameid pointer to the MAPINAMEID structure to fill
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_namedprops_copy_nameid(TALLOC_CTX *mem_ctx,
+							     const struct namedprops_cache_entry *entry,
+							     struct MAPINAMEID *nameid)
+{
+	*nameid = entry->nameid;
+	if (entry->nameid.ulKind == MNID_STRING) {
+		nameid->kind.lpwstr.NameSize = strlen(entry->nameid.kind.lpwstr.Name) * 2 + 2;
+		nameid->kind.lpwstr.Name = talloc_strdup(mem_ctx, entry->nameid.kind.lpwstr.Name);
+		MAPISTORE_RETVAL_IF(!nameid->kind.lpwstr.Name, MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Look up a mapped id in the cache, checking the backend
+   generation on miss
+
+   \param nprops pointer to the namedprops context
+   \param propID the mapped property ID to look up
+   \param entryp pointer on pointer to the returned cache entry
+
+   \return MAPISTORE_SUCCESS on hit, MAPISTORE_ERR_NOT_FOUND if the ID
+   is not mapped, MAPISTORE_ERR_NOT_INITIALIZED if the backend must be
+   queried instead
+ */
+static enum mapistore_error mapistore_namedprops_cache_lookup_id(struct namedprops_context *nprops,
+								 uint16_t propID,
+								 const struct namedprops_cache_entry **entryp)
+{
+	MAPISTORE_RETVAL_IF(!nprops->cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	*entryp = mapistore_namedprops_cache_get_entry(nprops->cache, propID);
+	if (*entryp) return MAPISTORE_SUCCESS;
+
+	if (!mapistore_namedprops_cache_trusted(nprops)) {
+		return MAPISTORE_ERR_NOT_INITIALIZED;
 	}
 
-	return MAPISTORE_ERR_INVALID_PARAMETER;
+	*entryp = mapistore_namedprops_cache_get_entry(nprops->cache, propID);
+	return *entryp ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 }
 
 
@@ -98,7 +183,12 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_next_unused_id(struct namedpr
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!highest_id, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	retval = nprops->next_unused_id(nprops, &nid);
+	/* The cache knows the highest mapped id once up to date */
+	if (nprops->cache && mapistore_namedprops_cache_trusted(nprops)) {
+		retval = mapistore_namedprops_cache_next_unused_id(nprops->cache, &nid);
+	} else {
+		retval = nprops->next_unused_id(nprops, &nid);
+	}
 	if (retval == MAPISTORE_SUCCESS) {
 		*highest_id = nid;
 		OC_DEBUG(5, "next unused id: 0x%x", *highest_id);
@@ -121,9 +211,16 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_create_id(struct namedprops_c
 							     struct MAPINAMEID nameid,
 							     uint16_t mapped_id)
 {
+	enum mapistore_error	retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 
-	return nprops->create_id(nprops, nameid, mapped_id);
+	retval = nprops->create_id(nprops, nameid, mapped_id);
+	if (retval == MAPISTORE_SUCCESS) {
+		mapistore_namedprops_cache_created(nprops->cache, &nameid, mapped_id);
+	}
+
+	return retval;
 }
 
 /**
@@ -140,12 +237,85 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_mapped_id(struct namedpro
 								 struct MAPINAMEID nameid,
 								 uint16_t *propID)
 {
+	enum mapistore_error	retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!propID, MAPISTORE_ERROR, NULL);
 
+	if (nprops->cache) {
+		retval = mapistore_namedprops_cache_get_mapped_id(nprops->cache, &nameid, propID);
+		MAPISTORE_RETVAL_IF(retval == MAPISTORE_ERR_INVALID_PARAMETER, MAPISTORE_ERROR, NULL);
+		if (retval == MAPISTORE_SUCCESS) return retval;
+
+		if (mapistore_namedprops_cache_trusted(nprops)) {
+			return mapistore_namedprops_cache_get_mapped_id(nprops->cache, &nameid, propID);
+		}
+	}
+
 	return nprops->get_mapped_id(nprops, nameid, propID);
 }
 
+/**
+   \details Return the mapped property IDs matching an array of
+   MAPINAMEID structures. The backend generation is checked at most
+   once, whatever the number of names missing from the cache.
+
+   \param nprops pointer to the namedprops context
+   \param count the number of names to look up
+   \param nameids the array of MAPINAMEID structures to look up
+   \param propIDs array of count property IDs the function fills, with
+   0 for the names with no mapping
+
+   \return MAPISTORE_SUCCESS if all names were found,
+   MAPISTORE_ERR_NOT_FOUND if some were not, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_namedprops_get_mapped_ids(struct namedprops_context *nprops,
+								  uint16_t count,
+								  const struct MAPINAMEID *nameids,
+								  uint16_t *propIDs)
+{
+	enum mapistore_error	retval;
+	uint16_t		missing = 0;
+	bool			trusted = false;
+	uint16_t		i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && (!nameids || !propIDs), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	if (!count) return MAPISTORE_SUCCESS;
+
+	memset(propIDs, 0, count * sizeof (uint16_t));
+
+	if (nprops->cache) {
+		for (i = 0; i < count; i++) {
+			if (mapistore_namedprops_cache_get_mapped_id(nprops->cache, &nameids[i],
+								     &propIDs[i]) != MAPISTORE_SUCCESS) {
+				missing++;
+			}
+		}
+		if (!missing) return MAPISTORE_SUCCESS;
+
+		trusted = mapistore_namedprops_cache_trusted(nprops);
+	}
+
+	missing = 0;
+	for (i = 0; i < count; i++) {
+		if (propIDs[i]) continue;
+
+		if (trusted) {
+			retval = mapistore_namedprops_cache_get_mapped_id(nprops->cache, &nameids[i], &propIDs[i]);
+		} else {
+			retval = nprops->get_mapped_id(nprops, nameids[i], &propIDs[i]);
+		}
+		if (retval != MAPISTORE_SUCCESS) {
+			propIDs[i] = 0;
+			missing++;
+		}
+	}
+
+	return missing ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
+}
+
 /**
    \details return the nameid structture matching the mapped property ID
    passed in parameter.
@@ -161,11 +331,104 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameid(struct namedprops_
 							      TALLOC_CTX *mem_ctx,
 							      struct MAPINAMEID **nameidp)
 {
+	const struct namedprops_cache_entry	*entry;
+	struct MAPINAMEID			*nameid;
+	enum mapistore_error			retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(propID < 0x8000, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!nameidp, MAPISTORE_ERROR, NULL);
 
-	return nprops->get_nameid(nprops, propID, mem_ctx, nameidp);
+	retval = mapistore_namedprops_cache_lookup_id(nprops, propID, &entry);
+	if (retval == MAPISTORE_ERR_NOT_INITIALIZED) {
+		return nprops->get_nameid(nprops, propID, mem_ctx, nameidp);
+	}
+	MAPISTORE_RETVAL_IF(retval, retval, NULL);
+
+	nameid = talloc_zero(mem_ctx, struct MAPINAMEID);
+	MAPISTORE_RETVAL_IF(!nameid, MAPISTORE_ERR_NO_MEMORY, NULL);
+	retval = mapistore_namedprops_copy_nameid(nameid, entry, nameid);
+	MAPISTORE_RETVAL_IF(retval, retval, nameid);
+
+	*nameidp = nameid;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Return the nameid structures matching an array of mapped
+   property IDs. The backend generation is checked at most once,
+   whatever the number of IDs missing from the cache.
+
+   \param nprops pointer to the namedprops context
+   \param count the number of property IDs to look up
+   \param propIDs the array of property IDs to look up
+   \param mem_ctx pointer to the memory context names are allocated in
+   \param nameids array of count MAPINAMEID structures the function
+   fills. Entries of IDs with no mapping, including IDs below 0x8000,
+   get an ulKind of 0xff.
+
+   \return MAPISTORE_SUCCESS if all IDs were found,
+   MAPISTORE_ERR_NOT_FOUND if some were not, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameids(struct namedprops_context *nprops,
+							       uint16_t count,
+							       const uint16_t *propIDs,
+							       TALLOC_CTX *mem_ctx,
+							       struct MAPINAMEID *nameids)
+{
+	const struct namedprops_cache_entry	*entry;
+	struct MAPINAMEID			*nameid;
+	enum mapistore_error			retval;
+	uint16_t				missing = 0;
+	bool					trusted = false;
+	uint16_t				i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && (!propIDs || !nameids), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	for (i = 0; i < count; i++) {
+		nameids[i].ulKind = 0xff;
+		if (propIDs[i] < 0x8000) continue;
+
+		entry = mapistore_namedprops_cache_get_entry(nprops->cache, propIDs[i]);
+		if (!entry) {
+			missing++;
+			continue;
+		}
+		retval = mapistore_namedprops_copy_nameid(mem_ctx, entry, &nameids[i]);
+		MAPISTORE_RETVAL_IF(retval, retval, NULL);
+	}
+	if (!missing) return MAPISTORE_SUCCESS;
+
+	if (nprops->cache) {
+		trusted = mapistore_namedprops_cache_trusted(nprops);
+	}
+
+	missing = 0;
+	for (i = 0; i < count; i++) {
+		if (nameids[i].ulKind != 0xff) continue;
+		if (propIDs[i] < 0x8000) {
+			missing++;
+			continue;
+		}
+
+		if (trusted) {
+			entry = mapistore_namedprops_cache_get_entry(nprops->cache, propIDs[i]);
+			if (entry) {
+				retval = mapistore_namedprops_copy_nameid(mem_ctx, entry, &nameids[i]);
+				MAPISTORE_RETVAL_IF(retval, retval, NULL);
+				continue;
+			}
+		} else if (nprops->get_nameid(nprops, propIDs[i], mem_ctx, &nameid) == MAPISTORE_SUCCESS) {
+			nameids[i] = *nameid;
+			continue;
+		}
+		missing++;
+	}
+
+	return missing ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
 }
 
 /**
@@ -185,7 +448,13 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameid_type(struct namedp
 	MAPISTORE_RETVAL_IF(propID < 0x8000, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!propTypeP, MAPISTORE_ERROR, NULL);
 
-	int ret = nprops->get_nameid_type(nprops, propID, propTypeP);
+	const struct namedprops_cache_entry *entry;
+	int ret = mapistore_namedprops_cache_lookup_id(nprops, propID, &entry);
+	if (ret == MAPISTORE_SUCCESS) {
+		*propTypeP = entry->prop_type;
+	} else if (ret == MAPISTORE_ERR_NOT_INITIALIZED) {
+		ret = nprops->get_nameid_type(nprops, propID, propTypeP);
+	}
 	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
 
 	switch (*propTypeP) {
@@ -307,7 +576,15 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_transaction_start(struct name
 
 _PUBLIC_ enum mapistore_error mapistore_namedprops_transaction_commit(struct namedprops_context *nprops)
 {
+	enum mapistore_error	retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	return nprops->transaction_commit(nprops);
+	retval = nprops->transaction_commit(nprops);
+	if (retval != MAPISTORE_SUCCESS) {
+		/* Mappings created in the transaction may not exist */
+		mapistore_namedprops_cache_invalidate(nprops->cache);
+	}
+
+	return retval;
 }
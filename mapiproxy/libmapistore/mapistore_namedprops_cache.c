@@ -0,0 +1,441 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_namedprops_cache.c
+
+   \brief Process-wide named properties mappings cache
+
+   The cache holds every name <-> mapped id mapping of a named
+   properties database, indexed both by name and by mapped id. It is
+   loaded when the first namedprops context of the process opens the
+   database and shared by the following ones.
+
+   Mappings are never modified nor deleted once created, so cached
+   entries can not become wrong: only misses may be outdated. Backends
+   expose a generation number increased by each mapping creation, and
+   a miss is only trusted once the cache generation has been checked
+   against the backend one. The cache is reloaded when another
+   process created mappings.
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "mapistore.h"
+#include "mapistore_errors.h"
+#include "mapistore_private.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+static struct namedprops_cache *namedprops_caches;
+
+/**
+   \details Hash a property name. Both backends compare string names
+   case insensitively, so does the cache.
+ */
+static uint32_t _nameid_hash(const struct MAPINAMEID *nameid)
+{
+	uint32_t	h;
+	const char	*p;
+
+	h = hash(&nameid->lpguid, 1, nameid->ulKind);
+	if (nameid->ulKind == MNID_ID) {
+		return hash(&nameid->kind.lid, 1, h);
+	}
+
+	for (p = nameid->kind.lpwstr.Name; p && *p; p++) {
+		h = h * 33 + tolower((unsigned char)*p);
+	}
+
+	return hash(&h, 1, 0);
+}
+
+static size_t _name_rehash(const void *e, void *unused)
+{
+	return ((const struct namedprops_cache_entry *)e)->name_hash;
+}
+
+static size_t _id_rehash(const void *e, void *unused)
+{
+	return hash(&((const struct namedprops_cache_entry *)e)->mapped_id, 1, 0);
+}
+
+static bool _name_cmp(const void *e, void *key)
+{
+	const struct MAPINAMEID	*a = &((const struct namedprops_cache_entry *)e)->nameid;
+	const struct MAPINAMEID	*b = (const struct MAPINAMEID *)key;
+
+	if (a->ulKind != b->ulKind) return false;
+	if (memcmp(&a->lpguid, &b->lpguid, sizeof (struct GUID))) return false;
+	if (a->ulKind == MNID_ID) {
+		return a->kind.lid == b->kind.lid;
+	}
+
+	return !strcasecmp(a->kind.lpwstr.Name, b->kind.lpwstr.Name);
+}
+
+static bool _id_cmp(const void *e, void *mapped_id)
+{
+	return ((const struct namedprops_cache_entry *)e)->mapped_id == *(uint16_t *)mapped_id;
+}
+
+static bool _nameid_is_valid(const struct MAPINAMEID *nameid)
+{
+	return nameid->ulKind == MNID_ID ||
+		(nameid->ulKind == MNID_STRING && nameid->kind.lpwstr.Name);
+}
+
+static void mapistore_namedprops_cache_clear(struct namedprops_cache *cache)
+{
+	htable_clear(&cache->by_name);
+	htable_clear(&cache->by_id);
+	talloc_free(cache->entries);
+	cache->entries = talloc_named(cache, 0, "namedprops_cache_entries");
+	cache->count = 0;
+	cache->highest_id = 0;
+}
+
+static int mapistore_namedprops_cache_destructor(struct namedprops_cache *cache)
+{
+	OC_DEBUG(5, "[namedprops] cache released: %"PRIu64" hits, %"PRIu64" misses, "
+		 "%"PRIu64" reloads, %u entries", cache->hits, cache->misses,
+		 cache->reloads, cache->count);
+
+	DLIST_REMOVE(namedprops_caches, cache);
+	htable_clear(&cache->by_name);
+	htable_clear(&cache->by_id);
+
+	return 0;
+}
+
+/**
+   \details Add a mapping to the cache. The first mapping of a name or
+   of a mapped id wins, as with backend lookups.
+
+   \param cache pointer to the named properties cache
+   \param nameid the property name
+   \param mapped_id the mapped property id
+   \param prop_type the property type
+ */
+static void mapistore_namedprops_cache_add(struct namedprops_cache *cache,
+					   const struct MAPINAMEID *nameid,
+					   uint16_t mapped_id, uint16_t prop_type)
+{
+	struct namedprops_cache_entry	*entry;
+	bool				by_name;
+	bool				by_id;
+	uint32_t			name_hash;
+
+	if (!cache || !nameid || !_nameid_is_valid(nameid)) return;
+
+	name_hash = _nameid_hash(nameid);
+	by_name = !htable_get(&cache->by_name, name_hash, _name_cmp, nameid);
+	by_id = !htable_get(&cache->by_id, hash(&mapped_id, 1, 0), _id_cmp, &mapped_id);
+	if (!by_name && !by_id) return;
+
+	entry = talloc_zero(cache->entries, struct namedprops_cache_entry);
+	if (!entry) return;
+	entry->nameid = *nameid;
+	if (nameid->ulKind == MNID_STRING) {
+		entry->nameid.kind.lpwstr.Name = talloc_strdup(entry, nameid->kind.lpwstr.Name);
+		if (!entry->nameid.kind.lpwstr.Name) {
+			talloc_free(entry);
+			return;
+		}
+	}
+	entry->mapped_id = mapped_id;
+	entry->prop_type = prop_type;
+	entry->name_hash = name_hash;
+
+	if (by_name && !htable_add(&cache->by_name, name_hash, entry)) {
+		talloc_free(entry);
+		return;
+	}
+	if (by_id && !htable_add(&cache->by_id, hash(&mapped_id, 1, 0), entry)) {
+		if (by_name) {
+			htable_del(&cache->by_name, name_hash, entry);
+		}
+		talloc_free(entry);
+		return;
+	}
+
+	if (mapped_id > cache->highest_id) {
+		cache->highest_id = mapped_id;
+	}
+	cache->count++;
+}
+
+/**
+   \details Load all the mappings of the backend into the cache
+
+   \param cache pointer to the named properties cache
+   \param nprops pointer to the namedprops context to load from
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_namedprops_cache_load(struct namedprops_cache *cache,
+							    struct namedprops_context *nprops)
+{
+	enum mapistore_error		retval;
+	TALLOC_CTX			*mem_ctx;
+	struct namedprops_mapping	*mappings = NULL;
+	uint32_t			count = 0;
+	uint64_t			generation;
+	uint32_t			i;
+
+	/* Read the generation first: mappings created meanwhile are
+	   picked up by the next reload */
+	retval = nprops->get_generation(nprops, &generation);
+	MAPISTORE_RETVAL_IF(retval, retval, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "mapistore_namedprops_cache_load");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	retval = nprops->list_mappings(nprops, mem_ctx, &mappings, &count);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
+
+	mapistore_namedprops_cache_clear(cache);
+	for (i = 0; i < count; i++) {
+		mapistore_namedprops_cache_add(cache, mappings[i].nameid,
+					       mappings[i].mapped_id,
+					       mappings[i].prop_type);
+	}
+	talloc_free(mem_ctx);
+
+	cache->generation = generation;
+	cache->created = 0;
+	cache->stale = false;
+	cache->reloads++;
+
+	OC_DEBUG(5, "[namedprops] cache loaded %u mappings at generation %"PRIu64,
+		 cache->count, cache->generation);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Return the named properties cache of the database opened
+   by a namedprops context. The cache is created and loaded if no
+   other context of the process opened the database yet.
+
+   \param nprops pointer to the namedprops context
+
+   \return Referenced cache on success, otherwise NULL. NULL is also
+   returned when the backend can not feed a cache.
+ */
+struct namedprops_cache *mapistore_namedprops_cache_init(struct namedprops_context *nprops)
+{
+	struct namedprops_cache	*cache;
+
+	if (!nprops || !nprops->location || !nprops->list_mappings || !nprops->get_generation) {
+		return NULL;
+	}
+
+	for (cache = namedprops_caches; cache; cache = cache->next) {
+		if (!strcmp(cache->backend_type, nprops->backend_type) &&
+		    !strcmp(cache->location, nprops->location)) {
+			return talloc_reference(nprops, cache);
+		}
+	}
+
+	cache = talloc_zero(nprops, struct namedprops_cache);
+	if (!cache) return NULL;
+
+	cache->backend_type = talloc_strdup(cache, nprops->backend_type);
+	cache->location = talloc_strdup(cache, nprops->location);
+	cache->entries = talloc_named(cache, 0, "namedprops_cache_entries");
+	if (!cache->backend_type || !cache->location || !cache->entries) {
+		talloc_free(cache);
+		return NULL;
+	}
+	htable_init(&cache->by_name, _name_rehash, NULL);
+	htable_init(&cache->by_id, _id_rehash, NULL);
+	DLIST_ADD(namedprops_caches, cache);
+	talloc_set_destructor(cache, mapistore_namedprops_cache_destructor);
+
+	if (mapistore_namedprops_cache_load(cache, nprops) != MAPISTORE_SUCCESS) {
+		talloc_free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/**
+   \details Bring the cache up to date with the backend. Mappings are
+   reloaded unless the backend generation only moved by the mappings
+   created through this cache.
+
+   \param cache pointer to the named properties cache
+   \param nprops pointer to the namedprops context to check against
+   \param reloadedp pointer to the boolean set when the mappings were
+   reloaded, may be NULL
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_namedprops_cache_refresh(struct namedprops_cache *cache,
+							struct namedprops_context *nprops,
+							bool *reloadedp)
+{
+	enum mapistore_error	retval;
+	uint64_t		generation;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (reloadedp) *reloadedp = false;
+
+	if (!cache->stale) {
+		retval = nprops->get_generation(nprops, &generation);
+		MAPISTORE_RETVAL_IF(retval, retval, NULL);
+
+		if (generation == cache->generation) {
+			return MAPISTORE_SUCCESS;
+		}
+		if (generation == cache->generation + cache->created) {
+			cache->generation = generation;
+			cache->created = 0;
+			return MAPISTORE_SUCCESS;
+		}
+	}
+
+	retval = mapistore_namedprops_cache_load(cache, nprops);
+	MAPISTORE_RETVAL_IF(retval, retval, NULL);
+	if (reloadedp) *reloadedp = true;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Force a reload of the cache on next refresh, e.g. after a
+   failed transaction which may have left created mappings behind
+
+   \param cache pointer to the named properties cache
+ */
+void mapistore_namedprops_cache_invalidate(struct namedprops_cache *cache)
+{
+	if (!cache) return;
+
+	cache->stale = true;
+}
+
+/**
+   \details Record a mapping created through the backend. Created
+   mappings have no type yet.
+
+   \param cache pointer to the named properties cache
+   \param nameid the property name
+   \param mapped_id the mapped property id
+ */
+void mapistore_namedprops_cache_created(struct namedprops_cache *cache,
+					const struct MAPINAMEID *nameid,
+					uint16_t mapped_id)
+{
+	if (!cache) return;
+
+	mapistore_namedprops_cache_add(cache, nameid, mapped_id, PT_NULL);
+	cache->created++;
+}
+
+/**
+   \details Return the next unused mapped id
+
+   \param cache pointer to the named properties cache
+   \param mapped_idp pointer to the mapped id to return
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND when
+   the mapped id range is exhausted, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_namedprops_cache_next_unused_id(struct namedprops_cache *cache,
+							       uint16_t *mapped_idp)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!mapped_idp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(cache->highest_id == 0xFFFF, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	*mapped_idp = cache->highest_id + 1;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Retrieve the mapped id of a property name
+
+   \param cache pointer to the named properties cache
+   \param nameid the property name to look up
+   \param mapped_idp pointer to the returned mapped id
+
+   \return MAPISTORE_SUCCESS on hit, MAPISTORE_ERR_NOT_FOUND on miss,
+   otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_namedprops_cache_get_mapped_id(struct namedprops_cache *cache,
+							      const struct MAPINAMEID *nameid,
+							      uint16_t *mapped_idp)
+{
+	struct namedprops_cache_entry	*entry;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(!nameid || !_nameid_is_valid(nameid), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mapped_idp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	entry = htable_get(&cache->by_name, _nameid_hash(nameid), _name_cmp, nameid);
+	if (!entry) {
+		cache->misses++;
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	*mapped_idp = entry->mapped_id;
+	cache->hits++;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Retrieve the property name and type of a mapped id
+
+   \param cache pointer to the named properties cache
+   \param mapped_id the mapped id to look up
+
+   \return the cache entry on hit, otherwise NULL. The entry belongs to
+   the cache and must not be kept across a refresh.
+ */
+const struct namedprops_cache_entry *mapistore_namedprops_cache_get_entry(struct namedprops_cache *cache,
+									  uint16_t mapped_id)
+{
+	struct namedprops_cache_entry	*entry;
+
+	if (!cache) return NULL;
+
+	entry = htable_get(&cache->by_id, hash(&mapped_id, 1, 0), _id_cmp, &mapped_id);
+	if (!entry) {
+		cache->misses++;
+		return NULL;
+	}
+	cache->hits++;
+
+	return entry;
+}
@@ -21,62 +21,8 @@
 
 #include <ctype.h>
 #include "mapiproxy/libmapistore/mapistore_notification.h"
-#include "mapiproxy/util/oc_memcached.h"
-
-/**
-   \details Map memcached to mapistore error mapping
-
-   \param rc memcached_return error
-
-   \return matching MAPISTORE error
- */
-static enum mapistore_error ret_to_mapistore(memcached_return rc)
-{
-	switch (rc) {
-	case MEMCACHED_SUCCESS:
-	case MEMCACHED_STORED:
-		return MAPISTORE_SUCCESS;
-	case MEMCACHED_FAILURE:
-	case MEMCACHED_NOTSTORED:
-		return MAPISTORE_ERROR;
-	case MEMCACHED_HOST_LOOKUP_FAILURE:
-	case MEMCACHED_CONNECTION_FAILURE:
-		return MAPISTORE_ERR_CONN_REFUSED;
-	case MEMCACHED_WRITE_FAILURE:
-	case MEMCACHED_READ_FAILURE:
-	case MEMCACHED_UNKNOWN_READ_FAILURE:
-		return MAPISTORE_ERR_INVALID_DATA;
-	case MEMCACHED_NOTFOUND:
-		return MAPISTORE_ERR_NOT_FOUND;
-	case MEMCACHED_ERROR:
-		return MAPISTORE_ERROR;
-	case MEMCACHED_DATA_EXISTS:
-		return MAPISTORE_ERR_EXIST;
-	default:
-		oc_log(OC_LOG_WARNING, "memcached return valud %d (%s) is not mapped", rc, memcached_strerror(NULL, rc));
-		return MAPISTORE_ERROR;
-	};
-}
-
-/**
-   \details Release the notification context used by mapistore
-   notification subsystem
-
-   \param data pointer on data to destroy
-
-   \return 0 on success, otherwise -1
- */
-static int mapistore_notification_destructor(void *data)
-{
-	struct mapistore_notification_context	*notification_ctx = (struct mapistore_notification_context *) data;
-
-	if (notification_ctx->memc_ctx) {
-		oc_memcached_release_connection(notification_ctx->memc_ctx,
-						!notification_ctx->threading);
-	}
-
-	return 0;
-}
+#include "mapiproxy/libmapistore/backends/notification_memcached.h"
+#include "mapiproxy/libmapistore/backends/notification_tdb.h"
 
 /**
    \details Initialize notification framework
@@ -85,6 +31,10 @@ static int mapistore_notification_destructor(void *data)
    \param lp_ctx loadparm_context to get smb.conf options
    \param _notification_ctx pointer to the notification context to return
 
+   \note mapistore:notification_cache selects the notification
+   store. URLs starting with tdb:// use a local TDB database, anything
+   else is used as memcached configuration string.
+
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERROR
  */
 
@@ -92,27 +42,18 @@ enum mapistore_error mapistore_notification_init(TALLOC_CTX *mem_ctx,
 						 struct loadparm_context *lp_ctx,
 						 struct mapistore_notification_context **_notification_ctx)
 {
-	struct mapistore_notification_context	*notification_ctx = NULL;
-	const char				*url = NULL;
-	bool					threading = false;
+	const char	*url = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!lp_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!_notification_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	notification_ctx = talloc_zero(mem_ctx, struct mapistore_notification_context);
-	MAPISTORE_RETVAL_IF(!notification_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
-	notification_ctx->memc_ctx = NULL;
-
 	url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "notification_cache");
-	threading = lpcfg_parm_bool(lp_ctx, NULL, "mapistore", "threading", false);
-	notification_ctx->threading = threading;
-	notification_ctx->memc_ctx = oc_memcached_new_connection(url, !threading);
-	MAPISTORE_RETVAL_IF(!notification_ctx->memc_ctx, MAPISTORE_ERR_CONTEXT_FAILED, NULL);
-	talloc_set_destructor((void *)notification_ctx, (int (*)(void *))mapistore_notification_destructor);
+	if (url && !strncmp(url, NOTIFICATION_BACKEND_TDB, strlen(NOTIFICATION_BACKEND_TDB))) {
+		return mapistore_notification_tdb_init(mem_ctx, lp_ctx, url, _notification_ctx);
+	}
 
-	*_notification_ctx = notification_ctx;
-	return MAPISTORE_SUCCESS;
+	return mapistore_notification_memcached_init(mem_ctx, lp_ctx, url, _notification_ctx);
 }
 
 
@@ -171,12 +112,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_add(struct mapistor
 	struct ndr_push				*ndr;
 	enum ndr_err_code			ndr_err_code;
 	char					*key;
-	memcached_return			rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -198,9 +138,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_add(struct mapistor
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Register the key */
-	rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->add(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -223,12 +162,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_delete(struct mapis
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -238,8 +176,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_delete(struct mapis
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->del(mstore_ctx->notification_ctx, key);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -261,12 +199,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_exist(struct mapist
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -275,9 +212,9 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_exist(struct mapist
 	retval = mapistore_notification_session_set_key(mem_ctx, async_uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	retval = mstore_ctx->notification_ctx->exist(mstore_ctx->notification_ctx, key);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -311,17 +248,13 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_get(TALLOC_CTX *mem
 	struct mapistore_notification_session	r;
 	DATA_BLOB				blob;
 	char					*key = NULL;
-	char					*value = NULL;
-	size_t					value_len = 0;
-	memcached_return_t			rc;
-	uint32_t				flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!uuid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!cnp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	local_mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -330,16 +263,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_get(TALLOC_CTX *mem
 	retval = mapistore_notification_session_set_key(local_mem_ctx, async_uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	retval = mstore_ctx->notification_ctx->get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob.data, &blob.length);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
 	/* Unpack session structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
 
 	ndr = ndr_pull_init_blob(&blob, local_mem_ctx);
 	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
@@ -445,7 +373,6 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 	struct mapistore_notification_resolver	r;
 	struct ndr_push				*ndr;
 	enum ndr_err_code			ndr_err_code;
-	memcached_return			rc = MEMCACHED_ERROR;
 	char					*key = NULL;
 
 	/* Sanity checks */
@@ -453,7 +380,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 	MAPISTORE_RETVAL_IF(!cn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!host, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -499,8 +426,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
 		/* Add the key/value record */
-		rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
+		retval = mstore_ctx->notification_ctx->set(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
 	} else if (retval == MAPISTORE_ERR_NOT_FOUND) {
 		r.vnum = 1;
 		r.v.v1.count = 1;
@@ -513,11 +439,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
 		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
+		retval = mstore_ctx->notification_ctx->add(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
 	}
 
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
@@ -548,10 +473,6 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 	struct mapistore_notification_resolver	r;
 	DATA_BLOB				blob;
 	char					*key = NULL;
-	char					*value = NULL;
-	size_t					value_len = 0;
-	memcached_return_t			rc;
-	uint32_t				flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -559,7 +480,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 	MAPISTORE_RETVAL_IF(!countp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!hostsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	local_mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -567,16 +488,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 	retval = mapistore_notification_resolver_set_key(local_mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	retval = mstore_ctx->notification_ctx->get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob.data, &blob.length);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
 	/* Unpack resolver structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
 
 	ndr = ndr_pull_init_blob(&blob, local_mem_ctx);
 	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
@@ -611,7 +527,6 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapi
 								     const char *cn, const char *host)
 {
 	TALLOC_CTX				*mem_ctx;
-	memcached_return			rc;
 	struct mapistore_notification_resolver	r;
 	enum mapistore_error			retval;
 	enum ndr_err_code			ndr_err_code;
@@ -627,7 +542,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapi
 	MAPISTORE_RETVAL_IF(!cn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!host, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -650,8 +565,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapi
 
 	/* If host is the only entry, delete the record */
 	if (count == 1) {
-		rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-		MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+		retval = mstore_ctx->notification_ctx->del(mstore_ctx->notification_ctx, key);
+		MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 		goto end;
 	}
 
@@ -677,9 +592,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapi
 	ndr_err_code = ndr_push_mapistore_notification_resolver(ndr, NDR_SCALARS, &r);
 	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
-	rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->set(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 end:
 	talloc_free(mem_ctx);
@@ -703,13 +617,12 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_exist(struct mapis
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!cn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -718,9 +631,9 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_exist(struct mapis
 	retval = mapistore_notification_resolver_set_key(mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	retval = mstore_ctx->notification_ctx->exist(mstore_ctx->notification_ctx, key);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -785,16 +698,12 @@ enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *mem_ctx
 	DATA_BLOB					blob;
 	struct mapistore_notification_subscription	r;
 	char						*key;
-	char						*value = NULL;
-	size_t						value_len = 0;
-	memcached_return_t				rc;
-	uint32_t					flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!_r, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	local_mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -803,16 +712,11 @@ enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *mem_ctx
 	retval = mapistore_notification_subscription_set_key(local_mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	retval = mstore_ctx->notification_ctx->get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob.data, &blob.length);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
 	/* Unpack subscription structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
 
 	ndr = ndr_pull_init_blob(&blob, mem_ctx);
 	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
@@ -859,7 +763,6 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 	struct mapistore_notification_subscription	r;
 	struct ndr_push					*ndr;
 	enum ndr_err_code				ndr_err_code;
-	memcached_return				rc = MEMCACHED_ERROR;
 	char						*key = NULL;
 
 
@@ -867,7 +770,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(count && !properties, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -913,8 +816,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
 		/* Add the key/value record */
-		rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *) ndr->data, ndr->offset, 0, 0);
+		retval = mstore_ctx->notification_ctx->set(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
 
 	} else {
 		r.vnum = 1;
@@ -932,11 +834,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
 		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
+		retval = mstore_ctx->notification_ctx->add(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
 	}
 
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 	talloc_free(mem_ctx);
 
 	return MAPISTORE_SUCCESS;
@@ -957,12 +858,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_exist(struct m
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -971,8 +871,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_exist(struct m
 	retval = mapistore_notification_subscription_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->exist(mstore_ctx->notification_ctx, key);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -993,12 +893,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete(struct
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1008,8 +907,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete(struct
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->del(mstore_ctx->notification_ctx, key);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -1031,7 +930,6 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 										   uint32_t handle)
 {
 	TALLOC_CTX					*mem_ctx;
-	memcached_return				rc;
 	struct mapistore_notification_subscription	r, _r;
 	enum mapistore_error				retval;
 	enum ndr_err_code				ndr_err_code;
@@ -1043,7 +941,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1066,8 +964,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 
 	/* If we only have one entry left, delete the record */
 	if (r.v.v1.count == 1) {
-		rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-		MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+		retval = mstore_ctx->notification_ctx->del(mstore_ctx->notification_ctx, key);
+		MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 		goto end;
 	}
 
@@ -1091,9 +989,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 	ndr_err_code = ndr_push_mapistore_notification_subscription(ndr, NDR_SCALARS, &_r);
 	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
 
-	rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->set(mstore_ctx->notification_ctx, key, ndr->data, ndr->offset);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 end:
 	talloc_free(mem_ctx);
@@ -1149,14 +1046,13 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_add(struct mapistor
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	memcached_return	rc;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!payload, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!length, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1165,20 +1061,9 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_add(struct mapistor
 	retval = mapistore_notification_deliver_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* Create deliver v1 blob */
-	retval = mapistore_notification_deliver_exist(mstore_ctx, uuid);
-	if (retval == MAPISTORE_SUCCESS) {
-		/* Update the key/value record */
-		rc = memcached_append(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *) payload, length, 0, 0);
-
-	} else {
-		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)payload, length, 0, 0);
-	}
-
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	/* Create or update the key/value record in a single operation */
+	retval = mstore_ctx->notification_ctx->append(mstore_ctx->notification_ctx, key, payload, length);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 	talloc_free(mem_ctx);
 
 	return MAPISTORE_SUCCESS;
@@ -1198,13 +1083,12 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_exist(struct mapist
 {
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
-	memcached_return	rc;
 	char			*key = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1213,8 +1097,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_exist(struct mapist
 	retval = mapistore_notification_deliver_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->exist(mstore_ctx->notification_ctx, key);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -1239,17 +1123,13 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_get(TALLOC_CTX *mem
 	TALLOC_CTX		*local_mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	char			*value;
-	size_t			value_len = 0;
-	memcached_return_t	rc;
-	uint32_t		flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!payload, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!length, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	local_mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1258,15 +1138,9 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_get(TALLOC_CTX *mem
 	retval = mapistore_notification_deliver_set_key(local_mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	retval = mstore_ctx->notification_ctx->get(mem_ctx, mstore_ctx->notification_ctx, key, payload, length);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
-
-	*payload = talloc_memdup(mem_ctx, value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!payload, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	*length = value_len;
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
 	talloc_free(local_mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -1285,13 +1159,12 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_delete(struct mapis
 {
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
-	memcached_return	rc;
 	char			*key = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
-	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->data, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
 
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
@@ -1301,8 +1174,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_delete(struct mapis
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	retval = mstore_ctx->notification_ctx->del(mstore_ctx->notification_ctx, key);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -22,10 +22,12 @@
 #ifndef	__MAPISTORE_PRIVATE_H__
 #define	__MAPISTORE_PRIVATE_H__
 
+#include <time.h>
 #include <talloc.h>
 #include "backends/namedprops_backend.h"
 #include "utils/dlinklist.h"
 #include "mapiproxy/libmapistore/gen_ndr/mapistore_notification.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
 
 #ifndef	ISDOT
 #define ISDOT(path) ( \
@@ -93,6 +95,83 @@ struct indexing_context_list {
 	struct indexing_context_list	*next;
 };
 
+/**
+   URI <-> FMID LRU cache
+
+   Entries are reachable through both hash tables and are kept in
+   most-recently-used order in the entries list, whose tail is the
+   next eviction candidate.
+ */
+struct indexing_cache_entry {
+	uint64_t			fmid;
+	char				*uri;
+	uint32_t			uri_hash;
+	time_t				expires;
+	struct indexing_cache_entry	*prev;
+	struct indexing_cache_entry	*next;
+};
+
+struct indexing_cache {
+	struct htable			by_fmid;
+	struct htable			by_uri;
+	struct indexing_cache_entry	*entries;
+	uint32_t			count;
+	uint32_t			max_entries;
+	uint32_t			ttl;
+	uint64_t			hits;
+	uint64_t			misses;
+	uint64_t			evictions;
+};
+
+#define	MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE	4096
+#define	MAPISTORE_INDEXING_CACHE_DEFAULT_TTL	30
+
+/**
+   Range of FMIDs reserved in advance by an indexing backend. FMIDs
+   in [next, end) belong to this process and are handed out without
+   querying the database.
+ */
+struct indexing_fmid_lease {
+	char				*username;
+	uint64_t			size;
+	uint64_t			next;
+	uint64_t			end;
+};
+
+#define	MAPISTORE_INDEXING_LEASE_DEFAULT_SIZE	64
+
+/**
+   Process-wide named properties mappings cache
+
+   Entries are reachable by name and by mapped id. Caches are shared
+   by the namedprops contexts opened on the same database and listed
+   in a process-wide list.
+ */
+struct namedprops_cache_entry {
+	struct MAPINAMEID		nameid;
+	uint16_t			mapped_id;
+	uint16_t			prop_type;
+	uint32_t			name_hash;
+};
+
+struct namedprops_cache {
+	const char			*backend_type;
+	const char			*location;
+	TALLOC_CTX			*entries;
+	struct htable			by_name;
+	struct htable			by_id;
+	uint32_t			count;
+	uint16_t			highest_id;
+	uint64_t			generation;
+	uint64_t			created;
+	bool				stale;
+	uint64_t			hits;
+	uint64_t			misses;
+	uint64_t			reloads;
+	struct namedprops_cache		*prev;
+	struct namedprops_cache		*next;
+};
+
 struct replica_mapping_context_list {
 	struct tdb_context		*tdb;
 	char				*username;
@@ -193,6 +272,27 @@ enum mapistore_error mapistore_indexing_record_add(TALLOC_CTX *, struct indexing
 enum mapistore_error mapistore_indexing_record_add_fmid(struct mapistore_context *, uint32_t, const char *, uint64_t, int type);
 enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context *, uint32_t, const char *, uint64_t, uint8_t, int type);
 
+/* definitions from mapistore_indexing_cache.c */
+void mapistore_set_default_indexing_cache_size(uint32_t);
+void mapistore_set_default_indexing_cache_ttl(uint32_t);
+struct indexing_cache *mapistore_indexing_cache_init(TALLOC_CTX *);
+void mapistore_indexing_cache_add(struct indexing_cache *, uint64_t, const char *);
+void mapistore_indexing_cache_del(struct indexing_cache *, uint64_t);
+enum mapistore_error mapistore_indexing_cache_get_uri(struct indexing_cache *, TALLOC_CTX *, uint64_t, char **);
+enum mapistore_error mapistore_indexing_cache_get_fmid(struct indexing_cache *, const char *, uint64_t *);
+
+/* definitions from mapistore_namedprops_cache.c */
+struct namedprops_cache *mapistore_namedprops_cache_init(struct namedprops_context *);
+enum mapistore_error mapistore_namedprops_cache_refresh(struct namedprops_cache *, struct namedprops_context *, bool *);
+void mapistore_namedprops_cache_invalidate(struct namedprops_cache *);
+void mapistore_namedprops_cache_created(struct namedprops_cache *, const struct MAPINAMEID *, uint16_t);
+enum mapistore_error mapistore_namedprops_cache_next_unused_id(struct namedprops_cache *, uint16_t *);
+enum mapistore_error mapistore_namedprops_cache_get_mapped_id(struct namedprops_cache *, const struct MAPINAMEID *, uint16_t *);
+const struct namedprops_cache_entry *mapistore_namedprops_cache_get_entry(struct namedprops_cache *, uint16_t);
+
+/* definitions from backends/indexing_mysql.c */
+void mapistore_set_default_indexing_lease_size(uint32_t);
+
 /* definitions from mapistore_notification.c */
 enum mapistore_error mapistore_notification_init(TALLOC_CTX *, struct loadparm_context *, struct mapistore_notification_context **);
 enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *, struct mapistore_context *, struct GUID, struct mapistore_notification_subscription *);
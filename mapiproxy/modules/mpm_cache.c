@@ -35,6 +35,8 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
+#include <errno.h>
 
 struct mpm_cache *mpm = NULL;
 
@@ -63,6 +65,41 @@ static uint32_t cache_find_call_request_index(uint8_t opnum, struct EcDoRpc_MAPI
 	return -1;
 }
 
+/**
+   \details Dump the cache hit ratio and the number of bytes served
+   from the cache and from the remote server
+ */
+static void cache_dump_stats(void)
+{
+	struct mpm_cache_stats	*stats = &mpm->stats;
+	uint64_t		reads;
+
+	reads = stats->cached_reads + stats->upstream_reads;
+	OC_DEBUG(1, "STATISTIC: hit ratio %.1f%% (%"PRIu64"/%"PRIu64" ReadStream), "
+		 "%"PRIu64" bytes from cache, %"PRIu64" bytes from server, "
+		 "%u syncs (%u failed, %u pending)",
+		 reads ? (100.0 * stats->cached_reads / reads) : 0.0,
+		 stats->cached_reads, reads, stats->cached_bytes, stats->upstream_bytes,
+		 stats->syncs, stats->sync_failures, stats->sync_pending);
+	OC_DEBUG(1, "STATISTIC: store %"PRIu64" bytes, %u deduplicated streams (%"PRIu64" bytes), "
+		 "%u evictions", mpm->store_size, stats->dedup, stats->dedup_bytes, stats->evictions);
+}
+
+
+/**
+   \details Run the store janitor periodically
+ */
+static void cache_janitor_handler(struct tevent_context *ev,
+				  struct tevent_timer *te,
+				  struct timeval current_time,
+				  void *private_data)
+{
+	mpm_cache_store_janitor(mpm);
+
+	mpm->janitor = tevent_add_timer(ev, mpm, timeval_current_ofs(mpm->janitor_interval, 0),
+					cache_janitor_handler, NULL);
+}
+
 /**
    \details Dump time statistic between OpenStream and Release
 
@@ -119,36 +156,136 @@ static void cache_dump_stream_stat(struct mpm_stream *stream)
 	OC_DEBUG(1, "STATISTIC: %-20s %s The difference is %ld seconds %ld microseconds",
 		  stage, name, (long int)sec, (long int)usec);
 	talloc_free(name);
+
+	cache_dump_stats();
+}
+
+
+static int cache_sync_destructor(struct mpm_sync *sync)
+{
+	if (sync->fd != -1) {
+		close(sync->fd);
+	}
+
+	return 0;
+}
+
+static int cache_stream_destructor(struct mpm_stream *stream)
+{
+	/* Let a running synchronization complete without the stream */
+	if (stream->sync) {
+		stream->sync->stream = NULL;
+	}
+	mpm_cache_stream_close(stream);
+
+	return 0;
+}
+
+
+/**
+   \details Complete a synchronization process
+
+   The child process inherits the write end of a pipe: end of file is
+   reported on the read end once it exits. If the synchronized file
+   matches the expected size, it is opened and marked as cached, so
+   next ReadStream calls are served from the cache at the position
+   reached by the client.
+ */
+static void cache_sync_handler(struct tevent_context *ev,
+			       struct tevent_fd *fde,
+			       uint16_t flags,
+			       void *private_data)
+{
+	struct mpm_sync		*sync = talloc_get_type(private_data, struct mpm_sync);
+	struct mpm_stream	*stream = sync->stream;
+	char			buf[64];
+	ssize_t			ret;
+	int			status = 0;
+	struct stat		sb;
+	size_t			offset;
+	bool			success = false;
+
+	ret = read(sync->fd, buf, sizeof (buf));
+	if (ret > 0 || (ret == -1 && (errno == EINTR || errno == EAGAIN))) {
+		return;
+	}
+
+	if (waitpid(sync->pid, &status, 0) == -1) {
+		OC_DEBUG(0, "waitpid: %s", strerror(errno));
+	} else if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		OC_DEBUG(0, "Sync command failed for %s", sync->filename);
+	} else if (stat(sync->filename, &sb) == -1) {
+		OC_DEBUG(0, "stat %s: %s", sync->filename, strerror(errno));
+	} else if (sb.st_size != sync->StreamSize) {
+		OC_DEBUG(0, "Sync'd file size is 0x%x and 0x%x was expected",
+			  (uint32_t)sb.st_size, sync->StreamSize);
+	} else {
+		success = true;
+	}
+
+	mpm->stats.sync_pending--;
+	if (success) {
+		mpm->stats.syncs++;
+	} else {
+		mpm->stats.sync_failures++;
+	}
+
+	if (stream) {
+		stream->sync = NULL;
+		if (success) {
+			offset = stream->offset;
+			mpm_cache_stream_open(mpm, stream);
+			stream->offset = offset;
+			stream->cached = (stream->fp != NULL);
+			if (stream->cached) {
+				mpm_cache_store_add(mpm, stream);
+			}
+		}
+	}
+
+	talloc_free(sync);
 }
 
 
 /**
-   \details
+   \details Start the synchronization process of a stream
 
    1. close the existing FILE *
    2. build complete file path
    3. replace __FILE__ arguments with complete file path
-   4. call execve
-   5. stat the sync'd file
-   6. open the stream again
-   7. mark the file as cached
+   4. fork and call execve
+   5. watch the child process from the event loop
 
+   The stream is served from the remote server until the child process
+   completes.
+
+   \param ev pointer to the event context
    \param stream pointer on the mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_UNSUCCESSFUL
+   or NT_STATUS_NO_MEMORY
  */
-static NTSTATUS cache_exec_sync_cmd(struct mpm_stream *stream)
+static NTSTATUS cache_exec_sync_cmd(struct tevent_context *ev, struct mpm_stream *stream)
 {
-	uint32_t	i;
-	int		ret = 0;
-	char		**args;
-	struct stat	sb;
-	pid_t		pid;
-	int		status;
+	struct mpm_sync		*sync;
+	struct tevent_fd	*fde;
+	uint32_t		i;
+	char			**args;
+	int			fds[2];
+	pid_t			pid;
 
 	mpm_cache_stream_close(stream);
 
+	sync = talloc_zero((TALLOC_CTX *)mpm, struct mpm_sync);
+	NT_STATUS_HAVE_NO_MEMORY(sync);
+	sync->fd = -1;
+	sync->StreamSize = stream->StreamSize;
+	sync->filename = talloc_strdup(sync, stream->filename);
+	talloc_set_destructor(sync, cache_sync_destructor);
+
 	for (i = 0; mpm->sync_cmd[i]; i++);
 
-	args = talloc_array((TALLOC_CTX *)mpm, char *, i + 1);
+	args = talloc_array(sync, char *, i + 1);
 
 	for (i = 0; mpm->sync_cmd[i]; i++){
 		if (strstr(mpm->sync_cmd[i], "__FILE__")) {
@@ -164,37 +301,43 @@ static NTSTATUS cache_exec_sync_cmd(struct mpm_stream *stream)
 	}
 	OC_DEBUG(0, "\n");
 
+	if (pipe(fds) == -1) {
+		OC_DEBUG(0, "pipe: %s", strerror(errno));
+		talloc_free(sync);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
 	switch(pid = fork()) {
 	case -1:
 		OC_DEBUG(0, "Failed to fork\n");
-		break;
+		close(fds[0]);
+		close(fds[1]);
+		talloc_free(sync);
+		return NT_STATUS_UNSUCCESSFUL;
 	case 0:
-		ret = execve(args[0], args, NULL);
-		break;
+		close(fds[0]);
+		execve(args[0], args, NULL);
+		perror("execve: ");
+		_exit(127);
 	default:
-		wait(&status);
+		close(fds[1]);
 		break;
 	}
 	talloc_free(args);
-	if (ret == -1) {
-		perror("execve: ");
-		return NT_STATUS_INVALID_PARAMETER;
-	}
 
-	ret = stat(stream->filename, &sb);
-	if (ret == -1) {
-		perror("stat: ");
-		return NT_STATUS_INVALID_PARAMETER;
-	}
+	sync->pid = pid;
+	sync->fd = fds[0];
+	mpm->stats.sync_pending++;
 
-	if (sb.st_size != stream->StreamSize) {
-		OC_DEBUG(0, "Sync'd file size is 0x%x and 0x%x was expected\n",
-			  (uint32_t)sb.st_size, stream->StreamSize);
-		return NT_STATUS_INVALID_PARAMETER;
+	fde = tevent_add_fd(ev, sync, sync->fd, TEVENT_FD_READ, cache_sync_handler, sync);
+	if (!fde) {
+		/* Fall back on waiting for the child */
+		cache_sync_handler(ev, NULL, 0, sync);
+		return NT_STATUS_OK;
 	}
 
-	mpm_cache_stream_open(mpm, stream);
-	stream->cached = true;
+	sync->stream = stream;
+	stream->sync = sync;
 
 	return NT_STATUS_OK;
 }
@@ -608,8 +751,9 @@ static NTSTATUS cache_pull_OpenStream(struct dcesrv_call_state *dce_call,
 	for (attach = mpm->attachments; attach; attach = attach->next) {
 		if ((mpm_session_cmp(attach->session, dce_call) == true) &&
 		    mapi_request->handles[mapi_req.handle_idx] == attach->handle) {
-			stream = talloc((TALLOC_CTX *)mpm, struct mpm_stream);
+			stream = talloc_zero((TALLOC_CTX *)mpm, struct mpm_stream);
 			NT_STATUS_HAVE_NO_MEMORY(stream);
+			talloc_set_destructor(stream, cache_stream_destructor);
 
 			stream->session = mpm_session_init(dce_call, NULL);
 			NT_STATUS_HAVE_NO_MEMORY(stream->session);
@@ -635,8 +779,9 @@ static NTSTATUS cache_pull_OpenStream(struct dcesrv_call_state *dce_call,
 	for (message = mpm->messages; message; message = message->next) {
 		if ((mpm_session_cmp(message->session, dce_call) == true) &&
 		    mapi_request->handles[mapi_req.handle_idx] == message->handle) {
-			stream = talloc((TALLOC_CTX *)mpm, struct mpm_stream);
+			stream = talloc_zero((TALLOC_CTX *)mpm, struct mpm_stream);
 			NT_STATUS_HAVE_NO_MEMORY(stream);
+			talloc_set_destructor(stream, cache_stream_destructor);
 
 			stream->session = mpm_session_init(dce_call, NULL);
 			NT_STATUS_HAVE_NO_MEMORY(stream->session);
@@ -764,9 +909,18 @@ static NTSTATUS cache_push_ReadStream(struct dcesrv_call_state *dce_call,
 	for (stream = mpm->streams; stream; stream = stream->next) {
 		if ((mpm_session_cmp(stream->session, dce_call) == true) &&
 		    mapi_response->handles[mapi_repl.handle_idx] == stream->handle) {
-			if (stream->fp && stream->cached == false) {
+			if (stream->cached == false) {
+				mpm->stats.upstream_reads++;
+				mpm->stats.upstream_bytes += response.data.length;
+			}
+
+			if (stream->sync) {
+				/* Synchronization in progress: keep track of the client position */
+				stream->offset += response.data.length;
+			} else if (stream->fp && stream->cached == false) {
 				if (mpm->sync == true && stream->StreamSize > mpm->sync_min) {
-					cache_exec_sync_cmd(stream);
+					stream->offset += response.data.length;
+					cache_exec_sync_cmd(dce_call->event_ctx, stream);
 				} else {
 					OC_DEBUG(5, "* [s(%s),c(0x%x)] %zd bytes from remove server",
 						  server_id_str_buf(stream->session->server_id, &tmp), stream->session->context_id, response.data.length);
@@ -774,6 +928,7 @@ static NTSTATUS cache_push_ReadStream(struct dcesrv_call_state *dce_call,
 					if (stream->offset == stream->StreamSize) {
 						if (response.data.length) {
 							cache_dump_stream_stat(stream);
+							mpm_cache_store_add(mpm, stream);
 						}
 					}
 				}
@@ -806,6 +961,13 @@ static NTSTATUS cache_pull(struct dcesrv_call_state *dce_call, TALLOC_CTX *mem_c
 	struct EcDoRpc_MAPI_REQ	*mapi_req;
 	uint32_t		i;
 
+	/* Start the store janitor with the first request of the process */
+	if (!mpm->janitor && mpm->janitor_interval > 0) {
+		mpm->janitor = tevent_add_timer(dce_call->event_ctx, mpm,
+						timeval_current_ofs(mpm->janitor_interval, 0),
+						cache_janitor_handler, NULL);
+	}
+
 	if (dce_call->pkt.u.request.opnum != 0x2) {
 		return NT_STATUS_OK;
 	}
@@ -988,11 +1150,11 @@ static NTSTATUS cache_dispatch(struct dcesrv_call_state *dce_call, TALLOC_CTX *m
 						mapi_response->mapi_repl[i].opnum = op_MAPI_ReadStream;
 						mapi_response->mapi_repl[i].handle_idx = mapi_req[i].handle_idx;
 						mapi_response->mapi_repl[i].error_code = MAPI_E_SUCCESS;
-						mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length = 0;
-						mapi_response->mapi_repl[i].u.mapi_ReadStream.data.data = talloc_size(mem_ctx, request.ByteCount);
-						mpm_cache_stream_read(stream, (size_t) request.ByteCount, 
+						mpm_cache_stream_read(mem_ctx, stream, (size_t) request.ByteCount,
 								      &mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length,
 								      &mapi_response->mapi_repl[i].u.mapi_ReadStream.data.data);
+						mpm->stats.cached_reads++;
+						mpm->stats.cached_bytes += mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length;
 						if (stream->offset == stream->StreamSize) {
 							if (mapi_response->mapi_repl[i].u.mapi_ReadStream.data.length) {
 								cache_dump_stream_stat(stream);
@@ -1015,6 +1177,7 @@ static NTSTATUS cache_dispatch(struct dcesrv_call_state *dce_call, TALLOC_CTX *m
 							/* When read ahead is over */
 							if (stream->offset == stream->StreamSize) {
 								cache_dump_stream_stat(stream);
+								mpm_cache_store_add(mpm, stream);
 								mpm_cache_stream_reset(stream);
 								stream->cached = true;
 								stream->ahead = false;
@@ -1093,6 +1256,8 @@ static NTSTATUS cache_unbind(struct server_id server_id, uint32_t context_id)
 		}
 	}
 
+	cache_dump_stats();
+
 	return NT_STATUS_OK;
 }
 
@@ -1103,6 +1268,8 @@ static NTSTATUS cache_unbind(struct server_id server_id, uint32_t context_id)
 
    Possible smb.conf parameters:
 	* mpm_cache:database
+	* mpm_cache:max_size
+	* mpm_cache:janitor_interval
 
    \param dce_ctx the session context
 
@@ -1114,6 +1281,7 @@ static NTSTATUS cache_init(struct dcesrv_context *dce_ctx)
 	char			*database;
 	NTSTATUS		status;
 	struct loadparm_context	*lp_ctx;
+	int			max_size;
 
 	mpm = talloc_zero(dce_ctx, struct mpm_cache);
 	if (!mpm) return NT_STATUS_NO_MEMORY;
@@ -1126,6 +1294,10 @@ static NTSTATUS cache_init(struct dcesrv_context *dce_ctx)
 	mpm->sync_min = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "sync_min", 500000);
 	mpm->sync_cmd = str_list_make(dce_ctx, lpcfg_parm_string(dce_ctx->lp_ctx, NULL, MPM_NAME, "sync_cmd"), " ");
 	mpm->dbpath = lpcfg_parm_string(dce_ctx->lp_ctx, NULL, MPM_NAME, "path");
+	max_size = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "max_size", MPM_STORE_MAX_SIZE);
+	mpm->max_size = (max_size > 0) ? (uint64_t) max_size * 1024 * 1024 : 0;
+	mpm->janitor_interval = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, MPM_NAME, "janitor_interval",
+					       MPM_STORE_JANITOR_INTERVAL);
 
 	if ((mpm->ahead == true) && mpm->sync) {
 		OC_DEBUG(0, "%s: cache:ahead and cache:sync are exclusive!", MPM_ERROR);
@@ -1147,6 +1319,15 @@ static NTSTATUS cache_init(struct dcesrv_context *dce_ctx)
 		return NT_STATUS_NO_MEMORY;
 	}
 
+	status = mpm_cache_store_init(mpm);
+	if (!NT_STATUS_IS_OK(status)) {
+		OC_DEBUG(0, "%s: Unable to initialize the object store", MPM_ERROR);
+		talloc_free(database);
+		talloc_free(mpm);
+		return status;
+	}
+	mpm_cache_store_janitor(mpm);
+
 	lp_ctx = loadparm_init(dce_ctx);
 	lpcfg_load_default(lp_ctx);
 	dcerpc_init();
@@ -23,6 +23,7 @@
 #define	__MPM_CACHE_H
 
 #include <stdio.h>
+#include <sys/types.h>
 
 #include <ldb_errors.h>
 #include <ldb.h>
@@ -56,6 +57,18 @@ struct mpm_attachment {
 	struct mpm_attachment	*next;
 };
 
+/**
+   Synchronization process running for a stream. It outlives the
+   stream if the client releases it before the copy completes.
+ */
+struct mpm_sync {
+	struct mpm_stream	*stream;
+	pid_t			pid;
+	int			fd;
+	char			*filename;
+	uint32_t		StreamSize;
+};
+
 /**
    A stream can either be for a message or attachment
  */
@@ -67,7 +80,10 @@ struct mpm_stream {
 	uint32_t		StreamSize;
 	size_t			offset;
 	FILE			*fp;
+	uint8_t			*map;
+	size_t			map_size;
 	char			*filename;
+	struct mpm_sync		*sync;
 	bool			cached;
 	bool			ahead;
 	struct timeval		tv_start;
@@ -79,6 +95,19 @@ struct mpm_stream {
 
 /* TODO: Make use of dce_ctx->context->context_id to differentiate sessions ? */
 
+struct mpm_cache_stats {
+	uint64_t		cached_reads;
+	uint64_t		cached_bytes;
+	uint64_t		upstream_reads;
+	uint64_t		upstream_bytes;
+	uint32_t		syncs;
+	uint32_t		sync_failures;
+	uint32_t		sync_pending;
+	uint32_t		dedup;
+	uint64_t		dedup_bytes;
+	uint32_t		evictions;
+};
+
 struct mpm_cache {
 	struct ldb_context	*ldb_ctx;
 	struct mpm_message	*messages;
@@ -89,6 +118,11 @@ struct mpm_cache {
 	bool			sync;
 	int			sync_min;
 	char     		**sync_cmd;
+	uint64_t		max_size;
+	uint64_t		store_size;
+	int			janitor_interval;
+	struct tevent_timer	*janitor;
+	struct mpm_cache_stats	stats;
 };
 
 __BEGIN_DECLS
@@ -99,13 +133,22 @@ NTSTATUS	mpm_cache_ldb_createdb(struct dcesrv_context *, const char *, struct ld
 NTSTATUS	mpm_cache_ldb_add_message(TALLOC_CTX *, struct ldb_context *, struct mpm_message *);
 NTSTATUS	mpm_cache_ldb_add_attachment(TALLOC_CTX *, struct ldb_context *, struct mpm_attachment *);
 NTSTATUS	mpm_cache_ldb_add_stream(struct mpm_cache *, struct ldb_context *, struct mpm_stream *);
+NTSTATUS	mpm_cache_ldb_set_stream(struct mpm_cache *, struct ldb_context *, struct mpm_stream *, const char *);
+NTSTATUS	mpm_cache_ldb_createobjects(TALLOC_CTX *, struct ldb_context *);
+NTSTATUS	mpm_cache_ldb_add_object(TALLOC_CTX *, struct ldb_context *, const char *, const char *, uint32_t, const char *);
+NTSTATUS	mpm_cache_ldb_touch_object(TALLOC_CTX *, struct ldb_context *, const char *);
 
 NTSTATUS	mpm_cache_stream_open(struct mpm_cache *, struct mpm_stream *);
 NTSTATUS	mpm_cache_stream_close(struct mpm_stream *);
 NTSTATUS	mpm_cache_stream_write(struct mpm_stream *, uint16_t, uint8_t *);
-NTSTATUS	mpm_cache_stream_read(struct mpm_stream *, size_t, size_t *, uint8_t **);
+NTSTATUS	mpm_cache_stream_map(struct mpm_stream *);
+NTSTATUS	mpm_cache_stream_read(TALLOC_CTX *, struct mpm_stream *, size_t, size_t *, uint8_t **);
 NTSTATUS	mpm_cache_stream_reset(struct mpm_stream *);
 
+NTSTATUS	mpm_cache_store_init(struct mpm_cache *);
+NTSTATUS	mpm_cache_store_add(struct mpm_cache *, struct mpm_stream *);
+NTSTATUS	mpm_cache_store_janitor(struct mpm_cache *);
+
 __END_DECLS
 
 /*
@@ -116,6 +159,13 @@ __END_DECLS
 #define	MPM_ERROR	"[ERROR] mpm_cache:"
 #define	MPM_DB		"mpm_cache.ldb"
 #define	MPM_DB_STORAGE	"data"
+#define	MPM_DB_OBJECTS	"objects"
+#define	MPM_DB_OBJECTS_DN	"CN=Objects"
+
+#define	MPM_STORE_MAX_SIZE		1024	/* MB */
+#define	MPM_STORE_JANITOR_INTERVAL	300	/* seconds */
+#define	MPM_STORE_ATIME_DELAY		60	/* seconds */
+#define	MPM_STORE_MAX_COLLISIONS	8
 
 #define	MPM_SESSION(x)	x->session->server_id.pid, x->session->server_id.task_id, x->session->server_id.vnn, x->session->context_id
 
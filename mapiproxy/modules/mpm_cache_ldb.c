@@ -229,8 +229,211 @@ NTSTATUS mpm_cache_ldb_add_attachment(TALLOC_CTX *mem_ctx,
 
 
 /**
-   \details Add stream references to a message or attachment in the
-   TDB store
+   \details Build the DN of the message or attachment record a stream
+   belongs to
+
+   \param mem_ctx pointer to the memory context
+   \param stream pointer to the mpm_stream entry
+
+   \return Allocated DN string on success, otherwise NULL
+ */
+static char *mpm_cache_ldb_stream_dn(TALLOC_CTX *mem_ctx, struct mpm_stream *stream)
+{
+	struct mpm_message	*message;
+
+	if (stream->attachment) {
+		message = stream->attachment->message;
+		return talloc_asprintf(mem_ctx, "CN=%d,CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
+				       stream->attachment->AttachmentID, message->MessageId,
+				       message->FolderId);
+	}
+
+	if (stream->message) {
+		return talloc_asprintf(mem_ctx, "CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
+				       stream->message->MessageId, stream->message->FolderId);
+	}
+
+	return NULL;
+}
+
+
+/**
+   \details Create the container of content-addressed objects
+
+   \param mem_ctx pointer to the memory context
+   \param ldb_ctx pointer to the LDB context
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_ldb_createobjects(TALLOC_CTX *mem_ctx, struct ldb_context *ldb_ctx)
+{
+	struct ldb_message	*msg;
+	int			ret;
+
+	msg = ldb_msg_new(mem_ctx);
+	if (msg == NULL) return NT_STATUS_NO_MEMORY;
+
+	msg->dn = ldb_dn_new(msg, ldb_ctx, MPM_DB_OBJECTS_DN);
+	if (!msg->dn) {
+		talloc_free(msg);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	ret = ldb_add(ldb_ctx, msg);
+	talloc_free(msg);
+	if (ret != LDB_SUCCESS && ret != LDB_ERR_ENTRY_ALREADY_EXISTS) {
+		OC_DEBUG(0, "* Failed to add record %s: %s", MPM_DB_OBJECTS_DN, ldb_errstring(ldb_ctx));
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Add or update a content-addressed object record
+
+   The record is created if needed, its access time is refreshed and
+   the stream file is added to its references.
+
+   \param mem_ctx pointer to the memory context
+   \param ldb_ctx pointer to the LDB context
+   \param key the object key
+   \param filename the object path
+   \param size the object size
+   \param reference the stream file linked to the object
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_ldb_add_object(TALLOC_CTX *mem_ctx,
+				  struct ldb_context *ldb_ctx,
+				  const char *key,
+				  const char *filename,
+				  uint32_t size,
+				  const char *reference)
+{
+	struct ldb_message	*msg;
+	char			*dn;
+	int			ret;
+
+	dn = talloc_asprintf(mem_ctx, "CN=%s,%s", key, MPM_DB_OBJECTS_DN);
+	if (!dn) return NT_STATUS_NO_MEMORY;
+
+	msg = ldb_msg_new(dn);
+	if (msg == NULL) {
+		talloc_free(dn);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	msg->dn = ldb_dn_new(msg, ldb_ctx, dn);
+	if (!msg->dn) {
+		talloc_free(dn);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	ldb_msg_add_string(msg, "filename", filename);
+	ldb_msg_add_fmt(msg, "size", "%u", size);
+	ldb_msg_add_fmt(msg, "atime", "%ld", (long) time(NULL));
+	ldb_msg_add_string(msg, "reference", reference);
+
+	ret = ldb_add(ldb_ctx, msg);
+	if (ret == LDB_ERR_ENTRY_ALREADY_EXISTS) {
+		talloc_free(msg);
+		msg = ldb_msg_new(dn);
+		if (msg == NULL) goto nomem;
+		msg->dn = ldb_dn_new(msg, ldb_ctx, dn);
+		ldb_msg_add_fmt(msg, "atime", "%ld", (long) time(NULL));
+		msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
+		ret = ldb_modify(ldb_ctx, msg);
+		if (ret == LDB_SUCCESS) {
+			/* Add the reference on its own: it may already be there */
+			talloc_free(msg);
+			msg = ldb_msg_new(dn);
+			if (msg == NULL) goto nomem;
+			msg->dn = ldb_dn_new(msg, ldb_ctx, dn);
+			ldb_msg_add_string(msg, "reference", reference);
+			msg->elements[0].flags = LDB_FLAG_MOD_ADD;
+			ret = ldb_modify(ldb_ctx, msg);
+			if (ret == LDB_ERR_ATTRIBUTE_OR_VALUE_EXISTS) ret = LDB_SUCCESS;
+		}
+	}
+
+	if (ret != LDB_SUCCESS) {
+		OC_DEBUG(0, "* Failed to modify record %s: %s", dn, ldb_errstring(ldb_ctx));
+		talloc_free(dn);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	talloc_free(dn);
+	return NT_STATUS_OK;
+
+nomem:
+	talloc_free(dn);
+	return NT_STATUS_NO_MEMORY;
+}
+
+
+/**
+   \details Refresh the access time of a content-addressed object
+
+   The record is only modified if its access time is older than
+   MPM_STORE_ATIME_DELAY seconds, to avoid a write on every cache hit.
+
+   \param mem_ctx pointer to the memory context
+   \param ldb_ctx pointer to the LDB context
+   \param key the object key
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_ldb_touch_object(TALLOC_CTX *mem_ctx,
+				    struct ldb_context *ldb_ctx,
+				    const char *key)
+{
+	struct ldb_message	*msg;
+	struct ldb_result	*res;
+	struct ldb_dn		*dn;
+	const char * const	attrs[] = { "atime", NULL };
+	time_t			now;
+	int			ret;
+
+	msg = ldb_msg_new(mem_ctx);
+	if (msg == NULL) return NT_STATUS_NO_MEMORY;
+
+	dn = ldb_dn_new_fmt(msg, ldb_ctx, "CN=%s,%s", key, MPM_DB_OBJECTS_DN);
+	if (!dn) {
+		talloc_free(msg);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	ret = ldb_search(ldb_ctx, msg, &res, dn, LDB_SCOPE_BASE, attrs, NULL);
+	if (ret != LDB_SUCCESS || res->count != 1) {
+		talloc_free(msg);
+		return NT_STATUS_NOT_FOUND;
+	}
+
+	now = time(NULL);
+	if (ldb_msg_find_attr_as_int64(res->msgs[0], "atime", 0) + MPM_STORE_ATIME_DELAY > now) {
+		talloc_free(msg);
+		return NT_STATUS_OK;
+	}
+
+	msg->dn = dn;
+	ldb_msg_add_fmt(msg, "atime", "%ld", (long) now);
+	msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
+	ret = ldb_modify(ldb_ctx, msg);
+	talloc_free(msg);
+
+	return (ret == LDB_SUCCESS) ? NT_STATUS_OK : NT_STATUS_UNSUCCESSFUL;
+}
+
+
+/**
+   \details Look up a cached stream and open it
+
+   Check whether the message or attachment record references a
+   complete copy of the stream. If so, the stream is opened from the
+   cache and the object access time is refreshed. If the file was
+   evicted in the meantime, the stream is downloaded again.
 
    \param mpm pointer to the cache module general structure
    \param ldb_ctx pointer to the LDB context
@@ -243,121 +446,133 @@ NTSTATUS mpm_cache_ldb_add_stream(struct mpm_cache *mpm,
 				  struct mpm_stream *stream)
 {
 	TALLOC_CTX		*mem_ctx;
-	struct mpm_message	*message;
-	struct mpm_attachment	*attach;
-	struct ldb_message	*msg;
 	struct ldb_dn		*dn;
 	const char * const	attrs[] = { "*", NULL };
 	struct ldb_result	*res;
-	char			*basedn = NULL;
+	char			*basedn;
 	char			*attribute;
+	const char		*filename;
+	const char		*key;
 	int			ret;
-	uint32_t		i;
 
 	mem_ctx = (TALLOC_CTX *) mpm;
-	
-	if (stream->attachment) {
-		attach = stream->attachment;
-		message = attach->message;
-	} else if (stream->message) {
-		attach = NULL;
-		message = stream->message;
-	} else {
-		return NT_STATUS_OK;
-	}
-
-	/* This is a stream for an attachment */
-	if (stream->attachment) {
-		basedn = talloc_asprintf(mem_ctx, "CN=%d,CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 attach->AttachmentID, message->MessageId,
-					 message->FolderId);
-		dn = ldb_dn_new(mem_ctx, ldb_ctx, basedn);
-		talloc_free(basedn);
-		if (!dn) return NT_STATUS_UNSUCCESSFUL;
-		
-		ret = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, 
-				 "(0x%x=*)", stream->PropertyTag);
-
-		if (ret == LDB_SUCCESS && res->count == 1) {
-			attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
-			basedn = (char *) ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
-			talloc_free(attribute);
-			OC_DEBUG(2, "* Loading from cache 0x%x = %s", stream->PropertyTag, basedn);
-			stream->filename = talloc_strdup(mem_ctx, basedn);
-			stream->cached = true;
-			stream->ahead = false;
-			mpm_cache_stream_open(mpm, stream);
 
-			return NT_STATUS_OK;
-		}
+	basedn = mpm_cache_ldb_stream_dn(mem_ctx, stream);
+	if (!basedn) return NT_STATUS_OK;
 
-		/* Otherwise create the stream with basedn above */
-		basedn = talloc_asprintf(mem_ctx, "CN=%d,CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 attach->AttachmentID, message->MessageId,
-					 message->FolderId);
-
-		OC_DEBUG(2, "* Create the stream TDB record for attachment");
-	} 
+	dn = ldb_dn_new(mem_ctx, ldb_ctx, basedn);
+	talloc_free(basedn);
+	if (!dn) return NT_STATUS_UNSUCCESSFUL;
 
-	if (stream->message) {
-		basedn = talloc_asprintf(mem_ctx, "CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 message->MessageId, message->FolderId);
-		dn = ldb_dn_new(mem_ctx, ldb_ctx, basedn);
-		talloc_free(basedn);
-		if (!dn) return NT_STATUS_UNSUCCESSFUL;
-
-		ret = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs, "(0x%x=*)", stream->PropertyTag);
-
-		if (ret == LDB_SUCCESS && res->count == 1) {
-			attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
-			basedn = (char *) ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
-			talloc_free(attribute);
-			OC_DEBUG(2, "* Loading from cache 0x%x = %s", stream->PropertyTag, basedn);
-			stream->filename = talloc_strdup(mem_ctx, basedn);
-			stream->cached = true;
-			stream->ahead = false;
-			mpm_cache_stream_open(mpm, stream);
+	ret = ldb_search(ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_BASE, attrs,
+			 "(0x%x=*)", stream->PropertyTag);
+	talloc_free(dn);
 
+	if (ret == LDB_SUCCESS && res->count == 1) {
+		attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
+		filename = ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
+		talloc_free(attribute);
+
+		attribute = talloc_asprintf(mem_ctx, "0x%x_Object", stream->PropertyTag);
+		key = ldb_msg_find_attr_as_string(res->msgs[0], attribute, NULL);
+		talloc_free(attribute);
+
+		OC_DEBUG(2, "* Loading from cache 0x%x = %s", stream->PropertyTag, filename);
+		stream->filename = talloc_strdup(mem_ctx, filename);
+		stream->cached = true;
+		stream->ahead = false;
+		mpm_cache_stream_open(mpm, stream);
+		if (stream->fp) {
+			if (key) {
+				mpm_cache_ldb_touch_object(mem_ctx, ldb_ctx, key);
+			}
+			talloc_free(res);
 			return NT_STATUS_OK;
 		}
 
-		/* Otherwise create the stream with basedn above */
-		basedn = talloc_asprintf(mem_ctx, "CN=0x%"PRIx64",CN=0x%"PRIx64",CN=Cache",
-					 message->MessageId, message->FolderId);
-		
-		OC_DEBUG(2, "* Modify the message TDB record and append stream information");
+		OC_DEBUG(2, "* %s was evicted from the cache", stream->filename);
+		talloc_free(stream->filename);
+		stream->filename = NULL;
 	}
+	if (ret == LDB_SUCCESS) talloc_free(res);
 
+	/* The stream is recorded in the database once complete */
 	stream->cached = false;
 	mpm_cache_stream_open(mpm, stream);
 
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Reference a complete stream from its message or attachment
+   record
+
+   \param mpm pointer to the cache module general structure
+   \param ldb_ctx pointer to the LDB context
+   \param stream pointer to the mpm_stream entry
+   \param key the content-addressed object key of the stream
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_ldb_set_stream(struct mpm_cache *mpm,
+				  struct ldb_context *ldb_ctx,
+				  struct mpm_stream *stream,
+				  const char *key)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct ldb_message	*msg;
+	char			*basedn;
+	char			*attribute;
+	int			ret;
+	uint32_t		i;
+
+	mem_ctx = (TALLOC_CTX *) mpm;
+
 	msg = ldb_msg_new(mem_ctx);
 	if (msg == NULL) return NT_STATUS_NO_MEMORY;
 
-	msg->dn = ldb_dn_new(ldb_ctx, ldb_ctx, basedn);
+	basedn = mpm_cache_ldb_stream_dn(msg, stream);
+	if (!basedn) {
+		talloc_free(msg);
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	OC_DEBUG(2, "* Modify the TDB record %s and append stream information", basedn);
+
+	msg->dn = ldb_dn_new(msg, ldb_ctx, basedn);
 	talloc_free(basedn);
-	if (!msg->dn) return NT_STATUS_NO_MEMORY;
-	
-	attribute = talloc_asprintf(mem_ctx, "0x%x", stream->PropertyTag);
+	if (!msg->dn) {
+		talloc_free(msg);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	attribute = talloc_asprintf(msg, "0x%x", stream->PropertyTag);
 	ldb_msg_add_fmt(msg, attribute, "%s", stream->filename);
 	talloc_free(attribute);
-	
-	attribute = talloc_asprintf(mem_ctx, "0x%x_StreamSize", stream->PropertyTag);
+
+	attribute = talloc_asprintf(msg, "0x%x_StreamSize", stream->PropertyTag);
 	ldb_msg_add_fmt(msg, attribute, "%d", stream->StreamSize);
 	talloc_free(attribute);
 
+	attribute = talloc_asprintf(msg, "0x%x_Object", stream->PropertyTag);
+	ldb_msg_add_fmt(msg, attribute, "%s", key);
+	talloc_free(attribute);
+
 	/* mark all the message elements as LDB_FLAG_MOD_REPLACE */
 	for (i=0;i<msg->num_elements;i++) {
 		msg->elements[i].flags = LDB_FLAG_MOD_REPLACE;
 	}
-	
+
 	ret = ldb_modify(ldb_ctx, msg);
 	if (ret != 0) {
 		OC_DEBUG(0, "* Failed to modify record %s: %s",
-			  ldb_dn_get_linearized(msg->dn), 
+			  ldb_dn_get_linearized(msg->dn),
 			  ldb_errstring(ldb_ctx));
+		talloc_free(msg);
 		return NT_STATUS_UNSUCCESSFUL;
 	}
 
+	talloc_free(msg);
 	return NT_STATUS_OK;
 }
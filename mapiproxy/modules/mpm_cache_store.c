@@ -0,0 +1,377 @@
+/*
+   MAPI Proxy - Cache module
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mpm_cache_store.c
+
+   \brief Content-addressed storage for the cache module
+
+   Complete streams are stored once per content under
+   path/objects/XX/HASH-SIZE. The per message/attachment stream file
+   becomes a hard link to the object, so the same attachment sent to
+   many recipients only uses disk space once while existing paths
+   (and the synchronization command) keep working.
+
+   Objects are recorded in the LDB database under CN=Objects with
+   their size, last access time and the stream files linked to
+   them. The janitor drops least recently used objects when the store
+   grows beyond mpm_cache:max_size.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/modules/mpm_cache.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+
+struct mpm_cache_object {
+	time_t			atime;
+	uint64_t		size;
+	struct ldb_message	*msg;
+};
+
+/**
+   \details Map a file read-only in memory
+
+   \param filename the file to map
+   \param size the expected file size
+   \param map pointer on the mapping to return
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_NOT_FOUND or
+   NT_STATUS_UNSUCCESSFUL
+ */
+static NTSTATUS mpm_cache_store_map(const char *filename, uint32_t size, uint8_t **map)
+{
+	struct stat	sb;
+	void		*ptr;
+	int		fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1) return NT_STATUS_NOT_FOUND;
+
+	if (fstat(fd, &sb) == -1 || sb.st_size != size) {
+		close(fd);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED) return NT_STATUS_UNSUCCESSFUL;
+
+	*map = (uint8_t *) ptr;
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Replace a stream file with a hard link to an existing object
+
+   \param object the object path
+   \param filename the stream file to replace
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_UNSUCCESSFUL
+ */
+static NTSTATUS mpm_cache_store_link(TALLOC_CTX *mem_ctx, const char *object, const char *filename)
+{
+	char	*tmp;
+	int	ret;
+
+	tmp = talloc_asprintf(mem_ctx, "%s.link", filename);
+	if (!tmp) return NT_STATUS_NO_MEMORY;
+
+	unlink(tmp);
+	ret = link(object, tmp);
+	if (ret == 0) {
+		ret = rename(tmp, filename);
+		if (ret == -1) unlink(tmp);
+	}
+	if (ret == -1) {
+		OC_DEBUG(1, "* Unable to link %s to %s: %s", filename, object, strerror(errno));
+	}
+	talloc_free(tmp);
+
+	return (ret == 0) ? NT_STATUS_OK : NT_STATUS_UNSUCCESSFUL;
+}
+
+
+/**
+   \details Initialize the content-addressed store
+
+   \param mpm pointer to the cache module general structure
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_store_init(struct mpm_cache *mpm)
+{
+	char	*path;
+	int	ret;
+
+	path = talloc_asprintf(mpm, "%s/%s", mpm->dbpath, MPM_DB_OBJECTS);
+	if (!path) return NT_STATUS_NO_MEMORY;
+	ret = mkdir(path, 0777);
+	talloc_free(path);
+	if ((ret == -1) && (errno != EEXIST)) return NT_STATUS_UNSUCCESSFUL;
+
+	return mpm_cache_ldb_createobjects(mpm, mpm->ldb_ctx);
+}
+
+
+/**
+   \details Store a complete stream in the content-addressed store
+
+   The stream file is hashed. If an object with the same content
+   already exists, the stream file is replaced with a hard link to it,
+   otherwise the stream file becomes the new object. Objects with the
+   same hash but different content are told apart with a suffix.
+
+   The message or attachment record is then updated so next
+   OpenStream calls are served from the cache.
+
+   \param mpm pointer to the cache module general structure
+   \param stream pointer to the complete mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_store_add(struct mpm_cache *mpm, struct mpm_stream *stream)
+{
+	TALLOC_CTX	*mem_ctx;
+	NTSTATUS	status;
+	uint8_t		*data = NULL;
+	uint8_t		*object_data;
+	uint64_t	hash;
+	char		*dir;
+	char		*key = NULL;
+	char		*object = NULL;
+	bool		dedup = false;
+	uint32_t	i;
+	int		ret;
+
+	if (!stream->filename || !stream->StreamSize) return NT_STATUS_INVALID_PARAMETER;
+	if (!stream->message && !stream->attachment) return NT_STATUS_OK;
+
+	if (stream->fp) fflush(stream->fp);
+
+	mem_ctx = talloc_new(NULL);
+	if (!mem_ctx) return NT_STATUS_NO_MEMORY;
+
+	status = mpm_cache_store_map(stream->filename, stream->StreamSize, &data);
+	if (!NT_STATUS_IS_OK(status)) {
+		OC_DEBUG(1, "* Unable to hash %s", stream->filename);
+		goto end;
+	}
+	hash = hash64_stable(data, stream->StreamSize, 0);
+
+	dir = talloc_asprintf(mem_ctx, "%s/%s/%.2"PRIx64, mpm->dbpath, MPM_DB_OBJECTS, hash >> 56);
+	ret = mkdir(dir, 0777);
+	if ((ret == -1) && (errno != EEXIST)) {
+		status = NT_STATUS_UNSUCCESSFUL;
+		goto end;
+	}
+
+	for (i = 0; i < MPM_STORE_MAX_COLLISIONS; i++) {
+		if (i) {
+			key = talloc_asprintf(mem_ctx, "%.16"PRIx64"-%.8x-%d", hash, stream->StreamSize, i);
+		} else {
+			key = talloc_asprintf(mem_ctx, "%.16"PRIx64"-%.8x", hash, stream->StreamSize);
+		}
+		object = talloc_asprintf(mem_ctx, "%s/%s", dir, key);
+
+		/* New object */
+		if (link(stream->filename, object) == 0) break;
+		if (errno != EEXIST) {
+			OC_DEBUG(1, "* Unable to link %s to %s: %s", object, stream->filename, strerror(errno));
+			status = NT_STATUS_UNSUCCESSFUL;
+			goto end;
+		}
+
+		/* Existing object: check it is not a hash collision */
+		status = mpm_cache_store_map(object, stream->StreamSize, &object_data);
+		if (!NT_STATUS_IS_OK(status)) continue;
+		ret = memcmp(data, object_data, stream->StreamSize);
+		munmap(object_data, stream->StreamSize);
+		if (ret == 0) {
+			status = mpm_cache_store_link(mem_ctx, object, stream->filename);
+			if (!NT_STATUS_IS_OK(status)) goto end;
+			dedup = true;
+			break;
+		}
+	}
+
+	if (i == MPM_STORE_MAX_COLLISIONS) {
+		OC_DEBUG(1, "* Too many objects share the hash of %s", stream->filename);
+		status = NT_STATUS_UNSUCCESSFUL;
+		goto end;
+	}
+
+	status = mpm_cache_ldb_add_object(mem_ctx, mpm->ldb_ctx, key, object,
+					  stream->StreamSize, stream->filename);
+	if (!NT_STATUS_IS_OK(status)) goto end;
+
+	status = mpm_cache_ldb_set_stream(mpm, mpm->ldb_ctx, stream, key);
+	if (!NT_STATUS_IS_OK(status)) goto end;
+
+	if (dedup) {
+		mpm->stats.dedup++;
+		mpm->stats.dedup_bytes += stream->StreamSize;
+	} else {
+		mpm->store_size += stream->StreamSize;
+	}
+	OC_DEBUG(2, "* Stored %s as %s%s", stream->filename, key, dedup ? " (existing)" : "");
+
+	if (mpm->max_size && mpm->store_size > mpm->max_size) {
+		mpm_cache_store_janitor(mpm);
+	}
+
+end:
+	if (data) munmap(data, stream->StreamSize);
+	talloc_free(mem_ctx);
+
+	return status;
+}
+
+
+static int mpm_cache_object_cmp(const void *a, const void *b)
+{
+	const struct mpm_cache_object	*oa = (const struct mpm_cache_object *) a;
+	const struct mpm_cache_object	*ob = (const struct mpm_cache_object *) b;
+
+	if (oa->atime < ob->atime) return -1;
+	if (oa->atime > ob->atime) return 1;
+	return 0;
+}
+
+
+/**
+   \details Remove an object and the stream files linked to it
+
+   Stream files are only removed if they are still links to the
+   object: they may have been downloaded again since.
+
+   \param mpm pointer to the cache module general structure
+   \param msg the object record
+ */
+static void mpm_cache_store_evict(struct mpm_cache *mpm, struct ldb_message *msg)
+{
+	struct ldb_message_element	*el;
+	const char			*object;
+	char				*reference;
+	struct stat			sb;
+	struct stat			rsb;
+	unsigned int			i;
+	int				ret;
+
+	object = ldb_msg_find_attr_as_string(msg, "filename", NULL);
+	if (object && stat(object, &sb) == 0) {
+		el = ldb_msg_find_element(msg, "reference");
+		for (i = 0; el && i < el->num_values; i++) {
+			reference = talloc_strndup(msg, (const char *)el->values[i].data, el->values[i].length);
+			if (!reference) continue;
+			if (stat(reference, &rsb) == 0 && rsb.st_dev == sb.st_dev && rsb.st_ino == sb.st_ino) {
+				unlink(reference);
+			}
+			talloc_free(reference);
+		}
+		unlink(object);
+	}
+
+	ret = ldb_delete(mpm->ldb_ctx, msg->dn);
+	if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_OBJECT) {
+		OC_DEBUG(1, "* Failed to delete record %s: %s",
+			  ldb_dn_get_linearized(msg->dn), ldb_errstring(mpm->ldb_ctx));
+	}
+}
+
+
+/**
+   \details Bound the size of the content-addressed store
+
+   Sum the size of the stored objects and, when mpm_cache:max_size is
+   exceeded, drop least recently used objects until the store is back
+   to 90% of the limit.
+
+   \param mpm pointer to the cache module general structure
+
+   \return NT_STATUS_OK on success, otherwise NT error
+ */
+NTSTATUS mpm_cache_store_janitor(struct mpm_cache *mpm)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct ldb_result	*res;
+	struct ldb_dn		*dn;
+	struct mpm_cache_object	*objects;
+	const char * const	attrs[] = { "filename", "size", "atime", "reference", NULL };
+	uint64_t		total = 0;
+	uint64_t		target;
+	uint32_t		evicted = 0;
+	unsigned int		i;
+	int			ret;
+
+	mem_ctx = talloc_new(NULL);
+	if (!mem_ctx) return NT_STATUS_NO_MEMORY;
+
+	dn = ldb_dn_new(mem_ctx, mpm->ldb_ctx, MPM_DB_OBJECTS_DN);
+	ret = ldb_search(mpm->ldb_ctx, mem_ctx, &res, dn, LDB_SCOPE_ONELEVEL, attrs, NULL);
+	if (ret != LDB_SUCCESS) {
+		OC_DEBUG(1, "* Unable to list objects: %s", ldb_errstring(mpm->ldb_ctx));
+		talloc_free(mem_ctx);
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	objects = talloc_array(mem_ctx, struct mpm_cache_object, res->count);
+	if (!objects && res->count) {
+		talloc_free(mem_ctx);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (i = 0; i < res->count; i++) {
+		objects[i].msg = res->msgs[i];
+		objects[i].size = ldb_msg_find_attr_as_uint64(res->msgs[i], "size", 0);
+		objects[i].atime = ldb_msg_find_attr_as_int64(res->msgs[i], "atime", 0);
+		total += objects[i].size;
+	}
+
+	if (mpm->max_size && total > mpm->max_size) {
+		qsort(objects, res->count, sizeof (struct mpm_cache_object), mpm_cache_object_cmp);
+
+		target = mpm->max_size - mpm->max_size / 10;
+		for (i = 0; i < res->count && total > target; i++) {
+			mpm_cache_store_evict(mpm, objects[i].msg);
+			total -= objects[i].size;
+			evicted++;
+		}
+		mpm->stats.evictions += evicted;
+		OC_DEBUG(2, "* Janitor evicted %u objects, store is now %"PRIu64" bytes", evicted, total);
+	}
+
+	mpm->store_size = total;
+	talloc_free(mem_ctx);
+
+	return NT_STATUS_OK;
+}
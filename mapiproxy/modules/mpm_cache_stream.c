@@ -31,8 +31,10 @@
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <errno.h>
 
@@ -75,6 +77,8 @@ NTSTATUS mpm_cache_stream_open(struct mpm_cache *mpm, struct mpm_stream *stream)
 
 		OC_DEBUG(2, "* Opening Message stream %s", file);
 		stream->filename = talloc_strdup(mem_ctx, file);
+		/* Never write through a link to a stored object */
+		unlink(file);
 		stream->fp = fopen(file, "w+");
 		stream->offset = 0;
 		talloc_free(file);
@@ -105,6 +109,8 @@ NTSTATUS mpm_cache_stream_open(struct mpm_cache *mpm, struct mpm_stream *stream)
 
 		OC_DEBUG(2, "* Opening Attachment stream %s", file);
 		stream->filename = talloc_strdup(mem_ctx, file);
+		/* Never write through a link to a stored object */
+		unlink(file);
 		stream->fp = fopen(file, "w+");
 		stream->offset = 0;
 		talloc_free(file);
@@ -125,13 +131,53 @@ NTSTATUS mpm_cache_stream_open(struct mpm_cache *mpm, struct mpm_stream *stream)
  */
 NTSTATUS mpm_cache_stream_close(struct mpm_stream *stream)
 {
-	if (stream && stream->fp) {
-		fclose(stream->fp);
-		stream->fp = NULL;
-	} else {
-		return NT_STATUS_NOT_FOUND;
+	if (!stream) return NT_STATUS_NOT_FOUND;
+
+	if (stream->map) {
+		munmap(stream->map, stream->map_size);
+		stream->map = NULL;
+		stream->map_size = 0;
+	}
+
+	if (!stream->fp) return NT_STATUS_NOT_FOUND;
+
+	fclose(stream->fp);
+	stream->fp = NULL;
+
+	return NT_STATUS_OK;
+}
+
+
+/**
+   \details Map a cached stream in memory
+
+   \param stream pointer to the mpm_stream entry
+
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_NOT_FOUND or
+   NT_STATUS_UNSUCCESSFUL
+ */
+NTSTATUS mpm_cache_stream_map(struct mpm_stream *stream)
+{
+	struct stat	sb;
+	void		*map;
+
+	if (stream->map) return NT_STATUS_OK;
+	if (!stream->fp) return NT_STATUS_NOT_FOUND;
+
+	fflush(stream->fp);
+	if (fstat(fileno(stream->fp), &sb) == -1 || !sb.st_size) {
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fileno(stream->fp), 0);
+	if (map == MAP_FAILED) {
+		OC_DEBUG(1, "* Unable to map %s: %s", stream->filename, strerror(errno));
+		return NT_STATUS_UNSUCCESSFUL;
 	}
 
+	stream->map = (uint8_t *) map;
+	stream->map_size = sb.st_size;
+
 	return NT_STATUS_OK;
 }
 
@@ -139,18 +185,49 @@ NTSTATUS mpm_cache_stream_close(struct mpm_stream *stream)
 /**
    \details Read input_size bytes from a local binary stream
 
+   Cached streams are mapped in memory and data points within the
+   mapping: it remains valid until the stream is closed. Otherwise
+   data is allocated on mem_ctx and filled with pread.
+
+   \param mem_ctx the memory context to allocate data when the stream
+   is not mapped
    \param stream pointer to the mpm_stream entry
    \param input_size the number of bytes to read
    \param length output pointer to the length effectively read from the
    stream
    \param data output pointer to the binary data read from the stream
 
-   \return NT_STATUS_OK
+   \return NT_STATUS_OK on success, otherwise NT_STATUS_NOT_FOUND or
+   NT_STATUS_NO_MEMORY
  */
-NTSTATUS mpm_cache_stream_read(struct mpm_stream *stream, size_t input_size, size_t *length, uint8_t **data)
+NTSTATUS mpm_cache_stream_read(TALLOC_CTX *mem_ctx, struct mpm_stream *stream, size_t input_size,
+			       size_t *length, uint8_t **data)
 {
-	fseek(stream->fp, stream->offset, SEEK_SET);
-	*length = fread(*data, sizeof (uint8_t), input_size, stream->fp);
+	ssize_t		ret;
+
+	*length = 0;
+	*data = NULL;
+
+	if (!stream->map && stream->cached) {
+		mpm_cache_stream_map(stream);
+	}
+
+	if (stream->map) {
+		if (stream->offset < stream->map_size) {
+			*length = MIN(input_size, stream->map_size - stream->offset);
+		}
+		*data = stream->map + stream->offset;
+	} else {
+		if (!stream->fp) return NT_STATUS_NOT_FOUND;
+
+		*data = talloc_size(mem_ctx, input_size);
+		NT_STATUS_HAVE_NO_MEMORY(*data);
+
+		fflush(stream->fp);
+		ret = pread(fileno(stream->fp), *data, input_size, stream->offset);
+		*length = (ret > 0) ? ret : 0;
+	}
+
 	stream->offset += *length;
 	OC_DEBUG(5, "* Current offset: 0x%zx", stream->offset);
 
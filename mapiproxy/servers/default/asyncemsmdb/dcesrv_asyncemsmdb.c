@@ -27,6 +27,7 @@
 #include "mapiproxy/libmapiproxy/fault_util.h"
 #include "mapiproxy/libmapistore/mapistore_private.h"
 #include "mapiproxy/libmapistore/gen_ndr/ndr_mapistore_notification.h"
+#include <util/debug.h>
 
 /**
    \file dcesrv_asyncemsmdb.c
@@ -634,10 +635,12 @@ static int process_tablemodified_contentstable_notification(TALLOC_CTX *mem_ctx,
    \param p pointer to the asyncemsmdb session
    \param notif pointer to the mapistore newmail notification
    \param s pointer to the array of subscriptions for this session
+   \param folderId pointer to the FolderId the mail was delivered to
 
    \note newmail notification (popup) will only be triggered for
    emails delivered to Inbox. However, TableModified notification
-   should be triggered in every case if the subscription exists
+   should be triggered in every case if the subscription exists: the
+   caller is responsible for it, once per folder.
 
    \todo handle tablemodified delivered in other folders but Inbox
 
@@ -646,15 +649,15 @@ static int process_tablemodified_contentstable_notification(TALLOC_CTX *mem_ctx,
 static int process_newmail_notification(TALLOC_CTX *mem_ctx,
 					struct exchange_asyncemsmdb_session *p,
 					struct mapistore_notification *notif,
-					struct mapistore_notification_subscription *s)
+					struct mapistore_notification_subscription *s,
+					uint64_t *folderId)
 {
 	int				i;
 	int				index = -1;
 	enum MAPISTATUS			retval;
 	enum mapistore_error		ret;
-	int				rval;
 	struct indexing_context		*ictx;
-	uint64_t			fid;
+	uint64_t			fid = 0;
 	uint64_t			mid;
 	char				*folder_uri = NULL;
 	char				*message_uri = NULL;
@@ -788,14 +791,152 @@ process:
 		return -1;
 	}
 
-	rval = process_tablemodified_contentstable_notification(mem_ctx, p, s, fid);
-	if (rval != 0) {
-		OC_DEBUG(0, "TableModified notification failed");
-	}
+	*folderId = fid;
 
 	return 0;
 }
 
+
+static bool _str_equal(const char *a, const char *b)
+{
+	if (!a || !b) return a == b;
+	return !strcmp(a, b);
+}
+
+/**
+   \details Tell whether two notifications are duplicates
+
+   \param a pointer to the first notification
+   \param b pointer to the second notification
+
+   \return true if both notifications would result in the same
+   delivery, otherwise false
+ */
+static bool asyncemsmdb_notification_equal(struct mapistore_notification *a,
+					   struct mapistore_notification *b)
+{
+	if (a->vnum != b->vnum || a->v.v1.flags != b->v.v1.flags) return false;
+
+	switch (a->v.v1.flags) {
+	case (sub_NewMail):
+		return (a->v.v1.u.newmail.separator == b->v.v1.u.newmail.separator &&
+			_str_equal(a->v.v1.u.newmail.backend, b->v.v1.u.newmail.backend) &&
+			_str_equal(a->v.v1.u.newmail.folder, b->v.v1.u.newmail.folder) &&
+			_str_equal(a->v.v1.u.newmail.eml, b->v.v1.u.newmail.eml));
+	default:
+		return false;
+	}
+}
+
+
+/**
+   \details Unpack a notification received on the session socket
+
+   \param mem_ctx pointer to the memory context
+   \param str pointer to the received message
+   \param bytes the size of the received message
+
+   \return pointer to the notification on success, otherwise NULL
+ */
+static struct mapistore_notification *asyncemsmdb_pull_notification(TALLOC_CTX *mem_ctx,
+								    char *str, int bytes)
+{
+	struct mapistore_notification	*n;
+	struct ndr_pull			*ndr_pull;
+	enum ndr_err_code		ndr_err_code;
+	DATA_BLOB			blob;
+
+	n = talloc_zero(mem_ctx, struct mapistore_notification);
+	if (!n) {
+		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
+		return NULL;
+	}
+
+	blob.data = (uint8_t *) str;
+	blob.length = bytes;
+	ndr_pull = ndr_pull_init_blob(&blob, n);
+	if (!ndr_pull) {
+		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
+		talloc_free(n);
+		return NULL;
+	}
+	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+
+	ndr_err_code = ndr_pull_mapistore_notification(ndr_pull, NDR_SCALARS, n);
+	talloc_free(ndr_pull);
+	if (ndr_err_code != NDR_ERR_SUCCESS) {
+		OC_DEBUG(0, "[asyncemsmdb]: Invalid mapistore_notification structure");
+		talloc_free(n);
+		return NULL;
+	}
+
+	/* Sanity checks on notification payload */
+	if (n->vnum >= MAPISTORE_NOTIFICATION_VMAX) {
+		OC_DEBUG(0, "[asyncemsmdb]: Invalid version, expected at max %d but got %d",
+			 MAPISTORE_NOTIFICATION_VMAX - 1, n->vnum);
+		talloc_free(n);
+		return NULL;
+	}
+
+	return n;
+}
+
+
+/**
+   \details Retrieve the subscriptions of the session. Subscriptions
+   are cached for asyncemsmdb:subscription_cache_ttl seconds.
+
+   \param p pointer to the asyncemsmdb session
+   \param refresh whether the cached subscriptions must be dropped
+
+   \return pointer to the subscriptions on success, otherwise NULL
+ */
+static struct mapistore_notification_subscription *asyncemsmdb_get_subscriptions(struct exchange_asyncemsmdb_session *p,
+										  bool refresh)
+{
+	struct mapistore_notification_subscription	*r;
+	enum mapistore_error				retval;
+	time_t						now;
+
+	now = time(NULL);
+	if (p->subscriptions && !refresh && (now - p->subscriptions_time) < p->subscriptions_ttl) {
+		return p->subscriptions;
+	}
+
+	talloc_free(p->subscriptions);
+	p->subscriptions = NULL;
+
+	r = talloc_zero(p->mem_ctx, struct mapistore_notification_subscription);
+	if (!r) {
+		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
+		return NULL;
+	}
+
+	retval = mapistore_notification_subscription_get(r, p->mstore_ctx, p->emsmdb_uuid, r);
+	if (retval != MAPISTORE_SUCCESS) {
+		talloc_free(r);
+		return NULL;
+	}
+
+	p->subscriptions = r;
+	p->subscriptions_time = now;
+
+	return r;
+}
+
+
+static bool asyncemsmdb_subscription_match(struct mapistore_notification_subscription *s,
+					   uint16_t flags)
+{
+	uint32_t	i;
+
+	for (i = 0; i < s->v.v1.count; i++) {
+		if (s->v.v1.subscription[i].flags & flags) return true;
+	}
+
+	return false;
+}
+
 static void EcDoAsyncWaitEx_handler(struct tevent_context *ev,
 				    struct tevent_fd *fde,
 				    uint16_t flags,
@@ -804,113 +945,153 @@ static void EcDoAsyncWaitEx_handler(struct tevent_context *ev,
 	struct exchange_asyncemsmdb_session		*p = talloc_get_type(asyncemsmdb_session,
 									     struct exchange_asyncemsmdb_session);
 	TALLOC_CTX					*mem_ctx;
-	enum mapistore_error				retval;
 	int						ret;
-	DATA_BLOB					blob;
 	char						*str = NULL;
 	int						bytes = 0;
 	NTSTATUS					status;
-	struct mapistore_notification_subscription	r;
-	struct mapistore_notification			n;
-	struct ndr_print				*ndr_print;
-	struct ndr_pull					*ndr_pull;
-	enum ndr_err_code				ndr_err_code;
+	struct mapistore_notification_subscription	*r;
+	struct mapistore_notification			*n;
+	struct mapistore_notification			**batch;
+	uint32_t					count = 0;
+	uint32_t					received = 0;
+	uint64_t					*fids;
+	uint32_t					fids_count = 0;
+	uint64_t					fid;
+	uint32_t					delivered = 0;
+	bool						refreshed = false;
+	struct ndr_print				*ndr_print = NULL;
 	struct oc_timer_ctx				*oc_t_ctx;
+	uint32_t					i;
+	uint32_t					j;
 
 	if (!p) {
 		OC_DEBUG(0, "[asyncemsmdb]: private_data is NULL");
 		return;
 	}
 	oc_t_ctx = OC_TIMER_START;
-	bytes = nn_recv(p->sock, &str, NN_MSG, NN_DONTWAIT);
-	if (bytes == 0) {
-		OC_DEBUG(0, "[asyncemsmdb]: EcDoAsyncWaitEx_handler: str is NULL!");
-		oc_timer_end(oc_t_ctx);
-		return;
-	}
 
 	mem_ctx = talloc_new(NULL);
-	if (!mem_ctx) {
+	batch = talloc_array(mem_ctx, struct mapistore_notification *, p->drain_batch);
+	fids = talloc_array(mem_ctx, uint64_t, p->drain_batch);
+	if (!mem_ctx || !batch || !fids) {
 		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
+		talloc_free(mem_ctx);
 		oc_timer_end(oc_t_ctx);
 		return;
 	}
 
-	blob.data = (uint8_t *) str;
-	blob.length = bytes;
-	ndr_pull = ndr_pull_init_blob(&blob, mem_ctx);
-	if (!ndr_pull) {
-		nn_freemsg(str);
-		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
-		oc_timer_end(oc_t_ctx);
-		return;
+	if (CHECK_DEBUGLVL(5)) {
+		ndr_print = talloc_zero(mem_ctx, struct ndr_print);
+		if (ndr_print) {
+			ndr_print->depth = 1;
+			ndr_print->print = ndr_print_debug_helper;
+			ndr_print->no_newline = false;
+		}
 	}
-	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
 
-	ndr_err_code = ndr_pull_mapistore_notification(ndr_pull, NDR_SCALARS, &n);
-	nn_freemsg(str);
-	if (ndr_err_code != NDR_ERR_SUCCESS) {
-		OC_DEBUG(0, "[asyncemsmdb]: Invalid mapistore_notification structure");
-		talloc_free(mem_ctx);
-		oc_timer_end(oc_t_ctx);
-		return;
+	/* Step 1. Drain pending notifications and drop duplicates */
+	while (received < p->drain_batch) {
+		bytes = nn_recv(p->sock, &str, NN_MSG, NN_DONTWAIT);
+		if (bytes < 0) break;
+		received++;
+		if (bytes == 0) {
+			OC_DEBUG(0, "[asyncemsmdb]: EcDoAsyncWaitEx_handler: str is NULL!");
+			nn_freemsg(str);
+			continue;
+		}
+
+		n = asyncemsmdb_pull_notification(mem_ctx, str, bytes);
+		nn_freemsg(str);
+		if (!n) continue;
+
+		if (ndr_print) {
+			ndr_print_mapistore_notification(ndr_print, "notification", n);
+		}
+
+		for (i = 0; i < count; i++) {
+			if (asyncemsmdb_notification_equal(batch[i], n)) break;
+		}
+		if (i < count) {
+			OC_DEBUG(5, "[asyncemsmdb]: Dropping duplicate notification");
+			talloc_free(n);
+			continue;
+		}
+		batch[count++] = n;
 	}
 
-	/* Sanity checks on notification payload */
-	if (n.vnum >= MAPISTORE_NOTIFICATION_VMAX) {
-		OC_DEBUG(0, "[asyncemsmdb]: Invalid version, expected at max %d but got %d",
-			 MAPISTORE_NOTIFICATION_VMAX - 1, n.vnum);
+	if (!count) {
 		talloc_free(mem_ctx);
 		oc_timer_end(oc_t_ctx);
 		return;
 	}
 
-	ndr_print = talloc_zero(mem_ctx, struct ndr_print);
-	if (!ndr_print) {
-		OC_DEBUG(0, "[asyncemsmdb]: No more memory");
+	OC_DEBUG(5, "%u notifications received (%u distinct) for session: %s",
+		 received, count, p->emsmdb_session_str);
+
+	/* Step 2. Retrieve subscriptions */
+	r = asyncemsmdb_get_subscriptions(p, false);
+	if (!r) {
+		OC_DEBUG(0, "no subscription to process");
 		talloc_free(mem_ctx);
 		oc_timer_end(oc_t_ctx);
 		return;
 	}
-	ndr_print->depth = 1;
-	ndr_print->print = ndr_print_debug_helper;
-	ndr_print->no_newline = false;
 
-	ndr_print_mapistore_notification(ndr_print, "notification", &n);
+	/* Step 3. Process notifications */
+	for (i = 0; i < count; i++) {
+		n = batch[i];
+		switch (n->v.v1.flags) {
+		case (sub_NewMail):
+			/* Cached subscriptions may be stale: refresh them once */
+			if (!asyncemsmdb_subscription_match(r, sub_NewMail) && !refreshed) {
+				refreshed = true;
+				r = asyncemsmdb_get_subscriptions(p, true);
+				if (!r) {
+					OC_DEBUG(0, "no subscription to process");
+					talloc_free(mem_ctx);
+					oc_timer_end(oc_t_ctx);
+					return;
+				}
+			}
 
-	OC_DEBUG(5, "Notification received for session: %s", p->emsmdb_session_str);
+			ret = process_newmail_notification(mem_ctx, p, n, r, &fid);
+			if (ret) {
+				OC_DEBUG(0, "[asyncemsmdb]: Failed to process newmail notification (error=0x%x)", ret);
+				continue;
+			}
+			delivered++;
 
-	retval = mapistore_notification_subscription_get(mem_ctx, p->mstore_ctx, p->emsmdb_uuid, &r);
-	if (retval != MAPISTORE_SUCCESS) {
-		OC_DEBUG(0, "no subscription to process");
-		talloc_free(mem_ctx);
-		oc_timer_end(oc_t_ctx);
-		return;
+			/* TableModified notifications are sent once per folder */
+			for (j = 0; j < fids_count; j++) {
+				if (fids[j] == fid) break;
+			}
+			if (j == fids_count) {
+				fids[fids_count++] = fid;
+			}
+			break;
+		default:
+			OC_DEBUG(0, "[asyncemsmdb]: Unsupported notification 0x%x", n->v.v1.flags);
+			break;
+		}
 	}
 
-	OC_DEBUG(5, "%d subscriptions available:", r.v.v1.count);
-	ndr_print_mapistore_notification_subscription(ndr_print, "subscriptions", &r);
-	talloc_free(ndr_print);
+	if (ndr_print) {
+		OC_DEBUG(5, "%d subscriptions available:", r->v.v1.count);
+		ndr_print_mapistore_notification_subscription(ndr_print, "subscriptions", r);
+	}
 
-	/* Process notifications */
-	switch (n.v.v1.flags) {
-	case (sub_NewMail):
-		ret = process_newmail_notification(mem_ctx, p, &n, &r);
-		if (ret) {
-			OC_DEBUG(0, "[asyncemsmdb]: Failed to process newmail notification (error=0x%x)", ret);
-			talloc_free(mem_ctx);
-			oc_timer_end(oc_t_ctx);
-			return;
+	for (j = 0; j < fids_count; j++) {
+		ret = process_tablemodified_contentstable_notification(mem_ctx, p, r, fids[j]);
+		if (ret != 0) {
+			OC_DEBUG(0, "TableModified notification failed");
 		}
-		break;
-	default:
-		OC_DEBUG(0, "[asyncemsmdb]: Unsupported notification 0x%x", n.v.v1.flags);
-		talloc_free(mem_ctx);
+	}
+	talloc_free(mem_ctx);
+
+	if (!delivered) {
 		oc_timer_end(oc_t_ctx);
 		return;
 	}
-	talloc_free(ndr_pull);
-	talloc_free(mem_ctx);
 
 	p->r->out.pulFlagsOut = talloc_zero(p->dce_call, uint32_t);
 	*p->r->out.pulFlagsOut = 0x1;
@@ -1055,6 +1236,14 @@ static NTSTATUS dcesrv_EcDoAsyncWaitEx(struct dcesrv_call_state *dce_call,
 		session->r = r;
 		session->fd_event = NULL;
 
+		session->drain_batch = lpcfg_parm_int(dce_call->conn->dce_ctx->lp_ctx, NULL, "asyncemsmdb",
+						      "drain_batch", ASYNCEMSMDB_DRAIN_BATCH);
+		if (session->drain_batch < 1) {
+			session->drain_batch = 1;
+		}
+		session->subscriptions_ttl = lpcfg_parm_int(dce_call->conn->dce_ctx->lp_ctx, NULL, "asyncemsmdb",
+							    "subscription_cache_ttl", ASYNCEMSMDB_SUBSCRIPTION_TTL);
+
 		session->sock = nn_socket(AF_SP, NN_PULL);
 		if (session->sock == -1) {
 			OC_DEBUG(0, "[asyncemsmdb]: failed to create socket: %s", nn_strerror(errno));
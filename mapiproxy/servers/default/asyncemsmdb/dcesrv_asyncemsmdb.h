@@ -50,6 +50,10 @@ struct exchange_asyncemsmdb_session {
 	int					sock;
 	int					fd;
 	int					lock;
+	int					drain_batch;
+	int					subscriptions_ttl;
+	time_t					subscriptions_time;
+	struct mapistore_notification_subscription	*subscriptions;
 };
 
 
@@ -83,6 +87,11 @@ __END_DECLS
 #define	ASYNCEMSMDB_FALLBACK_ADDR	"127.0.0.1"
 #define	ASYNCEMSMDB_INBOX_SYSTEMIDX	13
 
+/* Maximum number of notifications drained per wakeup and number of
+ * seconds session subscriptions are cached */
+#define	ASYNCEMSMDB_DRAIN_BATCH		64
+#define	ASYNCEMSMDB_SUBSCRIPTION_TTL	5
+
 #define	ASYNCEMSMDB_SPACE		' '
 #define	ASYNCEMSMDB_SOGO_SPACE		"_SP_"
 #define	ASYNCEMSMDB_SOGO_SPACE_LEN	4
@@ -31,8 +31,10 @@
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "mapiproxy/util/oc_timer.h"
+#include "mapiproxy/util/oc_rop_stats.h"
 #include "mapiproxy/libmapiproxy/fault_util.h"
 #include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "libmapi/libmapi_private.h"
 #include "dcesrv_exchange_emsmdb.h"
 
 void					*openchange_db_ctx = NULL;
@@ -265,6 +267,242 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
 	return MAPI_E_SUCCESS;
 }
 
+/* Smallest number of messages worth a preload round trip */
+#define EMSMDBP_ROP_BATCH_MIN	2
+
+struct EcDoRpc_batch_folder {
+	struct emsmdbp_object	*folder_object;
+	struct mapi_handles	*folder_rec;
+	struct UI8Array_r	mids;
+};
+
+/**
+   \details Return whether a ROP only reads from the store. The batch
+   scanner stops at the first ROP which is not, so nothing is prefetched
+   across a write.
+ */
+static bool EcDoRpc_rop_is_read_only(uint8_t opnum)
+{
+	switch (opnum) {
+	case op_MAPI_Release:
+	case op_MAPI_OpenFolder:
+	case op_MAPI_OpenMessage:
+	case op_MAPI_GetHierarchyTable:
+	case op_MAPI_GetContentsTable:
+	case op_MAPI_GetProps:
+	case op_MAPI_GetPropsAll:
+	case op_MAPI_GetPropList:
+	case op_MAPI_SetColumns:
+	case op_MAPI_QueryRows:
+	case op_MAPI_QueryPosition:
+	case op_MAPI_SeekRow:
+	case op_MAPI_GetAttachmentTable:
+	case op_MAPI_OpenAttach:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+   \details Retrieve the handle index a read-only ROP stores the object
+   it creates into
+
+   \return true if the ROP creates an object, otherwise false
+ */
+static bool EcDoRpc_rop_output_handle_idx(struct EcDoRpc_MAPI_REQ *mapi_req, uint8_t *handle_idx)
+{
+	switch (mapi_req->opnum) {
+	case op_MAPI_OpenFolder:
+		*handle_idx = mapi_req->u.mapi_OpenFolder.handle_idx;
+		return true;
+	case op_MAPI_OpenMessage:
+		*handle_idx = mapi_req->u.mapi_OpenMessage.handle_idx;
+		return true;
+	case op_MAPI_GetHierarchyTable:
+		*handle_idx = mapi_req->u.mapi_GetHierarchyTable.handle_idx;
+		return true;
+	case op_MAPI_GetContentsTable:
+		*handle_idx = mapi_req->u.mapi_GetContentsTable.handle_idx;
+		return true;
+	case op_MAPI_GetAttachmentTable:
+		*handle_idx = mapi_req->u.mapi_GetAttachmentTable.handle_idx;
+		return true;
+	case op_MAPI_OpenAttach:
+		*handle_idx = mapi_req->u.mapi_OpenAttach.handle_idx;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+   \details Resolve the mapistore folder an OpenMessage ROP opens its
+   message from, when the message is opened directly from its parent
+   folder handle.
+
+   \return the folder object on success, otherwise NULL
+ */
+static struct emsmdbp_object *EcDoRpc_batch_get_folder(struct emsmdbp_context *emsmdbp_ctx,
+						       struct EcDoRpc_MAPI_REQ *mapi_req,
+						       uint32_t *handles, uint32_t handles_count,
+						       struct mapi_handles **recp)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_handles	*rec = NULL;
+	struct emsmdbp_object	*object;
+	void			*data = NULL;
+
+	if (mapi_req->handle_idx >= handles_count) return NULL;
+
+	retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, handles[mapi_req->handle_idx], &rec);
+	if (retval != MAPI_E_SUCCESS) return NULL;
+
+	mapi_handles_get_private_data(rec, &data);
+	object = (struct emsmdbp_object *)data;
+	if (!object || object->type != EMSMDBP_OBJECT_FOLDER) return NULL;
+	if (object->object.folder->folderID != mapi_req->u.mapi_OpenMessage.FolderId) return NULL;
+	if (!emsmdbp_is_mapistore(object)) return NULL;
+
+	*recp = rec;
+	return object;
+}
+
+/**
+   \details Retrieve the table the messages of a folder batch are
+   preloaded from. OpenMessage does not tell whether a message is
+   FAI, so the type comes from the contents tables the client opened
+   on the folder with or without the Associated flag.
+
+   \param folder_rec pointer to the folder MAPI handle
+   \param table_type pointer to the table type to return
+
+   \return true on success, false if both FAI and regular contents
+   tables are open on the folder
+ */
+static bool EcDoRpc_batch_get_table_type(struct mapi_handles *folder_rec,
+					 enum mapistore_table_type *table_type)
+{
+	struct mapi_handles	*child;
+	struct emsmdbp_object	*object;
+	void			*data;
+	bool			fai = false;
+	bool			regular = false;
+
+	for (child = folder_rec->children; child; child = child->next) {
+		data = NULL;
+		mapi_handles_get_private_data(child, &data);
+		object = (struct emsmdbp_object *)data;
+		if (!object || object->type != EMSMDBP_OBJECT_TABLE) continue;
+
+		if (object->object.table->ulType == MAPISTORE_FAI_TABLE) {
+			fai = true;
+		} else if (object->object.table->ulType == MAPISTORE_MESSAGE_TABLE) {
+			regular = true;
+		}
+	}
+
+	if (fai && regular) return false;
+
+	*table_type = fai ? MAPISTORE_FAI_TABLE : MAPISTORE_MESSAGE_TABLE;
+	return true;
+}
+
+/**
+   \details Scan the leading read-only ROPs of a request and ask
+   mapistore to preload, in one round trip per folder, the messages
+   they are about to open. ROPs are still executed one by one in
+   request order afterwards: preloading is only a hint for the backend
+   and does not change any reply.
+
+   An OpenMessage ROP is batched only if its input handle already
+   exists when the request comes in, that is to say it is not the
+   output of a previous ROP of the same request.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param mapi_request pointer to the MAPI request to scan
+ */
+static void EcDoRpc_prefetch_transaction(struct emsmdbp_context *emsmdbp_ctx,
+					 struct mapi_request *mapi_request)
+{
+	TALLOC_CTX			*local_mem_ctx;
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	struct EcDoRpc_batch_folder	*batches = NULL;
+	struct EcDoRpc_batch_folder	*batch;
+	struct emsmdbp_object		*folder_object;
+	struct mapi_handles		*folder_rec = NULL;
+	enum mapistore_table_type	table_type;
+	bool				produced[256];
+	uint32_t			handles_count;
+	uint32_t			batches_count = 0;
+	uint32_t			i;
+	uint32_t			j;
+	uint8_t				handle_idx;
+
+	handles_count = (mapi_request->mapi_len - mapi_request->length) / sizeof(uint32_t);
+	memset(produced, 0, sizeof(produced));
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) return;
+
+	for (i = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
+		mapi_req = &mapi_request->mapi_req[i];
+		if (!EcDoRpc_rop_is_read_only(mapi_req->opnum)) {
+			break;
+		}
+
+		if (mapi_req->opnum == op_MAPI_OpenMessage && !produced[mapi_req->handle_idx]
+		    && !(mapi_req->u.mapi_OpenMessage.OpenModeFlags & OpenSoftDelete)) {
+			folder_object = EcDoRpc_batch_get_folder(emsmdbp_ctx, mapi_req,
+								 mapi_request->handles, handles_count,
+								 &folder_rec);
+			if (folder_object) {
+				batch = NULL;
+				for (j = 0; j < batches_count; j++) {
+					if (batches[j].folder_object == folder_object) {
+						batch = &batches[j];
+						break;
+					}
+				}
+				if (!batch) {
+					batches = talloc_realloc(local_mem_ctx, batches, struct EcDoRpc_batch_folder,
+								 batches_count + 1);
+					if (!batches) goto end;
+					batch = &batches[batches_count++];
+					batch->folder_object = folder_object;
+					batch->folder_rec = folder_rec;
+					batch->mids.cValues = 0;
+					batch->mids.lpui8 = NULL;
+				}
+				batch->mids.lpui8 = talloc_realloc(batches, batch->mids.lpui8, uint64_t,
+								   batch->mids.cValues + 1);
+				if (!batch->mids.lpui8) goto end;
+				batch->mids.lpui8[batch->mids.cValues++] = mapi_req->u.mapi_OpenMessage.MessageId;
+			}
+		}
+
+		if (EcDoRpc_rop_output_handle_idx(mapi_req, &handle_idx)) {
+			produced[handle_idx] = true;
+		}
+	}
+
+	for (j = 0; j < batches_count; j++) {
+		if (batches[j].mids.cValues < EMSMDBP_ROP_BATCH_MIN) continue;
+		if (!EcDoRpc_batch_get_table_type(batches[j].folder_rec, &table_type)) continue;
+
+		OC_DEBUG(5, "Preloading %"PRIu32" %s messages from folder 0x%.16"PRIx64,
+			 batches[j].mids.cValues, (table_type == MAPISTORE_FAI_TABLE) ? "FAI" : "regular",
+			 batches[j].folder_object->object.folder->folderID);
+		mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx,
+							emsmdbp_get_contextID(batches[j].folder_object),
+							batches[j].folder_object->backend_object,
+							table_type, &batches[j].mids);
+	}
+
+end:
+	talloc_free(local_mem_ctx);
+}
+
 static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 							 struct emsmdbp_context *emsmdbp_ctx,
 							 struct mapi_request *mapi_request)
@@ -292,16 +530,23 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 		goto notif;
 	}
 
-	/* Step 2. Process serialized MAPI requests */
+	/* Step 2. Preload the messages the leading read-only ROPs will open */
+	EcDoRpc_prefetch_transaction(emsmdbp_ctx, mapi_request);
+
+	/* Step 3. Process serialized MAPI requests */
 	mapi_response->mapi_repl = talloc_zero(mem_ctx, struct EcDoRpc_MAPI_REPL);
 	for (i = 0, idx = 0, size = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
 		struct oc_timer_ctx	*oc_t_ctx;
+		struct oc_rop_stats_call rop_call;
+		uint32_t		rop_size;
 		char			*op_description;
 
 		op_description = talloc_asprintf(mem_ctx, "EMSMDB operation 0x%02X",
 		                                 mapi_request->mapi_req[i].opnum);
 		oc_t_ctx = oc_timer_start(OC_TIMER_DEFAULT_LOG_LEVEL, op_description);
 		OC_DEBUG(0, "MAPI Rop: 0x%.2x (%d)\n", mapi_request->mapi_req[i].opnum, size);
+		oc_rop_stats_rop_start(&rop_call);
+		rop_size = size;
 
 		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
 			mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl,
@@ -890,11 +1135,16 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 		if (retval) {
 			OC_DEBUG(5, "MAPI Rop: 0x%.2x [retval=0x%.8x]\n", mapi_request->mapi_req[i].opnum, retval);
 		}
+		/* The ROP handlers update size as a 16 bits counter, the
+		   difference is taken modulo 2^16 so a counter that wrapped
+		   during this ROP still yields its response size */
+		oc_rop_stats_rop_end(&rop_call, mapi_request->mapi_req[i].opnum,
+				     retval != MAPI_E_SUCCESS, (uint16_t)(size - rop_size));
 		oc_timer_end(oc_t_ctx);
 	}
 
 notif:
-	/* Step 3. Notifications/Pending calls should be processed here */
+	/* Step 4. Notifications/Pending calls should be processed here */
 	/* Note: GetProps and GetRows are filled with flag NDR_REMAINING, which may hide the content of the following replies. */
 	{
 		DATA_BLOB		payload;
@@ -956,11 +1206,14 @@ end:
 		mapi_response->mapi_repl[idx].opnum = 0;
 	}
 
-	/* Step 4. Fill mapi_response structure */
+	/* Step 5. Fill mapi_response structure */
 	handles_length = mapi_request->mapi_len - mapi_request->length;
 	mapi_response->length = size + sizeof (mapi_response->length);
 	mapi_response->mapi_len = mapi_response->length + handles_length;
 
+	/* Step 6. Dump ROP statistics if requested */
+	oc_rop_stats_dump_pending();
+
 	return mapi_response;
 }
 
@@ -1388,11 +1641,10 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi2k7_request		mapi2k7_request;
 	struct mapi_response		*mapi_response;
-	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
 	struct ndr_pull			*ndr_pull = NULL;
 	struct ndr_push			*ndr_uncomp_rgbOut;
-	struct ndr_push			*ndr_comp_rgbOut;
 	struct ndr_push			*ndr_rgbOut;
+	uint16_t			rhef_flags;
 	uint32_t			pulFlags = 0x0;
 	uint32_t			pulTransTime = 0;
 	DATA_BLOB			rgbIn;
@@ -1448,6 +1700,14 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 		return ecRpcFormat;
 	}
 
+	/* Response header flags, pulFlags is overwritten in the reply */
+	rhef_flags = RHEF_Last;
+	rhef_flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
+	if (!(*r->in.pulFlags & pulFlags_NoCompression) &&
+	    lpcfg_parm_bool(emsmdbp_ctx->lp_ctx, NULL, "exchange_emsmdb", "compression", false)) {
+		rhef_flags |= RHEF_Compressed;
+	}
+
 	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request);
 	talloc_free(mapi2k7_request.mapi_request);
 
@@ -1461,26 +1721,15 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
 	talloc_free(mapi_response);
 
-	/* TODO: compress if requested */
-	ndr_comp_rgbOut = ndr_uncomp_rgbOut;
-
-	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_Last;
-	RPC_HEADER_EXT.Flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
-	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbOut->offset;
-
-	/* Obfuscate content if applicable*/
-	if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
-		obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
-	}
-
-	/* Push the constructed blob */
+	/* Push the MAPI response straight into the output blob */
 	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	ndr_err = ndr_push_mapi2k7_payload(ndr_rgbOut, rhef_flags, ndr_uncomp_rgbOut->data, ndr_uncomp_rgbOut->offset);
+	talloc_free(ndr_uncomp_rgbOut);
+	if (ndr_err != NDR_ERR_SUCCESS) {
+		r->out.result = ecRpcFailed;
+		return ecRpcFailed;
+	}
 
 	/* Push MAPI response into a DATA blob */
 	r->out.rgbOut = ndr_rgbOut->data;
@@ -1723,6 +1972,9 @@ static NTSTATUS dcesrv_exchange_emsmdb_dispatch(struct dcesrv_call_state *dce_ca
  */
 static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 {
+	char		*rop_stats_dir;
+	int		rop_stats_interval;
+
 	/* Open read/write context on OpenChange dispatcher database */
 	openchange_db_ctx = emsmdbp_openchangedb_init(dce_ctx->lp_ctx);
 	if (!openchange_db_ctx) {
@@ -1730,6 +1982,17 @@ static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 		return NT_STATUS_INTERNAL_ERROR;
 	}
 
+	/* Enable per-ROP statistics, inherited by forked server processes */
+	if (lpcfg_parm_bool(dce_ctx->lp_ctx, NULL, "mapiproxy", "rop_stats", false)) {
+		rop_stats_interval = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "mapiproxy", "rop_stats_interval", 60);
+		rop_stats_dir = talloc_asprintf(dce_ctx, "%s/%s", lpcfg_private_dir(dce_ctx->lp_ctx),
+						OC_ROP_STATS_DIRNAME);
+		if (!rop_stats_dir || !oc_rop_stats_init(rop_stats_dir, rop_stats_interval > 0 ? rop_stats_interval : 0)) {
+			OC_DEBUG(1, "[exchange_emsmdb] Unable to enable ROP statistics");
+		}
+		talloc_free(rop_stats_dir);
+	}
+
 	return NT_STATUS_OK;
 }
 
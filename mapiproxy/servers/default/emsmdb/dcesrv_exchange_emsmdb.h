@@ -46,6 +46,8 @@
 #endif
 #endif
 
+struct emsmdbp_hierarchy;
+
 struct emsmdbp_context {
 	char					*szUserDN;
 	char					*szDisplayName;
@@ -62,11 +64,25 @@ struct emsmdbp_context {
 	TALLOC_CTX				*mem_ctx;
 	struct GUID				session_uuid;
 	struct mapi_logon_context		*logon_ctx;
+	struct emsmdbp_hierarchy		*hierarchy;
+};
+
+/* Storage of a stream being written: data is kept in fixed size
+   chunks and moved to an unlinked temporary file once the stream
+   grows past spill_size */
+struct emsmdbp_stream_storage {
+	uint8_t			**chunks;
+	uint32_t		chunk_count;
+	int			fd;
 };
 
+/* buffer.data is only valid when storage is NULL, buffer.length is
+   always the stream size */
 struct emsmdbp_stream {
-	size_t			position;
-	DATA_BLOB		buffer;
+	size_t				position;
+	DATA_BLOB			buffer;
+	size_t				spill_size;
+	struct emsmdbp_stream_storage	*storage;
 };
 
 struct emsmdbp_syncconfigure_request {
@@ -243,6 +259,11 @@ struct emsmdbp_object {
 #define	EMSMDB_PCRETRY			6
 #define	EMSMDB_PCRETRYDELAY		10000
 
+#define	EMSMDBP_HIERARCHY_TTL		30
+
+#define	EMSMDBP_STREAM_CHUNK_SIZE	0x10000
+#define	EMSMDBP_STREAM_SPILL_SIZE	4
+
 enum emsmdbp_mailbox_systemidx {
 	EMSMDBP_MAILBOX_ROOT = 1,
 	EMSMDBP_DEFERRED_ACTION,
@@ -322,6 +343,15 @@ int		      emsmdbp_get_uri_from_fid(TALLOC_CTX *, struct emsmdbp_context *, uint
 int		      emsmdbp_get_fid_from_uri(struct emsmdbp_context *, const char *, uint64_t *);
 uint32_t	      emsmdbp_get_contextID(struct emsmdbp_object *);
 
+/* definitions from emsmdbp_hierarchy.c */
+enum MAPISTATUS	      emsmdbp_folder_get_recursive_folder_count(struct emsmdbp_context *, struct emsmdbp_object *, uint32_t *);
+void		      emsmdbp_hierarchy_invalidate(struct emsmdbp_context *, uint64_t);
+
+/* definitions from emsmdbp_stream.c */
+DATA_BLOB	      emsmdbp_stream_read_buffer(TALLOC_CTX *, struct emsmdbp_stream *, uint32_t);
+enum MAPISTATUS	      emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
+DATA_BLOB	      emsmdbp_stream_flatten(TALLOC_CTX *, struct emsmdbp_stream *);
+
 /* definitions from emsmdbp_provisioning.c */
 enum MAPISTATUS       emsmdbp_mailbox_provision(struct emsmdbp_context *, const char *);
 enum MAPISTATUS       emsmdbp_mailbox_provision_public_freebusy(struct emsmdbp_context *, const char *);
@@ -343,7 +373,6 @@ enum MAPISTATUS emsmdbp_object_copy_properties_submit(struct emsmdbp_context *,
 struct emsmdbp_object *emsmdbp_object_mailbox_init(TALLOC_CTX *, struct emsmdbp_context *, const char *, bool);
 struct emsmdbp_object *emsmdbp_object_folder_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum MAPISTATUS      emsmdbp_folder_get_folder_count(struct emsmdbp_context *, struct emsmdbp_object *, uint32_t *);
-enum MAPISTATUS emsmdbp_folder_get_recursive_folder_count(struct emsmdbp_context *, struct emsmdbp_object *, uint32_t *);
 enum mapistore_error emsmdbp_folder_delete_indexing_records(struct mapistore_context *, uint32_t, char *, uint64_t, uint64_t *, uint32_t, uint8_t);
 enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint8_t);
 enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context *, struct emsmdbp_object *, struct emsmdbp_object *, TALLOC_CTX *, const char *);
@@ -366,8 +395,6 @@ struct emsmdbp_object *emsmdbp_object_synccontext_init(TALLOC_CTX *, struct emsm
 struct emsmdbp_object *emsmdbp_object_ftcontext_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *, enum MAPITAGS, void *value, bool);
 struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *, enum MAPITAGS);
-DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *, uint32_t);
-void emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
 void emsmdbp_fill_table_row_blob(TALLOC_CTX *, struct emsmdbp_context *, DATA_BLOB *, uint16_t, enum MAPITAGS *, void **, enum MAPISTATUS *);
 void emsmdbp_fill_row_blob(TALLOC_CTX *, struct emsmdbp_context *, uint8_t *, DATA_BLOB *,struct SPropTagArray *, void **, enum MAPISTATUS *, bool *);
 enum MAPISTATUS emsmdbp_object_attach_sharing_metadata_XML_file(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *sharing_object);
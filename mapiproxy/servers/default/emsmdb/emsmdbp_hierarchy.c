@@ -0,0 +1,417 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_hierarchy.c
+
+   \brief Folder hierarchy cache
+
+   Each session keeps, for every mailbox it opened, a tree of the
+   folders it walked: the child folder identifiers of each folder and
+   the number of folders below it. Nodes are loaded from mapistore or
+   openchangedb the first time they are needed and reloaded once their
+   TTL expired, so changes made by other sessions are picked up. Folder
+   creation, deletion and moves made by the session drop the affected
+   nodes and the cached counts of their ancestors.
+ */
+
+#include <time.h>
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+#include "utils/dlinklist.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+/* Guard against corrupted parent links */
+#define	EMSMDBP_HIERARCHY_MAX_DEPTH	256
+
+struct emsmdbp_hierarchy_node {
+	uint64_t			fid;
+	uint64_t			parent_fid;
+	uint64_t			*children;
+	uint32_t			child_count;
+	uint32_t			subtree_count;
+	bool				subtree_valid;
+	time_t				expires;
+};
+
+struct emsmdbp_hierarchy {
+	struct emsmdbp_hierarchy	*prev;
+	struct emsmdbp_hierarchy	*next;
+	char				*owner;
+	struct htable			nodes_ht;
+	uint32_t			ttl;
+};
+
+/* Folder being walked, opened only if its node must be loaded */
+struct emsmdbp_hierarchy_walk {
+	struct emsmdbp_hierarchy_walk	*parent;
+	uint64_t			fid;
+	struct emsmdbp_object		*folder;
+	bool				opened;
+};
+
+static size_t emsmdbp_hierarchy_fid_hash(uint64_t fid)
+{
+	return hash64_stable(&fid, 1, 0);
+}
+
+static size_t _node_rehash(const void *e, void *unused)
+{
+	return emsmdbp_hierarchy_fid_hash(((const struct emsmdbp_hierarchy_node *)e)->fid);
+}
+
+static bool _node_cmp(const void *e, void *k)
+{
+	return ((const struct emsmdbp_hierarchy_node *)e)->fid == *(uint64_t *)k;
+}
+
+static struct emsmdbp_hierarchy_node *emsmdbp_hierarchy_node_get(struct emsmdbp_hierarchy *hierarchy, uint64_t fid)
+{
+	return htable_get(&hierarchy->nodes_ht, emsmdbp_hierarchy_fid_hash(fid), _node_cmp, &fid);
+}
+
+/**
+   \details Retrieve the identifier of a folder or mailbox object
+
+   \param object pointer to the folder or mailbox object
+
+   \return the folder identifier
+ */
+static uint64_t emsmdbp_hierarchy_object_fid(struct emsmdbp_object *object)
+{
+	if (object->type == EMSMDBP_OBJECT_MAILBOX) {
+		return object->object.mailbox->folderID;
+	}
+
+	return object->object.folder->folderID;
+}
+
+static int emsmdbp_hierarchy_destructor(struct emsmdbp_hierarchy *hierarchy)
+{
+	htable_clear(&hierarchy->nodes_ht);
+
+	return 0;
+}
+
+/**
+   \details Return the hierarchy cache of the mailbox a folder belongs
+   to, creating it if needed
+
+   \param emsmdbp_ctx pointer to the emsmdbp context
+   \param folder pointer to a folder or mailbox object
+
+   \return pointer to the hierarchy cache on success, otherwise NULL
+ */
+static struct emsmdbp_hierarchy *emsmdbp_hierarchy_get(struct emsmdbp_context *emsmdbp_ctx,
+							struct emsmdbp_object *folder)
+{
+	struct emsmdbp_hierarchy	*hierarchy;
+	const char			*owner;
+
+	owner = emsmdbp_get_owner(folder);
+	if (!owner) return NULL;
+
+	for (hierarchy = emsmdbp_ctx->hierarchy; hierarchy; hierarchy = hierarchy->next) {
+		if (!strcmp(hierarchy->owner, owner)) {
+			return hierarchy;
+		}
+	}
+
+	hierarchy = talloc_zero(emsmdbp_ctx, struct emsmdbp_hierarchy);
+	if (!hierarchy) return NULL;
+	hierarchy->owner = talloc_strdup(hierarchy, owner);
+	if (!hierarchy->owner) {
+		talloc_free(hierarchy);
+		return NULL;
+	}
+	hierarchy->ttl = lpcfg_parm_int(emsmdbp_ctx->lp_ctx, NULL, "exchange_emsmdb", "hierarchy_cache_ttl",
+					EMSMDBP_HIERARCHY_TTL);
+	htable_init(&hierarchy->nodes_ht, _node_rehash, NULL);
+	talloc_set_destructor(hierarchy, emsmdbp_hierarchy_destructor);
+	DLIST_ADD(emsmdbp_ctx->hierarchy, hierarchy);
+
+	return hierarchy;
+}
+
+/**
+   \details Retrieve the identifiers of the child folders of a folder
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdbp context
+   \param folder pointer to the folder or mailbox object
+   \param fidsp pointer on the array of folder identifiers to return
+   \param countp pointer on the number of folder identifiers to return
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsmdbp_hierarchy_fetch_children(TALLOC_CTX *mem_ctx,
+							struct emsmdbp_context *emsmdbp_ctx,
+							struct emsmdbp_object *folder,
+							uint64_t **fidsp,
+							uint32_t *countp)
+{
+	enum MAPISTATUS		retval;
+	enum mapistore_error	ret;
+	struct emsmdbp_object	*table_object;
+	void			**data_pointers;
+	enum MAPISTATUS		*retvals;
+	uint64_t		*fids;
+	uint32_t		count = 0;
+	uint32_t		i;
+
+	if (emsmdbp_is_mapistore(folder)) {
+		ret = mapistore_folder_get_child_fmids(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(folder),
+						       folder->backend_object, MAPISTORE_FOLDER_TABLE,
+						       mem_ctx, fidsp, countp);
+		return mapistore_error_to_mapi(ret);
+	}
+
+	retval = emsmdbp_folder_get_folder_count(emsmdbp_ctx, folder, &count);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	fids = talloc_array(mem_ctx, uint64_t, count);
+	OPENCHANGE_RETVAL_IF(!fids, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	*fidsp = fids;
+	*countp = 0;
+	if (!count) {
+		return MAPI_E_SUCCESS;
+	}
+
+	table_object = emsmdbp_folder_open_table(mem_ctx, folder, MAPISTORE_FOLDER_TABLE, 0);
+	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_INVALID_OBJECT, NULL);
+
+	table_object->object.table->prop_count = 1;
+	table_object->object.table->properties = talloc_array(table_object, enum MAPITAGS, 1);
+	OPENCHANGE_RETVAL_IF(!table_object->object.table->properties, MAPI_E_NOT_ENOUGH_MEMORY, table_object);
+	table_object->object.table->properties[0] = PidTagFolderId;
+
+	for (i = 0; i < count; i++) {
+		data_pointers = emsmdbp_object_table_get_row_props(table_object, emsmdbp_ctx, table_object,
+								   i, MAPISTORE_PREFILTERED_QUERY, &retvals);
+		if (data_pointers) {
+			if (retvals[0] == MAPI_E_SUCCESS) {
+				fids[(*countp)++] = *((uint64_t *)data_pointers[0]);
+			}
+			talloc_free(data_pointers);
+			talloc_free(retvals);
+		}
+	}
+	talloc_free(table_object);
+
+	return MAPI_E_SUCCESS;
+}
+
+static struct emsmdbp_object *emsmdbp_hierarchy_walk_folder(struct emsmdbp_context *emsmdbp_ctx,
+							    struct emsmdbp_hierarchy_walk *walk)
+{
+	struct emsmdbp_object	*parent;
+
+	if (!walk->folder && walk->parent) {
+		parent = emsmdbp_hierarchy_walk_folder(emsmdbp_ctx, walk->parent);
+		if (parent && emsmdbp_object_open_folder(NULL, emsmdbp_ctx, parent, walk->fid,
+							 &walk->folder) == MAPISTORE_SUCCESS) {
+			walk->opened = true;
+		} else {
+			walk->folder = NULL;
+		}
+	}
+
+	return walk->folder;
+}
+
+/**
+   \details Return the cached node of a folder, loading its children
+   if the node is missing or expired
+
+   \param emsmdbp_ctx pointer to the emsmdbp context
+   \param hierarchy pointer to the hierarchy cache
+   \param walk pointer to the folder being walked
+
+   \return pointer to the node on success, otherwise NULL
+ */
+static struct emsmdbp_hierarchy_node *emsmdbp_hierarchy_load(struct emsmdbp_context *emsmdbp_ctx,
+							     struct emsmdbp_hierarchy *hierarchy,
+							     struct emsmdbp_hierarchy_walk *walk)
+{
+	struct emsmdbp_hierarchy_node	*node;
+	struct emsmdbp_object		*folder;
+	uint64_t			*children = NULL;
+	uint32_t			child_count = 0;
+	time_t				now = time(NULL);
+
+	node = emsmdbp_hierarchy_node_get(hierarchy, walk->fid);
+	if (node && walk->parent) {
+		/* The node may have been loaded as the root of a walk */
+		node->parent_fid = walk->parent->fid;
+	}
+	if (node && node->expires > now) {
+		return node;
+	}
+
+	folder = emsmdbp_hierarchy_walk_folder(emsmdbp_ctx, walk);
+	if (!folder) return NULL;
+
+	if (!node) {
+		node = talloc_zero(hierarchy, struct emsmdbp_hierarchy_node);
+		if (!node) return NULL;
+		node->fid = walk->fid;
+		if (!htable_add(&hierarchy->nodes_ht, emsmdbp_hierarchy_fid_hash(node->fid), node)) {
+			talloc_free(node);
+			return NULL;
+		}
+	}
+	if (walk->parent) {
+		node->parent_fid = walk->parent->fid;
+	}
+
+	if (emsmdbp_hierarchy_fetch_children(node, emsmdbp_ctx, folder, &children, &child_count) != MAPI_E_SUCCESS) {
+		talloc_free(children);
+		node->expires = 0;
+		return NULL;
+	}
+
+	talloc_free(node->children);
+	node->children = children;
+	node->child_count = child_count;
+	node->subtree_valid = false;
+	node->expires = now + (hierarchy->ttl ? hierarchy->ttl : 1);
+
+	return node;
+}
+
+static uint32_t emsmdbp_hierarchy_subtree_count(struct emsmdbp_context *emsmdbp_ctx,
+						struct emsmdbp_hierarchy *hierarchy,
+						struct emsmdbp_hierarchy_walk *walk,
+						uint32_t depth, bool *completep)
+{
+	struct emsmdbp_hierarchy_node	*node;
+	struct emsmdbp_hierarchy_walk	child;
+	uint32_t			count;
+	uint32_t			i;
+	bool				complete = true;
+
+	node = emsmdbp_hierarchy_load(emsmdbp_ctx, hierarchy, walk);
+	if (!node || depth > EMSMDBP_HIERARCHY_MAX_DEPTH) {
+		*completep = false;
+		return 0;
+	}
+	if (node->subtree_valid) {
+		return node->subtree_count;
+	}
+
+	count = node->child_count;
+	for (i = 0; i < node->child_count; i++) {
+		child.parent = walk;
+		child.fid = node->children[i];
+		child.folder = NULL;
+		child.opened = false;
+		count += emsmdbp_hierarchy_subtree_count(emsmdbp_ctx, hierarchy, &child, depth + 1, &complete);
+		if (child.opened) {
+			talloc_free(child.folder);
+		}
+		/* The child may have reloaded the node */
+		node = emsmdbp_hierarchy_node_get(hierarchy, walk->fid);
+		if (!node) break;
+	}
+
+	/* Counts missing part of the subtree are recomputed next time */
+	if (node && complete) {
+		node->subtree_count = count;
+		node->subtree_valid = true;
+	} else {
+		*completep = false;
+	}
+
+	return count;
+}
+
+/**
+   \details Return the full number of folders within specified
+   folder's hierarchy
+
+   \param emsmdbp_ctx pointer to the emsmdbp context
+   \param folder pointer to the emsmdb folder to start the count from
+   \param row_countp pointer on the number of folders to return
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_ERROR
+ */
+enum MAPISTATUS emsmdbp_folder_get_recursive_folder_count(struct emsmdbp_context *emsmdbp_ctx,
+							  struct emsmdbp_object *folder,
+							  uint32_t *row_countp)
+{
+	struct emsmdbp_hierarchy	*hierarchy;
+	struct emsmdbp_hierarchy_walk	walk;
+	bool				complete = true;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsmdbp_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!folder, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!row_countp, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(folder->type != EMSMDBP_OBJECT_FOLDER && folder->type != EMSMDBP_OBJECT_MAILBOX,
+			     MAPI_E_INVALID_OBJECT, NULL);
+
+	hierarchy = emsmdbp_hierarchy_get(emsmdbp_ctx, folder);
+	OPENCHANGE_RETVAL_IF(!hierarchy, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	walk.parent = NULL;
+	walk.fid = emsmdbp_hierarchy_object_fid(folder);
+	walk.folder = folder;
+	walk.opened = false;
+
+	if (!emsmdbp_hierarchy_load(emsmdbp_ctx, hierarchy, &walk)) {
+		return MAPI_E_CALL_FAILED;
+	}
+	*row_countp += emsmdbp_hierarchy_subtree_count(emsmdbp_ctx, hierarchy, &walk, 0, &complete);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Drop a folder from the hierarchy cache of every mailbox
+   opened by the session. Its children are fetched again on next use
+   and the cached counts of its ancestors are dropped.
+
+   \param emsmdbp_ctx pointer to the emsmdbp context
+   \param fid the identifier of the folder whose children changed
+ */
+void emsmdbp_hierarchy_invalidate(struct emsmdbp_context *emsmdbp_ctx, uint64_t fid)
+{
+	struct emsmdbp_hierarchy	*hierarchy;
+	struct emsmdbp_hierarchy_node	*node;
+	uint32_t			depth;
+
+	if (!emsmdbp_ctx) return;
+
+	for (hierarchy = emsmdbp_ctx->hierarchy; hierarchy; hierarchy = hierarchy->next) {
+		node = emsmdbp_hierarchy_node_get(hierarchy, fid);
+		if (node) {
+			node->expires = 0;
+		}
+		for (depth = 0; node && depth <= EMSMDBP_HIERARCHY_MAX_DEPTH; depth++) {
+			node->subtree_valid = false;
+			node = node->parent_fid ? emsmdbp_hierarchy_node_get(hierarchy, node->parent_fid) : NULL;
+		}
+	}
+}
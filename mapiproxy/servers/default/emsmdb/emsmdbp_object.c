@@ -412,6 +412,7 @@ _PUBLIC_ enum MAPISTATUS emsmdbp_object_create_folder(struct emsmdbp_context *em
 			OC_PANIC(true, ("PidTagChangeNumber *must* be present\n"));
 		}
 	}
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, parent_folder->object.folder->folderID);
 	*new_folderp = new_folder;
 
 	return MAPI_E_SUCCESS;
@@ -717,6 +718,9 @@ _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
 
 	rc = MAPISTORE_SUCCESS;
 	if (stream->needs_commit) {
+		if (stream->stream.storage && !emsmdbp_stream_flatten(stream, &stream->stream).data) {
+			return MAPISTORE_ERR_NO_MEMORY;
+		}
 		stream->needs_commit = false;
 		aRow.cValues = 1;
 		aRow.lpProps = talloc_zero(NULL, struct SPropValue);
@@ -1482,88 +1486,6 @@ enum MAPISTATUS emsmdbp_folder_get_folder_count(struct emsmdbp_context *emsmdbp_
 }
 
 
-/**
-   \details Return the full number of folders within specified
-   folder's hierarchy
-
-   \param emsmdbp_ctx pointer to the emsmdbp context
-   \param folder pointer to the emsmdb folder to start the count from
-   \param row_countp pointer on the number of folders to return
-
-   \return MAPI_E_SUCCESS on success, otherwise MAPI_ERROR
- */
-enum MAPISTATUS emsmdbp_folder_get_recursive_folder_count(struct emsmdbp_context *emsmdbp_ctx,
-							  struct emsmdbp_object *folder,
-							  uint32_t *row_countp)
-{
-	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
-	struct emsmdbp_object	*table_object;
-	uint32_t		count = 0;
-	struct mapi_handles	*rec = NULL;
-	uint32_t		i;
-	struct SPropTagArray	*SPropTagArray = NULL;
-	uint32_t		handle = 0;
-
-	retval = emsmdbp_folder_get_folder_count(emsmdbp_ctx, folder, &count);
-	if ((retval == MAPI_E_SUCCESS) && count) {
-		*row_countp += count;
-
-		retval = mapi_handles_add(emsmdbp_ctx->handles_ctx, handle, &rec);
-		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
-		table_object = emsmdbp_folder_open_table(rec, folder, MAPISTORE_FOLDER_TABLE, rec->handle);
-		if (!table_object) {
-			mapi_handles_delete(emsmdbp_ctx->handles_ctx, rec->handle);
-			retval = MAPI_E_INVALID_OBJECT;
-			goto end;
-		}
-
-		table_object->object.table->prop_count = 1;
-		table_object->object.table->properties = talloc_array(table_object, enum MAPITAGS, 1);
-		if (!table_object->object.table->properties) {
-			mapi_handles_delete(emsmdbp_ctx->handles_ctx, rec->handle);
-			talloc_free(table_object);
-			retval = MAPI_E_INVALID_OBJECT;
-			goto end;
-		}
-		table_object->object.table->properties[0] = PidTagFolderId;
-
-		SPropTagArray = set_SPropTagArray(table_object, 1, PidTagFolderId);
-		mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object),
-					    table_object->backend_object, SPropTagArray->cValues,
-					    SPropTagArray->aulPropTag);
-		for (i = 0; i < count; i++) {
-			void		**data_pointers = NULL;
-			enum MAPISTATUS	*retvals = NULL;
-
-			data_pointers = emsmdbp_object_table_get_row_props(table_object, emsmdbp_ctx, table_object,
-									   i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-
-			if (data_pointers) {
-				struct emsmdbp_object	*sfolder = NULL;
-
-				retval = emsmdbp_object_open_folder_by_fid(table_object, emsmdbp_ctx, folder,
-									   *((uint64_t *)data_pointers[0]), &sfolder);
-				if (retval == MAPI_E_SUCCESS) {
-					uint32_t scount = 0;
-
-					retval = emsmdbp_folder_get_recursive_folder_count(emsmdbp_ctx, sfolder, &scount);
-					*row_countp += scount;
-					talloc_free(sfolder);
-				}
-				talloc_free(data_pointers);
-				talloc_free(retvals);
-			}
-		}
-		talloc_free(table_object->object.table->properties);
-		talloc_free(SPropTagArray);
-		talloc_free(table_object);
-		mapi_handles_delete(emsmdbp_ctx->handles_ctx, rec->handle);
-	}
-end:
-	return retval;
-}
-
-
 static inline enum MAPISTATUS emsmdbp_object_move_folder_to_mapistore_root(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *folder, struct emsmdbp_object *parent_folder, const char *new_name)
 {
 	uint64_t		parent_fid, fid, test_folder_id, change_number;
@@ -1671,6 +1593,21 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context
 		}
 	}
 
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, move_folder->object.folder->folderID);
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, target_folder->object.folder->folderID);
+	if (move_folder->parent_object) {
+		switch (move_folder->parent_object->type) {
+		case EMSMDBP_OBJECT_FOLDER:
+			emsmdbp_hierarchy_invalidate(emsmdbp_ctx, move_folder->parent_object->object.folder->folderID);
+			break;
+		case EMSMDBP_OBJECT_MAILBOX:
+			emsmdbp_hierarchy_invalidate(emsmdbp_ctx, move_folder->parent_object->object.mailbox->folderID);
+			break;
+		default:
+			break;
+		}
+	}
+
 	contextID = emsmdbp_get_contextID(move_folder);
 	if (is_top_of_IS) {
 		/* We move it in MAPIStore backend and then we create
@@ -1835,6 +1772,8 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *emsm
 		}
 	}
 
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, fid);
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, parent_folder->object.folder->folderID);
 	ret = MAPISTORE_SUCCESS;
 
 end:
@@ -2770,6 +2709,8 @@ _PUBLIC_ struct emsmdbp_object *emsmdbp_object_stream_init(TALLOC_CTX *mem_ctx,
 	object->object.stream->stream.buffer.data = NULL;
 	object->object.stream->stream.buffer.length = 0;
 	object->object.stream->stream.position = 0;
+	object->object.stream->stream.spill_size = lpcfg_parm_int(emsmdbp_ctx->lp_ctx, NULL, "exchange_emsmdb", "stream_spill_size",
+								  EMSMDBP_STREAM_SPILL_SIZE) * 1024 * 1024;
 
 	return object;
 }
@@ -3599,50 +3540,6 @@ _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *
 	return stream_data;
 }
 
-_PUBLIC_ DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *stream, uint32_t length)
-{
-	DATA_BLOB buffer;
-	uint32_t real_length;
-
-	real_length = length;
-	if (real_length + stream->position > stream->buffer.length) {
-		real_length = stream->buffer.length - stream->position;
-	}
-	buffer.length = real_length;
-	buffer.data = stream->buffer.data + stream->position;
-	stream->position += real_length;
-
-	return buffer;
-}
-
-_PUBLIC_ void emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
-{
-	size_t new_position;
-	uint32_t old_length;
-	uint8_t *old_data;
-
-	new_position = stream->position + new_buffer.length;
-	if (new_position >= stream->buffer.length) {
-		old_length = stream->buffer.length;
-		stream->buffer.length = new_position;
-		if (stream->buffer.data) {
-			old_data = stream->buffer.data;
-			stream->buffer.data = talloc_realloc(mem_ctx, stream->buffer.data, uint8_t, stream->buffer.length);
-			if (!stream->buffer.data) {
-				OC_DEBUG(5, "WARNING: [bug] lost buffer pointer (data = NULL)\n");
-				stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-				memcpy(stream->buffer.data, old_data, old_length);
-			}
-		}
-		else {
-			stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-		}
-	}
-
-	memcpy(stream->buffer.data + stream->position, new_buffer.data, new_buffer.length);
-	stream->position = new_position;
-}
-
 _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *object, enum MAPITAGS prop_tag)
 {
         struct emsmdbp_stream_data *current_data;
@@ -0,0 +1,302 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) Julien Kerihuel 2009-2015
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_stream.c
+
+   \brief Storage of the streams read and written by ReadStream,
+   WriteStream, FastTransfer and sync state ROPs
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+
+#include "dcesrv_exchange_emsmdb.h"
+
+static int emsmdbp_stream_storage_destructor(struct emsmdbp_stream_storage *storage)
+{
+	if (storage->fd != -1) {
+		close(storage->fd);
+	}
+
+	return 0;
+}
+
+static bool emsmdbp_stream_storage_write(struct emsmdbp_stream_storage *storage, size_t offset,
+					 const uint8_t *data, size_t length)
+{
+	uint8_t		**chunks;
+	uint32_t	idx;
+	size_t		chunk_offset;
+	size_t		count;
+	ssize_t		ret;
+
+	while (length) {
+		if (storage->fd != -1) {
+			ret = pwrite(storage->fd, data, length, offset);
+			if (ret == -1 && errno == EINTR) continue;
+			if (ret <= 0) {
+				OC_DEBUG(0, "unable to write stream data: %s", strerror(errno));
+				return false;
+			}
+			count = ret;
+		} else {
+			idx = offset / EMSMDBP_STREAM_CHUNK_SIZE;
+			chunk_offset = offset % EMSMDBP_STREAM_CHUNK_SIZE;
+			if (idx >= storage->chunk_count) {
+				if (idx >= talloc_array_length(storage->chunks)) {
+					chunks = talloc_realloc(storage, storage->chunks, uint8_t *, 2 * idx + 8);
+					if (!chunks) return false;
+					storage->chunks = chunks;
+				}
+				storage->chunks[idx] = talloc_array(storage, uint8_t, EMSMDBP_STREAM_CHUNK_SIZE);
+				if (!storage->chunks[idx]) return false;
+				storage->chunk_count = idx + 1;
+			}
+			count = MIN(length, EMSMDBP_STREAM_CHUNK_SIZE - chunk_offset);
+			memcpy(storage->chunks[idx] + chunk_offset, data, count);
+		}
+		data += count;
+		offset += count;
+		length -= count;
+	}
+
+	return true;
+}
+
+static bool emsmdbp_stream_storage_read(struct emsmdbp_stream_storage *storage, size_t offset,
+					uint8_t *data, size_t length)
+{
+	size_t		chunk_offset;
+	size_t		count;
+	ssize_t		ret;
+
+	while (length) {
+		if (storage->fd != -1) {
+			ret = pread(storage->fd, data, length, offset);
+			if (ret == -1 && errno == EINTR) continue;
+			if (ret <= 0) {
+				OC_DEBUG(0, "unable to read stream data: %s", ret ? strerror(errno) : "short file");
+				return false;
+			}
+			count = ret;
+		} else {
+			chunk_offset = offset % EMSMDBP_STREAM_CHUNK_SIZE;
+			count = MIN(length, EMSMDBP_STREAM_CHUNK_SIZE - chunk_offset);
+			memcpy(data, storage->chunks[offset / EMSMDBP_STREAM_CHUNK_SIZE] + chunk_offset, count);
+		}
+		data += count;
+		offset += count;
+		length -= count;
+	}
+
+	return true;
+}
+
+/**
+   \details Move the chunks of a stream to an unlinked temporary file
+
+   Data is kept in memory if the file cannot be created or written.
+
+   \param storage pointer to the stream storage
+   \param length the stream size
+ */
+static void emsmdbp_stream_storage_spill(struct emsmdbp_stream_storage *storage, size_t length)
+{
+	const char	*tmpdir;
+	char		*path;
+	uint32_t	i;
+	int		fd;
+
+	tmpdir = getenv("TMPDIR");
+	path = talloc_asprintf(storage, "%s/openchange-stream-XXXXXX", tmpdir ? tmpdir : "/tmp");
+	if (!path) return;
+
+	fd = mkstemp(path);
+	if (fd == -1) {
+		OC_DEBUG(1, "unable to create %s: %s", path, strerror(errno));
+		talloc_free(path);
+		return;
+	}
+	unlink(path);
+	talloc_free(path);
+
+	storage->fd = fd;
+	for (i = 0; i < storage->chunk_count && i * EMSMDBP_STREAM_CHUNK_SIZE < length; i++) {
+		if (!emsmdbp_stream_storage_write(storage, i * EMSMDBP_STREAM_CHUNK_SIZE, storage->chunks[i],
+						  MIN(EMSMDBP_STREAM_CHUNK_SIZE, length - i * EMSMDBP_STREAM_CHUNK_SIZE))) {
+			close(fd);
+			storage->fd = -1;
+			return;
+		}
+	}
+
+	for (i = 0; i < storage->chunk_count; i++) {
+		talloc_free(storage->chunks[i]);
+	}
+	TALLOC_FREE(storage->chunks);
+	storage->chunk_count = 0;
+}
+
+/**
+   \details Read data at the current position of a stream
+
+   Data of a stream never written is returned in place. Once written,
+   the data is copied out of the chunked storage: EcDoRpc only pushes
+   replies once every ROP of the request ran, and a later WriteStream
+   in the same request must not change what an earlier reply returns.
+
+   \param mem_ctx pointer to the memory context of the reply
+   \param stream pointer to the stream to read from
+   \param length the maximum number of bytes to read
+
+   \return the data read, data is NULL if nothing was read
+ */
+_PUBLIC_ DATA_BLOB emsmdbp_stream_read_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, uint32_t length)
+{
+	DATA_BLOB	buffer;
+	uint32_t	real_length;
+
+	real_length = length;
+	if (real_length + stream->position > stream->buffer.length) {
+		real_length = stream->buffer.length - stream->position;
+	}
+	buffer.length = real_length;
+	if (!stream->storage) {
+		buffer.data = stream->buffer.data + stream->position;
+		stream->position += real_length;
+		return buffer;
+	}
+
+	buffer.data = NULL;
+	if (!real_length) {
+		return buffer;
+	}
+
+	buffer.data = talloc_array(mem_ctx, uint8_t, real_length);
+	if (!buffer.data) {
+		buffer.length = 0;
+		return buffer;
+	}
+
+	if (!emsmdbp_stream_storage_read(stream->storage, stream->position, buffer.data, real_length)) {
+		OC_DEBUG(1, "unable to read %u bytes at offset %zu from stream", real_length, stream->position);
+		TALLOC_FREE(buffer.data);
+		buffer.length = 0;
+		return buffer;
+	}
+	stream->position += real_length;
+
+	return buffer;
+}
+
+/**
+   \details Write data at the current position of a stream
+
+   The first write moves the stream content to chunked storage, so
+   growing a stream never reallocates or copies what was already
+   written. The previous buffer is released with the storage, so
+   replies read from it earlier in the request stay valid. When the
+   stream has a spill size and grows past it, the content is moved to
+   an unlinked temporary file.
+
+   \param mem_ctx pointer to the memory context owning the stream
+   \param stream pointer to the stream to write to
+   \param new_buffer the data to write
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
+{
+	struct emsmdbp_stream_storage	*storage;
+	size_t				new_position;
+
+	if (!stream->storage) {
+		storage = talloc_zero(mem_ctx, struct emsmdbp_stream_storage);
+		OPENCHANGE_RETVAL_IF(!storage, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		storage->fd = -1;
+		talloc_set_destructor(storage, emsmdbp_stream_storage_destructor);
+
+		if (!emsmdbp_stream_storage_write(storage, 0, stream->buffer.data, stream->buffer.length)) {
+			talloc_free(storage);
+			return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		stream->storage = storage;
+		talloc_steal(storage, stream->buffer.data);
+		stream->buffer.data = NULL;
+	}
+	storage = stream->storage;
+
+	new_position = stream->position + new_buffer.length;
+	if (stream->spill_size && storage->fd == -1 && new_position > stream->spill_size) {
+		emsmdbp_stream_storage_spill(storage, stream->buffer.length);
+	}
+
+	OPENCHANGE_RETVAL_IF(!emsmdbp_stream_storage_write(storage, stream->position, new_buffer.data, new_buffer.length),
+			     MAPI_E_DISK_ERROR, NULL);
+	if (new_position > stream->buffer.length) {
+		stream->buffer.length = new_position;
+	}
+	stream->position = new_position;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Make the content of a stream contiguous in memory
+
+   The stream storage is released and buffer.data is valid again
+   until the next write.
+
+   \param mem_ctx pointer to the memory context owning the stream
+   \param stream pointer to the stream
+
+   \return the stream content, data is NULL on failure
+ */
+_PUBLIC_ DATA_BLOB emsmdbp_stream_flatten(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream)
+{
+	DATA_BLOB	data;
+
+	if (!stream->storage) {
+		return stream->buffer;
+	}
+
+	data.length = stream->buffer.length;
+	data.data = talloc_array(mem_ctx, uint8_t, data.length);
+	if (!data.data || !emsmdbp_stream_storage_read(stream->storage, 0, data.data, data.length)) {
+		OC_DEBUG(0, "unable to flatten %zu bytes stream", data.length);
+		talloc_free(data.data);
+		data.data = NULL;
+		data.length = 0;
+		return data;
+	}
+
+	TALLOC_FREE(stream->storage);
+	stream->buffer = data;
+
+	return data;
+}
@@ -887,6 +887,7 @@ static enum MAPISTATUS RopEmptyFolder_GenericFolder(TALLOC_CTX *mem_ctx,
 	}
 
 end:
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, folder_object->object.folder->folderID);
 	talloc_free(local_mem_ctx);
 
 	return ret;
@@ -1294,6 +1295,7 @@ enum MAPISTATUS EcDoRpc_RopCopyFolder(TALLOC_CTX *mem_ctx, struct emsmdbp_contex
 	
 	contextID = emsmdbp_get_contextID(copy_folder);
 	ret = mapistore_folder_copy_folder(emsmdbp_ctx->mstore_ctx, contextID, copy_folder->backend_object, target_folder->backend_object, mem_ctx, request->WantRecursive, request->NewFolderName.lpszW);
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, target_folder->object.folder->folderID);
 	mapi_repl->error_code = mapistore_error_to_mapi(ret);
 	response->PartialCompletion = false;
 
@@ -35,8 +35,6 @@
 /* a constant time offset by which the first change number ever can be produced by OpenChange */
 #define oc_version_time 0x4dbb2dbe
 
-/* the maximum buffer that will be populated during msg synchronization operations (note: this is a soft limit) */
-static const size_t max_message_sync_size = 262144;
 static const uint32_t message_preload_interval = 150;
 
 /** notes:
@@ -76,8 +74,12 @@ struct oxcfxics_sync_data {
 	uint8_t				table_type;
 	struct oxcfxics_prop_index	prop_index;
 
+	/* each chunk starts with the unread tail of the previous one and
+	   is filled with new elements until chunk_size bytes are available */
 	struct ndr_push			*ndr;
 	struct ndr_push			*cutmarks_ndr;
+	uint32_t			chunk_size;
+	size_t				peak_size;
 
 	struct rawidset			*eid_set;
 	struct rawidset			*cnset_seen;
@@ -982,7 +984,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	}
 
 	/* open each message and fetch properties */
-	for (; sync_data->ndr->offset < max_message_sync_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
+	for (; sync_data->ndr->offset < sync_data->chunk_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
 		msg_ctx = talloc_new(NULL);
 		msg_properties = properties;
 
@@ -1216,8 +1218,8 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		talloc_free(msg_ctx);
 	}
 
-	if (sync_data->ndr->offset >= max_message_sync_size) {
-		OC_DEBUG(5, "reached max sync size: %u >= %zu\n", sync_data->ndr->offset, max_message_sync_size);
+	if (sync_data->ndr->offset >= sync_data->chunk_size) {
+		OC_DEBUG(5, "reached chunk size: %u >= %u\n", sync_data->ndr->offset, sync_data->chunk_size);
 	}
 
 	if (message_sync_data->count < message_sync_data->max) {
@@ -1262,7 +1264,56 @@ end:
 	return end_of_table;
 }
 
-static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
+/**
+   \details Start a new content sync chunk with the part of the current
+   one that has not been sent yet, and carry its cutmarks over.
+
+   Responses already produced in this transaction still point into the
+   current chunk, so it is handed over to mem_ctx rather than freed.
+
+   \param mem_ctx memory context of the current transaction
+   \param synccontext pointer to the synccontext object
+   \param sync_data pointer to the content sync producer data
+ */
+static void oxcfxics_carry_over_sync_data(TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, struct oxcfxics_sync_data *sync_data)
+{
+	struct ndr_push	*ndr;
+	size_t		position, tail;
+	uint32_t	*cutmarks;
+	uint32_t	mark_idx, count;
+
+	position = synccontext->stream.position;
+	if (position > sync_data->ndr->offset) {
+		position = sync_data->ndr->offset;
+	}
+	tail = sync_data->ndr->offset - position;
+
+	ndr = ndr_push_init_ctx(sync_data);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	ndr->offset = 0;
+	if (tail) {
+		ndr_push_bytes(ndr, sync_data->ndr->data + position, tail);
+	}
+	(void) talloc_steal(mem_ctx, sync_data->ndr);
+	sync_data->ndr = ndr;
+
+	/* cutmarks are (min_value_buffer, offset) pairs ending with
+	   (0, 0xffffffff), pending ones are moved in place */
+	count = 0;
+	cutmarks = (uint32_t *) sync_data->cutmarks_ndr->data;
+	if (tail && cutmarks) {
+		for (mark_idx = synccontext->next_cutmark_idx; cutmarks[mark_idx] != 0xffffffff; mark_idx += 2) {
+			cutmarks[count] = cutmarks[mark_idx - 1];
+			cutmarks[count + 1] = cutmarks[mark_idx] - position;
+			count += 2;
+		}
+	}
+	sync_data->cutmarks_ndr->offset = count * sizeof (uint32_t);
+
+	OC_DEBUG(5, "carried %zu bytes and %u cutmarks over to the next chunk\n", tail, count / 2);
+}
+
+static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object, uint32_t request_buffer_size)
 {
 	struct oxcfxics_sync_data	*sync_data;
 	struct idset			*new_idset, *old_idset;
@@ -1285,20 +1336,22 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 		sync_data->eid_set = RAWIDSET_make(sync_data, false, false);
 		sync_data->deleted_eid_set = RAWIDSET_make(sync_data, false, false);
 
+		sync_data->ndr = ndr_push_init_ctx(sync_data);
+		ndr_set_flags(&sync_data->ndr->flags, LIBNDR_FLAG_NOALIGN);
+		sync_data->ndr->offset = 0;
+		sync_data->cutmarks_ndr = ndr_push_init_ctx(sync_data);
+		ndr_set_flags(&sync_data->cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
+		sync_data->cutmarks_ndr->offset = 0;
+
 		synccontext->sync_data = sync_data;
 		synccontext->sync_stage = 1;
 	}
 	else {
 		sync_data = synccontext->sync_data;
-		talloc_free(sync_data->ndr);
-		talloc_free(sync_data->cutmarks_ndr);
+		oxcfxics_carry_over_sync_data(mem_ctx, synccontext, sync_data);
 	}
-	sync_data->ndr = ndr_push_init_ctx(sync_data);
-	ndr_set_flags(&sync_data->ndr->flags, LIBNDR_FLAG_NOALIGN);
-	sync_data->ndr->offset = 0;
-	sync_data->cutmarks_ndr = ndr_push_init_ctx(sync_data);
-	ndr_set_flags(&sync_data->cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
-	sync_data->cutmarks_ndr->offset = 0;
+	/* produce just enough elements to fill the client buffer */
+	sync_data->chunk_size = request_buffer_size;
 
 	if (synccontext->sync_stage == 1) {
 		/* 2a. we build the message stream (normal messages) */
@@ -1431,7 +1484,12 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 	synccontext->stream.buffer.data = sync_data->ndr->data;
 	synccontext->stream.buffer.length = sync_data->ndr->offset;
 
+	if (sync_data->ndr->alloc_size + sync_data->cutmarks_ndr->alloc_size > sync_data->peak_size) {
+		sync_data->peak_size = sync_data->ndr->alloc_size + sync_data->cutmarks_ndr->alloc_size;
+	}
+
 	if (synccontext->sync_stage == 4) {
+		OC_DEBUG(5, "content sync stream peak memory: %zu bytes\n", sync_data->peak_size);
 		(void) talloc_reference(synccontext, sync_data->ndr->data);
 		(void) talloc_reference(synccontext, sync_data->cutmarks_ndr->data);
 		talloc_free(sync_data);
@@ -1764,7 +1822,7 @@ static inline void oxcfxics_fill_ftcontext_fasttransfer_response(struct FastTran
 		ftcontext->next_cutmark_idx = mark_idx;
 	}
 	
-	response->TransferBuffer = emsmdbp_stream_read_buffer(&ftcontext->stream, buffer_size);
+	response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &ftcontext->stream, buffer_size);
 	response->TotalStepCount = ftcontext->total_steps;
 	if (ftcontext->stream.position == ftcontext->stream.buffer.length) {
 		response->TransferStatus = TransferStatus_Done;
@@ -1804,10 +1862,8 @@ static uint32_t oxcfxics_advance_cutmarks(struct emsmdbp_object_synccontext *syn
 static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTransferSourceGetBuffer_repl *response, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_object *parent_object)
 {
 	char		*owner;
-	size_t		old_chunk_size, new_chunk_size;
 	uint32_t	buffer_size;
 	bool		end_of_buffer = false;
-	DATA_BLOB	joint_buffer;
 
 	owner = emsmdbp_get_owner(parent_object);
 
@@ -1815,7 +1871,7 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 	if (synccontext->stream.position + request_buffer_size < synccontext->stream.buffer.length) {
 		/* the current chunk has not been "emptied" yet */
 		buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-		response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
+		response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, buffer_size);
 	}
 	else {
 		/* the current chunk not does exist or we reached its end */
@@ -1824,67 +1880,25 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 			if (synccontext->sync_stage == 4) {
 				/* the last chunk was the last one */
 				end_of_buffer = true;
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, request_buffer_size);
+				response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, request_buffer_size);
 			}
-			else if (synccontext->sync_stage == 0) {
-				/* no chunk sent yet, so we create a new one */
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
+			else {
+				/* produce the next chunk right after the unread
+				   end of the current one, so the response is
+				   always read from a single contiguous buffer */
+				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object, request_buffer_size);
 				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-				if (request_buffer_size < synccontext->stream.buffer.length) {
-					buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-				}
-				else {
+				if (synccontext->stream.buffer.length <= request_buffer_size && synccontext->sync_stage == 4) {
 					buffer_size = request_buffer_size;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
-				}
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
-			}
-			else {
-				/* we have reached the end of a middle chunk, we must thus finish it and complete the buffer with the content of the next chunk */
-				old_chunk_size = synccontext->stream.buffer.length - synccontext->stream.position;
-
-				if (old_chunk_size > 0) {
-					joint_buffer.length = old_chunk_size;
-					joint_buffer.data = talloc_memdup(mem_ctx, synccontext->stream.buffer.data + synccontext->stream.position, joint_buffer.length);
+					end_of_buffer = true;
 				}
-
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-
-				new_chunk_size = request_buffer_size - old_chunk_size;
-				if (synccontext->stream.buffer.length < new_chunk_size) {
-					new_chunk_size = synccontext->stream.buffer.length;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
+				else if (synccontext->stream.buffer.length < request_buffer_size) {
+					abort();
 				}
 				else {
-					new_chunk_size = oxcfxics_advance_cutmarks(synccontext, new_chunk_size);
-				}
-
-				if (new_chunk_size > 0) {
-					if (old_chunk_size) {
-						joint_buffer.length += new_chunk_size;
-						joint_buffer.data = talloc_realloc(mem_ctx, joint_buffer.data, uint8_t, joint_buffer.length);
-						memcpy(joint_buffer.data + old_chunk_size, synccontext->stream.buffer.data, new_chunk_size);
-						synccontext->stream.position += new_chunk_size;
-					}
-					else {
-						joint_buffer = emsmdbp_stream_read_buffer(&synccontext->stream, new_chunk_size);
-					}
+					buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
 				}
-				response->TransferBuffer = joint_buffer;
-
-
-				OC_DEBUG(5, "joint buffers of sizes %zu and %zu\n", old_chunk_size, new_chunk_size);
+				response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, buffer_size);
 			}
 		}
 		else {
@@ -1897,7 +1911,7 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
 				OC_DEBUG(5, "synccontext buffer is %u bytes long\n", (uint32_t) synccontext->stream.buffer.length);
 			}
-			response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
+			response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, buffer_size);
 
 			if (synccontext->stream.position == synccontext->stream.buffer.length) {
 				end_of_buffer = true;
@@ -2860,6 +2874,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamBegin(TALLOC_CTX *mem_c
 	}
 
 	synccontext_object->object.synccontext->state_property = property;
+	TALLOC_FREE(synccontext_object->object.synccontext->state_stream.storage);
 	memset(&synccontext_object->object.synccontext->state_stream, 0, sizeof(struct emsmdbp_stream));
 	synccontext_object->object.synccontext->state_stream.buffer.data = talloc_zero(synccontext_object->object.synccontext, uint8_t);
 
@@ -2939,9 +2954,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamContinue(TALLOC_CTX *me
 	request = &mapi_req->u.mapi_SyncUploadStateStreamContinue;
 	new_data.length = request->StreamDataSize;
 	new_data.data = request->StreamData;
-	emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
-				    &synccontext_object->object.synccontext->state_stream,
-				    new_data);
+	mapi_repl->error_code = emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
+							   &synccontext_object->object.synccontext->state_stream,
+							   new_data);
 
 end:
 	*size += libmapiserver_RopSyncUploadStateStreamContinue_size(mapi_repl);
@@ -3060,7 +3075,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 
 	/* parse IDSET */
 	synccontext = synccontext_object->object.synccontext;
-	parsed_idset = IDSET_parse(synccontext, synccontext->state_stream.buffer, false);
+	parsed_idset = IDSET_parse(synccontext, emsmdbp_stream_flatten(synccontext, &synccontext->state_stream), false);
 
 	if (parsed_idset) {
 		retval = IDSET_check_ranges(parsed_idset);
@@ -3122,9 +3137,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 reset:
 	/* reset synccontext state */
 	if (synccontext->state_stream.buffer.length > 0) {
+		TALLOC_FREE(synccontext->state_stream.storage);
 		talloc_free(synccontext->state_stream.buffer.data);
 		synccontext->state_stream.buffer.data = talloc_zero(synccontext, uint8_t);
 		synccontext->state_stream.buffer.length = 0;
+		synccontext->state_stream.position = 0;
 	}
 
 	synccontext->state_property = 0;
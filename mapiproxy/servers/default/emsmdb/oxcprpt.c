@@ -785,7 +785,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopReadStream(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-        mapi_repl->u.mapi_ReadStream.data = emsmdbp_stream_read_buffer(&object->object.stream->stream, buffer_size);
+        mapi_repl->u.mapi_ReadStream.data = emsmdbp_stream_read_buffer(mem_ctx, &object->object.stream->stream, buffer_size);
 
 end:
 	*size += libmapiserver_RopReadStream_size(mapi_repl);
@@ -866,7 +866,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopWriteStream(TALLOC_CTX *mem_ctx,
 
 	request = &mapi_req->u.mapi_WriteStream;
 	if (request->data.length > 0) {
-                emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		retval = emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
 		mapi_repl->u.mapi_WriteStream.WrittenSize = request->data.length;
 	}
 
@@ -1211,7 +1215,6 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetPropertyIdsFromNames(TALLOC_CTX *mem_ctx,
 {
 	enum mapistore_error	retval;
 	int			i;
-	int			ret;
 	struct GUID		*lpguid;
 	bool			has_transaction = false;
 	uint16_t		mapped_id = 0;
@@ -1232,11 +1235,20 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetPropertyIdsFromNames(TALLOC_CTX *mem_ctx,
 	mapi_repl->u.mapi_GetIDsFromNames.propID = talloc_array(mem_ctx, uint16_t, 
 								mapi_req->u.mapi_GetIDsFromNames.count);
 
+	/* Resolve all names at once, unknown ones are left to 0 */
+	mapistore_namedprops_get_mapped_ids(emsmdbp_ctx->mstore_ctx->nprops_ctx,
+					    mapi_req->u.mapi_GetIDsFromNames.count,
+					    mapi_req->u.mapi_GetIDsFromNames.nameid,
+					    mapi_repl->u.mapi_GetIDsFromNames.propID);
+
 	for (i = 0; i < mapi_req->u.mapi_GetIDsFromNames.count; i++) {
-		ret = mapistore_namedprops_get_mapped_id(emsmdbp_ctx->mstore_ctx->nprops_ctx, 
-							 mapi_req->u.mapi_GetIDsFromNames.nameid[i],
-							 &mapi_repl->u.mapi_GetIDsFromNames.propID[i]);
-		if (ret == MAPISTORE_SUCCESS)
+		if (mapi_repl->u.mapi_GetIDsFromNames.propID[i])
+			continue;
+		/* The same name may be requested twice */
+		if (has_transaction &&
+		    mapistore_namedprops_get_mapped_id(emsmdbp_ctx->mstore_ctx->nprops_ctx,
+						       mapi_req->u.mapi_GetIDsFromNames.nameid[i],
+						       &mapi_repl->u.mapi_GetIDsFromNames.propID[i]) == MAPISTORE_SUCCESS)
 			continue;
 		// It doesn't exist, let's create it!
 		if (mapi_req->u.mapi_GetIDsFromNames.ulFlags == GetIDsFromNames_GetOrCreate) {
@@ -1317,7 +1329,6 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetNamesFromIDs(TALLOC_CTX *mem_ctx,
 	uint16_t			i;
 	struct GetNamesFromIDs_req	*request;
 	struct GetNamesFromIDs_repl	*response;
-	struct MAPINAMEID		*nameid;
 
 	OC_DEBUG(4, "exchange_emsmdb: [OXCPRPT] GetNamesFromIDs (0x55)\n");
 
@@ -1337,18 +1348,17 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetNamesFromIDs(TALLOC_CTX *mem_ctx,
 
 	response->nameid = talloc_array(mem_ctx, struct MAPINAMEID, request->PropertyIdCount);
 	response->count = request->PropertyIdCount;
+
+	/* Unknown named properties are returned with an ulKind of 0xff */
+	mapistore_namedprops_get_nameids(emsmdbp_ctx->mstore_ctx->nprops_ctx,
+					 request->PropertyIdCount, request->PropertyIds,
+					 mem_ctx, response->nameid);
 	for (i = 0; i < request->PropertyIdCount; i++) {
 		if (request->PropertyIds[i] < 0x8000) {
 			response->nameid[i].ulKind = MNID_ID;
 			GUID_from_string(PS_MAPI, &response->nameid[i].lpguid);
 			response->nameid[i].kind.lid = (uint32_t) request->PropertyIds[i] << 16 | get_property_type(request->PropertyIds[i]);
 		}
-		else if (mapistore_namedprops_get_nameid(emsmdbp_ctx->mstore_ctx->nprops_ctx, request->PropertyIds[i], mem_ctx, &nameid) == MAPISTORE_SUCCESS) {
-			response->nameid[i] = *nameid;
-		}
-		else {
-			response->nameid[i].ulKind = 0xff;
-		}
 	}
 
 	*size += libmapiserver_RopGetNamesFromIDs_size(mapi_repl);
@@ -122,6 +122,8 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSetColumns(TALLOC_CTX *mem_ctx,
                         } else {
 				/* openchangedb case */
 				OC_DEBUG(5, "object: Setting Columns on openchangedb table\n");
+				openchangedb_table_set_columns(emsmdbp_ctx->oc_ctx, object->backend_object,
+							       request.prop_count, request.properties);
 			}
 		}
 	}
@@ -233,11 +233,13 @@ static void dcesrv_NspiUnbind(struct dcesrv_call_state *dce_call,
 
    \param pStat pointer to struct STAT which will be used to get the positions
    \param mids pointer to struct PropertyTagArray_r which contains the table as MIDs array
+   \param snapshot pointer to the snapshot mids comes from, NULL otherwise
    \param[out] out_row pointer to the uint32_t which will cotaint the current row
    \param[out] out_last_row pointer to the uint32_t which will cotaint the last row in table
  */
 static void position_in_table(struct STAT *pStat,
 			      struct PropertyTagArray_r *mids,
+			      struct emsabp_snapshot *snapshot,
 			      uint32_t *out_row, uint32_t *out_last_row)
 {
 	bool		found;
@@ -263,6 +265,11 @@ static void position_in_table(struct STAT *pStat,
 		}
 		else if (pStat->CurrentRec == MID_END_OF_TABLE) {
 			row = last_row;
+		} else if (snapshot) {
+			if (!emsabp_snapshot_find_row(snapshot, pStat->CurrentRec, &row)) {
+				/* In this case the position is undefined. To avoid problems we will use first row */
+				row = 0;
+			}
 		} else {
 			found = false;
 			row = 0;
@@ -290,14 +297,16 @@ static void position_in_table(struct STAT *pStat,
 
    \param[in,out] r pointer to the NspiUpdateStat request data
    \param mids pointer to struct PropertyTagArray_r which contains the table as MIDs array
+   \param snapshot pointer to the snapshot mids comes from, NULL otherwise
 */
 static void dcesrv_do_NspiUpdateStat(struct NspiUpdateStat *r,
-				     struct PropertyTagArray_r *mids)
+				     struct PropertyTagArray_r *mids,
+				     struct emsabp_snapshot *snapshot)
 {
 	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
 	uint32_t			row, last_row;
 
-	position_in_table(r->in.pStat, mids, &row, &last_row);
+	position_in_table(r->in.pStat, mids, snapshot, &row, &last_row);
 
 	if (r->in.pStat->Delta != 0) {
 		/* Adjust row  by Delta */
@@ -352,6 +361,7 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
 	struct emsabp_context		*emsabp_ctx = NULL;
 	bool				container_exists;
 	struct PropertyTagArray_r	*mids;
+	struct emsabp_snapshot		*snapshot = NULL;
 	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
 
 	OC_DEBUG(3, "exchange_nsp: NspiUpdateStat (0x2)");
@@ -372,14 +382,21 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
 		DCESRV_NSP_RETURN_IF(!container_exists, r, MAPI_E_INVALID_BOOKMARK, NULL);
 	}
 
-	/* Step 1. Search in the directory */
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	DCESRV_NSP_RETURN_IF(!mids, r, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
-	retval = emsabp_search(mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
-	DCESRV_NSP_RETURN_IF(retval != MAPI_E_SUCCESS, r, retval, NULL);
+	/* Step 1. Use the container snapshot or search in the directory */
+	if (r->in.pStat->SortType == SortTypeDisplayName) {
+		snapshot = emsabp_snapshot_get(emsabp_ctx, r->in.pStat->ContainerID);
+	}
+	if (snapshot) {
+		mids = &snapshot->mids;
+	} else {
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		DCESRV_NSP_RETURN_IF(!mids, r, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		retval = emsabp_search(mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
+		DCESRV_NSP_RETURN_IF(retval != MAPI_E_SUCCESS, r, retval, NULL);
+	}
 
 	/* Step 2. Do the update stat with the result */
-	dcesrv_do_NspiUpdateStat(r, mids);
+	dcesrv_do_NspiUpdateStat(r, mids, snapshot);
 }
 
 /**
@@ -390,11 +407,12 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
    \param[in,out] r pointer to the NspiQueryRows request data
    \param emsabp_ctx pointer to the emsabp context
    \param mids pointer to struct PropertyTagArray_r which contains the table as MIDs array
+   \param snapshot pointer to the container snapshot mids comes from, NULL to query the directory
    \param updateStat update the out stat struct inside the NspiQueryRows request data. The update is not necessary when called from NspiSeekEntries
 */
 static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r,
 				    struct emsabp_context *emsabp_ctx,  struct PropertyTagArray_r *mids,
-				    bool updateStat)
+				    struct emsabp_snapshot *snapshot, bool updateStat)
 {
 	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
 	struct SPropTagArray		*pPropTags;
@@ -441,17 +459,25 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 	/* Step 2. Fill ppRows  */
 	if (r->in.lpETable == NULL) {
 		/* Step 2.1 Fill ppRows for supplied Container ID */
-		struct ldb_result	*ldb_res;
+		struct ldb_result	*ldb_res = NULL;
+		struct ldb_message	*msg;
 		uint32_t		start_pos;
 		uint32_t		last_row;
+		uint32_t		total;
 
-		position_in_table(r->in.pStat, mids, &start_pos, &last_row);
-		retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
-						  r->in.pStat->ContainerID, &ldb_res);
-		if (retval != MAPI_E_SUCCESS)  {
-			goto failure;
+		position_in_table(r->in.pStat, mids, snapshot, &start_pos, &last_row);
+		if (snapshot) {
+			/* The snapshot already holds the sorted container records */
+			total = snapshot->count;
+		} else {
+			retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
+							  r->in.pStat->ContainerID, &ldb_res);
+			if (retval != MAPI_E_SUCCESS)  {
+				goto failure;
+			}
+			total = ldb_res ? ldb_res->count : 0;
 		}
-		if (ldb_res == NULL) {
+		if (total == 0) {
 			/* No elements in this container */
 			*r->out.ppRows = pRows;
 			DCESRV_NSP_RETURN(r, MAPI_E_SUCCESS, NULL);
@@ -459,8 +485,8 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 
 		if (r->in.pStat->Delta >= 0) {
 			start_pos = start_pos + r->in.pStat->Delta;
-			if (start_pos >= ldb_res->count) {
-				start_pos = ldb_res->count;
+			if (start_pos >= total) {
+				start_pos = total;
 			}
 		} else {
 			if (abs(r->in.pStat->Delta) > r->in.pStat->NumPos) {
@@ -470,7 +496,7 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 			}
 		}
 
-		count = ldb_res->count - start_pos;
+		count = total - start_pos;
 		if (r->in.Count < count) {
 			count = r->in.Count;
 		}
@@ -485,8 +511,9 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 
 			/* fetch required attributes for every entry found */
 			for (i = 0; i < count; i++) {
+				msg = snapshot ? snapshot->entries[start_pos+i].msg : ldb_res->msgs[start_pos+i];
 				retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
-								     ldb_res->msgs[start_pos+i], 0, r->in.dwFlags, pPropTags);
+								     msg, 0, r->in.dwFlags, pPropTags);
 				if (retval != MAPI_E_SUCCESS) {
 					goto failure;
 				}
@@ -502,9 +529,9 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 			r_UpdateStat.in.pStat = r->in.pStat;
 			r_UpdateStat.in.pStat->Delta += pRows->cRows;
 			r_UpdateStat.in.plDelta = NULL;
-			r_UpdateStat.in.pStat->TotalRecs = ldb_res->count;
+			r_UpdateStat.in.pStat->TotalRecs = total;
 			r_UpdateStat.out.pStat = r->out.pStat;
-			dcesrv_do_NspiUpdateStat(&r_UpdateStat, mids);
+			dcesrv_do_NspiUpdateStat(&r_UpdateStat, mids, snapshot);
 			if (r_UpdateStat.out.result != MAPI_E_SUCCESS) {
 				/* Not clear in the spec what to do if updateStat fails, ignoring it and logging error for the moment */
 				OC_DEBUG(1, "NSPI UpdateStat after GetRows failed: %u\n", r_UpdateStat.out.result);
@@ -564,6 +591,7 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call, TALLOC_CTX
 	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
 	struct emsabp_context		*emsabp_ctx = NULL;
 	struct PropertyTagArray_r	*mids;
+	struct emsabp_snapshot		*snapshot = NULL;
 
 	OC_DEBUG(3, "exchange_nsp: NspiQueryRows (0x3)\n");
 
@@ -588,16 +616,23 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call, TALLOC_CTX
 			r, MAPI_E_INVALID_BOOKMARK, NULL);
 	}
 
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	DCESRV_NSP_RETURN_IF(!mids, r, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	/* Step 2. Use the container snapshot or perform the search */
+	if (r->in.lpETable == NULL && r->in.pStat->SortType == SortTypeDisplayName) {
+		snapshot = emsabp_snapshot_get(emsabp_ctx, r->in.pStat->ContainerID);
+	}
+	if (snapshot) {
+		mids = &snapshot->mids;
+	} else {
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		DCESRV_NSP_RETURN_IF(!mids, r, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 
-	/* Step 2. Perform the search */
-	retval = emsabp_search(mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
-	DCESRV_NSP_RETURN_IF(retval != MAPI_E_SUCCESS, r, retval, NULL);
+		retval = emsabp_search(mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
+		DCESRV_NSP_RETURN_IF(retval != MAPI_E_SUCCESS, r, retval, NULL);
+	}
 
 	/* Step 3. Now we have passed session verifications and have
 	   the data we can do the operation */
-	dcesrv_do_NspiQueryRows(mem_ctx, r, emsabp_ctx, mids, true);
+	dcesrv_do_NspiQueryRows(mem_ctx, r, emsabp_ctx, mids, snapshot, true);
 }
 
 
@@ -618,6 +653,8 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 	uint32_t			row;
 	struct PropertyTagArray_r	*mids, *all_mids;
 	struct Restriction_r		*seek_restriction;
+	struct emsabp_snapshot		*snapshot = NULL;
+	const char			*target;
 	bool				container_exists;
 	struct NspiQueryRows		r_QueryRows;
 	struct STAT			r_QueryRowsStatOut;
@@ -660,6 +697,8 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 
 	if (r->in.lpETable) {
 		all_mids = r->in.lpETable;
+	} else if ((snapshot = emsabp_snapshot_get(emsabp_ctx, r->in.pStat->ContainerID))) {
+		all_mids = &snapshot->mids;
 	} else {
 		all_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
 		if (all_mids == NULL) {
@@ -673,35 +712,56 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 		}
 	}
 
-	/* find the records matching the qualifier */
-	seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
-	if (seek_restriction == NULL) {
-		retval = MAPI_E_NOT_ENOUGH_MEMORY;
-		goto failure;
-	}
-	seek_restriction->rt = RES_PROPERTY;
-	seek_restriction->res.resProperty.relop = RELOP_GE;
-	seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
-	seek_restriction->res.resProperty.lpProp = r->in.pTarget;
-
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	if (mids == NULL) {
-		retval = MAPI_E_NOT_ENOUGH_MEMORY;
-		goto failure;
-	}
-	if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
-		mids = all_mids;
-		retval = MAPI_E_NOT_FOUND;
-	}
-
 	r->out.pStat->CurrentRec = MID_END_OF_TABLE;
 	r->out.pStat->NumPos = all_mids->cValues - 1;
 	r->out.pStat->TotalRecs = all_mids->cValues;
-	for (row = 0; row < all_mids->cValues; row++) {
-		if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
-			r->out.pStat->CurrentRec = mids->aulPropTag[0];
+
+	if (snapshot && (r->in.pTarget->ulPropTag == PR_DISPLAY_NAME ||
+			 r->in.pTarget->ulPropTag == PR_DISPLAY_NAME_UNICODE)) {
+		/* The snapshot is sorted by display name: binary search
+		 * the first record greater than or equal to the target */
+		target = (const char *) get_PropertyValue_data(r->in.pTarget);
+		if (target == NULL) {
+			retval = MAPI_E_INVALID_PARAMETER;
+			goto failure;
+		}
+		row = emsabp_snapshot_seek(snapshot, target);
+		if (row == snapshot->count) {
+			row = 0;
+			retval = MAPI_E_NOT_FOUND;
+		}
+		if (row < snapshot->count) {
+			r->out.pStat->CurrentRec = all_mids->aulPropTag[row];
 			r->out.pStat->NumPos = row;
-			break;
+		}
+	} else {
+		/* find the records matching the qualifier */
+		seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
+		if (seek_restriction == NULL) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto failure;
+		}
+		seek_restriction->rt = RES_PROPERTY;
+		seek_restriction->res.resProperty.relop = RELOP_GE;
+		seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
+		seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (mids == NULL) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto failure;
+		}
+		if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
+			mids = all_mids;
+			retval = MAPI_E_NOT_FOUND;
+		}
+
+		for (row = 0; row < all_mids->cValues; row++) {
+			if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
+				r->out.pStat->CurrentRec = mids->aulPropTag[0];
+				r->out.pStat->NumPos = row;
+				break;
+			}
 		}
 	}
 
@@ -751,7 +811,7 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 	/* The returned rows from QueryRows are used as returned value */
 	r_QueryRows.out.ppRows = r->out.pRows;
 
-	dcesrv_do_NspiQueryRows(mem_ctx, &r_QueryRows, emsabp_ctx, all_mids, false);
+	dcesrv_do_NspiQueryRows(mem_ctx, &r_QueryRows, emsabp_ctx, all_mids, snapshot, false);
 	if (r_QueryRows.out.result != MAPI_E_SUCCESS) {
 		retval = r_QueryRows.out.result;
 		goto failure;
@@ -26,6 +26,7 @@
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
 #include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
 #include <ldb.h>
 #include <ldb_errors.h>
 #include <tevent.h>
@@ -41,6 +42,27 @@
 #endif
 #endif
 
+struct emsabp_snapshot_entry {
+	uint32_t		MId;
+	uint32_t		row;
+	const char		*sort_key;
+	struct ldb_message	*msg;
+};
+
+struct emsabp_snapshot {
+	struct emsabp_snapshot		*prev;
+	struct emsabp_snapshot		*next;
+	struct emsabp_context		*emsabp_ctx;
+	uint32_t			ContainerID;
+	uint64_t			usn;
+	time_t				checked;
+	size_t				size;
+	uint32_t			count;
+	struct emsabp_snapshot_entry	*entries;
+	struct PropertyTagArray_r	mids;
+	struct htable			rows;
+};
+
 struct emsabp_context {
 	const char		*account_name;
 	const char		*organization_name;
@@ -50,6 +72,8 @@ struct emsabp_context {
 	TDB_CONTEXT		*tdb_ctx;
 	TDB_CONTEXT		*ttdb_ctx;
 	TALLOC_CTX		*mem_ctx;
+	size_t			snapshot_max_size;
+	int			snapshot_refresh;
 };
 
 struct emsabp_MId {
@@ -100,6 +124,11 @@ struct EphemeralEntryID {
 #define	EMSABP_TDB_TMP_MID_START	0x5000
 #define	EMSABP_TDB_DATA_REC		"MId_index"
 
+/* Default address book snapshot refresh interval (seconds) and
+ * memory cap (megabytes) */
+#define	EMSABP_SNAPSHOT_REFRESH		60
+#define	EMSABP_SNAPSHOT_MAX_SIZE	64
+
 #define DCESRV_NSP_RETURN_IF(x,r,c,ctx)		\
 do {						\
 	if (x) {				\
@@ -161,9 +190,17 @@ enum MAPISTATUS		emsabp_tdb_insert(TDB_CONTEXT *, const char *);
 enum MAPISTATUS		emsabp_tdb_fetch_MId(TDB_CONTEXT *, const char *, uint32_t *);
 bool			emsabp_tdb_lookup_MId(TDB_CONTEXT *, uint32_t);
 enum MAPISTATUS		emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *, TDB_CONTEXT *, uint32_t, char **);
+void			emsabp_tdb_index_release(TDB_CONTEXT *);
 
 TDB_CONTEXT		*emsabp_tdb_init_tmp(TALLOC_CTX *);
 
+/* definitions from emsabp_snapshot.c */
+struct emsabp_snapshot	*emsabp_snapshot_get(struct emsabp_context *, uint32_t);
+enum MAPISTATUS		emsabp_snapshot_index(struct emsabp_context *, struct emsabp_snapshot *, struct ldb_result *);
+bool			emsabp_snapshot_find_row(struct emsabp_snapshot *, uint32_t, uint32_t *);
+uint32_t		emsabp_snapshot_seek(struct emsabp_snapshot *, const char *);
+void			emsabp_snapshot_release(struct emsabp_context *);
+
 /* definitions from emsabp_property.c */
 const char		*emsabp_property_get_attribute(uint32_t);
 uint32_t		emsabp_property_get_ulPropTag(const char *);
@@ -52,6 +52,7 @@ _PUBLIC_ struct emsabp_context *emsabp_init(struct loadparm_context *lp_ctx,
 {
 	TALLOC_CTX		*mem_ctx;
 	struct emsabp_context	*emsabp_ctx;
+	int			max_size;
 
 	/* Sanity checks */
 	if (!lp_ctx) return NULL;
@@ -88,6 +89,12 @@ _PUBLIC_ struct emsabp_context *emsabp_init(struct loadparm_context *lp_ctx,
 		return NULL;
 	}
 
+	/* Address book containers snapshots settings */
+	emsabp_ctx->snapshot_refresh = lpcfg_parm_int(lp_ctx, NULL, "exchange_nsp", "gal_snapshot_refresh",
+						      EMSABP_SNAPSHOT_REFRESH);
+	max_size = lpcfg_parm_int(lp_ctx, NULL, "exchange_nsp", "gal_snapshot_max_size", EMSABP_SNAPSHOT_MAX_SIZE);
+	emsabp_ctx->snapshot_max_size = (max_size > 0) ? (size_t)max_size * 1024 * 1024 : 0;
+
 	return emsabp_ctx;
 }
 
@@ -98,6 +105,7 @@ _PUBLIC_ bool emsabp_destructor(void *data)
 
 	if (emsabp_ctx) {
 		if (emsabp_ctx->ttdb_ctx) {
+			emsabp_tdb_index_release(emsabp_ctx->ttdb_ctx);
 			tdb_close(emsabp_ctx->ttdb_ctx);
 		}
 
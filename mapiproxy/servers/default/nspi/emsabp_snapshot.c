@@ -0,0 +1,414 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_snapshot.c
+
+   \brief Sorted snapshots of address book containers
+
+   Browsing an address book container used to run the container
+   search against the directory for every NspiQueryRows and
+   NspiSeekEntries call. A snapshot keeps the records of a container
+   sorted by display name together with their session MIds, so
+   positioning becomes a hash lookup, seeking a binary search and
+   fetching rows a slice of the snapshot.
+
+   Snapshots are bound to the EMSABP context because MIds are
+   allocated in its temporary TDB, but the snapshots of every session
+   of a server process share a single least recently used list, so
+   exchange_nsp:gal_snapshot_max_size caps the process. A snapshot is
+   trusted for exchange_nsp:gal_snapshot_refresh seconds, after which
+   the directory highestCommittedUSN is checked and the snapshot
+   rebuilt if the directory changed.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/util/samdb.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+#include "utils/dlinklist.h"
+#include "dcesrv_exchange_nsp.h"
+#include "ldb.h"
+
+/* Snapshots of every session, most recently used first */
+static struct emsabp_snapshot	*emsabp_snapshots;
+static size_t			emsabp_snapshots_size;
+
+static size_t _row_rehash(const void *e, void *unused)
+{
+	return hash(&((const struct emsabp_snapshot_entry *)e)->MId, 1, 0);
+}
+
+static bool _row_cmp(const void *e, void *MId)
+{
+	return ((const struct emsabp_snapshot_entry *)e)->MId == *(uint32_t *)MId;
+}
+
+/* Display names are compared with the displayName schema syntax, the
+ * way the LDB server_sort control orders the directory searches */
+struct emsabp_snapshot_cmp_ctx {
+	struct ldb_context			*ldb_ctx;
+	const struct ldb_schema_attribute	*attr;
+	TALLOC_CTX				*mem_ctx;
+};
+
+static int emsabp_snapshot_key_cmp(struct emsabp_snapshot_cmp_ctx *cmp_ctx, const char *a, const char *b)
+{
+	struct ldb_val	va;
+	struct ldb_val	vb;
+
+	va.data = discard_const_p(uint8_t, a);
+	va.length = strlen(a);
+	vb.data = discard_const_p(uint8_t, b);
+	vb.length = strlen(b);
+
+	return cmp_ctx->attr->syntax->comparison_fn(cmp_ctx->ldb_ctx, cmp_ctx->mem_ctx, &va, &vb);
+}
+
+static int emsabp_snapshot_entry_cmp(void *a, void *b, void *opaque)
+{
+	const struct emsabp_snapshot_entry	*ea = (const struct emsabp_snapshot_entry *)a;
+	const struct emsabp_snapshot_entry	*eb = (const struct emsabp_snapshot_entry *)b;
+	int					ret;
+
+	ret = emsabp_snapshot_key_cmp((struct emsabp_snapshot_cmp_ctx *)opaque, ea->sort_key, eb->sort_key);
+	if (ret) return ret;
+
+	return (ea->MId > eb->MId) - (ea->MId < eb->MId);
+}
+
+static int emsabp_snapshot_destructor(struct emsabp_snapshot *snapshot)
+{
+	/* Snapshots are freed with their session too */
+	if (snapshot->prev) {
+		emsabp_snapshots_size -= snapshot->size;
+		DLIST_REMOVE(emsabp_snapshots, snapshot);
+	}
+	htable_clear(&snapshot->rows);
+	return 0;
+}
+
+/**
+   \details Retrieve the directory highestCommittedUSN
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param usn pointer to the USN to return
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_get_usn(struct emsabp_context *emsabp_ctx, uint64_t *usn)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct ldb_result	*res = NULL;
+	const char * const	attrs[] = { "highestCommittedUSN", NULL };
+	int			ret;
+
+	mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = safe_ldb_search(&emsabp_ctx->samdb_ctx, mem_ctx, &res,
+			      ldb_dn_new(mem_ctx, emsabp_ctx->samdb_ctx, ""),
+			      LDB_SCOPE_BASE, attrs, NULL);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || res->count != 1, MAPI_E_NOT_FOUND, mem_ctx);
+
+	*usn = ldb_msg_find_attr_as_uint64(res->msgs[0], "highestCommittedUSN", 0);
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Free snapshots of any session, least recently used first,
+   until size additional bytes fit in the configured memory cap
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param size the number of bytes to make room for
+ */
+static void emsabp_snapshot_evict(struct emsabp_context *emsabp_ctx, size_t size)
+{
+	struct emsabp_snapshot	*snapshot;
+
+	while (emsabp_snapshots && emsabp_snapshots_size + size > emsabp_ctx->snapshot_max_size) {
+		snapshot = DLIST_TAIL(emsabp_snapshots);
+		OC_DEBUG(5, "[nspi] Evicting snapshot of container 0x%x (%u records)",
+			 snapshot->ContainerID, snapshot->count);
+		talloc_free(snapshot);
+	}
+}
+
+/**
+   \details Allocate the session MIds of the records of a snapshot,
+   sort them by display name and index their position
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param snapshot pointer to the zeroed snapshot to fill
+   \param ldb_res pointer to the container records
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_snapshot_index(struct emsabp_context *emsabp_ctx,
+					       struct emsabp_snapshot *snapshot,
+					       struct ldb_result *ldb_res)
+{
+	enum MAPISTATUS			retval;
+	struct emsabp_snapshot_entry	*entry;
+	struct emsabp_snapshot_cmp_ctx	cmp_ctx;
+	const char			*dn;
+	uint32_t			i;
+
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx || !snapshot, MAPI_E_INVALID_PARAMETER, NULL);
+
+	snapshot->emsabp_ctx = emsabp_ctx;
+	htable_init(&snapshot->rows, _row_rehash, NULL);
+	talloc_set_destructor(snapshot, emsabp_snapshot_destructor);
+
+	if (ldb_res && ldb_res->count) {
+		snapshot->count = ldb_res->count;
+		snapshot->entries = talloc_array(snapshot, struct emsabp_snapshot_entry, snapshot->count);
+		OPENCHANGE_RETVAL_IF(!snapshot->entries, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		snapshot->mids.aulPropTag = talloc_array(snapshot, uint32_t, snapshot->count);
+		OPENCHANGE_RETVAL_IF(!snapshot->mids.aulPropTag, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		snapshot->mids.cValues = snapshot->count;
+	}
+
+	/* Step 1. Allocate session MIds and sort keys */
+	for (i = 0; i < snapshot->count; i++) {
+		entry = &snapshot->entries[i];
+		entry->msg = ldb_res->msgs[i];
+		entry->sort_key = ldb_msg_find_attr_as_string(entry->msg, "displayName", "");
+
+		dn = ldb_msg_find_attr_as_string(entry->msg, "distinguishedName", NULL);
+		OPENCHANGE_RETVAL_IF(!dn, MAPI_E_CORRUPT_STORE, NULL);
+		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &entry->MId);
+		if (retval != MAPI_E_SUCCESS) {
+			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
+			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+			retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &entry->MId);
+			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+		}
+	}
+
+	/* Step 2. Sort the records and index their position */
+	cmp_ctx.ldb_ctx = emsabp_ctx->samdb_ctx;
+	cmp_ctx.attr = ldb_schema_attribute_by_name(emsabp_ctx->samdb_ctx, "displayName");
+	cmp_ctx.mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!cmp_ctx.mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	ldb_qsort(snapshot->entries, snapshot->count, sizeof (struct emsabp_snapshot_entry),
+		  &cmp_ctx, emsabp_snapshot_entry_cmp);
+	talloc_free(cmp_ctx.mem_ctx);
+
+	for (i = 0; i < snapshot->count; i++) {
+		entry = &snapshot->entries[i];
+		entry->row = i;
+		snapshot->mids.aulPropTag[i] = entry->MId;
+		OPENCHANGE_RETVAL_IF(!htable_add(&snapshot->rows, hash(&entry->MId, 1, 0), entry),
+				     MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Build the snapshot of an address book container
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param ContainerID the container MId, 0 for the GAL
+   \param usn the directory USN the snapshot is built at
+   \param snapshotp pointer on pointer to the snapshot to return
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_TABLE_TOO_BIG if the
+   snapshot does not fit in the memory cap, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_build(struct emsabp_context *emsabp_ctx,
+					     uint32_t ContainerID, uint64_t usn,
+					     struct emsabp_snapshot **snapshotp)
+{
+	enum MAPISTATUS			retval;
+	struct emsabp_snapshot		*snapshot;
+	struct ldb_result		*ldb_res = NULL;
+
+	snapshot = talloc_zero(emsabp_ctx->mem_ctx, struct emsabp_snapshot);
+	OPENCHANGE_RETVAL_IF(!snapshot, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	snapshot->ContainerID = ContainerID;
+	snapshot->usn = usn;
+	snapshot->checked = time(NULL);
+
+	/* Step 1. Fetch the container records */
+	retval = emsabp_ab_container_enum(snapshot, emsabp_ctx, ContainerID, &ldb_res);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, snapshot);
+
+	/* Step 2. Sort and index the records */
+	retval = emsabp_snapshot_index(emsabp_ctx, snapshot, ldb_res);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, snapshot);
+
+	snapshot->size = talloc_total_size(snapshot);
+	OPENCHANGE_RETVAL_IF(snapshot->size > emsabp_ctx->snapshot_max_size, MAPI_E_TABLE_TOO_BIG, snapshot);
+
+	OC_DEBUG(5, "[nspi] Snapshot of container 0x%x built: %u records, %zu bytes",
+		 ContainerID, snapshot->count, snapshot->size);
+
+	*snapshotp = snapshot;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the display name sorted snapshot of an address
+   book container, building or refreshing it when needed
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param ContainerID the container MId, 0 for the GAL
+
+   \return pointer to the snapshot on success, NULL if snapshots are
+   disabled or the container cannot be snapshotted. In the latter
+   case, callers have to query the directory.
+ */
+_PUBLIC_ struct emsabp_snapshot *emsabp_snapshot_get(struct emsabp_context *emsabp_ctx,
+						     uint32_t ContainerID)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_snapshot	*snapshot;
+	time_t			now;
+	uint64_t		usn = 0;
+
+	if (!emsabp_ctx || !emsabp_ctx->snapshot_max_size) return NULL;
+
+	now = time(NULL);
+	for (snapshot = emsabp_snapshots; snapshot; snapshot = snapshot->next) {
+		if (snapshot->emsabp_ctx == emsabp_ctx && snapshot->ContainerID == ContainerID) break;
+	}
+
+	if (snapshot) {
+		if (now - snapshot->checked < emsabp_ctx->snapshot_refresh) {
+			goto found;
+		}
+
+		retval = emsabp_snapshot_get_usn(emsabp_ctx, &usn);
+		if (retval == MAPI_E_SUCCESS && usn == snapshot->usn) {
+			snapshot->checked = now;
+			goto found;
+		}
+
+		OC_DEBUG(5, "[nspi] Directory changed, refreshing snapshot of container 0x%x",
+			 ContainerID);
+		talloc_free(snapshot);
+		if (retval != MAPI_E_SUCCESS) return NULL;
+	} else {
+		retval = emsabp_snapshot_get_usn(emsabp_ctx, &usn);
+		if (retval != MAPI_E_SUCCESS) return NULL;
+	}
+
+	retval = emsabp_snapshot_build(emsabp_ctx, ContainerID, usn, &snapshot);
+	if (retval != MAPI_E_SUCCESS) {
+		OC_DEBUG(3, "[nspi] Unable to snapshot container 0x%x: %s",
+			 ContainerID, mapi_get_errstr(retval));
+		return NULL;
+	}
+
+	emsabp_snapshot_evict(emsabp_ctx, snapshot->size);
+	emsabp_snapshots_size += snapshot->size;
+	DLIST_ADD(emsabp_snapshots, snapshot);
+
+	return snapshot;
+
+found:
+	DLIST_PROMOTE(emsabp_snapshots, snapshot);
+	return snapshot;
+}
+
+/**
+   \details Retrieve the row of a MId within a snapshot
+
+   \param snapshot pointer to the snapshot
+   \param MId the MId to look for
+   \param row pointer to the row to return
+
+   \return true if the MId is part of the snapshot, otherwise false
+ */
+_PUBLIC_ bool emsabp_snapshot_find_row(struct emsabp_snapshot *snapshot, uint32_t MId, uint32_t *row)
+{
+	struct emsabp_snapshot_entry	*entry;
+
+	if (!snapshot || !row) return false;
+
+	entry = htable_get(&snapshot->rows, hash(&MId, 1, 0), _row_cmp, &MId);
+	if (!entry) return false;
+
+	*row = entry->row;
+	return true;
+}
+
+/**
+   \details Retrieve the first row of a snapshot whose display name
+   is greater than or equal to the target
+
+   \param snapshot pointer to the snapshot
+   \param target the display name to seek
+
+   \return the row on success, snapshot->count if every display name
+   is lower than the target
+ */
+_PUBLIC_ uint32_t emsabp_snapshot_seek(struct emsabp_snapshot *snapshot, const char *target)
+{
+	struct emsabp_snapshot_cmp_ctx	cmp_ctx;
+	uint32_t			low = 0;
+	uint32_t			high;
+	uint32_t			mid;
+
+	if (!snapshot || !snapshot->count || !target) return 0;
+
+	cmp_ctx.ldb_ctx = snapshot->emsabp_ctx->samdb_ctx;
+	cmp_ctx.attr = ldb_schema_attribute_by_name(cmp_ctx.ldb_ctx, "displayName");
+	cmp_ctx.mem_ctx = talloc_new(NULL);
+	if (!cmp_ctx.mem_ctx) return 0;
+
+	high = snapshot->count;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (emsabp_snapshot_key_cmp(&cmp_ctx, snapshot->entries[mid].sort_key, target) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	talloc_free(cmp_ctx.mem_ctx);
+
+	return low;
+}
+
+/**
+   \details Release all the snapshots of an EMSABP context
+
+   \param emsabp_ctx pointer to the EMSABP context
+ */
+_PUBLIC_ void emsabp_snapshot_release(struct emsabp_context *emsabp_ctx)
+{
+	struct emsabp_snapshot	*snapshot;
+
+	if (!emsabp_ctx) return;
+
+	while ((snapshot = emsabp_ctx->snapshots)) {
+		DLIST_REMOVE(emsabp_ctx->snapshots, snapshot);
+		talloc_free(snapshot);
+	}
+	emsabp_ctx->snapshot_size = 0;
+}
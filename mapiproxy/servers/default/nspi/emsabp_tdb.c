@@ -26,16 +26,236 @@
 */
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+#include "utils/dlinklist.h"
 #include "dcesrv_exchange_nsp.h"
 
 /**
-   \details Structure to be used for MId traversal within TDB
+   \details In-memory MId <-> DN index of an EMSABP TDB database.
+
+   MIds are allocated sequentially, so MId -> DN resolution uses a
+   dense array indexed by MId - base while DN -> MId resolution uses
+   a hash table. The TDB remains the reference: the index is
+   resynchronized whenever the EMSABP_TDB_DATA_REC counter moved
+   because another process inserted records.
  */
-struct traverse_MId {
-	uint32_t	MId;
-	bool		found;
+struct emsabp_tdb_index_entry {
+	uint32_t			MId;
+	char				*dn;
 };
 
+struct emsabp_tdb_index {
+	struct emsabp_tdb_index		*prev;
+	struct emsabp_tdb_index		*next;
+	TDB_CONTEXT			*tdb_ctx;
+	uint32_t			base;
+	uint32_t			size;
+	uint32_t			count;
+	uint32_t			last_MId;
+	struct emsabp_tdb_index_entry	**entries;
+	struct htable			dn_ht;
+};
+
+static struct emsabp_tdb_index	*emsabp_tdb_indexes = NULL;
+
+static size_t _dn_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct emsabp_tdb_index_entry *)e)->dn);
+}
+
+static bool _dn_cmp(const void *e, void *dn)
+{
+	return !strcmp(((const struct emsabp_tdb_index_entry *)e)->dn, (const char *)dn);
+}
+
+static bool emsabp_tdb_parse_MId(TDB_DATA dbuf, uint32_t *MId)
+{
+	char	str[16];
+
+	if (!dbuf.dptr || !dbuf.dsize || dbuf.dsize >= sizeof (str)) return false;
+
+	memcpy(str, dbuf.dptr, dbuf.dsize);
+	str[dbuf.dsize] = '\0';
+	*MId = strtoul(str, NULL, 16);
+
+	return true;
+}
+
+static int emsabp_tdb_index_destructor(struct emsabp_tdb_index *tdb_index)
+{
+	htable_clear(&tdb_index->dn_ht);
+	DLIST_REMOVE(emsabp_tdb_indexes, tdb_index);
+
+	return 0;
+}
+
+static struct emsabp_tdb_index_entry *emsabp_tdb_index_get_entry(struct emsabp_tdb_index *tdb_index,
+								 uint32_t MId)
+{
+	if (MId < tdb_index->base || MId - tdb_index->base >= tdb_index->size) {
+		return NULL;
+	}
+
+	return tdb_index->entries[MId - tdb_index->base];
+}
+
+static void emsabp_tdb_index_add(struct emsabp_tdb_index *tdb_index, uint32_t MId,
+				 const char *dn, size_t dn_len)
+{
+	struct emsabp_tdb_index_entry	**entries;
+	struct emsabp_tdb_index_entry	*entry;
+	uint32_t			shift = 0;
+	uint32_t			size;
+
+	entry = emsabp_tdb_index_get_entry(tdb_index, MId);
+	if (entry) {
+		if (strlen(entry->dn) == dn_len && !strncmp(entry->dn, dn, dn_len)) return;
+		htable_del(&tdb_index->dn_ht, hash_string(entry->dn), entry);
+		tdb_index->entries[MId - tdb_index->base] = NULL;
+		tdb_index->count--;
+		talloc_free(entry);
+	}
+
+	/* Grow the array on either side so MId gets a slot */
+	if (!tdb_index->size) {
+		tdb_index->base = MId;
+	} else if (MId < tdb_index->base) {
+		shift = tdb_index->base - MId;
+	}
+	size = tdb_index->size + shift;
+	if (MId - (tdb_index->base - shift) >= size) {
+		size = MId - (tdb_index->base - shift) + 1;
+	}
+	if (size > tdb_index->size) {
+		if (!shift && size < tdb_index->size * 2) {
+			size = tdb_index->size * 2;
+		}
+		entries = talloc_realloc(tdb_index, tdb_index->entries, struct emsabp_tdb_index_entry *, size);
+		if (!entries) return;
+		if (shift) {
+			memmove(entries + shift, entries, tdb_index->size * sizeof (*entries));
+			memset(entries, 0, shift * sizeof (*entries));
+		}
+		memset(entries + shift + tdb_index->size, 0,
+		       (size - shift - tdb_index->size) * sizeof (*entries));
+		tdb_index->entries = entries;
+		tdb_index->size = size;
+		tdb_index->base -= shift;
+	}
+
+	entry = talloc_zero(tdb_index, struct emsabp_tdb_index_entry);
+	if (!entry) return;
+	entry->MId = MId;
+	entry->dn = talloc_strndup(entry, dn, dn_len);
+	if (!entry->dn || !htable_add(&tdb_index->dn_ht, hash_string(entry->dn), entry)) {
+		talloc_free(entry);
+		return;
+	}
+
+	tdb_index->entries[MId - tdb_index->base] = entry;
+	tdb_index->count++;
+}
+
+static int emsabp_tdb_traverse_index(TDB_CONTEXT *tdb_ctx,
+				     TDB_DATA key, TDB_DATA dbuf,
+				     void *state)
+{
+	struct emsabp_tdb_index	*tdb_index = (struct emsabp_tdb_index *) state;
+	uint32_t		MId;
+
+	if (!key.dptr || !key.dsize) return 0;
+	if (key.dsize == strlen(EMSABP_TDB_DATA_REC) &&
+	    !strncmp((const char *)key.dptr, EMSABP_TDB_DATA_REC, key.dsize)) {
+		return 0;
+	}
+
+	if (emsabp_tdb_parse_MId(dbuf, &MId)) {
+		emsabp_tdb_index_add(tdb_index, MId, (const char *)key.dptr, key.dsize);
+	}
+
+	return 0;
+}
+
+/**
+   \details Bring the index up to date with the TDB database. The
+   whole database is only traversed if the MId counter changed since
+   the last synchronization.
+ */
+static enum MAPISTATUS emsabp_tdb_index_sync(struct emsabp_tdb_index *tdb_index)
+{
+	enum MAPISTATUS	retval;
+	TDB_DATA	dbuf;
+	uint32_t	last_MId;
+	bool		parsed;
+	int		ret;
+
+	retval = emsabp_tdb_fetch(tdb_index->tdb_ctx, EMSABP_TDB_DATA_REC, &dbuf);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	parsed = emsabp_tdb_parse_MId(dbuf, &last_MId);
+	free(dbuf.dptr);
+	OPENCHANGE_RETVAL_IF(!parsed, MAPI_E_CORRUPT_STORE, NULL);
+
+	if (tdb_index->last_MId && last_MId == tdb_index->last_MId) {
+		return MAPI_E_SUCCESS;
+	}
+
+	ret = tdb_traverse(tdb_index->tdb_ctx, emsabp_tdb_traverse_index, (void *)tdb_index);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, NULL);
+	tdb_index->last_MId = last_MId;
+
+	OC_DEBUG(5, "[nspi] MId index synchronized: %u records", tdb_index->count);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the index of a TDB database, building it on
+   first use
+ */
+static struct emsabp_tdb_index *emsabp_tdb_index_get(TDB_CONTEXT *tdb_ctx)
+{
+	struct emsabp_tdb_index	*tdb_index;
+
+	for (tdb_index = emsabp_tdb_indexes; tdb_index; tdb_index = tdb_index->next) {
+		if (tdb_index->tdb_ctx == tdb_ctx) return tdb_index;
+	}
+
+	tdb_index = talloc_zero(NULL, struct emsabp_tdb_index);
+	if (!tdb_index) return NULL;
+
+	tdb_index->tdb_ctx = tdb_ctx;
+	htable_init(&tdb_index->dn_ht, _dn_rehash, NULL);
+	DLIST_ADD(emsabp_tdb_indexes, tdb_index);
+	talloc_set_destructor(tdb_index, emsabp_tdb_index_destructor);
+
+	if (emsabp_tdb_index_sync(tdb_index) != MAPI_E_SUCCESS) {
+		talloc_free(tdb_index);
+		return NULL;
+	}
+
+	return tdb_index;
+}
+
+/**
+   \details Release the in-memory index associated to a TDB
+   database. This function must be called before the TDB context is
+   closed.
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+ */
+_PUBLIC_ void emsabp_tdb_index_release(TDB_CONTEXT *tdb_ctx)
+{
+	struct emsabp_tdb_index	*tdb_index;
+
+	for (tdb_index = emsabp_tdb_indexes; tdb_index; tdb_index = tdb_index->next) {
+		if (tdb_index->tdb_ctx == tdb_ctx) {
+			talloc_free(tdb_index);
+			return;
+		}
+	}
+}
+
 /**
    \details Open EMSABP TDB database
 
@@ -80,6 +300,13 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 		free (dbuf.dptr);
 	}
 
+	/* Step 2. Build the in-memory MId <-> DN index */
+	if (!emsabp_tdb_index_get(tdb_ctx)) {
+		OC_DEBUG(3, "Unable to build the MId index");
+		tdb_close(tdb_ctx);
+		return NULL;
+	}
+
 	return tdb_ctx;
 }
 
@@ -118,6 +345,12 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init_tmp(TALLOC_CTX *mem_ctx)
 		return NULL;
 	}
 
+	/* Step 2. Build the (empty) in-memory MId <-> DN index */
+	if (!emsabp_tdb_index_get(tdb_ctx)) {
+		tdb_close(tdb_ctx);
+		return NULL;
+	}
+
 	return tdb_ctx;
 }
 
@@ -133,6 +366,7 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_close(TDB_CONTEXT *tdb_ctx)
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_INVALID_PARAMETER, NULL);
 
+	emsabp_tdb_index_release(tdb_ctx);
 	tdb_close(tdb_ctx);
 	OC_DEBUG(0, "TDB database closed");
 
@@ -194,59 +428,68 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_MId(TDB_CONTEXT *tdb_ctx,
 					      const char *keyname,
 					      uint32_t *MId)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	char		*str;
+	struct emsabp_tdb_index		*tdb_index;
+	struct emsabp_tdb_index_entry	*entry;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	bool				parsed;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!keyname, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!MId, MAPI_E_INVALID_PARAMETER, NULL);
 
+	tdb_index = emsabp_tdb_index_get(tdb_ctx);
+	if (tdb_index) {
+		entry = htable_get(&tdb_index->dn_ht, hash_string(keyname), _dn_cmp, keyname);
+		if (entry) {
+			*MId = entry->MId;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
 	key.dptr = (unsigned char *) keyname;
 	key.dsize = strlen(keyname);
 
 	dbuf = tdb_fetch(tdb_ctx, key);
 	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, NULL);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_fetch_MId");
-	str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	*MId = strtol((const char *)str, NULL, 16);
-	talloc_free(mem_ctx);
+	parsed = emsabp_tdb_parse_MId(dbuf, MId);
 	free(dbuf.dptr);
+	OPENCHANGE_RETVAL_IF(!parsed, MAPI_E_NOT_FOUND, NULL);
+
+	/* Record inserted by another process */
+	if (tdb_index) {
+		emsabp_tdb_index_add(tdb_index, *MId, keyname, key.dsize);
+	}
 
 	return MAPI_E_SUCCESS;
 }
 
 
-static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx, 
-				   TDB_DATA key, TDB_DATA dbuf, 
-				   void *state)
+/**
+   \details Retrieve the index entry for a MId, resynchronizing the
+   index with the TDB database if the MId is unknown
+ */
+static struct emsabp_tdb_index_entry *emsabp_tdb_index_lookup(TDB_CONTEXT *tdb_ctx,
+							      uint32_t MId)
 {
-	TALLOC_CTX		*mem_ctx;
-	uint32_t		value;
-	char			*value_str = NULL;
-	struct traverse_MId	*mid_trav = (struct traverse_MId *) state;
-
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_traverse_MId");
-	value_str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	value = strtol((const char *)value_str, NULL, 16);
-	talloc_free(mem_ctx);
+	struct emsabp_tdb_index		*tdb_index;
+	struct emsabp_tdb_index_entry	*entry;
 
-	if (value == mid_trav->MId) {
-		mid_trav->found = true;
-		return 1;
-	}
+	tdb_index = emsabp_tdb_index_get(tdb_ctx);
+	if (!tdb_index) return NULL;
 
-	return 0;
+	entry = emsabp_tdb_index_get_entry(tdb_index, MId);
+	if (entry) return entry;
+
+	if (emsabp_tdb_index_sync(tdb_index) != MAPI_E_SUCCESS) return NULL;
+
+	return emsabp_tdb_index_get_entry(tdb_index, MId);
 }
 
 
 /**
-   \details Traverse the EMSABP TDB database and look for the input
-   MId
+   \details Look for the input MId in the EMSABP TDB database
 
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to lookup
@@ -256,42 +499,14 @@ static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ bool emsabp_tdb_lookup_MId(TDB_CONTEXT *tdb_ctx,
 				    uint32_t MId)
 {
-	int			ret;
-	struct traverse_MId	mid_trav = { MId, false };
-
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId, (void *)&mid_trav);
+	if (!tdb_ctx) return false;
 
-	return (ret > 0) && mid_trav.found;
-}
-
-
-static int emsabp_tdb_traverse_MId_DN(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	char			*MId;
-	uint32_t		value;
-	struct emsabp_MId	*emsabp_MId = (struct emsabp_MId *) state;
-
-	if (key.dptr) {
-		if (!strncmp((const char *)key.dptr, "CN=", 3)) {
-			MId = talloc_strndup(emsabp_MId, (char *)dbuf.dptr, dbuf.dsize);
-			value = strtol((const char *)MId, NULL, 16);
-			talloc_free(MId);
-			if (value == emsabp_MId->MId) {
-				emsabp_MId->dn = talloc_strndup(emsabp_MId, (char *)key.dptr, key.dsize);
-				return 1;
-			}
-		}
-	}
-
-	return 0;
+	return emsabp_tdb_index_lookup(tdb_ctx, MId) != NULL;
 }
 
 
 /**
-   \details Traverse the EMSABP TDB and fetch the DN associated with
-   the MId
+   \details Fetch the DN associated with the MId from the EMSABP TDB
 
    \param mem_ctx pointer to the memory context
    \param tdb_ctx pointer to the EMSABP TDB context
@@ -305,24 +520,22 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 						      uint32_t MId,
 						      char **dn)
 {
-	int			ret;
-	struct emsabp_MId	*emsabp_MId;
-	
-	emsabp_MId = talloc_zero(mem_ctx, struct emsabp_MId);
-	emsabp_MId->dn = NULL;
-	emsabp_MId->MId = MId;
-	
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId_DN, (void *)emsabp_MId);
-	if (ret > -1 && emsabp_MId->dn) {
-		*dn = talloc_strdup(mem_ctx, emsabp_MId->dn);
-		talloc_free(emsabp_MId);
-		return MAPI_E_SUCCESS;
-	}
+	struct emsabp_tdb_index_entry	*entry;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!dn, MAPI_E_INVALID_PARAMETER, NULL);
 
 	*dn = NULL;
-	talloc_free(emsabp_MId);
 
-	return MAPI_E_NOT_FOUND;
+	entry = emsabp_tdb_index_lookup(tdb_ctx, MId);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
+	OPENCHANGE_RETVAL_IF(strncmp(entry->dn, "CN=", 3), MAPI_E_NOT_FOUND, NULL);
+
+	*dn = talloc_strdup(mem_ctx, entry->dn);
+	OPENCHANGE_RETVAL_IF(!*dn, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -337,13 +550,14 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 _PUBLIC_ enum MAPISTATUS emsabp_tdb_insert(TDB_CONTEXT *tdb_ctx,
 					   const char *keyname)
 {
-	enum MAPISTATUS	retval;
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	char		*str;
-	int		index;
-	int		ret;
+	enum MAPISTATUS			retval;
+	struct emsabp_tdb_index		*tdb_index;
+	TALLOC_CTX			*mem_ctx;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	char				*str;
+	int				index;
+	int				ret;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
@@ -383,6 +597,17 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_insert(TDB_CONTEXT *tdb_ctx,
 	ret = tdb_store(tdb_ctx, key, dbuf, TDB_MODIFY);
 	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
 
+	/* Step 5. Update the in-memory index. Only move the index
+	 * counter forward if no other process inserted records since
+	 * the last synchronization, so the next miss resynchronizes */
+	tdb_index = emsabp_tdb_index_get(tdb_ctx);
+	if (tdb_index) {
+		emsabp_tdb_index_add(tdb_index, index, keyname, strlen(keyname));
+		if (tdb_index->last_MId == index - 1) {
+			tdb_index->last_MId = index;
+		}
+	}
+
 	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -21,6 +21,8 @@
 
 #include "mysql.h"
 
+#include <stdarg.h>
+
 #include "oc_timer.h"
 #include "ccan/htable/htable.h"
 #include "ccan/hash/hash.h"
@@ -51,6 +53,58 @@ static bool _ht_cmp(const void *e, void *string)
 static struct htable ht = HTABLE_INITIALIZER(ht, _ht_rehash, NULL);
 
 
+/* Prepared statements, one per connection and statement template */
+struct stmt_v {
+	MYSQL		*conn;
+	const char	*sql;
+	MYSQL_STMT	*stmt;
+};
+
+struct stmt_key {
+	MYSQL		*conn;
+	const char	*sql;
+};
+
+static size_t _stmt_hash(const MYSQL *conn, const char *sql)
+{
+	return hash_pointer(conn, hash_string(sql));
+}
+
+static size_t _stmt_ht_rehash(const void *e, void *unused)
+{
+	const struct stmt_v *entry = e;
+
+	return _stmt_hash(entry->conn, entry->sql);
+}
+
+static bool _stmt_ht_cmp(const void *e, void *k)
+{
+	const struct stmt_v	*entry = e;
+	const struct stmt_key	*key = k;
+
+	return entry->conn == key->conn && strcmp(entry->sql, key->sql) == 0;
+}
+
+/* This is a dictionary [MYSQL *, sql] -> [MYSQL_STMT *] (actually struct stmt_v) */
+static struct htable stmt_ht = HTABLE_INITIALIZER(stmt_ht, _stmt_ht_rehash, NULL);
+
+static uint64_t stmt_prepared = 0;
+static uint64_t stmt_executed = 0;
+
+
+/**
+   \details Close and forget a prepared statement
+
+   \param entry pointer to the statement table entry
+ */
+static void stmt_cache_del(struct stmt_v *entry)
+{
+	htable_del(&stmt_ht, _stmt_hash(entry->conn, entry->sql), entry);
+	mysql_stmt_close(entry->stmt);
+	talloc_free(entry);
+}
+
+
 /**
     \details Close and delete all mysql connections already open
  */
@@ -58,6 +112,16 @@ void close_all_connections(void)
 {
 	struct htable_iter 	i;
 	struct conn_v		*entry;
+	struct stmt_v		*stmt_entry;
+
+	/* Prepared statements are bound to their connection */
+	stmt_entry = htable_first(&stmt_ht, &i);
+	while (stmt_entry) {
+		mysql_stmt_close(stmt_entry->stmt);
+		talloc_free(stmt_entry);
+		stmt_entry = htable_next(&stmt_ht, &i);
+	}
+	htable_clear(&stmt_ht);
 
 	entry = htable_first(&ht, &i);
 	while (entry) {
@@ -435,6 +499,443 @@ enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql,
 }
 
 
+/**
+   \details Retrieve the prepared statement for a query template,
+   preparing it on first use
+
+   \param conn pointer to the MySQL connection
+   \param sql the query template, with ? placeholders
+
+   \return the statement table entry on success, otherwise NULL
+ */
+static struct stmt_v *stmt_cache_get(MYSQL *conn, const char *sql)
+{
+	struct stmt_key	key = { conn, sql };
+	struct stmt_v	*entry;
+
+	entry = htable_get(&stmt_ht, _stmt_hash(conn, sql), _stmt_ht_cmp, &key);
+	if (entry) {
+		return entry;
+	}
+
+	entry = talloc_zero(talloc_autofree_context(), struct stmt_v);
+	if (!entry) return NULL;
+	entry->conn = conn;
+	entry->sql = talloc_strdup(entry, sql);
+	if (!entry->sql) goto error;
+
+	entry->stmt = mysql_stmt_init(conn);
+	if (!entry->stmt) goto error;
+	if (mysql_stmt_prepare(entry->stmt, sql, strlen(sql)) != 0) {
+		OC_DEBUG(3, "Error preparing `%s`: %s", sql, mysql_stmt_error(entry->stmt));
+		mysql_stmt_close(entry->stmt);
+		goto error;
+	}
+
+	if (!htable_add(&stmt_ht, _stmt_hash(conn, sql), entry)) {
+		mysql_stmt_close(entry->stmt);
+		goto error;
+	}
+	stmt_prepared++;
+
+	return entry;
+error:
+	talloc_free(entry);
+	return NULL;
+}
+
+/**
+   \details Execute a prepared statement and buffer its result set
+
+   Statements are prepared once per connection and query template, then
+   only their parameters are sent to the server. types describes the
+   variadic parameters, one character per ? placeholder: 's' for a
+   const char * (NULL binds SQL NULL), 'u' for a uint64_t and 'i' for a
+   uint32_t. A statement invalidated by a reconnection is prepared
+   again once.
+
+   \param conn pointer to the MySQL connection
+   \param sql the query template
+   \param types the parameter types
+   \param ap the parameters
+   \param stmtp pointer to the executed statement
+
+   \return MYSQL_SUCCESS on success, otherwise MYSQL_ERROR
+ */
+static enum MYSQLRESULT stmt_execute(MYSQL *conn, const char *sql,
+				     const char *types, va_list ap,
+				     MYSQL_STMT **stmtp)
+{
+	struct oc_timer_ctx	*oc_t_ctx;
+	float			seconds_spent;
+	struct stmt_v		*entry;
+	MYSQL_BIND		params[MYSQL_STMT_MAX_PARAMS];
+	uint64_t		values[MYSQL_STMT_MAX_PARAMS];
+	unsigned long		lengths[MYSQL_STMT_MAX_PARAMS];
+	const char		*str;
+	size_t			count, i;
+	int			attempt;
+
+	count = strlen(types);
+	if (count > MYSQL_STMT_MAX_PARAMS) {
+		OC_DEBUG(0, "Too many parameters for `%s`", sql);
+		return MYSQL_ERROR;
+	}
+
+	memset(params, 0, sizeof(params));
+	for (i = 0; i < count; i++) {
+		switch (types[i]) {
+		case 's':
+			str = va_arg(ap, const char *);
+			if (str == NULL) {
+				params[i].buffer_type = MYSQL_TYPE_NULL;
+				break;
+			}
+			lengths[i] = strlen(str);
+			params[i].buffer_type = MYSQL_TYPE_STRING;
+			params[i].buffer = (char *) str;
+			params[i].buffer_length = lengths[i];
+			params[i].length = &lengths[i];
+			break;
+		case 'u':
+		case 'i':
+			if (types[i] == 'u') {
+				values[i] = va_arg(ap, uint64_t);
+			} else {
+				values[i] = va_arg(ap, uint32_t);
+			}
+			params[i].buffer_type = MYSQL_TYPE_LONGLONG;
+			params[i].buffer = &values[i];
+			params[i].is_unsigned = true;
+			break;
+		default:
+			OC_DEBUG(0, "Unknown parameter type '%c' for `%s`", types[i], sql);
+			return MYSQL_ERROR;
+		}
+	}
+
+	oc_t_ctx = oc_timer_start_with_threshold(5, NULL, THRESHOLD_SLOW_QUERIES);
+	for (attempt = 0; attempt < 2; attempt++) {
+		entry = stmt_cache_get(conn, sql);
+		if (!entry) break;
+		if (mysql_stmt_param_count(entry->stmt) != count) {
+			OC_DEBUG(0, "`%s` expects %lu parameters, %zu given", sql,
+				 mysql_stmt_param_count(entry->stmt), count);
+			entry = NULL;
+			break;
+		}
+		if (mysql_stmt_bind_param(entry->stmt, params) == 0 &&
+		    mysql_stmt_execute(entry->stmt) == 0 &&
+		    mysql_stmt_store_result(entry->stmt) == 0) {
+			break;
+		}
+
+		OC_DEBUG(3, "Error on statement `%s`: %s", sql, mysql_stmt_error(entry->stmt));
+		stmt_cache_del(entry);
+		entry = NULL;
+	}
+
+	seconds_spent = oc_timer_end_diff(oc_t_ctx);
+	if (!entry) {
+		return MYSQL_ERROR;
+	}
+	stmt_executed++;
+
+	if (seconds_spent > THRESHOLD_SLOW_QUERIES) {
+		OC_DEBUG(5, "MySQL slow query!\n\tQuery: `%s`\n\tTime: %.3f\n",
+		         sql, seconds_spent);
+	}
+
+	*stmtp = entry->stmt;
+	return MYSQL_SUCCESS;
+}
+
+static enum MYSQLRESULT stmt_select_first_uints_v(MYSQL *conn, const char *sql,
+						  uint64_t *values, size_t count,
+						  const char *types, va_list ap)
+{
+	MYSQL_STMT		*stmt;
+	MYSQL_BIND		results[MYSQL_STMT_MAX_PARAMS];
+	my_bool			is_null[MYSQL_STMT_MAX_PARAMS];
+	enum MYSQLRESULT	ret;
+	size_t			i;
+	int			fetched;
+
+	if (!values || count == 0 || count > MYSQL_STMT_MAX_PARAMS) {
+		return MYSQL_ERROR;
+	}
+
+	ret = stmt_execute(conn, sql, types, ap, &stmt);
+	if (ret != MYSQL_SUCCESS) {
+		return ret;
+	}
+
+	if (mysql_stmt_field_count(stmt) < count) {
+		OC_DEBUG(0, "`%s` returns less than %zu columns", sql, count);
+		mysql_stmt_free_result(stmt);
+		return MYSQL_ERROR;
+	}
+
+	memset(results, 0, sizeof(results));
+	for (i = 0; i < count; i++) {
+		results[i].buffer_type = MYSQL_TYPE_LONGLONG;
+		results[i].buffer = &values[i];
+		results[i].is_unsigned = true;
+		results[i].is_null = &is_null[i];
+	}
+
+	ret = MYSQL_ERROR;
+	if (mysql_stmt_bind_result(stmt, results) == 0) {
+		fetched = mysql_stmt_fetch(stmt);
+		if (fetched == MYSQL_NO_DATA) {
+			ret = MYSQL_NOT_FOUND;
+		} else if (fetched == 0) {
+			ret = MYSQL_SUCCESS;
+			for (i = 0; i < count; i++) {
+				if (is_null[i]) ret = MYSQL_ERROR;
+			}
+		}
+	}
+	if (ret == MYSQL_ERROR) {
+		OC_DEBUG(0, "Error getting row of `%s`: %s", sql, mysql_stmt_error(stmt));
+	}
+	mysql_stmt_free_result(stmt);
+
+	return ret;
+}
+
+/**
+   \details Run a prepared SELECT and read the first column of the
+   first row as an unsigned integer. See stmt_execute for types.
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_uint(MYSQL *conn, const char *sql, uint64_t *n,
+					const char *types, ...)
+{
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+
+	va_start(ap, types);
+	ret = stmt_select_first_uints_v(conn, sql, n, 1, types, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/**
+   \details Run a prepared SELECT and read the count first columns of
+   the first row as unsigned integers. See stmt_execute for types.
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_uints(MYSQL *conn, const char *sql,
+					 uint64_t *values, size_t count,
+					 const char *types, ...)
+{
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+
+	va_start(ap, types);
+	ret = stmt_select_first_uints_v(conn, sql, values, count, types, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/**
+   \details Run a prepared SELECT and read the first column of the
+   first row as a string allocated on mem_ctx. A NULL column gives a
+   NULL string. See stmt_execute for types.
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_string(TALLOC_CTX *mem_ctx, MYSQL *conn,
+					  const char *sql, const char **s,
+					  const char *types, ...)
+{
+	MYSQL_STMT		*stmt;
+	MYSQL_BIND		result;
+	char			buffer[256];
+	char			*str;
+	unsigned long		length = 0;
+	my_bool			is_null = false;
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+	int			fetched;
+
+	if (!s) {
+		return MYSQL_ERROR;
+	}
+
+	va_start(ap, types);
+	ret = stmt_execute(conn, sql, types, ap, &stmt);
+	va_end(ap);
+	if (ret != MYSQL_SUCCESS) {
+		return ret;
+	}
+
+	memset(&result, 0, sizeof(result));
+	result.buffer_type = MYSQL_TYPE_STRING;
+	result.buffer = buffer;
+	result.buffer_length = sizeof(buffer);
+	result.length = &length;
+	result.is_null = &is_null;
+
+	ret = MYSQL_ERROR;
+	if (mysql_stmt_bind_result(stmt, &result) != 0) {
+		goto end;
+	}
+
+	fetched = mysql_stmt_fetch(stmt);
+	if (fetched == MYSQL_NO_DATA) {
+		ret = MYSQL_NOT_FOUND;
+		goto end;
+	}
+	if (fetched != 0 && fetched != MYSQL_DATA_TRUNCATED) {
+		goto end;
+	}
+
+	if (is_null) {
+		*s = NULL;
+		ret = MYSQL_SUCCESS;
+		goto end;
+	}
+
+	str = talloc_array(mem_ctx, char, length + 1);
+	if (!str) goto end;
+	if (length < sizeof(buffer)) {
+		memcpy(str, buffer, length);
+	} else {
+		/* Value larger than the stack buffer, fetch it again */
+		result.buffer = str;
+		result.buffer_length = length + 1;
+		if (mysql_stmt_fetch_column(stmt, &result, 0, 0) != 0) {
+			talloc_free(str);
+			goto end;
+		}
+	}
+	str[length] = '\0';
+	*s = str;
+	ret = MYSQL_SUCCESS;
+end:
+	if (ret == MYSQL_ERROR) {
+		OC_DEBUG(0, "Error getting row of `%s`: %s", sql, mysql_stmt_error(stmt));
+	}
+	mysql_stmt_free_result(stmt);
+
+	return ret;
+}
+
+/**
+   \details Run a prepared SELECT and read the count first columns of
+   the first row as blobs allocated on mem_ctx. Every blob is followed
+   by a NUL byte not counted in its length, so text columns can be used
+   as strings. A NULL column gives a blob with NULL data. See
+   stmt_execute for types.
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_blobs(TALLOC_CTX *mem_ctx, MYSQL *conn,
+					 const char *sql, DATA_BLOB *values,
+					 size_t count, const char *types, ...)
+{
+	MYSQL_STMT		*stmt;
+	MYSQL_BIND		results[MYSQL_STMT_MAX_PARAMS];
+	unsigned long		lengths[MYSQL_STMT_MAX_PARAMS];
+	my_bool			is_null[MYSQL_STMT_MAX_PARAMS];
+	uint8_t			*data;
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+	size_t			i;
+	int			fetched;
+
+	if (!values || count == 0 || count > MYSQL_STMT_MAX_PARAMS) {
+		return MYSQL_ERROR;
+	}
+
+	va_start(ap, types);
+	ret = stmt_execute(conn, sql, types, ap, &stmt);
+	va_end(ap);
+	if (ret != MYSQL_SUCCESS) {
+		return ret;
+	}
+
+	ret = MYSQL_ERROR;
+	if (mysql_stmt_field_count(stmt) < count) {
+		OC_DEBUG(0, "`%s` returns less than %zu columns", sql, count);
+		goto end;
+	}
+
+	/* Bind empty buffers to learn the lengths, then fetch each column */
+	memset(results, 0, sizeof(results));
+	for (i = 0; i < count; i++) {
+		lengths[i] = 0;
+		is_null[i] = false;
+		results[i].buffer_type = MYSQL_TYPE_BLOB;
+		results[i].length = &lengths[i];
+		results[i].is_null = &is_null[i];
+	}
+	if (mysql_stmt_bind_result(stmt, results) != 0) {
+		goto end;
+	}
+
+	fetched = mysql_stmt_fetch(stmt);
+	if (fetched == MYSQL_NO_DATA) {
+		ret = MYSQL_NOT_FOUND;
+		goto end;
+	}
+	if (fetched != 0 && fetched != MYSQL_DATA_TRUNCATED) {
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		values[i].data = NULL;
+		values[i].length = 0;
+		if (is_null[i]) continue;
+
+		data = talloc_array(mem_ctx, uint8_t, lengths[i] + 1);
+		if (!data) goto end;
+		if (lengths[i]) {
+			results[i].buffer = data;
+			results[i].buffer_length = lengths[i];
+			if (mysql_stmt_fetch_column(stmt, &results[i], i, 0) != 0) {
+				talloc_free(data);
+				goto end;
+			}
+		}
+		data[lengths[i]] = '\0';
+		values[i].data = data;
+		values[i].length = lengths[i];
+	}
+	ret = MYSQL_SUCCESS;
+end:
+	if (ret == MYSQL_ERROR) {
+		OC_DEBUG(0, "Error getting row of `%s`: %s", sql, mysql_stmt_error(stmt));
+	}
+	mysql_stmt_free_result(stmt);
+
+	return ret;
+}
+
+/**
+   \details Report how many statements were prepared and executed
+   through the prepared statement cache
+
+   \param prepared pointer to the number of statements prepared
+   \param executed pointer to the number of statements executed
+ */
+void stmt_cache_stats(uint64_t *prepared, uint64_t *executed)
+{
+	if (prepared) *prepared = stmt_prepared;
+	if (executed) *executed = stmt_executed;
+}
+
+
 bool table_exists(MYSQL *conn, char *table_name)
 {
 	MYSQL_RES *res;
@@ -28,6 +28,7 @@
 #include <gen_ndr/exchange.h>
 
 #define THRESHOLD_SLOW_QUERIES 0.25
+#define MYSQL_STMT_MAX_PARAMS 8
 #define _sql(A, B) _sql_escape(A, B, '\'')
 
 const char* _sql_escape(TALLOC_CTX *mem_ctx, const char *s, char c);
@@ -38,6 +39,12 @@ enum MYSQLRESULT select_all_strings(TALLOC_CTX *, MYSQL *, const char *, struct
 enum MYSQLRESULT select_first_string(TALLOC_CTX *, MYSQL *, const char *, const char **);
 enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql, uint64_t *n);
 
+enum MYSQLRESULT stmt_select_first_uint(MYSQL *, const char *, uint64_t *, const char *, ...);
+enum MYSQLRESULT stmt_select_first_uints(MYSQL *, const char *, uint64_t *, size_t, const char *, ...);
+enum MYSQLRESULT stmt_select_first_string(TALLOC_CTX *, MYSQL *, const char *, const char **, const char *, ...);
+enum MYSQLRESULT stmt_select_first_blobs(TALLOC_CTX *, MYSQL *, const char *, DATA_BLOB *, size_t, const char *, ...);
+void stmt_cache_stats(uint64_t *, uint64_t *);
+
 bool table_exists(MYSQL *, char *);
 bool create_schema(MYSQL *, const char *);
 bool convert_string_to_ull(const char *, uint64_t *);
@@ -0,0 +1,374 @@
+/*
+   Per-ROP statistics
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file oc_rop_stats.c
+
+   \brief Per-process ROP counters, latency histograms and backend
+   time accounting
+
+   Statistics are kept in a static table owned by the process: each
+   forked server process collects its own figures and dumps them in
+   its own file, named after its pid, so no locking is needed. The
+   file is removed when the process exits and files left behind by
+   processes which did not exit cleanly are removed when statistics
+   are enabled again.
+   Backend time is accumulated in process-wide counters which are
+   snapshotted when a ROP starts and attributed to the ROP when it
+   ends.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <talloc.h>
+
+#include "libmapi/oc_log.h"
+#include "oc_rop_stats.h"
+
+enum oc_rop_stats_clock_state {
+	OC_ROP_STATS_CLOCK_OFF = 0,
+	OC_ROP_STATS_CLOCK_NESTED,
+	OC_ROP_STATS_CLOCK_RUNNING
+};
+
+static const char *backend_names[OC_ROP_STATS_BACKEND_MAX] = {
+	"mapistore",
+	"openchangedb"
+};
+
+static struct {
+	bool				enabled;
+	char				*dir;
+	uint32_t			interval;
+	time_t				since;
+	time_t				last_dump;
+	uint64_t			backend_nsec[OC_ROP_STATS_BACKEND_MAX];
+	uint32_t			backend_depth[OC_ROP_STATS_BACKEND_MAX];
+	struct oc_rop_stats_entry	rops[OC_ROP_STATS_OPNUM_MAX];
+} rop_stats;
+
+
+static uint64_t _diff_in_nsec(const struct timespec *start, const struct timespec *end)
+{
+	return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000 +
+		end->tv_nsec - start->tv_nsec;
+}
+
+static char *_dump_path(TALLOC_CTX *mem_ctx, pid_t pid)
+{
+	return talloc_asprintf(mem_ctx, "%s/%d%s", rop_stats.dir, (int)pid, OC_ROP_STATS_SUFFIX);
+}
+
+/**
+   \details Remove the file of the current process, registered with
+   atexit and therefore run by every forked server process
+ */
+static void oc_rop_stats_exit(void)
+{
+	char	*path;
+
+	if (!rop_stats.enabled || !rop_stats.dir) return;
+
+	path = _dump_path(NULL, getpid());
+	if (path) {
+		unlink(path);
+		talloc_free(path);
+	}
+}
+
+int oc_rop_stats_cleanup(const char *dir)
+{
+	DIR		*d;
+	struct dirent	*de;
+	char		*end;
+	char		*path;
+	long		pid;
+	int		count = 0;
+
+	if (!dir) return -1;
+
+	d = opendir(dir);
+	if (!d) return -1;
+
+	while ((de = readdir(d)) != NULL) {
+		pid = strtol(de->d_name, &end, 10);
+		if (end == de->d_name || pid <= 0) continue;
+		if (strcmp(end, OC_ROP_STATS_SUFFIX) && strcmp(end, OC_ROP_STATS_SUFFIX ".tmp")) continue;
+		if (kill((pid_t)pid, 0) == 0 || errno != ESRCH) continue;
+
+		path = talloc_asprintf(NULL, "%s/%s", dir, de->d_name);
+		if (path && unlink(path) == 0) {
+			count++;
+		}
+		talloc_free(path);
+	}
+	closedir(d);
+
+	if (count) {
+		OC_DEBUG(3, "[rop_stats] Removed %d stale statistics files from %s", count, dir);
+	}
+
+	return count;
+}
+
+bool oc_rop_stats_init(const char *dir, uint32_t interval)
+{
+	static bool	exit_registered = false;
+
+	talloc_free(rop_stats.dir);
+	rop_stats.dir = NULL;
+
+	if (dir) {
+		if (mkdir(dir, 0700) == -1 && errno != EEXIST) {
+			OC_DEBUG(1, "[rop_stats] Unable to create %s: %s", dir, strerror(errno));
+			return false;
+		}
+		rop_stats.dir = talloc_strdup(NULL, dir);
+		if (!rop_stats.dir) return false;
+
+		oc_rop_stats_cleanup(dir);
+		if (!exit_registered && atexit(oc_rop_stats_exit) == 0) {
+			exit_registered = true;
+		}
+	}
+
+	rop_stats.interval = interval;
+	rop_stats.since = time(NULL);
+	rop_stats.last_dump = rop_stats.since;
+	rop_stats.enabled = true;
+
+	return true;
+}
+
+bool oc_rop_stats_enabled(void)
+{
+	return rop_stats.enabled;
+}
+
+void oc_rop_stats_reset(void)
+{
+	memset(rop_stats.rops, 0, sizeof (rop_stats.rops));
+	rop_stats.since = time(NULL);
+}
+
+void oc_rop_stats_rop_start(struct oc_rop_stats_call *call)
+{
+	if (!call) return;
+
+	call->active = rop_stats.enabled;
+	if (!call->active) return;
+
+	memcpy(call->backend_nsec, rop_stats.backend_nsec, sizeof (call->backend_nsec));
+	clock_gettime(CLOCK_MONOTONIC, &call->start);
+}
+
+void oc_rop_stats_rop_end(struct oc_rop_stats_call *call, uint8_t opnum,
+			  bool failed, uint32_t response_bytes)
+{
+	struct oc_rop_stats_entry	*entry;
+	struct timespec			now;
+	uint64_t			usec;
+	int				i;
+
+	if (!call || !call->active) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	usec = _diff_in_nsec(&call->start, &now) / 1000;
+
+	entry = &rop_stats.rops[opnum];
+	entry->calls++;
+	if (failed) {
+		entry->errors++;
+	}
+	entry->usec += usec;
+	if (usec > entry->max_usec) {
+		entry->max_usec = usec;
+	}
+	entry->response_bytes += response_bytes;
+	for (i = 0; i < OC_ROP_STATS_BACKEND_MAX; i++) {
+		entry->backend_usec[i] += (rop_stats.backend_nsec[i] - call->backend_nsec[i]) / 1000;
+	}
+	entry->buckets[oc_rop_stats_bucket_index(usec)]++;
+}
+
+void oc_rop_stats_backend_start(enum oc_rop_stats_backend backend,
+				struct oc_rop_stats_clock *clk)
+{
+	if (!rop_stats.enabled) {
+		clk->state = OC_ROP_STATS_CLOCK_OFF;
+		return;
+	}
+
+	if (rop_stats.backend_depth[backend]++) {
+		clk->state = OC_ROP_STATS_CLOCK_NESTED;
+		return;
+	}
+
+	clk->state = OC_ROP_STATS_CLOCK_RUNNING;
+	clock_gettime(CLOCK_MONOTONIC, &clk->start);
+}
+
+void oc_rop_stats_backend_end(enum oc_rop_stats_backend backend,
+			      struct oc_rop_stats_clock *clk)
+{
+	struct timespec	now;
+
+	switch (clk->state) {
+	case OC_ROP_STATS_CLOCK_OFF:
+		return;
+	case OC_ROP_STATS_CLOCK_NESTED:
+		rop_stats.backend_depth[backend]--;
+		return;
+	default:
+		rop_stats.backend_depth[backend]--;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		rop_stats.backend_nsec[backend] += _diff_in_nsec(&clk->start, &now);
+	}
+}
+
+const struct oc_rop_stats_entry *oc_rop_stats_get(uint8_t opnum)
+{
+	return &rop_stats.rops[opnum];
+}
+
+uint32_t oc_rop_stats_bucket_index(uint64_t usec)
+{
+	uint32_t	msb = 0;
+	uint32_t	idx;
+	uint64_t	v;
+
+	if (usec < OC_ROP_STATS_SUB_BUCKETS) {
+		return usec;
+	}
+
+	for (v = usec; v >>= 1; msb++);
+
+	idx = (msb - OC_ROP_STATS_SUB_BITS + 1) * OC_ROP_STATS_SUB_BUCKETS +
+		((usec >> (msb - OC_ROP_STATS_SUB_BITS)) & (OC_ROP_STATS_SUB_BUCKETS - 1));
+
+	return (idx < OC_ROP_STATS_BUCKETS) ? idx : OC_ROP_STATS_BUCKETS - 1;
+}
+
+uint64_t oc_rop_stats_bucket_lower(uint32_t idx)
+{
+	uint32_t	octave;
+
+	if (idx < OC_ROP_STATS_SUB_BUCKETS) {
+		return idx;
+	}
+
+	octave = idx / OC_ROP_STATS_SUB_BUCKETS;
+	return (uint64_t)(OC_ROP_STATS_SUB_BUCKETS + idx % OC_ROP_STATS_SUB_BUCKETS) << (octave - 1);
+}
+
+int oc_rop_stats_dump(const char *path)
+{
+	const struct oc_rop_stats_entry	*entry;
+	FILE				*f;
+	char				*tmp_path;
+	int				opnum;
+	int				i;
+	int				ret = 0;
+
+	if (!path) return -1;
+
+	tmp_path = talloc_asprintf(NULL, "%s.tmp", path);
+	if (!tmp_path) return -1;
+
+	f = fopen(tmp_path, "w");
+	if (!f) {
+		OC_DEBUG(1, "[rop_stats] Unable to open %s: %s", tmp_path, strerror(errno));
+		talloc_free(tmp_path);
+		return -1;
+	}
+
+	fprintf(f, "# OpenChange ROP statistics\n");
+	fprintf(f, "version %d\n", OC_ROP_STATS_VERSION);
+	fprintf(f, "pid %d\n", (int)getpid());
+	fprintf(f, "since %ld\n", (long)rop_stats.since);
+	fprintf(f, "time %ld\n", (long)time(NULL));
+
+	for (opnum = 0; opnum < OC_ROP_STATS_OPNUM_MAX; opnum++) {
+		entry = &rop_stats.rops[opnum];
+		if (!entry->calls) continue;
+
+		fprintf(f, "rop 0x%.2x calls %"PRIu64" errors %"PRIu64" usec %"PRIu64
+			" max_usec %"PRIu64" bytes %"PRIu64, opnum, entry->calls,
+			entry->errors, entry->usec, entry->max_usec, entry->response_bytes);
+		for (i = 0; i < OC_ROP_STATS_BACKEND_MAX; i++) {
+			fprintf(f, " %s_usec %"PRIu64, backend_names[i], entry->backend_usec[i]);
+		}
+		fprintf(f, " buckets");
+		for (i = 0; i < OC_ROP_STATS_BUCKETS; i++) {
+			if (!entry->buckets[i]) continue;
+			fprintf(f, " %"PRIu64":%"PRIu64, oc_rop_stats_bucket_lower(i), entry->buckets[i]);
+		}
+		fprintf(f, "\n");
+	}
+
+	if (ferror(f)) {
+		ret = -1;
+	}
+	if (fclose(f) != 0) {
+		ret = -1;
+	}
+	if (ret == 0 && rename(tmp_path, path) == -1) {
+		ret = -1;
+	}
+	if (ret != 0) {
+		OC_DEBUG(1, "[rop_stats] Unable to write %s: %s", path, strerror(errno));
+		unlink(tmp_path);
+	}
+
+	talloc_free(tmp_path);
+	return ret;
+}
+
+int oc_rop_stats_dump_pending(void)
+{
+	char	*path;
+	time_t	now;
+	int	ret;
+
+	if (!rop_stats.enabled || !rop_stats.dir || !rop_stats.interval) return 0;
+
+	now = time(NULL);
+	if (now - rop_stats.last_dump < rop_stats.interval) {
+		return 0;
+	}
+	rop_stats.last_dump = now;
+
+	path = _dump_path(NULL, getpid());
+	if (!path) return -1;
+
+	ret = oc_rop_stats_dump(path);
+	talloc_free(path);
+
+	return ret;
+}
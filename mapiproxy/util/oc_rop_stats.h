@@ -0,0 +1,202 @@
+/*
+   Per-ROP statistics
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __OC_ROP_STATS_H__
+#define __OC_ROP_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Latencies are bucketed per power of two, each power of two being
+ * split in OC_ROP_STATS_SUB_BUCKETS linear sub-buckets. 128 buckets
+ * cover a bit more than two hours with a 25% relative error. */
+#define OC_ROP_STATS_OPNUM_MAX		256
+#define OC_ROP_STATS_SUB_BITS		2
+#define OC_ROP_STATS_SUB_BUCKETS	(1 << OC_ROP_STATS_SUB_BITS)
+#define OC_ROP_STATS_BUCKETS		128
+
+#define OC_ROP_STATS_DIRNAME		"rop_stats"
+#define OC_ROP_STATS_SUFFIX		".stats"
+#define OC_ROP_STATS_VERSION		1
+
+enum oc_rop_stats_backend {
+	OC_ROP_STATS_MAPISTORE = 0,
+	OC_ROP_STATS_OPENCHANGEDB,
+	OC_ROP_STATS_BACKEND_MAX
+};
+
+struct oc_rop_stats_entry {
+	uint64_t	calls;
+	uint64_t	errors;
+	uint64_t	usec;
+	uint64_t	max_usec;
+	uint64_t	response_bytes;
+	uint64_t	backend_usec[OC_ROP_STATS_BACKEND_MAX];
+	uint64_t	buckets[OC_ROP_STATS_BUCKETS];
+};
+
+struct oc_rop_stats_call {
+	struct timespec	start;
+	uint64_t	backend_nsec[OC_ROP_STATS_BACKEND_MAX];
+	bool		active;
+};
+
+struct oc_rop_stats_clock {
+	struct timespec	start;
+	int		state;
+};
+
+/**
+  \details Account the time spent running stmt to the given backend.
+  Nested calls to the same backend are only accounted once.
+ */
+#define OC_ROP_STATS_BACKEND_CALL(backend, stmt)			\
+	do {								\
+		struct oc_rop_stats_clock	_oc_rop_stats_clk;	\
+									\
+		oc_rop_stats_backend_start(backend, &_oc_rop_stats_clk); \
+		stmt;							\
+		oc_rop_stats_backend_end(backend, &_oc_rop_stats_clk);	\
+	} while (0)
+
+/**
+  \details Return the result of a backend call of the given type,
+  accounting its time to the given backend.
+ */
+#define OC_ROP_STATS_BACKEND_RETURN(backend, type, call)		\
+	do {								\
+		type	_oc_rop_stats_ret;				\
+									\
+		OC_ROP_STATS_BACKEND_CALL(backend, _oc_rop_stats_ret = (call)); \
+		return _oc_rop_stats_ret;				\
+	} while (0)
+
+#define OC_ROP_STATS_OPENCHANGEDB_RETURN(call)				\
+	OC_ROP_STATS_BACKEND_RETURN(OC_ROP_STATS_OPENCHANGEDB, enum MAPISTATUS, call)
+
+#define OC_ROP_STATS_MAPISTORE_RETURN(call)				\
+	OC_ROP_STATS_BACKEND_RETURN(OC_ROP_STATS_MAPISTORE, enum mapistore_error, call)
+
+/**
+  \details Enable ROP statistics for the current process and the
+  processes it forks afterwards
+
+  \param dir directory where statistics are dumped, NULL to disable dumps
+  \param interval dump the statistics every interval seconds, 0 to
+  disable periodic dumps
+
+  \return true on success, otherwise false
+ */
+bool oc_rop_stats_init(const char *dir, uint32_t interval);
+
+/**
+  \details Remove the statistics files of processes which no longer
+  run from a dump directory
+
+  \param dir the dump directory
+
+  \return the number of files removed, -1 if dir cannot be read
+ */
+int oc_rop_stats_cleanup(const char *dir);
+
+/**
+  \details Tell whether ROP statistics are enabled
+ */
+bool oc_rop_stats_enabled(void);
+
+/**
+  \details Drop all the collected statistics
+ */
+void oc_rop_stats_reset(void);
+
+/**
+  \details Start timing a ROP
+
+  \param call pointer to the call accounting structure to initialize
+ */
+void oc_rop_stats_rop_start(struct oc_rop_stats_call *call);
+
+/**
+  \details Account a ROP started with oc_rop_stats_rop_start
+
+  \param call pointer to the call accounting structure
+  \param opnum the ROP identifier
+  \param failed whether the ROP returned an error
+  \param response_bytes the size of the ROP response
+ */
+void oc_rop_stats_rop_end(struct oc_rop_stats_call *call, uint8_t opnum,
+			  bool failed, uint32_t response_bytes);
+
+/**
+  \details Start timing a backend call, see OC_ROP_STATS_BACKEND_CALL
+ */
+void oc_rop_stats_backend_start(enum oc_rop_stats_backend backend,
+				struct oc_rop_stats_clock *clk);
+
+/**
+  \details Account a backend call started with oc_rop_stats_backend_start
+ */
+void oc_rop_stats_backend_end(enum oc_rop_stats_backend backend,
+			      struct oc_rop_stats_clock *clk);
+
+/**
+  \details Retrieve the statistics collected for a ROP
+
+  \param opnum the ROP identifier
+
+  \return pointer to the statistics, read-only
+ */
+const struct oc_rop_stats_entry *oc_rop_stats_get(uint8_t opnum);
+
+/**
+  \details Return the histogram bucket a latency falls in
+
+  \param usec latency in microseconds
+ */
+uint32_t oc_rop_stats_bucket_index(uint64_t usec);
+
+/**
+  \details Return the smallest latency, in microseconds, a histogram
+  bucket holds
+
+  \param idx the bucket index
+ */
+uint64_t oc_rop_stats_bucket_lower(uint32_t idx);
+
+/**
+  \details Dump the statistics if the dump interval elapsed. This
+  function is meant to be called once a request has been processed.
+
+  \return 0 on success or if there was nothing to do, otherwise -1
+ */
+int oc_rop_stats_dump_pending(void);
+
+/**
+  \details Write the statistics of the current process to a file
+
+  \param path the file to write, replaced atomically
+
+  \return 0 on success, otherwise -1
+ */
+int oc_rop_stats_dump(const char *path);
+
+#endif /* __OC_ROP_STATS_H__ */
@@ -24,6 +24,7 @@
 */
 
 #include <ctype.h>
+#include <string.h>
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
 #include <ndr.h>
@@ -51,132 +52,145 @@ ssize_t lzxpress_decompress(const uint8_t *input,
 			    uint8_t *output,
 			    uint32_t max_output_size);
 
-/**
-   \details Compress a LZXPRESS chunk
-
-   \param ndrpush pointer to the compressed data to return
-   \param ndrpull pointer to the uncompressed data used for compression
-   \param last pointer on boolean to define whether or not this is the
-   last chunk
+/* Plain LZ77 output is one byte per literal plus a 32-bit indicator
+   every 32 elements and a final indicator, matches are never longer
+   than the literals they replace */
+#define	LZXPRESS_COMPRESS_BOUND(n)	((n) + 4 * ((n) / 32) + 8)
 
-   \return NDR_ERR_SUCCESS on success, otherwise NDR error
- */
-static enum ndr_err_code ndr_push_lxpress_chunk(struct ndr_push *ndrpush,
-						struct ndr_pull *ndrpull,
-						bool *last)
-{
-	DATA_BLOB	comp_chunk;
-	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_size;
-	uint32_t	plain_chunk_offset;
-	uint32_t	max_plain_size = 0x00010000;
-	uint32_t	max_comp_size = 0x00020000 + 2; /* TODO: use the correct value here */
-	ssize_t		ret;
+#define	LZXPRESS_MIN_SIZE		128
+#define	LZXPRESS_PROBE_SIZE		4096
+#define	LZXPRESS_PROBE_HASH_BITS	10
+#define	LZXPRESS_PROBE_RATIO		8
 
-	/* Step 1. Retrieve the uncompressed buf */
-	plain_chunk_size = MIN(max_plain_size, ndrpull->data_size - ndrpull->offset);
-	plain_chunk_offset = ndrpull->offset;
-	NDR_CHECK(ndr_pull_advance(ndrpull, plain_chunk_size));
+/**
+   \details Estimate whether LZXPRESS compression pays off on a buffer
 
-	plain_chunk.data = ndrpull->data + plain_chunk_offset;
-	plain_chunk.length = plain_chunk_size;
+   LZXPRESS has no entropy coding stage: only repeated sequences make
+   the output smaller. The probe counts the 3-byte sequences of a
+   sample taken in the middle of the buffer which already appeared
+   earlier in the sample. Already compressed content (pictures,
+   archives) has almost none and would only grow.
 
-	if (plain_chunk_size < max_plain_size) {
-		*last = true;
-	};
+   \param data pointer to the uncompressed data
+   \param size size of the uncompressed data
 
-	NDR_CHECK(ndr_push_expand(ndrpush, max_comp_size));
+   \return true if compression is worth trying, otherwise false
+ */
+_PUBLIC_ bool lzxpress_probe(const uint8_t *data, uint32_t size)
+{
+	uint16_t	table[1 << LZXPRESS_PROBE_HASH_BITS];
+	uint32_t	sample;
+	uint32_t	hits = 0;
+	uint32_t	h;
+	uint32_t	i;
 
-	comp_chunk.data = ndrpush->data + ndrpush->offset;
-	comp_chunk.length = max_comp_size;
+	if (!data || size < LZXPRESS_MIN_SIZE) return false;
 
-	/* Compressing the buffer using LZ Xpress algorithm */
-	ret = lzxpress_compress(plain_chunk.data,
-				plain_chunk.length,
-				comp_chunk.data,
-				comp_chunk.length);
+	sample = MIN(size, LZXPRESS_PROBE_SIZE);
+	data += (size - sample) / 2;
 
-	if (ret < 0) {
-		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_compress() returned %d\n",
-				      (int)ret);
+	memset(table, 0xFF, sizeof (table));
+	for (i = 0; i + 3 <= sample; i++) {
+		h = (((uint32_t)data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761U;
+		h >>= 32 - LZXPRESS_PROBE_HASH_BITS;
+		if (table[h] != 0xFFFF && !memcmp(data + table[h], data + i, 3)) {
+			hits++;
+		}
+		table[h] = i;
 	}
-	comp_chunk.length = ret;
 
-	ndrpush->offset += comp_chunk.length;
-	return NDR_ERR_SUCCESS;
+	return (hits * LZXPRESS_PROBE_RATIO >= sample);
 }
 
-static enum ndr_err_code ndr_pull_lxpress_chunk(struct ndr_pull *ndrpull,
-						struct ndr_push *ndrpush,
-						ssize_t decompressed_len,
-						bool *last)
-{
-	DATA_BLOB	comp_chunk;
-	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_offset;
-	int		ret;
+/**
+   \details Compress a buffer at the current offset of a NDR push
+   context
 
-	/* Step 1. Retrieve the compressed buf */
-	comp_chunk.length = ndrpull->data_size;
-	comp_chunk.data = ndrpull->data;
+   The push buffer is expanded once to the worst case compressed size
+   and lzxpress_compress() writes straight into it.
 
-	plain_chunk_offset = ndrpush->offset;
-	NDR_CHECK(ndr_push_zero(ndrpush, decompressed_len));
-	plain_chunk.length = decompressed_len;
-	plain_chunk.data = ndrpush->data + plain_chunk_offset;
+   \param ndrpush pointer to the push context to write compressed data into
+   \param data pointer to the uncompressed data
+   \param size size of the uncompressed data
 
-	ret = lzxpress_decompress(comp_chunk.data,
-				  comp_chunk.length,
-				  plain_chunk.data,
-				  plain_chunk.length);
-	if (ret < 0) {
-		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_decompress() returned %d\n",
-				      (int)ret);
-	}
-	plain_chunk.length = ret;
-	ndrpush->offset = ret;
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+static enum ndr_err_code ndr_push_lzxpress_data(struct ndr_push *ndrpush,
+						const uint8_t *data,
+						uint32_t size)
+{
+	uint32_t	max_comp_size = LZXPRESS_COMPRESS_BOUND(size);
+	ssize_t		ret;
+
+	NDR_CHECK(ndr_push_expand(ndrpush, max_comp_size));
 
-	if ((decompressed_len < 0x00010000) || (ndrpull->offset+4 >= ndrpull->data_size)) {
-		/* this is the last chunk */
-		*last = true;
+	ret = lzxpress_compress(data, size, ndrpush->data + ndrpush->offset, max_comp_size);
+	if (ret < 0 || ret > max_comp_size) {
+		return ndr_push_error(ndrpush, NDR_ERR_COMPRESSION,
+				      "XPRESS lzxpress_compress() returned %d\n",
+				      (int)ret);
 	}
 
+	ndrpush->offset += ret;
 	return NDR_ERR_SUCCESS;
 }
 
+/**
+   \details Decompress a LZXPRESS blob
+
+   The remaining data of subndr is decompressed in a single call into
+   a buffer of the announced size, which is then used as is by the
+   returned pull context.
+
+   \param subndr pointer to the compressed blob
+   \param _comndr pointer on pointer to the uncompressed pull context
+   to return
+   \param decompressed_len size of the uncompressed data
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
 _PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
 							struct ndr_pull **_comndr,
 							ssize_t decompressed_len)
 {
-	struct ndr_push *ndrpush;
-	struct ndr_pull *comndr;
-	DATA_BLOB	uncompressed;
-	bool		last = false;
-
-	ndrpush = ndr_push_init_ctx(subndr);
-	NDR_ERR_HAVE_NO_MEMORY(ndrpush);
+	struct ndr_pull	*comndr;
+	uint8_t		*data;
+	ssize_t		ret;
 
-	while (!last) {
-		NDR_CHECK(ndr_pull_lxpress_chunk(subndr, ndrpush, decompressed_len, &last));
+	if (decompressed_len < 0) {
+		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
+				      "Bad uncompressed_len [%d] (PULL)",
+				      (int)decompressed_len);
 	}
 
-	uncompressed = ndr_push_blob(ndrpush);
-	if (uncompressed.length != decompressed_len) {
+	comndr = talloc_zero(subndr, struct ndr_pull);
+	NDR_ERR_HAVE_NO_MEMORY(comndr);
+	data = talloc_size(comndr, decompressed_len);
+	NDR_ERR_HAVE_NO_MEMORY(data);
+
+	ret = lzxpress_decompress(subndr->data + subndr->offset,
+				  subndr->data_size - subndr->offset,
+				  data, decompressed_len);
+	if (ret < 0) {
+		talloc_free(comndr);
+		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
+				      "XPRESS lzxpress_decompress() returned %d\n",
+				      (int)ret);
+	}
+	if (ret != decompressed_len) {
+		talloc_free(comndr);
 		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
 				      "Bad uncompressed_len [%u] != [%u](0x%08X) (PULL)",
-				      (int)uncompressed.length,
+				      (int)ret,
 				      (int)decompressed_len,
 				      (int)decompressed_len);
 	}
+	subndr->offset = subndr->data_size;
 
-	comndr = talloc_zero(subndr, struct ndr_pull);
-	NDR_ERR_HAVE_NO_MEMORY(comndr);
 	comndr->flags = subndr->flags;
 	comndr->current_mem_ctx = subndr->current_mem_ctx;
-	comndr->data = uncompressed.data;
-	comndr->data_size = uncompressed.length;
+	comndr->data = data;
+	comndr->data_size = decompressed_len;
 	comndr->offset = 0;
 
 	*_comndr = comndr;
@@ -187,25 +201,78 @@ _PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
    \details Push a compressed LZXPRESS blob
 
    \param subndr pointer to the compressed blob the function returns
-   \param _uncomndr pointer on pointer to the uncompressed DATA blob
+   \param uncomndr pointer to the uncompressed DATA blob
 
    \return NDR_ERR_SUCCESS on success, otherwise NDR error
  */
 _PUBLIC_ enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *subndr,
 						      struct ndr_push *uncomndr)
 {
-	struct ndr_pull	*ndrpull;
-	bool		last = false;
+	return ndr_push_lzxpress_data(subndr, uncomndr->data, uncomndr->offset);
+}
+
+/**
+   \details Push a RPC_HEADER_EXT and its payload
+
+   The payload is compressed straight into ndr when RHEF_Compressed is
+   requested, lzxpress_probe() expects a gain and the compressed blob
+   is actually smaller. Otherwise RHEF_Compressed is cleared and data
+   is copied as is. RHEF_XorMagic obfuscates the pushed payload, data
+   is never modified.
+
+   \param ndr pointer to the push context
+   \param flags the requested RPC_HEADER_EXT flags
+   \param data pointer to the payload
+   \param size size of the payload
 
-	ndrpull = talloc_zero(uncomndr, struct ndr_pull);
-	NDR_ERR_HAVE_NO_MEMORY(ndrpull);
-	ndrpull->flags = uncomndr->flags;
-	ndrpull->data = uncomndr->data;
-	ndrpull->data_size = uncomndr->offset;
-	ndrpull->offset = 0;
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code ndr_push_mapi2k7_payload(struct ndr_push *ndr,
+						    uint16_t flags,
+						    const uint8_t *data,
+						    uint32_t size)
+{
+	struct RPC_HEADER_EXT	header;
+	uint32_t		header_offset;
+	uint32_t		payload_offset;
+	uint32_t		end_offset;
+
+	header.Version = 0x0000;
+	header.Flags = flags;
+	header.Size = size;
+	header.SizeActual = size;
+
+	if ((flags & RHEF_Compressed) && !lzxpress_probe(data, size)) {
+		header.Flags &= ~RHEF_Compressed;
+	}
+
+	header_offset = ndr->offset;
+	NDR_CHECK(ndr_push_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header));
+	payload_offset = ndr->offset;
+
+	if (header.Flags & RHEF_Compressed) {
+		NDR_CHECK(ndr_push_lzxpress_data(ndr, data, size));
+		if (ndr->offset - payload_offset < size) {
+			/* Rewrite the header with the compressed size */
+			end_offset = ndr->offset;
+			header.Size = end_offset - payload_offset;
+			ndr->offset = header_offset;
+			NDR_CHECK(ndr_push_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header));
+			ndr->offset = end_offset;
+		} else {
+			/* Compression did not pay off, send plain data */
+			header.Flags &= ~RHEF_Compressed;
+			ndr->offset = header_offset;
+			NDR_CHECK(ndr_push_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header));
+		}
+	}
+
+	if (!(header.Flags & RHEF_Compressed)) {
+		NDR_CHECK(ndr_push_bytes(ndr, data, size));
+	}
 
-	while (!last) {
-		NDR_CHECK(ndr_push_lxpress_chunk(subndr, ndrpull, &last));
+	if (header.Flags & RHEF_XorMagic) {
+		obfuscate_data(ndr->data + payload_offset, ndr->offset - payload_offset, 0xA5);
 	}
 
 	return NDR_ERR_SUCCESS;
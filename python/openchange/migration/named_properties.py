@@ -125,3 +125,25 @@ class InitialDataMigration(Migration):
     @classmethod
     def unapply(cls, cur):
         cur.execute("DELETE FROM named_properties")
+
+
+@migration('named_properties', 3)
+class GenerationMigration(Migration):
+
+    description = 'Generation counter for named properties caches'
+
+    @classmethod
+    def apply(cls, cur, **kwargs):
+        # Bumped by each mapping creation: processes caching the
+        # mappings reload them when it changes
+        cur.execute("""CREATE TABLE IF NOT EXISTS `named_properties_generation` (
+                         `id` TINYINT UNSIGNED NOT NULL,
+                         `generation` BIGINT UNSIGNED NOT NULL DEFAULT 0,
+                         PRIMARY KEY(`id`)
+                      ) ENGINE=InnoDB""")
+        cur.execute("INSERT IGNORE INTO `named_properties_generation` "
+                    "(`id`, `generation`) VALUES (1, 0)")
+
+    @classmethod
+    def unapply(cls, cur, **kwargs):
+        cur.execute("DROP TABLE `named_properties_generation`")
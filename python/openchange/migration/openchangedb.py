@@ -330,3 +330,34 @@ class ReplicaMappingDataMigration(Migration):
     @classmethod
     def unapply(cls, cur, **kwargs):
         cur.execute("DELETE FROM `replica_mapping`")
+
+
+@migration('openchangedb', 4)
+class TypedPropertiesSchemaMigration(Migration):
+
+    description = 'Typed (NDR packed) property values'
+
+    @classmethod
+    def apply(cls, cur, **kwargs):
+        # Every row caches the decoded form of the text value it was
+        # built from: the backend ignores it as soon as value changes
+        for owner, owner_table in (('folder', 'folders'),
+                                   ('message', 'messages'),
+                                   ('mailbox', 'mailboxes')):
+            cur.execute("""CREATE TABLE IF NOT EXISTS `{1}_properties_typed` (
+                             `{0}_id` BIGINT UNSIGNED NOT NULL,
+                             `name` VARCHAR(128) NOT NULL,
+                             `value` VARCHAR(512) NOT NULL,
+                             `typed_value` BLOB NOT NULL,
+                             PRIMARY KEY (`{0}_id`, `name`),
+                             CONSTRAINT `fk_{1}_properties_typed_{0}_id`
+                             FOREIGN KEY (`{0}_id`)
+                               REFERENCES `{1}` (`id`)
+                               ON DELETE CASCADE
+                               ON UPDATE CASCADE)
+                           ENGINE = InnoDB""".format(owner, owner_table))
+
+    @classmethod
+    def unapply(cls, cur, **kwargs):
+        for table in ('folders', 'messages', 'mailboxes'):
+            cur.execute("DROP TABLE `{0}_properties_typed`".format(table))
@@ -8,6 +8,7 @@ import string
 import subprocess
 import sys
 import tempfile
+import uuid
 
 knownpropsets = { "PSETID_PostRss" :           "{00062041-0000-0000-C000-000000000046}",
 		  "PSETID_Sharing" :           "{00062040-0000-0000-C000-000000000046}",
@@ -448,6 +449,209 @@ def debug_dump():
 	for entry in properties:
 		print entry
 
+# Additional properties, referenced on MSDN but not in MS-OXPROPS
+extra_proptag_values = [ ("PidTagAssociatedContentCount", 0x36170003),
+			 ("PidTagFolderChildCount", 0x66380003),
+			 ("PidTagIpmPublicFoldersEntryId", 0x66310102),
+			 ("PidTagConversationKey", 0x000b0102),
+			 ("PidTagContactEmailAddresses", 0x3a56101f),
+			 ("PidTagGenerateExchangeViews", 0x36e9000b),
+			 ("PidTagLatestDeliveryTime", 0x00190040),
+			 ("PidTagMailPermission", 0x3a0e000b)
+			 ]
+
+# Compile-time perfect hash tables for the generated lookup functions.
+#
+# Keys are hashed with FNV-1a seeded through the offset basis and
+# finished with the murmur3 avalanche step. Keys are first spread over
+# a small number of buckets (seed 0), then every bucket gets the first
+# seed placing all its keys into free slots of the slot table
+# ("hash and displace"). The C side (mapi_phash_find in
+# libmapi/libmapi_private.h) computes exactly the same function, so
+# both must be kept in sync.
+proptype_values = dict((datatypemap[k], int(knowndatatypes[k], 16)) for k in datatypemap)
+proptype_values["PT_ERROR"] = 0x000A
+proptype_values["PT_ACTIONS"] = 0x00FE
+
+def phash(seed, key):
+	h = (0x811C9DC5 ^ seed) & 0xFFFFFFFF
+	for c in bytearray(key):
+		h ^= c
+		h = (h * 0x01000193) & 0xFFFFFFFF
+	h ^= h >> 16
+	h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+	h ^= h >> 13
+	h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+	h ^= h >> 16
+	return h
+
+def phash_key_u16(value):
+	return bytearray([value & 0xFF, (value >> 8) & 0xFF])
+
+def phash_key_u32(value):
+	return bytearray([value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF])
+
+def phash_key_string(value):
+	return bytearray(value.encode("utf-8"))
+
+def make_perfect_hash(items):
+	"""return (seeds, slots) for a list of (key, entry index) pairs.
+
+	Only the first occurrence of a duplicated key is indexed, which
+	matches what the former linear scans returned. Slots hold the
+	entry index + 1, 0 marking an empty slot."""
+	index = {}
+	for (key, i) in items:
+		if bytes(key) not in index:
+			index[bytes(key)] = i
+	if len(index) >= 0xFFFF:
+		raise ValueError("too many keys for a 16-bit slot table")
+	nbuckets = len(index) // 4 + 1
+	nslots = (len(index) * 5) // 4 + 1
+	buckets = [[] for i in range(nbuckets)]
+	for key in sorted(index):
+		buckets[phash(0, key) % nbuckets].append(key)
+	seeds = [0] * nbuckets
+	slots = [0] * nslots
+	for b in sorted(range(nbuckets), key=lambda b: (-len(buckets[b]), b)):
+		if not buckets[b]:
+			break
+		seed = 1
+		while True:
+			positions = [phash(seed, key) % nslots for key in buckets[b]]
+			if len(set(positions)) == len(positions) and not [p for p in positions if slots[p]]:
+				break
+			seed += 1
+		seeds[b] = seed
+		for (key, p) in zip(buckets[b], positions):
+			slots[p] = index[key] + 1
+	return (seeds, slots)
+
+def format_perfect_hash(name, items):
+	"""return the C definition of a struct mapi_phash called name"""
+	(seeds, slots) = make_perfect_hash(items)
+	out = ""
+	for (ctype, suffix, values) in (("uint32_t", "seeds", seeds), ("uint16_t", "slots", slots)):
+		out += "static const %s %s_%s[%d] = {\n" % (ctype, name, suffix, len(values))
+		for i in range(0, len(values), 12):
+			out += "\t" + ", ".join(["%d" % v for v in values[i:i+12]]) + ",\n"
+		out += "};\n"
+	out += "static const struct mapi_phash %s = {\n" % name
+	out += "\t%s_seeds, %d, %s_slots, %d\n};\n\n" % (name, len(seeds), name, len(slots))
+	return out
+
+def load_proptag_values(filenames):
+	"""return a dictionary of property tag values defined in the given
+	headers, either as PROP_TAG() defines annotated with their value or
+	as plain hexadecimal defines and enum members"""
+	values = {}
+	for filename in filenames:
+		f = open(filename, "r")
+		for line in f:
+			m = re.match(r"#define\s+(\w+)\s+PROP_TAG\(.*\)\s*/\*\s*(0x[0-9A-Fa-f]+)", line)
+			if m is None:
+				m = re.match(r"(?:#define)?\s*(\w+)\s*=?\s*(0x[0-9A-Fa-f]{8})\b", line)
+			if m is not None and m.group(1) not in values:
+				values[m.group(1)] = int(m.group(2), 16)
+		f.close()
+	for (name, value) in extra_proptag_values:
+		values.setdefault(name, value)
+	return values
+
+def load_oleguid_values(filename):
+	"""return a dictionary mapping the OLEGUID property set macros of
+	libmapi/mapidefs.h to the GUID little-endian wire representation"""
+	values = {}
+	f = open(filename, "r")
+	for line in f:
+		m = re.match(r"#define\s+(PS\w+)\s+\"([0-9A-Fa-f-]{36})\"", line)
+		if m is not None:
+			values[m.group(1)] = bytearray(uuid.UUID(m.group(2)).bytes_le)
+	f.close()
+	return values
+
+def parse_proptags_struct(proplines):
+	"""return the (proptag, proptype, propname) triplets of the
+	canonical_property_tags initializer lines"""
+	entries = []
+	for line in proplines:
+		m = re.match(r"\s*\{\s*(\w+),\s*(\w+),\s*\"(\w+)\"", line)
+		if m is not None:
+			entries.append(m.groups())
+	return entries
+
+def format_proptags_lookup(proplines, values):
+	"""return the perfect hash tables indexing canonical_property_tags"""
+	entries = parse_proptags_struct(proplines)
+	by_tag = []
+	by_name = []
+	by_id = []
+	for (i, (tag, ptype, name)) in enumerate(entries):
+		by_tag.append((phash_key_u32(values[tag]), i))
+		by_name.append((phash_key_string(name), i))
+		# get_property_type() skips PT_ERROR and PT_STRING8 entries
+		if ptype not in ("PT_ERROR", "PT_STRING8"):
+			by_id.append((phash_key_u16(values[tag] >> 16), i))
+	out = format_perfect_hash("canonical_property_tags_by_tag", by_tag)
+	out += format_perfect_hash("canonical_property_tags_by_name", by_name)
+	out += format_perfect_hash("canonical_property_tags_by_id", by_id)
+	return out
+
+def format_pidtags_lookup(proplines, values):
+	"""return the perfect hash tables indexing openchangedb pidtags"""
+	by_tag = []
+	by_id = []
+	i = 0
+	for line in proplines:
+		m = re.match(r"\s*\{\s*(\w+),\s*\"", line)
+		if m is None:
+			continue
+		by_tag.append((phash_key_u32(values[m.group(1)]), i))
+		by_id.append((phash_key_u16(values[m.group(1)] >> 16), i))
+		i += 1
+	out = format_perfect_hash("pidtags_by_tag", by_tag)
+	out += format_perfect_hash("pidtags_by_id", by_id)
+	return out
+
+def format_nameid_lookup(namedlines, values, guids):
+	"""return the binary OLEGUID of each mapi_nameid_tags entry and the
+	perfect hash tables indexing them. Composite keys are the 16 bytes
+	GUID followed by the lid (little-endian) or the string."""
+	entries = []
+	for line in namedlines:
+		m = re.match(r"\{\s*(\w+)\s*,\s*(NULL|\"[^\"]*\")\s*,\s*(0x[0-9A-Fa-f]+),\s*(NULL|\"[^\"]*\"),\s*\w+\s*,\s*\w+,\s*(\w+),", line)
+		if m is not None and m.group(5) != "NULL":
+			entries.append(m.groups())
+	oleguids = sorted(set([e[4] for e in entries]))
+	out = "static const uint8_t mapi_nameid_oleguids[%d][16] = {\n" % len(oleguids)
+	for OLEGUID in oleguids:
+		out += "\t{ " + ", ".join(["0x%.2x" % c for c in guids[OLEGUID]]) + " }, /* %s */\n" % OLEGUID
+	out += "};\n\n"
+	by_proptag = []
+	by_lid = []
+	by_name = []
+	by_oom = []
+	out += "static const uint8_t mapi_nameid_tags_oleguid[%d] = {\n" % len(entries)
+	for (i, (proptag, OOM, lid, Name, OLEGUID)) in enumerate(entries):
+		guid = guids[OLEGUID]
+		if i % 16 == 0:
+			out += "\t"
+		out += "%d," % oleguids.index(OLEGUID)
+		out += "\n" if (i % 16 == 15 or i == len(entries) - 1) else " "
+		by_proptag.append((phash_key_u32(values[proptag]), i))
+		if int(lid, 16):
+			by_lid.append((guid + phash_key_u16(int(lid, 16)), i))
+		if Name != "NULL":
+			by_name.append((guid + phash_key_string(Name[1:-1]), i))
+		if OOM != "NULL":
+			by_oom.append((guid + phash_key_string(OOM[1:-1]), i))
+	out += "};\n\n"
+	out += format_perfect_hash("mapi_nameid_tags_by_proptag", by_proptag)
+	out += format_perfect_hash("mapi_nameid_tags_by_lid", by_lid)
+	out += format_perfect_hash("mapi_nameid_tags_by_name", by_name)
+	out += format_perfect_hash("mapi_nameid_tags_by_OOM", by_oom)
+	return out
+
 extra_private_tags_struct = """\t{ PidTagFolderChildCount,                                             PT_LONG,      \"PidTagFolderChildCount\"                                            },
 """
 
@@ -731,24 +935,41 @@ def make_mapi_properties_file():
 	for propline in sortedproplines:
 		f.write(propline)
 	f.write("\t{ 0,                                                                  0,            \"NULL\"                                                              }\n")
-	f.write("};\n")
-	f.write("""
+	f.write("};\n\n")
+	f.write(format_proptags_lookup(sortedproplines, load_proptag_values(['libmapi/property_tags.h'])))
+	f.write("""static uint32_t canonical_property_tags_find_tag(uint32_t proptag)
+{
+	uint8_t		key[4];
+	uint32_t	idx;
+
+	key[0] = proptag & 0xFF;
+	key[1] = (proptag >> 8) & 0xFF;
+	key[2] = (proptag >> 16) & 0xFF;
+	key[3] = (proptag >> 24) & 0xFF;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_tag, NULL, 0, key, sizeof (key));
+	if (!idx || canonical_property_tags[idx - 1].proptag != proptag) {
+		return 0;
+	}
+	return idx;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
 	uint32_t idx;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	if (!proptag) return NULL;
+
+	idx = canonical_property_tags_find_tag(proptag);
+	if (idx) {
+		return canonical_property_tags[idx - 1].propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
 		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		idx = canonical_property_tags_find_tag(proptag);
+		if (idx) {
+			return canonical_property_tags[idx - 1].propname;
 		}
 	}
 	return NULL;
@@ -758,10 +979,11 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
 	uint32_t idx;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
+	if (!propname) return 0;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_name, NULL, 0, propname, strlen(propname));
+	if (idx && !strcmp(canonical_property_tags[idx - 1].propname, propname)) {
+		return canonical_property_tags[idx - 1].proptag;
 	}
 
 	return 0;
@@ -769,16 +991,15 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint8_t		key[2];
 	uint32_t	idx;
-	uint16_t	current_type;
-
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
-		}
+
+	key[0] = untypedtag & 0xFF;
+	key[1] = (untypedtag >> 8) & 0xFF;
+
+	idx = mapi_phash_find(&canonical_property_tags_by_id, NULL, 0, key, sizeof (key));
+	if (idx && (canonical_property_tags[idx - 1].proptag >> 16) == untypedtag) {
+		return canonical_property_tags[idx - 1].proptype;
 	}
 
 	OC_DEBUG(5, "type for property '%x' could not be deduced", untypedtag);
@@ -837,14 +1058,8 @@ _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 		f.write(propline)
 
 	# Add additional properties, referenced on MSDN but not in MS-OXPROPS
-	f.write("\t" + string.ljust("PidTagAssociatedContentCount", 68) + " = 0x36170003,\n")
-	f.write("\t" + string.ljust("PidTagFolderChildCount", 68) + " = 0x66380003,\n")
-	f.write("\t" + string.ljust("PidTagIpmPublicFoldersEntryId", 68) + " = 0x66310102,\n")
-	f.write("\t" + string.ljust("PidTagConversationKey", 68) + " = 0x000b0102,\n")
-	f.write("\t" + string.ljust("PidTagContactEmailAddresses", 68) + " = 0x3a56101f,\n")
-	f.write("\t" + string.ljust("PidTagGenerateExchangeViews", 68) + " = 0x36e9000b,\n")
-	f.write("\t" + string.ljust("PidTagLatestDeliveryTime", 68) + " = 0x00190040,\n")
-	f.write("\t" + string.ljust("PidTagMailPermission", 68) + " = 0x3a0e000b,\n")
+	for (name, value) in extra_proptag_values:
+		f.write("\t" + string.ljust(name, 68) + " = 0x%.8x,\n" % value)
 
 	f.write("\tMAPI_PROP_RESERVED                                                   = 0xFFFFFFFF\n")
 	f.write("} MAPITAGS;\n")
@@ -953,15 +1168,20 @@ static struct pidtags pidtags[] = {
 	f.write("""\t{ 0,                                                                   NULL         }
 };
 
-static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
+""")
+	f.write(format_pidtags_lookup(sortedproplines, load_proptag_values(['libmapi/property_tags.h', 'properties_enum.h'])))
+	f.write("""static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t tag_id = (proptag >> 16);
+	uint8_t		key[2];
+	uint32_t	idx;
+	uint16_t	tag_id = (proptag >> 16);
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (tag_id == (pidtags[i].proptag >> 16)) {
-			return pidtags[i].pidtag;
-		}
+	key[0] = tag_id & 0xFF;
+	key[1] = (tag_id >> 8) & 0xFF;
+
+	idx = mapi_phash_find(&pidtags_by_id, NULL, 0, key, sizeof (key));
+	if (idx && (pidtags[idx - 1].proptag >> 16) == tag_id) {
+		return pidtags[idx - 1].pidtag;
 	}
 
 	return NULL;
@@ -969,17 +1189,22 @@ static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 
 _PUBLIC_ const char *openchangedb_property_get_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t prop_type = proptag & 0x0FFF;
+	uint8_t		key[4];
+	uint32_t	idx;
+	uint32_t	prop_type = proptag & 0x0FFF;
 
 	if (prop_type == PT_UNICODE || prop_type == PT_STRING8) {
 		return _openchangedb_property_get_string_attribute(proptag);
 	}
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (pidtags[i].proptag == proptag) {
-			return pidtags[i].pidtag;
-		}
+	key[0] = proptag & 0xFF;
+	key[1] = (proptag >> 8) & 0xFF;
+	key[2] = (proptag >> 16) & 0xFF;
+	key[3] = (proptag >> 24) & 0xFF;
+
+	idx = mapi_phash_find(&pidtags_by_tag, NULL, 0, key, sizeof (key));
+	if (idx && pidtags[idx - 1].proptag == proptag) {
+		return pidtags[idx - 1].pidtag;
 	}
 	OC_DEBUG(0, "Unsupported property tag '0x%.8x'", proptag);
 
@@ -1380,6 +1605,8 @@ struct mapi_nameid {
 static struct mapi_nameid_tags mapi_nameid_tags[] = {
 """)
 
+	namedlines = []
+
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
 			OOM = "\"%s\"" % line[1]
@@ -1388,6 +1615,7 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 			propline = "{ %s, %s, %s, %s, %s, %s, %s, %s },\n" % (
 				string.ljust(line[0], 60), string.ljust(OOM, 65), line[2], line[3], 
 				string.ljust(datatype, 15), "MNID_ID", line[6], "0x0")
+			namedlines.append(propline)
 			f.write(propline)
 
 	for line in sortednamedprops:
@@ -1398,12 +1626,14 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 			propline = "{ %s, %s, %s, \"%s\", %s, %s, %s, %s },\n" % (
 				string.ljust(line[0], 60), string.ljust(OOM, 65), line[2], line[3], 
 				string.ljust(datatype, 15), "MNID_STRING", line[6], "0x0")
+			namedlines.append(propline)
 			f.write(propline)
 
 	# Addtional named properties
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s },\n" % (
 		string.ljust("PidLidRemoteTransferSize", 60), string.ljust("\"RemoteTransferSize\"", 65), "0x8f05",
 		"NULL", string.ljust("PT_LONG", 15), "MNID_ID", "PSETID_Remote", "0x0")
+	namedlines.append(propline)
 	f.write(propline)
 
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s }\n" % (
@@ -1412,7 +1642,10 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 	f.write(propline)
 	f.write("""
 };
+
 """)
+	f.write(format_nameid_lookup(namedlines, load_proptag_values(['libmapi/mapi_nameid.h']),
+				     load_oleguid_values('libmapi/mapidefs.h')))
 
 	f.write("""
 static struct mapi_nameid_names mapi_nameid_names[] = {
@@ -24,6 +24,9 @@
 #include "libmapi/libmapi_private.h"
 #include <gen_ndr/ndr_exchange.h>
 
+/* Number of fragmented ranges used by the lookup test */
+#define	IDSET_TEST_RANGES	10000
+
 /* Global test variables */
 static TALLOC_CTX *mem_ctx;
 
@@ -245,6 +248,100 @@ START_TEST (test_IDSET_includes_guid_glob) {
 
 } END_TEST
 
+START_TEST (test_IDSET_includes_eid) {
+	const uint64_t		ids[] = {0x1d0401000000,
+					0x1e0401000000,
+					0x1f0401000000,
+					0x230401000000,
+					0x240401000000,
+					0x500401000000};
+	const uint64_t		not_in_ids[] = {0x1c0401000000,
+						0x200401000000,
+						0x250401000000,
+						0x510401000000};
+	size_t			ids_size = sizeof(ids)/sizeof(uint64_t);
+	size_t			not_in_ids_size = sizeof(not_in_ids)/sizeof(uint64_t);
+	uint16_t		repl_id = 0x0001;
+	struct idset		*idset_in;
+	struct rawidset		*rawidset_in, *rawidset_rm;
+	int			i;
+
+	rawidset_in = RAWIDSET_make(mem_ctx, true, false);
+	ck_assert(rawidset_in != NULL);
+	for (i = 0; i < ids_size; i++) {
+		RAWIDSET_push_eid(rawidset_in, (ids[i] << 16) | repl_id);
+	}
+	idset_in = RAWIDSET_convert_to_idset(mem_ctx, rawidset_in);
+	ck_assert(idset_in != NULL);
+	ck_assert_int_eq(idset_in->range_count, 3);
+	ck_assert(idset_in->index != NULL);
+	ck_assert_int_eq(idset_in->index->count, 3);
+
+	for (i = 0; i < ids_size; i++) {
+		ck_assert(IDSET_includes_eid(idset_in, (ids[i] << 16) | repl_id));
+	}
+	for (i = 0; i < not_in_ids_size; i++) {
+		ck_assert(!IDSET_includes_eid(idset_in, (not_in_ids[i] << 16) | repl_id));
+	}
+	/* Different replica ID */
+	ck_assert(!IDSET_includes_eid(idset_in, (ids[0] << 16) | 0x0002));
+
+	/* The lookup table follows removals */
+	rawidset_rm = RAWIDSET_make(mem_ctx, true, true);
+	ck_assert(rawidset_rm != NULL);
+	RAWIDSET_push_eid(rawidset_rm, (ids[1] << 16) | repl_id);
+	IDSET_remove_rawidset(idset_in, rawidset_rm);
+
+	ck_assert_int_eq(idset_in->index->count, 4);
+	ck_assert(!IDSET_includes_eid(idset_in, (ids[1] << 16) | repl_id));
+	ck_assert(IDSET_includes_eid(idset_in, (ids[0] << 16) | repl_id));
+	ck_assert(IDSET_includes_eid(idset_in, (ids[2] << 16) | repl_id));
+} END_TEST
+
+static bool idset_linear_includes(const struct idset *idset, uint64_t globcnt)
+{
+	struct globset_range	*range;
+
+	for (range = idset->ranges; range; range = range->next) {
+		if (exchange_globcnt(range->low) <= exchange_globcnt(globcnt)
+		    && exchange_globcnt(range->high) >= exchange_globcnt(globcnt)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+START_TEST (test_IDSET_includes_many_ranges) {
+	struct GUID		server_guid = GUID_random();
+	struct rawidset		*rawidset_in;
+	struct idset		*idset_in;
+	uint64_t		globcnt;
+	bool			included;
+	int			i, found;
+
+	/* Every other change number: one range per element */
+	rawidset_in = RAWIDSET_make(mem_ctx, false, false);
+	ck_assert(rawidset_in != NULL);
+	for (i = 0; i < IDSET_TEST_RANGES; i++) {
+		RAWIDSET_push_guid_glob(rawidset_in, &server_guid, exchange_globcnt(2 * i + 1));
+	}
+	idset_in = RAWIDSET_convert_to_idset(mem_ctx, rawidset_in);
+	ck_assert(idset_in != NULL);
+	ck_assert_int_eq(idset_in->range_count, IDSET_TEST_RANGES);
+
+	/* The indexed lookup agrees with a walk of every range */
+	found = 0;
+	for (i = 0; i < 2 * IDSET_TEST_RANGES; i++) {
+		globcnt = exchange_globcnt(i + 1);
+		included = IDSET_includes_guid_glob(idset_in, &server_guid, globcnt);
+		ck_assert(included == idset_linear_includes(idset_in, globcnt));
+		ck_assert(included == ((i % 2) == 0));
+		found += included ? 1 : 0;
+	}
+	ck_assert_int_eq(found, IDSET_TEST_RANGES);
+} END_TEST
+
 START_TEST (test_IDSET_remove_rawidset) {
 	const uint64_t		ids[] = {0x1d0401000000,
 					0x1e0401000000,
@@ -621,6 +718,8 @@ Suite *libmapi_idset_suite(void)
 	tc = tcase_create("IDSET_includes_guid_glob");
 	tcase_add_checked_fixture(tc, tc_mapi_idset_setup, tc_mapi_idset_teardown);
 	tcase_add_test(tc, test_IDSET_includes_guid_glob);
+	tcase_add_test(tc, test_IDSET_includes_eid);
+	tcase_add_test(tc, test_IDSET_includes_many_ranges);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("IDSET_remove_rawidset");
@@ -24,6 +24,7 @@
 #include "testsuite.h"
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
+#include "libmapi/mapi_nameid.h"
 #include <gen_ndr/ndr_exchange.h>
 
 /* Global test variables */
@@ -375,6 +376,76 @@ START_TEST (test_get_TimeZoneDefinition) {
 
 } END_TEST
 
+START_TEST (test_get_proptag_lookups) {
+	ck_assert_str_eq(get_proptag_name(PidTagDisplayName), "PidTagDisplayName");
+	ck_assert_str_eq(get_proptag_name(PidTagDisplayName_Error), "PidTagDisplayName_Error");
+	/* PT_STRING8 falls back on the PT_UNICODE entry */
+	ck_assert_str_eq(get_proptag_name((PidTagDisplayName & 0xFFFF0000) | PT_STRING8), "PidTagDisplayName");
+	ck_assert_str_eq(get_proptag_name(PidTagFolderChildCount), "PidTagFolderChildCount");
+	ck_assert(get_proptag_name(0) == NULL);
+	ck_assert(get_proptag_name(0x7ff00003) == NULL);
+
+	ck_assert_int_eq(get_proptag_value("PidTagDisplayName"), PidTagDisplayName);
+	ck_assert_int_eq(get_proptag_value("PidTagAddressBookHomeMessageDatabase"),
+			 PidTagAddressBookHomeMessageDatabase);
+	ck_assert_int_eq(get_proptag_value("PidTagDisplayNam"), 0);
+	ck_assert_int_eq(get_proptag_value(""), 0);
+
+	/* PT_ERROR and PT_STRING8 entries never give the property type */
+	ck_assert_int_eq(get_property_type(PidTagDisplayName >> 16), PT_UNICODE);
+	ck_assert_int_eq(get_property_type(PidTagAccess >> 16), PT_LONG);
+	ck_assert_int_eq(get_property_type(PidTagAddressBookHomeMessageDatabase >> 16), 0);
+	ck_assert_int_eq(get_property_type(0x7ff0), 0);
+} END_TEST
+
+START_TEST (test_mapi_nameid_lookups) {
+	uint16_t	propType;
+	uint32_t	propTag;
+
+	ck_assert_int_eq(mapi_nameid_lid_lookup(0x8501, PSETID_Common, &propType), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_LONG);
+	ck_assert_int_eq(mapi_nameid_lid_lookup_canonical(0x8501, PSETID_Common, &propTag), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propTag, PidLidReminderDelta);
+	/* OLEGUIDs are compared as GUIDs, not as strings */
+	ck_assert_int_eq(mapi_nameid_lid_lookup_canonical(0x8501, "00062008-0000-0000-C000-000000000046",
+							  &propTag), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propTag, PidLidReminderDelta);
+	ck_assert_int_eq(mapi_nameid_lid_lookup(0x8501, PSETID_Address, &propType), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_nameid_lid_lookup(0x8501, "not a guid", &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_string_lookup("Keywords", PS_PUBLIC_STRINGS, &propType), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_MV_UNICODE);
+	ck_assert_int_eq(mapi_nameid_string_lookup_canonical("Keywords", PS_PUBLIC_STRINGS, &propTag), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propTag, PidNameKeywords);
+	ck_assert_int_eq(mapi_nameid_string_lookup("Keyword", PS_PUBLIC_STRINGS, &propType), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_nameid_string_lookup("Keywords", PSETID_Common, &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_OOM_lookup("FileUnder", PSETID_Address, &propType), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_UNICODE);
+	ck_assert_int_eq(mapi_nameid_OOM_lookup("FileUnder", PSETID_Common, &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_property_lookup(PidLidFileUnder), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_nameid_property_lookup(PidTagDisplayName), MAPI_E_NOT_FOUND);
+} END_TEST
+
+START_TEST (test_proptag_lookups) {
+	uint32_t		id, found = 0;
+	uint16_t		type;
+	const char		*name;
+
+	/* Every property id, then the name and the tag of the known ones */
+	for (id = 0x0001; id < 0x10000; id++) {
+		type = get_property_type(id);
+		if (!type) continue;
+		name = get_proptag_name((id << 16) | type);
+		ck_assert(name != NULL);
+		ck_assert_int_eq(get_proptag_value(name), (id << 16) | type);
+		found++;
+	}
+
+	ck_assert(found > 0);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -509,5 +580,11 @@ Suite *libmapi_property_suite(void)
 	tcase_add_test(tc, test_get_TimeZoneDefinition);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("property tag lookups");
+	tcase_add_test(tc, test_get_proptag_lookups);
+	tcase_add_test(tc, test_mapi_nameid_lookups);
+	tcase_add_test(tc, test_proptag_lookups);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,195 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+
+#define	HANDLES_TEST_COUNT	10000
+
+static TALLOC_CTX			*g_mem_ctx;
+static struct mapi_handles_context	*g_handles_ctx;
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_add_search) {
+	enum MAPISTATUS		retval;
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(rec->handle, 1);
+	ck_assert_int_eq(rec->parent_handle, 0);
+
+	retval = mapi_handles_search(g_handles_ctx, rec->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(found == rec);
+
+	retval = mapi_handles_search(g_handles_ctx, 0x42, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_handles_search(g_handles_ctx, MAPI_HANDLES_RESERVED, &found);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_delete_reuse) {
+	enum MAPISTATUS		retval;
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*rec2 = NULL;
+	struct mapi_handles	*found = NULL;
+	uint32_t		handle;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	handle = rec->handle;
+
+	retval = mapi_handles_delete(g_handles_ctx, handle);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	retval = mapi_handles_delete(g_handles_ctx, handle);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	/* The slot is reused but the stale handle must not resolve */
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec2);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(rec2->handle & MAPI_HANDLES_INDEX_MASK, handle & MAPI_HANDLES_INDEX_MASK);
+	ck_assert_int_ne(rec2->handle, handle);
+
+	retval = mapi_handles_search(g_handles_ctx, handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_handles_search(g_handles_ctx, rec2->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(found == rec2);
+} END_TEST
+
+START_TEST (test_delete_children) {
+	enum MAPISTATUS		retval;
+	struct mapi_handles	*root = NULL;
+	struct mapi_handles	*child = NULL;
+	struct mapi_handles	*grandchild = NULL;
+	struct mapi_handles	*sibling = NULL;
+	struct mapi_handles	*found = NULL;
+	uint32_t		child_handle;
+	uint32_t		grandchild_handle;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &root);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = mapi_handles_add(g_handles_ctx, root->handle, &child);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = mapi_handles_add(g_handles_ctx, child->handle, &grandchild);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = mapi_handles_add(g_handles_ctx, 0, &sibling);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	ck_assert(root->children == child);
+	ck_assert(child->children == grandchild);
+	ck_assert_int_eq(g_handles_ctx->count, 4);
+
+	child_handle = child->handle;
+	grandchild_handle = grandchild->handle;
+
+	retval = mapi_handles_delete(g_handles_ctx, root->handle);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(g_handles_ctx->count, 1);
+
+	retval = mapi_handles_search(g_handles_ctx, child_handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(g_handles_ctx, grandchild_handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(g_handles_ctx, sibling->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(g_handles_ctx->handles == sibling);
+} END_TEST
+
+START_TEST (test_many_handles) {
+	enum MAPISTATUS		retval;
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*parent = NULL;
+	uint32_t		*handles;
+	int			i;
+
+	handles = talloc_array(g_mem_ctx, uint32_t, HANDLES_TEST_COUNT);
+	ck_assert(handles != NULL);
+
+	/* Every 10th handle is a container for the following ones */
+	for (i = 0; i < HANDLES_TEST_COUNT; i++) {
+		retval = mapi_handles_add(g_handles_ctx, parent ? parent->handle : 0, &rec);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		handles[i] = rec->handle;
+		if ((i % 10) == 0) {
+			parent = rec;
+		}
+	}
+	ck_assert_int_eq(g_handles_ctx->count, HANDLES_TEST_COUNT);
+
+	for (i = 0; i < HANDLES_TEST_COUNT; i++) {
+		retval = mapi_handles_search(g_handles_ctx, handles[i], &rec);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert_int_eq(rec->handle, handles[i]);
+	}
+
+	/* Release in allocation order, children go away with their parent */
+	for (i = 0; i < HANDLES_TEST_COUNT; i++) {
+		retval = mapi_handles_delete(g_handles_ctx, handles[i]);
+		ck_assert(retval == MAPI_E_SUCCESS || retval == MAPI_E_NOT_FOUND);
+	}
+	ck_assert_int_eq(g_handles_ctx->count, 0);
+
+	talloc_free(handles);
+} END_TEST
+
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void mapi_handles_setup(void)
+{
+	g_mem_ctx = talloc_new(talloc_autofree_context());
+	g_handles_ctx = mapi_handles_init(g_mem_ctx);
+	ck_assert(g_handles_ctx != NULL);
+}
+
+static void mapi_handles_teardown(void)
+{
+	mapi_handles_release(g_handles_ctx);
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_mapi_handles_suite(void)
+{
+	Suite *s = suite_create("mapi handles");
+
+	TCase *tc = tcase_create("mapi handles interface");
+	tcase_add_checked_fixture(tc, mapi_handles_setup, mapi_handles_teardown);
+
+	tcase_add_test(tc, test_add_search);
+	tcase_add_test(tc, test_delete_reuse);
+	tcase_add_test(tc, test_delete_children);
+	tcase_add_test(tc, test_many_handles);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
@@ -26,6 +26,7 @@
 #include "mapiproxy/libmapiproxy/backends/openchangedb_ldb.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_mysql.h"
 #include "libmapi/libmapi.h"
+#include "mapiproxy/util/mysql.h"
 #include <inttypes.h>
 #include <mysql/mysql.h>
 
@@ -387,6 +388,113 @@ START_TEST (test_get_next_changeNumber) {
 	}
 } END_TEST
 
+START_TEST (test_get_new_changeNumber_lease) {
+	uint64_t base, cn = 0, next_cn = 0;
+	int i;
+
+	retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	base = exchange_globcnt(next_cn >> 16);
+
+	g_oc_ctx->cn_lease_size = 4;
+	for (i = 0; i < 6; i++) {
+		retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+		CHECK_SUCCESS;
+		ck_assert(cn == ((exchange_globcnt(base + i) << 16) | 0x0001));
+
+		/* The next change number comes from the lease */
+		retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+		CHECK_SUCCESS;
+		ck_assert(next_cn == ((exchange_globcnt(base + i + 1) << 16) | 0x0001));
+	}
+
+	/* Two leases were taken from the backend */
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 8) << 16) | 0x0001));
+
+	/* Leave the remaining leased values unused */
+	g_oc_ctx->cn_lease_size = 0;
+	retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 8) << 16) | 0x0001));
+} END_TEST
+
+START_TEST (test_get_new_changeNumbers_lease) {
+	uint64_t base, cn = 0, next_cn = 0;
+	struct UI8Array_r *cns;
+	int i;
+
+	/* Start without any leftover lease */
+	openchangedb_cn_leases_return(g_oc_ctx);
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	base = exchange_globcnt(next_cn >> 16);
+
+	g_oc_ctx->cn_lease_size = 4;
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base) << 16) | 0x0001));
+
+	/* The batch drains the lease before asking the backend */
+	retval = openchangedb_get_new_changeNumbers(g_oc_ctx, g_mem_ctx, USER1, 5, &cns);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(5, cns->cValues);
+	for (i = 0; i < 5; i++) {
+		ck_assert(cns->lpui8[i] == ((exchange_globcnt(base + 1 + i) << 16) | 0x0001));
+	}
+
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base + 6) << 16) | 0x0001));
+
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 10) << 16) | 0x0001));
+
+	g_oc_ctx->cn_lease_size = 0;
+} END_TEST
+
+START_TEST (test_cn_lease_return) {
+	uint64_t base, cn = 0, next_cn = 0;
+
+	openchangedb_cn_leases_return(g_oc_ctx);
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	base = exchange_globcnt(next_cn >> 16);
+
+	g_oc_ctx->cn_lease_size = 4;
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base) << 16) | 0x0001));
+
+	/* Unused change numbers go back to the backend */
+	openchangedb_cn_leases_return(g_oc_ctx);
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 1) << 16) | 0x0001));
+
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base + 1) << 16) | 0x0001));
+
+	/* Someone else allocated after our lease: the remainder is lost */
+	retval = g_oc_ctx->get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base + 5) << 16) | 0x0001));
+
+	openchangedb_cn_leases_return(g_oc_ctx);
+	retval = g_oc_ctx->get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 6) << 16) | 0x0001));
+
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	ck_assert(cn == ((exchange_globcnt(base + 6) << 16) | 0x0001));
+
+	g_oc_ctx->cn_lease_size = 0;
+} END_TEST
+
 START_TEST (test_get_folder_property) {
 	void *data;
 	uint64_t fid;
@@ -453,6 +561,103 @@ START_TEST (test_get_public_folder_property) {
 	ck_assert_int_eq(130264095410000000 & 0xffffffff, ((struct FILETIME *)data)->dwLowDateTime);
 } END_TEST
 
+START_TEST (test_property_pack_round_trip) {
+	TALLOC_CTX		*mem_ctx;
+	DATA_BLOB		blob, longer;
+	struct Binary_r		*bin, *bin_after;
+	struct BinaryArray_r	bin_array, *bin_array_after;
+	struct LongArray_r	long_array, *long_array_after;
+	struct FILETIME		ft, *ft_after;
+	uint32_t		l = 63, longs[3] = { 1, 0xffffffff, 42 };
+	uint64_t		ll = 0x0123456789abcdeful;
+	int			b = 1;
+	uint8_t			bytes[3] = { 0x00, 0xff, 0x27 };
+	void			*data;
+
+	mem_ctx = talloc_new(g_mem_ctx);
+
+	// PT_LONG, PT_BOOLEAN and PT_I8
+	retval = openchangedb_property_pack(mem_ctx, PidTagAccess, &l, &blob);
+	CHECK_SUCCESS;
+	data = openchangedb_property_unpack(mem_ctx, PidTagAccess, &blob);
+	ck_assert(data != NULL);
+	ck_assert_int_eq(63, *(uint32_t *)data);
+	// The typed form belongs to a single property type
+	ck_assert(openchangedb_property_unpack(mem_ctx, PidTagChangeNumber, &blob) == NULL);
+
+	retval = openchangedb_property_pack(mem_ctx, PidTagAttributeReadOnly, &b, &blob);
+	CHECK_SUCCESS;
+	data = openchangedb_property_unpack(mem_ctx, PidTagAttributeReadOnly, &blob);
+	ck_assert(data != NULL);
+	ck_assert_int_eq(1, *(int *)data);
+
+	retval = openchangedb_property_pack(mem_ctx, PidTagChangeNumber, &ll, &blob);
+	CHECK_SUCCESS;
+	data = openchangedb_property_unpack(mem_ctx, PidTagChangeNumber, &blob);
+	ck_assert(data != NULL);
+	ck_assert(*(uint64_t *)data == ll);
+
+	// PT_SYSTIME
+	ft.dwLowDateTime = 130268260180000000 & 0xffffffff;
+	ft.dwHighDateTime = 130268260180000000 >> 32;
+	retval = openchangedb_property_pack(mem_ctx, PidTagLastModificationTime, &ft, &blob);
+	CHECK_SUCCESS;
+	ft_after = openchangedb_property_unpack(mem_ctx, PidTagLastModificationTime, &blob);
+	ck_assert(ft_after != NULL);
+	ck_assert_int_eq(ft.dwLowDateTime, ft_after->dwLowDateTime);
+	ck_assert_int_eq(ft.dwHighDateTime, ft_after->dwHighDateTime);
+
+	// PT_BINARY, taken from the database
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagIpmDraftsEntryId,
+						  17438782182108692481ul, (void **)&bin);
+	CHECK_SUCCESS;
+	retval = openchangedb_property_pack(mem_ctx, PidTagIpmDraftsEntryId, bin, &blob);
+	CHECK_SUCCESS;
+	bin_after = openchangedb_property_unpack(mem_ctx, PidTagIpmDraftsEntryId, &blob);
+	ck_assert(bin_after != NULL);
+	ck_assert_int_eq(bin->cb, bin_after->cb);
+	ck_assert(memcmp(bin->lpb, bin_after->lpb, bin->cb) == 0);
+
+	// Truncated or oversized blobs are rejected
+	longer.length = blob.length + 1;
+	longer.data = talloc_zero_array(mem_ctx, uint8_t, longer.length);
+	memcpy(longer.data, blob.data, blob.length);
+	ck_assert(openchangedb_property_unpack(mem_ctx, PidTagIpmDraftsEntryId, &longer) == NULL);
+	blob.length--;
+	ck_assert(openchangedb_property_unpack(mem_ctx, PidTagIpmDraftsEntryId, &blob) == NULL);
+
+	// PT_MV_BINARY with an empty value
+	bin_array.cValues = 2;
+	bin_array.lpbin = talloc_zero_array(mem_ctx, struct Binary_r, 2);
+	bin_array.lpbin[0].cb = sizeof(bytes);
+	bin_array.lpbin[0].lpb = bytes;
+	retval = openchangedb_property_pack(mem_ctx, PidTagAdditionalRenEntryIds, &bin_array, &blob);
+	CHECK_SUCCESS;
+	bin_array_after = openchangedb_property_unpack(mem_ctx, PidTagAdditionalRenEntryIds, &blob);
+	ck_assert(bin_array_after != NULL);
+	ck_assert_int_eq(2, bin_array_after->cValues);
+	ck_assert_int_eq(sizeof(bytes), bin_array_after->lpbin[0].cb);
+	ck_assert(memcmp(bytes, bin_array_after->lpbin[0].lpb, sizeof(bytes)) == 0);
+	ck_assert_int_eq(0, bin_array_after->lpbin[1].cb);
+
+	// PT_MV_LONG
+	long_array.cValues = 3;
+	long_array.lpl = longs;
+	retval = openchangedb_property_pack(mem_ctx, PidTagScheduleInfoMonthsBusy, &long_array, &blob);
+	CHECK_SUCCESS;
+	long_array_after = openchangedb_property_unpack(mem_ctx, PidTagScheduleInfoMonthsBusy, &blob);
+	ck_assert(long_array_after != NULL);
+	ck_assert_int_eq(3, long_array_after->cValues);
+	ck_assert(memcmp(longs, long_array_after->lpl, sizeof(longs)) == 0);
+
+	// Strings keep their text form
+	ck_assert(!openchangedb_property_is_packable(PidTagDisplayName));
+	retval = openchangedb_property_pack(mem_ctx, PidTagDisplayName, "A3", &blob);
+	ck_assert_int_eq(retval, MAPI_E_NO_SUPPORT);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
 START_TEST (test_set_folder_properties) {
 	uint64_t fid;
 	uint32_t proptag;
@@ -508,6 +713,68 @@ START_TEST (test_set_folder_properties) {
 	ck_assert_str_eq(display_name, "foo");
 } END_TEST
 
+START_TEST (test_folder_property_cache) {
+	struct openchangedb_cache_stats	stats;
+	struct SRow			*row;
+	uint64_t			fid;
+	uint32_t			*access, *access_cached;
+	char				*display_name, *display_name_cached;
+	char				*original_name;
+
+	retval = openchangedb_cache_init(g_oc_ctx, 64, 0);
+	CHECK_SUCCESS;
+
+	fid = 17871127746336260097ul;
+	retval = openchangedb_get_folder_property(g_mem_ctx, g_oc_ctx, USER1, PidTagDisplayName,
+						  fid, (void **)&display_name);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(g_mem_ctx, g_oc_ctx, USER1, PidTagDisplayName,
+						  fid, (void **)&display_name_cached);
+	CHECK_SUCCESS;
+	ck_assert_str_eq(display_name, display_name_cached);
+	ck_assert(display_name != display_name_cached);
+	original_name = display_name;
+
+	retval = openchangedb_get_folder_property(g_mem_ctx, g_oc_ctx, USER1, PidTagAccess,
+						  fid, (void **)&access);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(g_mem_ctx, g_oc_ctx, USER1, PidTagAccess,
+						  fid, (void **)&access_cached);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(*access, *access_cached);
+
+	retval = openchangedb_cache_get_stats(g_oc_ctx, &stats);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(stats.hits, 2);
+	ck_assert_int_eq(stats.misses, 2);
+
+	/* Writes through the frontend must not leave stale values behind */
+	row = talloc_zero(g_mem_ctx, struct SRow);
+	row->cValues = 1;
+	row->lpProps = talloc_zero(g_mem_ctx, struct SPropValue);
+	row->lpProps[0].ulPropTag = PidTagDisplayName;
+	row->lpProps[0].value.lpszW = talloc_strdup(g_mem_ctx, "cached folder");
+	retval = openchangedb_set_folder_properties(g_oc_ctx, USER1, fid, row);
+	CHECK_SUCCESS;
+
+	retval = openchangedb_get_folder_property(g_mem_ctx, g_oc_ctx, USER1, PidTagDisplayName,
+						  fid, (void **)&display_name);
+	CHECK_SUCCESS;
+	ck_assert_str_eq(display_name, "cached folder");
+
+	retval = openchangedb_cache_get_stats(g_oc_ctx, &stats);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(stats.invalidations, 1);
+	ck_assert_int_eq(stats.misses, 3);
+
+	row->lpProps[0].value.lpszW = original_name;
+	retval = openchangedb_set_folder_properties(g_oc_ctx, USER1, fid, row);
+	CHECK_SUCCESS;
+
+	retval = openchangedb_cache_init(g_oc_ctx, 0, 0);
+	CHECK_SUCCESS;
+} END_TEST
+
 START_TEST (test_set_folder_properties_on_mailbox) {
 	uint64_t fid;
 	uint32_t proptag;
@@ -1227,6 +1494,103 @@ START_TEST (test_build_table_folders_live_filtering) {
 	ck_assert_str_eq("Schedule", (char *)data);
 } END_TEST
 
+START_TEST (test_build_table_folders_with_columns) {
+	void *table, *columns_table, *data, *columns_data;
+	uint64_t fid;
+	uint32_t i, j;
+	struct mapi_SRestriction res;
+	enum MAPITAGS columns[] = { PidTagDisplayName, PidTagFolderId,
+				    PidTagContainerClass, PidTagAccess };
+	enum MAPISTATUS columns_retval;
+	int ok = 0;
+
+	fid = 17438782182108692481ul;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &columns_table);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_set_columns(g_oc_ctx, columns_table, 4, columns);
+	CHECK_SUCCESS;
+
+	/* Rows read through the column set match rows read one cell at
+	   a time */
+	for (i = 0; i < 13; i++) {
+		for (j = 0; j < 4; j++) {
+			retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+								 columns[j], i, false, &data);
+			columns_retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, columns_table,
+									 columns[j], i, false, &columns_data);
+			ck_assert_int_eq(retval, columns_retval);
+			if (retval != MAPI_E_SUCCESS) continue;
+
+			if ((columns[j] & 0xFFFF) == PT_UNICODE) {
+				ck_assert_str_eq((char *)data, (char *)columns_data);
+			} else if ((columns[j] & 0xFFFF) == PT_I8) {
+				ck_assert(*(uint64_t *)data == *(uint64_t *)columns_data);
+			} else {
+				ck_assert_int_eq(*(uint32_t *)data, *(uint32_t *)columns_data);
+			}
+		}
+	}
+	retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, columns_table,
+						 PidTagDisplayName, 13, false, &data);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_OBJECT);
+
+	/* Live filtering keeps working once columns are set */
+	res.rt = RES_PROPERTY;
+	res.res.resProperty.ulPropTag = PidTagDisplayName;
+	res.res.resProperty.lpProp.ulPropTag = PidTagDisplayName;
+	res.res.resProperty.lpProp.value.lpszW = "Schedule";
+	retval = openchangedb_table_set_restrictions(g_oc_ctx, columns_table, &res);
+	CHECK_SUCCESS;
+
+	for (i = 0; i < 13; i++) {
+		retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, columns_table,
+							 PidTagDisplayName, i, true, &data);
+		if (retval == MAPI_E_SUCCESS) {
+			ck_assert_str_eq("Schedule", (char *)data);
+			ok++;
+		}
+	}
+	ck_assert_int_eq(1, ok);
+} END_TEST
+
+START_TEST (test_build_table_folders_with_columns_after_write) {
+	void *table, *data;
+	uint64_t fid, row_fid;
+	enum MAPITAGS columns[] = { PidTagDisplayName, PidTagFolderId };
+	struct SRow *row;
+
+	fid = 17438782182108692481ul;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_set_columns(g_oc_ctx, table, 2, columns);
+	CHECK_SUCCESS;
+
+	retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+						 PidTagFolderId, 0, false, &data);
+	CHECK_SUCCESS;
+	row_fid = *(uint64_t *)data;
+	retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+						 PidTagDisplayName, 0, false, &data);
+	CHECK_SUCCESS;
+	ck_assert_str_ne((char *)data, "renamed");
+
+	row = talloc_zero(g_mem_ctx, struct SRow);
+	row->cValues = 1;
+	row->lpProps = talloc_zero(g_mem_ctx, struct SPropValue);
+	row->lpProps[0].ulPropTag = PidTagDisplayName;
+	row->lpProps[0].value.lpszW = talloc_strdup(g_mem_ctx, "renamed");
+	retval = openchangedb_set_folder_properties(g_oc_ctx, USER1, row_fid, row);
+	CHECK_SUCCESS;
+
+	/* Rows read after the write see the new value */
+	retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+						 PidTagDisplayName, 0, false, &data);
+	CHECK_SUCCESS;
+	ck_assert_str_eq((char *)data, "renamed");
+} END_TEST
+
 START_TEST (test_set_locale) {
 	ck_assert(openchangedb_set_locale(g_oc_ctx, USER1, 0x1001));
 	ck_assert(!openchangedb_set_locale(g_oc_ctx, USER1, 0x1001));
@@ -1283,6 +1647,203 @@ START_TEST (test_get_indexing_url) {
 	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
 } END_TEST
 
+START_TEST (test_prepared_getters) {
+	TALLOC_CTX		*mem_ctx;
+	MYSQL			*conn = g_oc_ctx->data;
+	uint64_t		prepared, prepared_after, executed, executed_after;
+	uint64_t		folder_id, text_folder_id, fid;
+	char			*uri, *sql;
+	const char		*text_uri;
+	void			*data;
+
+	mem_ctx = talloc_new(g_mem_ctx);
+
+	/* Warm up the statement cache */
+	retval = openchangedb_get_SystemFolderID(g_oc_ctx, USER1, 2, &folder_id);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_mapistoreURI(mem_ctx, g_oc_ctx, USER1, 145241087982698497ul, &uri, true);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess,
+						  17871127746336260097ul, &data);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_fid_by_name(g_oc_ctx, USER1, 18231415716525899777ul, "A2", &fid);
+	CHECK_SUCCESS;
+	stmt_cache_stats(&prepared, &executed);
+
+	retval = openchangedb_get_SystemFolderID(g_oc_ctx, USER1, 2, &folder_id);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_mapistoreURI(mem_ctx, g_oc_ctx, USER1, 145241087982698497ul, &uri, true);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess,
+						  17871127746336260097ul, &data);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_fid_by_name(g_oc_ctx, USER1, 18231415716525899777ul, "A2", &fid);
+	CHECK_SUCCESS;
+
+	/* Every statement was prepared once and only executed afterwards */
+	stmt_cache_stats(&prepared_after, &executed_after);
+	ck_assert(prepared_after == prepared);
+	ck_assert(executed_after - executed >= 4);
+
+	/* Same results as the text protocol */
+	sql = talloc_asprintf(mem_ctx,
+		"SELECT f.folder_id FROM folders f "
+		"JOIN mailboxes m ON f.mailbox_id = m.id "
+		"  AND m.name = '%s' "
+		"WHERE f.SystemIdx = %d"
+		"  AND f.folder_class = 'system' "
+		"ORDER BY parent_folder_id", USER1, 2);
+	ck_assert_int_eq(select_first_uint(conn, sql, &text_folder_id), MYSQL_SUCCESS);
+	ck_assert(folder_id == text_folder_id);
+	sql = talloc_asprintf(mem_ctx,
+		"SELECT MAPIStoreURI FROM folders f "
+		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = '%s' "
+		"WHERE f.folder_id = %"PRIu64, USER1, 145241087982698497ul);
+	ck_assert_int_eq(select_first_string(mem_ctx, conn, sql, &text_uri), MYSQL_SUCCESS);
+	ck_assert_str_eq(uri, text_uri);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_typed_folder_property) {
+	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn = g_oc_ctx->data;
+	uint64_t	fid = 17871127746336260097ul, count;
+	const char	*typed_value;
+	char		*sql;
+	void		*data;
+
+	mem_ctx = talloc_new(g_mem_ctx);
+
+	// First read stores the typed form, next ones use it
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(63, *(uint32_t *)data);
+	sql = talloc_asprintf(mem_ctx,
+		"SELECT t.value FROM folders_properties_typed t "
+		"JOIN folders f ON f.id = t.folder_id AND f.folder_id = %"PRIu64" "
+		"WHERE t.name = 'PidTagAccess'", fid);
+	ck_assert_int_eq(select_first_string(mem_ctx, conn, sql, &typed_value), MYSQL_SUCCESS);
+	ck_assert_str_eq(typed_value, "63");
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(63, *(uint32_t *)data);
+
+	// A text value changed behind our back makes the typed one stale
+	ck_assert_int_eq(execute_query(conn, talloc_asprintf(mem_ctx,
+		"UPDATE folders_properties fp "
+		"JOIN folders f ON f.id = fp.folder_id AND f.folder_id = %"PRIu64" "
+		"SET fp.value = '62' WHERE fp.name = 'PidTagAccess'", fid)), MYSQL_SUCCESS);
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(62, *(uint32_t *)data);
+	ck_assert_int_eq(select_first_string(mem_ctx, conn, sql, &typed_value), MYSQL_SUCCESS);
+	ck_assert_str_eq(typed_value, "62");
+
+	ck_assert_int_eq(execute_query(conn, talloc_asprintf(mem_ctx,
+		"UPDATE folders_properties fp "
+		"JOIN folders f ON f.id = fp.folder_id AND f.folder_id = %"PRIu64" "
+		"SET fp.value = '63' WHERE fp.name = 'PidTagAccess'", fid)), MYSQL_SUCCESS);
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(63, *(uint32_t *)data);
+
+	// Strings are not duplicated
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagDisplayName, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(select_first_uint(conn,
+		"SELECT COUNT(*) FROM folders_properties_typed "
+		"WHERE name = 'PidTagDisplayName'", &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 0);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_typed_backfill_failure) {
+	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn = g_oc_ctx->data;
+	uint64_t	fid = 17871127746336260097ul, count;
+	void		*data;
+
+	mem_ctx = talloc_new(g_mem_ctx);
+
+	ck_assert_int_eq(execute_query(conn, "DELETE FROM folders_properties_typed"), MYSQL_SUCCESS);
+	ck_assert_int_eq(execute_query(conn,
+		"CREATE TRIGGER oc_test_typed_readonly BEFORE INSERT ON folders_properties_typed "
+		"FOR EACH ROW SIGNAL SQLSTATE '45000'"), MYSQL_SUCCESS);
+
+	// The failed write does not fail the read
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(63, *(uint32_t *)data);
+
+	ck_assert_int_eq(select_first_uint(conn,
+		"SELECT COUNT(*) FROM folders_properties_typed", &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 0);
+
+	// An error other than a missing table or column keeps storing
+	// typed values on later reads
+	ck_assert_int_eq(execute_query(conn, "DROP TRIGGER oc_test_typed_readonly"), MYSQL_SUCCESS);
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagAccess, fid, &data);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(63, *(uint32_t *)data);
+	ck_assert_int_eq(select_first_uint(conn,
+		"SELECT COUNT(*) FROM folders_properties_typed", &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 1);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_typed_properties_match_text) {
+	TALLOC_CTX		*mem_ctx;
+	MYSQL			*conn = g_oc_ctx->data;
+	uint64_t		mailbox_fid = 17438782182108692481ul;
+	struct Binary_r		*bin, *text_bin;
+	struct FILETIME		*ft, *text_ft;
+	uint64_t		count;
+
+	mem_ctx = talloc_new(g_mem_ctx);
+
+	/* Text form only: the LEFT JOIN finds no typed value */
+	ck_assert_int_eq(execute_query(conn, "DELETE FROM mailboxes_properties_typed"), MYSQL_SUCCESS);
+	openchangedb_mysql_set_typed_backfill(false);
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagIpmDraftsEntryId,
+						  mailbox_fid, (void **)&text_bin);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagLastModificationTime,
+						  mailbox_fid, (void **)&text_ft);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(select_first_uint(conn,
+		"SELECT COUNT(*) FROM mailboxes_properties_typed", &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 0);
+
+	/* The first reads store the typed form, the next ones unpack it */
+	openchangedb_mysql_set_typed_backfill(true);
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagIpmDraftsEntryId,
+						  mailbox_fid, (void **)&bin);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagLastModificationTime,
+						  mailbox_fid, (void **)&ft);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(select_first_uint(conn,
+		"SELECT COUNT(*) FROM mailboxes_properties_typed", &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 2);
+
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagIpmDraftsEntryId,
+						  mailbox_fid, (void **)&bin);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_folder_property(mem_ctx, g_oc_ctx, USER1, PidTagLastModificationTime,
+						  mailbox_fid, (void **)&ft);
+	CHECK_SUCCESS;
+
+	ck_assert_int_eq(bin->cb, text_bin->cb);
+	ck_assert(memcmp(bin->lpb, text_bin->lpb, bin->cb) == 0);
+	ck_assert(ft->dwHighDateTime == text_ft->dwHighDateTime);
+	ck_assert(ft->dwLowDateTime == text_ft->dwLowDateTime);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
 START_TEST (test_replica_mapping_sanity_checks) {
 	struct GUID		client_guid = GUID_random();
 	enum MAPISTATUS		ret;
@@ -1453,9 +2014,14 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 	tcase_add_test(tc, test_get_new_changeNumber);
 	tcase_add_test(tc, test_get_new_changeNumbers);
 	tcase_add_test(tc, test_get_next_changeNumber);
+	tcase_add_test(tc, test_get_new_changeNumber_lease);
+	tcase_add_test(tc, test_get_new_changeNumbers_lease);
+	tcase_add_test(tc, test_cn_lease_return);
 	tcase_add_test(tc, test_get_folder_property);
 	tcase_add_test(tc, test_get_public_folder_property);
+	tcase_add_test(tc, test_property_pack_round_trip);
 	tcase_add_test(tc, test_set_folder_properties);
+	tcase_add_test(tc, test_folder_property_cache);
 	tcase_add_test(tc, test_set_folder_properties_on_mailbox);
 	tcase_add_test(tc, test_set_public_folder_properties);
 	tcase_add_test(tc, test_get_fid_by_name);
@@ -1486,6 +2052,8 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 	tcase_add_test(tc, test_build_table_folders);
 	tcase_add_test(tc, test_build_table_folders_with_restrictions);
 	tcase_add_test(tc, test_build_table_folders_live_filtering);
+	tcase_add_test(tc, test_build_table_folders_with_columns);
+	tcase_add_test(tc, test_build_table_folders_with_columns_after_write);
 	tcase_add_test(tc, test_get_Transport_folder_when_has_unusual_display_name);
 
 	if (strcmp(backend_name, "MySQL") == 0) {
@@ -1493,6 +2061,10 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 		tcase_add_test(tc, test_set_locale);
 		tcase_add_test(tc, test_get_folders_names);
 		tcase_add_test(tc, test_get_indexing_url);
+		tcase_add_test(tc, test_prepared_getters);
+		tcase_add_test(tc, test_typed_folder_property);
+		tcase_add_test(tc, test_typed_backfill_failure);
+		tcase_add_test(tc, test_typed_properties_match_text);
 	}
 
 	/* Replica mapping tests */
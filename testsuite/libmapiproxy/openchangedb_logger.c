@@ -89,6 +89,79 @@ START_TEST (test_call_get_SystemFolderID) {
 } END_TEST
 
 
+START_TEST (test_cache_read_through) {
+	struct openchangedb_cache_stats	stats;
+	uint64_t			folder_id;
+	uint64_t			parent_fid;
+	char				*mapistoreURL;
+	int				i;
+
+	CHECK_SUCCESS(openchangedb_cache_init(oc_ctx, 16, 0));
+
+	for (i = 0; i < 3; i++) {
+		CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 1234, &folder_id));
+		ck_assert_int_eq(folder_id, FOLDER_ID_EXPECTED);
+		CHECK_SUCCESS(openchangedb_get_parent_fid(oc_ctx, "mail_user", FOLDER_ID_EXPECTED, &parent_fid, true));
+		ck_assert_int_eq(parent_fid, PARENT_FOLDER_ID);
+		CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &mapistoreURL, true));
+		ck_assert_str_eq(mapistoreURL, MOCKED_URL);
+		/* Hits hand out a private copy */
+		ck_assert(i == 0 || mapistoreURL != (char *)MOCKED_URL);
+	}
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 1);
+	ck_assert_int_eq(functions_called.get_parent_fid, 1);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 1);
+
+	/* Keys are per mailbox and per mailboxstore flag */
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "other", 1234, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 2);
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &mapistoreURL, false));
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 2);
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.hits, 6);
+	ck_assert_int_eq(stats.misses, 5);
+	ck_assert_int_eq(stats.entries, 5);
+
+	/* Any write drops the cache */
+	CHECK_SUCCESS(openchangedb_set_mapistoreURI(oc_ctx, "usera", FOLDER_ID_EXPECTED, "mapistoreURL"));
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &mapistoreURL, true));
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 3);
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.invalidations, 1);
+	ck_assert_int_eq(stats.entries, 1);
+} END_TEST
+
+START_TEST (test_cache_eviction) {
+	struct openchangedb_cache_stats	stats;
+	uint64_t			folder_id;
+
+	CHECK_SUCCESS(openchangedb_cache_init(oc_ctx, 2, 0));
+
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 1, &folder_id));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 2, &folder_id));
+	/* Promote 1 so 2 is the least recently used record */
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 1, &folder_id));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 3, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 3);
+
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 1, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 3);
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 2, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 4);
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.evictions, 2);
+	ck_assert_int_eq(stats.entries, 2);
+
+	/* A size of 0 disables the cache */
+	CHECK_SUCCESS(openchangedb_cache_init(oc_ctx, 0, 0));
+	CHECK_FAILURE(openchangedb_cache_get_stats(oc_ctx, &stats));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 1, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 5);
+} END_TEST
+
 START_TEST (test_call_get_PublicFolderID) {
 	uint64_t folder_id;
 
@@ -404,6 +477,13 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return MAPI_E_NOT_IMPLEMENTED;
 }
 
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	return MAPI_E_NOT_IMPLEMENTED;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
@@ -661,6 +741,7 @@ static enum MAPISTATUS mock_backend_init(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -774,6 +855,8 @@ static Suite *openchangedb_create_suite(SFun setup, SFun teardown)
 	tcase_add_test(tc, test_call_get_ReceiveFolder);
 	tcase_add_test(tc, test_call_replica_mapping_guid_to_replid);
 	tcase_add_test(tc, test_call_replica_mapping_replid_to_guid);
+	tcase_add_test(tc, test_cache_read_through);
+	tcase_add_test(tc, test_cache_eviction);
 
 	suite_add_tcase(s, tc);
 	return s;
@@ -43,6 +43,11 @@
 /* Existing FMID/URL to be populated on setup */
 #define INDEXING_EXIST_FMID	0xEEEE
 #define INDEXING_EXIST_URL	"idxtest://existing_url"
+/* TDB URI index */
+#define INDEXING_LEGACY_USER	"legacyuser"
+#define INDEXING_PREFIX_USER	"prefixuser"
+#define INDEXING_PREFIX_FOLDERS	10
+#define INDEXING_PREFIX_MESSAGES	100
 
 /* Global test variables */
 static struct mapistore_context	*g_mstore_ctx = NULL;
@@ -155,6 +160,132 @@ START_TEST(test_mysql_search_existing_fmid_invalid_input) {
 	/* test with good input is going to be tested through interface tests */
 } END_TEST
 
+/* FMID leases */
+
+static uint64_t _mysql_next_fmid(MYSQL *conn, const char *username)
+{
+	char		*sql;
+	uint64_t	next_fmid = 0;
+
+	sql = talloc_asprintf(g_mstore_ctx, "SELECT next_fmid FROM %s WHERE username = '%s'",
+			      INDEXING_ALLOC_TABLE, username);
+	ck_assert(sql != NULL);
+	ck_assert_int_eq(select_first_uint(conn, sql, &next_fmid), MYSQL_SUCCESS);
+	talloc_free(sql);
+
+	return next_fmid;
+}
+
+START_TEST(test_mysql_fmid_lease) {
+	enum mapistore_error	retval;
+	uint64_t		size;
+	uint64_t		fmid1, fmid2, first;
+
+	ck_assert(g_ictx->lease != NULL);
+	size = g_ictx->lease->size;
+
+	/* The first allocation leases a whole range */
+	retval = g_ictx->allocate_fmid(g_ictx, g_test_username, &fmid1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + size);
+
+	/* Following ones are served from it */
+	retval = g_ictx->allocate_fmid(g_ictx, g_test_username, &fmid2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid2 == fmid1 + 1);
+	retval = g_ictx->allocate_fmids(g_ictx, g_test_username, 2, &first);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(first == fmid1 + 2);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + size);
+
+	/* Ranges larger than a lease go straight to the database */
+	retval = g_ictx->allocate_fmids(g_ictx, g_test_username, size, &first);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(first == fmid1 + size);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + 2 * size);
+
+	/* Exhausting the lease reserves a new one */
+	retval = g_ictx->allocate_fmids(g_ictx, g_test_username, size - 4, &first);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(first == fmid1 + 4);
+	retval = g_ictx->allocate_fmid(g_ictx, g_test_username, &fmid2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid2 == fmid1 + 2 * size);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + 3 * size);
+} END_TEST
+
+START_TEST(test_mysql_fmid_lease_return) {
+	enum mapistore_error	retval;
+	struct indexing_context	*ictx2;
+	char			*conn_string;
+	uint64_t		fmid1, fmid2, next_fmid;
+
+	retval = g_ictx->allocate_fmid(g_ictx, g_test_username, &fmid1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* Nobody reserved anything since, the lease goes back */
+	mysql_return_fmid_lease(g_ictx);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + 1);
+
+	retval = g_ictx->allocate_fmid(g_ictx, g_test_username, &fmid2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid2 == fmid1 + 1);
+
+	/* Another process leasing after us keeps the counter */
+	conn_string = _make_connection_string(g_mstore_ctx,
+					      INDEXING_MYSQL_USER, INDEXING_MYSQL_PASS,
+					      INDEXING_MYSQL_HOST, INDEXING_MYSQL_DB);
+	ck_assert(conn_string != NULL);
+	retval = mapistore_indexing_mysql_init(g_mstore_ctx, g_test_username, conn_string, &ictx2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = ictx2->allocate_fmid(ictx2, g_test_username, &fmid1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid1 > fmid2);
+	next_fmid = _mysql_next_fmid(g_ictx->data, g_test_username);
+
+	mysql_return_fmid_lease(g_ictx);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == next_fmid);
+
+	/* ictx2 returns its lease when released */
+	talloc_free(ictx2);
+	ck_assert(_mysql_next_fmid(g_ictx->data, g_test_username) == fmid1 + 1);
+	talloc_free(conn_string);
+} END_TEST
+
+START_TEST(test_mysql_fmid_lease_concurrent) {
+	enum mapistore_error	retval;
+	struct indexing_context	*ictx2;
+	struct indexing_context	*ictx;
+	char			*conn_string;
+	uint64_t		fmids[256];
+	int			i, j;
+
+	conn_string = _make_connection_string(g_mstore_ctx,
+					      INDEXING_MYSQL_USER, INDEXING_MYSQL_PASS,
+					      INDEXING_MYSQL_HOST, INDEXING_MYSQL_DB);
+	ck_assert(conn_string != NULL);
+	retval = mapistore_indexing_mysql_init(g_mstore_ctx, g_test_username, conn_string, &ictx2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	for (i = 0; i < 256; i++) {
+		ictx = (i % 3) ? g_ictx : ictx2;
+		retval = ictx->allocate_fmids(ictx, g_test_username, 1 + (i % 5), &fmids[i]);
+		ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	}
+
+	/* Ranges handed out by both contexts never overlap */
+	for (i = 0; i < 256; i++) {
+		for (j = i + 1; j < 256; j++) {
+			ck_assert(fmids[i] + 1 + (i % 5) <= fmids[j] ||
+				  fmids[j] + 1 + (j % 5) <= fmids[i]);
+		}
+	}
+
+	talloc_free(ictx2);
+	talloc_free(conn_string);
+} END_TEST
+
 
 /* add_fmid */
 
@@ -472,6 +603,324 @@ START_TEST (test_allocate_fmid) {
 	ck_assert(fmid1 != fmid2);
 } END_TEST
 
+/* URI <-> FMID cache */
+
+START_TEST (test_get_uri_cached) {
+	enum mapistore_error	retval;
+	char			*uri = NULL;
+	bool			soft_deleted = true;
+	uint64_t		fmid = 0;
+	uint64_t		hits;
+
+	ck_assert(g_ictx->lru != NULL);
+
+	retval = g_ictx->add_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	hits = g_ictx->lru->hits;
+	retval = g_ictx->get_uri(g_ictx, g_test_username, g_ictx, INDEXING_TEST_FMID, &uri, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(uri, INDEXING_TEST_URI);
+	ck_assert(!soft_deleted);
+	ck_assert(g_ictx->lru->hits == hits + 1);
+
+	retval = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == INDEXING_TEST_FMID);
+	ck_assert(g_ictx->lru->hits == hits + 2);
+
+	/* Updates are visible through the cache */
+	retval = g_ictx->update_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI_2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = g_ictx->get_uri(g_ictx, g_test_username, g_ictx, INDEXING_TEST_FMID, &uri, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(uri, INDEXING_TEST_URI_2);
+	retval = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI_2, false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == INDEXING_TEST_FMID);
+
+	/* Soft deleted records are not served from the cache */
+	retval = g_ictx->del_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, MAPISTORE_SOFT_DELETE);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = g_ictx->get_uri(g_ictx, g_test_username, g_ictx, INDEXING_TEST_FMID, &uri, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(soft_deleted);
+} END_TEST
+
+START_TEST (test_cache_lru_eviction) {
+	TALLOC_CTX		*mem_ctx;
+	struct indexing_cache	*cache;
+	enum mapistore_error	retval;
+	char			*uri;
+	uint64_t		fmid;
+	uint64_t		i;
+
+	mem_ctx = talloc_new(NULL);
+	mapistore_set_default_indexing_cache_size(4);
+	cache = mapistore_indexing_cache_init(mem_ctx);
+	mapistore_set_default_indexing_cache_size(MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE);
+	ck_assert(cache != NULL);
+
+	for (i = 1; i <= 4; i++) {
+		uri = talloc_asprintf(mem_ctx, "idxtest://lru/%"PRIu64, i);
+		mapistore_indexing_cache_add(cache, i, uri);
+	}
+	ck_assert_int_eq(cache->count, 4);
+
+	/* Touch the oldest record so the second one gets evicted */
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://lru/1", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 1);
+
+	mapistore_indexing_cache_add(cache, 5, "idxtest://lru/5");
+	ck_assert_int_eq(cache->count, 4);
+	ck_assert(cache->evictions == 1);
+
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 2, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://lru/2", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(uri, "idxtest://lru/1");
+
+	/* Reusing a URI for another FMID replaces the previous record */
+	mapistore_indexing_cache_add(cache, 6, "idxtest://lru/1");
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://lru/1", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 6);
+
+	mapistore_indexing_cache_del(cache, 6);
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://lru/1", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(cache->count, 3);
+	ck_assert(cache->hits == 3);
+	ck_assert(cache->misses == 4);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_cache_disabled) {
+	TALLOC_CTX		*mem_ctx;
+	struct indexing_cache	*cache;
+	char			*uri;
+	uint64_t		fmid;
+
+	mem_ctx = talloc_new(NULL);
+	mapistore_set_default_indexing_cache_size(0);
+	cache = mapistore_indexing_cache_init(mem_ctx);
+	mapistore_set_default_indexing_cache_size(MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE);
+	ck_assert(cache == NULL);
+
+	/* A disabled cache always misses */
+	mapistore_indexing_cache_add(cache, 1, "idxtest://lru/1");
+	ck_assert_int_eq(mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri), MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(mapistore_indexing_cache_get_fmid(cache, "idxtest://lru/1", &fmid), MAPISTORE_ERR_NOT_FOUND);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_cache_ttl) {
+	TALLOC_CTX		*mem_ctx;
+	struct indexing_cache	*cache;
+	enum mapistore_error	retval;
+	char			*uri;
+	uint64_t		fmid;
+
+	mem_ctx = talloc_new(NULL);
+	cache = mapistore_indexing_cache_init(mem_ctx);
+	ck_assert(cache != NULL);
+	ck_assert_int_eq(cache->ttl, MAPISTORE_INDEXING_CACHE_DEFAULT_TTL);
+
+	mapistore_indexing_cache_add(cache, 1, "idxtest://ttl/1");
+	mapistore_indexing_cache_add(cache, 2, "idxtest://ttl/2");
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* Expired records are dropped on lookup in either direction */
+	cache->entries->expires = time(NULL) - 1;
+	cache->entries->next->expires = time(NULL) - 1;
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://ttl/2", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(cache->count, 0);
+
+	/* Adding the record again starts a new period */
+	mapistore_indexing_cache_add(cache, 1, "idxtest://ttl/1");
+	retval = mapistore_indexing_cache_get_fmid(cache, "idxtest://ttl/1", &fmid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 1);
+	talloc_free(mem_ctx);
+
+	/* A TTL of 0 never expires records */
+	mem_ctx = talloc_new(NULL);
+	mapistore_set_default_indexing_cache_ttl(0);
+	cache = mapistore_indexing_cache_init(mem_ctx);
+	mapistore_set_default_indexing_cache_ttl(MAPISTORE_INDEXING_CACHE_DEFAULT_TTL);
+	ck_assert(cache != NULL);
+
+	mapistore_indexing_cache_add(cache, 1, "idxtest://ttl/1");
+	cache->entries->expires = time(NULL) - 1;
+	retval = mapistore_indexing_cache_get_uri(cache, mem_ctx, 1, &uri);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(uri, "idxtest://ttl/1");
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+/* TDB URI index */
+
+static char *_tdb_indexing_path(TALLOC_CTX *mem_ctx, const char *username)
+{
+	return talloc_asprintf(mem_ctx, "%s%s/indexing.tdb", mapistore_get_mapping_path(), username);
+}
+
+START_TEST (test_tdb_uri_index_upgrade) {
+	TALLOC_CTX		*mem_ctx;
+	struct indexing_context	*ictx;
+	struct tdb_context	*tdb;
+	enum mapistore_error	retval;
+	TDB_DATA		key, dbuf;
+	char			*path;
+	uint64_t		fmid;
+	bool			soft_deleted;
+	int			i;
+	const char		*records[][2] = {
+		{ "0x0000000000000101", "legacy://user/inbox/" },
+		{ "0x0000000000000102", "legacy://user/inbox/1.eml" },
+		{ "0x0000000000000103", "legacy://user/inbox/2.eml" },
+		{ "SOFT_DELETED:0x0000000000000104", "legacy://user/inbox/3.eml" },
+		{ "GlobalCount", "0x0000000000000105" },
+	};
+
+	mem_ctx = talloc_new(NULL);
+	mkdir(talloc_asprintf(mem_ctx, "%s%s", mapistore_get_mapping_path(), INDEXING_LEGACY_USER), 0700);
+	path = _tdb_indexing_path(mem_ctx, INDEXING_LEGACY_USER);
+	unlink(path);
+
+	/* Create an indexing database the way previous versions did */
+	tdb = tdb_open(path, 0, 0, O_RDWR|O_CREAT, 0600);
+	ck_assert(tdb != NULL);
+	for (i = 0; i < sizeof(records) / sizeof(records[0]); i++) {
+		key.dptr = (unsigned char *) records[i][0];
+		key.dsize = strlen(records[i][0]);
+		dbuf.dptr = (unsigned char *) records[i][1];
+		dbuf.dsize = strlen(records[i][1]);
+		ck_assert_int_eq(tdb_store(tdb, key, dbuf, TDB_INSERT), 0);
+	}
+	tdb_close(tdb);
+
+	retval = mapistore_indexing_tdb_init(g_mstore_ctx, INDEXING_LEGACY_USER, &ictx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+	ck_assert(tdb_exists(((struct tdb_wrap *)ictx->data)->tdb, key));
+
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox", false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 0x101);
+	ck_assert(!soft_deleted);
+
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox/2.eml", false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 0x103);
+
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox/3.eml", false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 0x104);
+	ck_assert(soft_deleted);
+
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox/1*", true, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 0x102);
+
+	/* The index follows updates and deletions */
+	retval = ictx->update_fmid(ictx, INDEXING_LEGACY_USER, 0x102, "legacy://user/archive/1.eml");
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox/1*", true, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/archive/*", true, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 0x102);
+
+	retval = ictx->del_fmid(ictx, INDEXING_LEGACY_USER, 0x103, MAPISTORE_PERMANENT_DELETE);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "legacy://user/inbox/2.eml", false, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = ictx->get_fmid(ictx, INDEXING_LEGACY_USER, "*2.eml", true, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	unlink(path);
+	talloc_free(ictx);
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_tdb_uri_index_prefix) {
+	TALLOC_CTX		*mem_ctx;
+	struct indexing_context	*ictx;
+	struct tdb_context	*tdb;
+	enum mapistore_error	retval;
+	char			*uri;
+	uint64_t		fmid;
+	bool			soft_deleted;
+	int			i, j;
+
+	mem_ctx = talloc_new(NULL);
+	unlink(_tdb_indexing_path(mem_ctx, INDEXING_PREFIX_USER));
+
+	/* Query the database, not the per-process cache */
+	mapistore_set_default_indexing_cache_size(0);
+	retval = mapistore_indexing_tdb_init(g_mstore_ctx, INDEXING_PREFIX_USER, &ictx);
+	mapistore_set_default_indexing_cache_size(MAPISTORE_INDEXING_CACHE_DEFAULT_SIZE);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(ictx->lru == NULL);
+	tdb = ((struct tdb_wrap *)ictx->data)->tdb;
+
+	ck_assert_int_eq(tdb_transaction_start(tdb), 0);
+	for (i = 0; i < INDEXING_PREFIX_FOLDERS; i++) {
+		for (j = 0; j < INDEXING_PREFIX_MESSAGES; j++) {
+			uri = talloc_asprintf(mem_ctx, "prefix://user/folder%d/msg%d.eml", i, j);
+			retval = ictx->add_fmid(ictx, INDEXING_PREFIX_USER,
+						1 + i * INDEXING_PREFIX_MESSAGES + j, uri);
+			ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+			talloc_free(uri);
+		}
+	}
+	ck_assert_int_eq(tdb_transaction_commit(tdb), 0);
+
+	for (i = 0; i < INDEXING_PREFIX_FOLDERS; i++) {
+		for (j = 0; j < INDEXING_PREFIX_MESSAGES; j++) {
+			uri = talloc_asprintf(mem_ctx, "prefix://user/folder%d/msg%d.eml", i, j);
+			retval = ictx->get_fmid(ictx, INDEXING_PREFIX_USER, uri, false, &fmid, &soft_deleted);
+			ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+			ck_assert(fmid == 1 + i * INDEXING_PREFIX_MESSAGES + j);
+			talloc_free(uri);
+		}
+	}
+
+	/* Wildcard lookups answered by the prefix index */
+	for (i = 0; i < INDEXING_PREFIX_FOLDERS; i++) {
+		uri = talloc_asprintf(mem_ctx, "prefix://user/folder%d/msg42*", i);
+		retval = ictx->get_fmid(ictx, INDEXING_PREFIX_USER, uri, true, &fmid, &soft_deleted);
+		ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+		ck_assert(fmid == 1 + i * INDEXING_PREFIX_MESSAGES + 42);
+		talloc_free(uri);
+	}
+
+	/* A leading wildcard falls back to a full scan */
+	retval = ictx->get_fmid(ictx, INDEXING_PREFIX_USER, "*folder9/msg99.eml", true, &fmid, &soft_deleted);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fmid == 1 + 9 * INDEXING_PREFIX_MESSAGES + 99);
+
+	unlink(_tdb_indexing_path(mem_ctx, INDEXING_PREFIX_USER));
+	talloc_free(ictx);
+	talloc_free(mem_ctx);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -502,8 +951,11 @@ static void mysql_setup(void)
 
 static void mysql_teardown(void)
 {
-	drop_mysql_database(g_ictx->data, INDEXING_MYSQL_DB);
+	MYSQL *conn = g_ictx->data;
+
+	/* Release contexts first, they give their FMID lease back */
 	talloc_free(g_mstore_ctx);
+	drop_mysql_database(conn, INDEXING_MYSQL_DB);
 }
 
 static void tdb_setup(void)
@@ -565,6 +1017,7 @@ static TCase *create_test_case_indexing_interface(const char *name, SFun setup,
 	tcase_add_test(tc_interface, test_get_fmid);
 	tcase_add_test(tc_interface, test_get_fmid_with_wildcard);
 	tcase_add_test(tc_interface, test_allocate_fmid);
+	tcase_add_test(tc_interface, test_get_uri_cached);
 
 	return tc_interface;
 }
@@ -587,6 +1040,9 @@ Suite *mapistore_indexing_mysql_suite(void)
 	tc_internal = tcase_create("indexing: MySQL backend internal");
 	tcase_add_checked_fixture(tc_internal, mysql_setup, mysql_teardown);
 	tcase_add_test(tc_internal, test_mysql_search_existing_fmid_invalid_input);
+	tcase_add_test(tc_internal, test_mysql_fmid_lease);
+	tcase_add_test(tc_internal, test_mysql_fmid_lease_return);
+	tcase_add_test(tc_internal, test_mysql_fmid_lease_concurrent);
 	suite_add_tcase(s, tc_internal);
 
 	tc_interface = create_test_case_indexing_interface("MySQL", mysql_setup, mysql_teardown);
@@ -599,11 +1055,25 @@ Suite *mapistore_indexing_tdb_suite(void)
 {
 	Suite *s;
 	TCase *tc_interface;
+	TCase *tc_uri_index;
+	TCase *tc_cache;
 
 	s = suite_create("libmapistore indexing: TDB backend");
 
 	tc_interface = create_test_case_indexing_interface("TDB", tdb_setup, tdb_teardown);
 	suite_add_tcase(s, tc_interface);
 
+	tc_uri_index = tcase_create("indexing: TDB URI index");
+	tcase_add_checked_fixture(tc_uri_index, tdb_setup, tdb_teardown);
+	tcase_add_test(tc_uri_index, test_tdb_uri_index_upgrade);
+	tcase_add_test(tc_uri_index, test_tdb_uri_index_prefix);
+	suite_add_tcase(s, tc_uri_index);
+
+	tc_cache = tcase_create("indexing: URI/FMID cache");
+	tcase_add_test(tc_cache, test_cache_lru_eviction);
+	tcase_add_test(tc_cache, test_cache_disabled);
+	tcase_add_test(tc_cache, test_cache_ttl);
+	suite_add_tcase(s, tc_cache);
+
 	return s;
 }
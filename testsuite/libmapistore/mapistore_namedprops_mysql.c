@@ -332,6 +332,43 @@ START_TEST (test_create_id_MNID_STRING) {
 	talloc_free(local_mem_ctx);
 } END_TEST
 
+START_TEST (test_generation) {
+	TALLOC_CTX			*local_mem_ctx = talloc_new(NULL);
+	struct namedprops_mapping	*mappings = NULL;
+	struct MAPINAMEID		nameid = {0};
+	uint64_t			generation = 0;
+	uint64_t			next_generation = 0;
+	uint32_t			count = 0;
+	uint32_t			i;
+	bool				found = false;
+
+	ck_assert_int_eq(get_generation(g_nprops, &generation), MAPISTORE_SUCCESS);
+
+	/* Each created mapping moves the generation */
+	nameid.ulKind = MNID_ID;
+	nameid.kind.lid = 43;
+	ck_assert_int_eq(create_id(g_nprops, nameid, 43), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(get_generation(g_nprops, &next_generation), MAPISTORE_SUCCESS);
+	ck_assert(next_generation == generation + 1);
+
+	/* Listed mappings include the created and the default ones */
+	ck_assert_int_eq(list_mappings(g_nprops, local_mem_ctx, &mappings, &count), MAPISTORE_SUCCESS);
+	ck_assert(count > 0);
+	for (i = 0; i < count; i++) {
+		if (mappings[i].mapped_id == 37975) {
+			ck_assert_int_eq(mappings[i].prop_type, PT_UNICODE);
+		}
+		if (mappings[i].nameid->ulKind == MNID_ID &&
+		    mappings[i].nameid->kind.lid == 43) {
+			ck_assert_int_eq(mappings[i].mapped_id, 43);
+			found = true;
+		}
+	}
+	ck_assert(found);
+
+	talloc_free(local_mem_ctx);
+} END_TEST
+
 
 Suite *mapistore_namedprops_mysql_suite(void)
 {
@@ -361,6 +398,7 @@ Suite *mapistore_namedprops_mysql_suite(void)
 	tcase_add_test(tc_mysql_q, test_get_nameid_not_found);
 	tcase_add_test(tc_mysql_q, test_create_id_MNID_ID);
 	tcase_add_test(tc_mysql_q, test_create_id_MNID_STRING);
+	tcase_add_test(tc_mysql_q, test_generation);
 	suite_add_tcase(s, tc_mysql_q);
 
 	return s;
@@ -251,11 +251,189 @@ START_TEST (test_create_id_MNID_STRING) {
 	talloc_free(mem_ctx);
 } END_TEST
 
+/* Named properties cache in front of the LDB backend. g_nprops has no
+   cache and plays the part of another process sharing the database */
+static struct namedprops_context	*g_cached_nprops;
+
+static void cache_setup(void)
+{
+	ldb_setup();
+
+	retval = mapistore_namedprops_init(g_mem_ctx, g_lp_ctx, &g_cached_nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(g_cached_nprops->cache != NULL);
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 1);
+}
+
+START_TEST (test_cache_lookups) {
+	TALLOC_CTX		*mem_ctx = talloc_new(NULL);
+	struct MAPINAMEID	nameid = {0};
+	struct MAPINAMEID	*result = NULL;
+	struct namedprops_context *nprops;
+	uint16_t		prop_id = 0;
+	uint16_t		prop_type = 0;
+
+	nameid.ulKind = MNID_ID;
+	nameid.lpguid.time_low = 0x62003;
+	nameid.lpguid.clock_seq[0] = 0xc0;
+	nameid.lpguid.node[5] = 0x46;
+	nameid.kind.lid = 33026;
+	retval = mapistore_namedprops_get_mapped_id(g_cached_nprops, nameid, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_id, 37153);
+
+	/* Names match case insensitively, as in the backends */
+	nameid.ulKind = MNID_STRING;
+	nameid.lpguid.time_low = 0x20329;
+	nameid.kind.lpwstr.Name = "HTTP://schemas.microsoft.com/exchange/SmallIcon";
+	retval = mapistore_namedprops_get_mapped_id(g_cached_nprops, nameid, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_id, 38342);
+
+	retval = mapistore_namedprops_get_nameid(g_cached_nprops, 38306, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(result->ulKind, MNID_STRING);
+	ck_assert_str_eq(result->kind.lpwstr.Name, "urn:schemas:httpmail:junkemail");
+
+	retval = mapistore_namedprops_get_nameid(g_cached_nprops, 38212, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(result->ulKind, MNID_ID);
+	ck_assert_int_eq(result->kind.lid, 32778);
+
+	retval = mapistore_namedprops_get_nameid_type(g_cached_nprops, 37975, &prop_type);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_type, PT_UNICODE);
+
+	retval = mapistore_namedprops_get_nameid_type(g_cached_nprops, 38306, &prop_type);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_type, PT_NULL);
+
+	/* Unknown id: the miss is confirmed without reloading */
+	retval = mapistore_namedprops_get_nameid(g_cached_nprops, 0x8001, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 1);
+
+	/* Contexts opened on the same database share the cache */
+	retval = mapistore_namedprops_init(mem_ctx, g_lp_ctx, &nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(nprops->cache == g_cached_nprops->cache);
+	talloc_free(nprops);
+	ck_assert(g_cached_nprops->cache->count > 0);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_cache_batch) {
+	TALLOC_CTX		*mem_ctx = talloc_new(NULL);
+	struct MAPINAMEID	nameids[3];
+	struct MAPINAMEID	results[3];
+	uint16_t		prop_ids[3];
+	const uint16_t		ids[3] = { 38306, 0x1234, 0x8001 };
+
+	memset(nameids, 0, sizeof (nameids));
+	nameids[0].ulKind = MNID_ID;
+	nameids[0].lpguid.time_low = 0x62003;
+	nameids[0].lpguid.clock_seq[0] = 0xc0;
+	nameids[0].lpguid.node[5] = 0x46;
+	nameids[0].kind.lid = 33026;
+	nameids[1].ulKind = MNID_STRING;
+	nameids[1].lpguid.time_low = 0x20329;
+	nameids[1].lpguid.clock_seq[0] = 0xc0;
+	nameids[1].lpguid.node[5] = 0x46;
+	nameids[1].kind.lpwstr.Name = "http://schemas.microsoft.com/exchange/smallicon";
+	nameids[2].ulKind = MNID_STRING;
+	nameids[2].kind.lpwstr.Name = "unknown";
+
+	retval = mapistore_namedprops_get_mapped_ids(g_cached_nprops, 2, nameids, prop_ids);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_ids[0], 37153);
+	ck_assert_int_eq(prop_ids[1], 38342);
+
+	retval = mapistore_namedprops_get_mapped_ids(g_cached_nprops, 3, nameids, prop_ids);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(prop_ids[0], 37153);
+	ck_assert_int_eq(prop_ids[1], 38342);
+	ck_assert_int_eq(prop_ids[2], 0);
+
+	retval = mapistore_namedprops_get_nameids(g_cached_nprops, 3, ids, mem_ctx, results);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(results[0].ulKind, MNID_STRING);
+	ck_assert_str_eq(results[0].kind.lpwstr.Name, "urn:schemas:httpmail:junkemail");
+	ck_assert_int_eq(results[1].ulKind, 0xff);
+	ck_assert_int_eq(results[2].ulKind, 0xff);
+
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 1);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_cache_create_id) {
+	struct MAPINAMEID	nameid = {0};
+	uint16_t		mapped_id = 0;
+	uint16_t		prop_id = 0;
+
+	retval = mapistore_namedprops_next_unused_id(g_cached_nprops, &mapped_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapped_id, NEXT_UNUSED_ID);
+
+	nameid.ulKind = MNID_STRING;
+	nameid.kind.lpwstr.Name = "cached";
+	retval = mapistore_namedprops_create_id(g_cached_nprops, nameid, mapped_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = mapistore_namedprops_get_mapped_id(g_cached_nprops, nameid, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_id, NEXT_UNUSED_ID);
+
+	retval = mapistore_namedprops_next_unused_id(g_cached_nprops, &mapped_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapped_id, NEXT_UNUSED_ID + 1);
+
+	/* Our own creation does not trigger a reload */
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 1);
+} END_TEST
+
+START_TEST (test_cache_invalidation) {
+	TALLOC_CTX		*mem_ctx = talloc_new(NULL);
+	struct MAPINAMEID	nameid = {0};
+	struct MAPINAMEID	*result = NULL;
+	uint16_t		prop_id = 0;
+
+	/* Mapping created by another process */
+	nameid.ulKind = MNID_ID;
+	nameid.kind.lid = 0x4242;
+	retval = create_id(g_nprops, nameid, NEXT_UNUSED_ID);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = mapistore_namedprops_get_mapped_id(g_cached_nprops, nameid, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_id, NEXT_UNUSED_ID);
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 2);
+
+	retval = mapistore_namedprops_get_nameid(g_cached_nprops, NEXT_UNUSED_ID, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(result->ulKind, MNID_ID);
+	ck_assert_int_eq(result->kind.lid, 0x4242);
+
+	retval = mapistore_namedprops_next_unused_id(g_cached_nprops, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_id, NEXT_UNUSED_ID + 1);
+
+	/* Nothing changed since: misses do not reload */
+	nameid.kind.lid = 0x4243;
+	retval = mapistore_namedprops_get_mapped_id(g_cached_nprops, nameid, &prop_id);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(g_cached_nprops->cache->reloads, 2);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
 
 Suite *mapistore_namedprops_tdb_suite(void)
 {
 	Suite	*s;
 	TCase	*tc_ldb_q;
+	TCase	*tc_cache;
 
 	s = suite_create("libmapistore named properties: TDB backend");
 
@@ -275,5 +453,13 @@ Suite *mapistore_namedprops_tdb_suite(void)
 
 	suite_add_tcase(s, tc_ldb_q);
 
+	tc_cache = tcase_create("Named properties cache");
+	tcase_add_checked_fixture(tc_cache, cache_setup, ldb_teardown);
+	tcase_add_test(tc_cache, test_cache_lookups);
+	tcase_add_test(tc_cache, test_cache_batch);
+	tcase_add_test(tc_cache, test_cache_create_id);
+	tcase_add_test(tc_cache, test_cache_invalidation);
+	suite_add_tcase(s, tc_cache);
+
 	return s;
 }
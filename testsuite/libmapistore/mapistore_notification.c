@@ -25,6 +25,7 @@
 #include "mapiproxy/libmapistore/mapistore_errors.h"
 #include "mapiproxy/libmapistore/gen_ndr/mapistore_notification.h"
 #include "mapiproxy/libmapistore/gen_ndr/ndr_mapistore_notification.h"
+#include "mapiproxy/libmapistore/backends/notification_tdb.h"
 
 /* Global variables */
 static struct GUID	gl_async_uuid;
@@ -43,6 +44,8 @@ static const uint16_t	gl_flags_wholestore = sub_WholeStore;
 static enum MAPITAGS	gl_tags[] = { PidTagParentFolderId, PidTagSubject };
 static const char	*gl_deliver_1 = "deliver1";
 static const char	*gl_deliver_2 = "deliver2";
+static char		gl_tdb_dir[] = "/tmp/mapistore_notification_XXXXXX";
+static char		*gl_tdb_path;
 
 START_TEST(test_initialization) {
 	TALLOC_CTX				*mem_ctx = NULL;
@@ -97,7 +100,7 @@ START_TEST(session_add) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_session_add(&mstore_ctx, gl_uuid, gl_async_uuid, cn);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -152,7 +155,7 @@ START_TEST(session_exist) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_session_exist(&mstore_ctx, gl_async_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -206,7 +209,7 @@ START_TEST(session_get) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_session_get(NULL, &mstore_ctx, gl_async_uuid, &uuid, &cnp);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -254,7 +257,7 @@ START_TEST(session_delete) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_session_delete(&mstore_ctx, gl_async_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -310,7 +313,7 @@ START_TEST(resolver_add) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn, gl_host1);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -378,7 +381,7 @@ START_TEST(resolver_exist) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_resolver_exist(&mstore_ctx, gl_cn);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -439,7 +442,7 @@ START_TEST(resolver_get) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_resolver_get(NULL, &mstore_ctx, gl_cn, &count, &hosts);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -498,7 +501,7 @@ START_TEST(resolver_delete) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_resolver_delete(&mstore_ctx, gl_cn, gl_host1);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -581,7 +584,7 @@ START_TEST(subscription_add) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle,
 							 gl_flags_newmail, gl_FolderId,
 							 gl_MessageId, 0, NULL);
@@ -675,7 +678,7 @@ START_TEST(subscription_exist) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_subscription_exist(&mstore_ctx, gl_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -725,7 +728,7 @@ START_TEST(subscription_get) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_subscription_get(NULL, &mstore_ctx, gl_uuid, &r);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -771,7 +774,7 @@ START_TEST(subscription_delete) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_subscription_delete(&mstore_ctx, gl_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -831,7 +834,7 @@ START_TEST(subscription_delete_by_handle) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_subscription_delete_by_handle(&mstore_ctx, gl_uuid, gl_handle);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -917,7 +920,7 @@ START_TEST(deliver_add) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_deliver_add(&mstore_ctx, gl_uuid, payload.data, payload.length);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -982,7 +985,7 @@ START_TEST(deliver_exist) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_deliver_exist(&mstore_ctx, gl_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -1035,7 +1038,7 @@ START_TEST(deliver_get) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_deliver_get(NULL, &mstore_ctx, gl_uuid, &payload.data, &payload.length);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -1083,7 +1086,7 @@ START_TEST(deliver_delete) {
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
 	mstore_ctx.notification_ctx = &_ctx;
-	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	mstore_ctx.notification_ctx->data = NULL;
 	retval = mapistore_notification_deliver_delete(&mstore_ctx, gl_uuid);
 	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
 
@@ -1164,6 +1167,114 @@ START_TEST(payload_newmail) {
 
 } END_TEST
 
+static struct mapistore_notification_context *notification_tdb_init(TALLOC_CTX *mem_ctx)
+{
+	struct loadparm_context			*lp_ctx;
+	struct mapistore_notification_context	*ctx = NULL;
+	enum mapistore_error			retval;
+
+	lp_ctx = loadparm_init(mem_ctx);
+	ck_assert(lp_ctx != NULL);
+	ck_assert(lpcfg_set_cmdline(lp_ctx, "mapistore:notification_cache",
+				    talloc_asprintf(mem_ctx, "tdb://%s", gl_tdb_path)));
+
+	retval = mapistore_notification_init(mem_ctx, lp_ctx, &ctx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(ctx->backend_type, NOTIFICATION_BACKEND_TDB);
+
+	return ctx;
+}
+
+START_TEST(tdb_backend) {
+	TALLOC_CTX					*mem_ctx;
+	struct mapistore_context			mstore_ctx;
+	enum mapistore_error				retval;
+	struct mapistore_notification_subscription	r;
+	struct GUID					uuid;
+	DATA_BLOB					payload;
+	char						*cn = NULL;
+	uint32_t					count;
+	const char					**hosts;
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_backend");
+	ck_assert(mem_ctx != NULL);
+	mstore_ctx.notification_ctx = notification_tdb_init(mem_ctx);
+
+	/* session */
+	retval = mapistore_notification_session_add(&mstore_ctx, gl_uuid, gl_async_uuid, gl_cn);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_session_add(&mstore_ctx, gl_uuid, gl_async_uuid, gl_cn);
+	ck_assert_int_eq(retval, MAPISTORE_ERROR);
+	retval = mapistore_notification_session_get(mem_ctx, &mstore_ctx, gl_async_uuid, &uuid, &cn);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(GUID_equal(&uuid, &gl_uuid));
+	ck_assert_str_eq(cn, gl_cn);
+	retval = mapistore_notification_session_delete(&mstore_ctx, gl_async_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_session_exist(&mstore_ctx, gl_async_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	/* resolver */
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn, gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn_lowercase, gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_get(mem_ctx, &mstore_ctx, gl_cn, &count, &hosts);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 2);
+	ck_assert_str_eq(hosts[0], gl_host1);
+	ck_assert_str_eq(hosts[1], gl_host2);
+
+	/* subscription */
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle, gl_flags_newmail,
+							 0, 0, 0, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle + 1, gl_flags_table,
+							 gl_FolderId, 0, 2, gl_tags);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_get(mem_ctx, &mstore_ctx, gl_uuid, &r);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(r.v.v1.count, 2);
+	ck_assert_int_eq(r.v.v1.subscription[1].fid, gl_FolderId);
+	retval = mapistore_notification_subscription_delete_by_handle(&mstore_ctx, gl_uuid, gl_handle);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_get(mem_ctx, &mstore_ctx, gl_uuid, &r);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(r.v.v1.count, 1);
+	ck_assert_int_eq(r.v.v1.subscription[0].handle, gl_handle + 1);
+
+	/* deliver: payloads are appended */
+	retval = mapistore_notification_deliver_add(&mstore_ctx, gl_uuid, (uint8_t *)gl_deliver_1, strlen(gl_deliver_1) + 1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_add(&mstore_ctx, gl_uuid, (uint8_t *)gl_deliver_2, strlen(gl_deliver_2) + 1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_get(mem_ctx, &mstore_ctx, gl_uuid, &payload.data, &payload.length);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(payload.length, strlen(gl_deliver_1) + strlen(gl_deliver_2) + 2);
+	ck_assert_str_eq((char *) payload.data, gl_deliver_1);
+	ck_assert_str_eq((char *)(payload.data + strlen(gl_deliver_1) + 1), gl_deliver_2);
+	retval = mapistore_notification_deliver_delete(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_delete(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+static void tdb_backend_setup(void)
+{
+	ck_assert(mkdtemp(gl_tdb_dir) != NULL);
+	gl_tdb_path = talloc_asprintf(NULL, "%s/notification.tdb", gl_tdb_dir);
+	ck_assert(gl_tdb_path != NULL);
+}
+
+static void tdb_backend_teardown(void)
+{
+	unlink(gl_tdb_path);
+	rmdir(gl_tdb_dir);
+	TALLOC_FREE(gl_tdb_path);
+}
+
 Suite *mapistore_notification_suite(void)
 {
 	Suite	*s;
@@ -1173,6 +1284,7 @@ Suite *mapistore_notification_suite(void)
 	TCase	*tc_subscription;
 	TCase	*tc_deliver;
 	TCase	*tc_payload;
+	TCase	*tc_backend;
 
 	s = suite_create("libmapistore notification");
 
@@ -1222,5 +1334,11 @@ Suite *mapistore_notification_suite(void)
 	tcase_add_test(tc_payload, payload_newmail);
 	suite_add_tcase(s, tc_payload);
 
+	/* Backends */
+	tc_backend = tcase_create("notification backends");
+	tcase_add_checked_fixture(tc_backend, tdb_backend_setup, tdb_backend_teardown);
+	tcase_add_test(tc_backend, tdb_backend);
+	suite_add_tcase(s, tc_backend);
+
 	return s;
 }
@@ -0,0 +1,240 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+
+#define	HIERARCHY_TEST_FOLDERS	16
+
+static TALLOC_CTX		*mem_ctx;
+static struct emsmdbp_context	*emsmdbp_ctx;
+
+/* Parent of each test folder, indexed by folder identifier. Folder 1
+ * is the root and 0 marks unused identifiers. */
+static uint64_t			tree[HIERARCHY_TEST_FOLDERS];
+static uint32_t			fetch_count;
+
+/* The folder tree is served by the stubs below instead of mapistore
+ * and openchangedb */
+
+char *emsmdbp_get_owner(struct emsmdbp_object *object)
+{
+	return "hierarchy_user";
+}
+
+bool emsmdbp_is_mapistore(struct emsmdbp_object *object)
+{
+	return false;
+}
+
+uint32_t emsmdbp_get_contextID(struct emsmdbp_object *object)
+{
+	return 0;
+}
+
+static uint64_t tree_child(uint64_t fid, uint32_t row, uint32_t *countp)
+{
+	uint64_t	child = 0;
+	uint32_t	count = 0;
+	uint64_t	i;
+
+	for (i = 1; i < HIERARCHY_TEST_FOLDERS; i++) {
+		if (tree[i] != fid) continue;
+		if (count == row) child = i;
+		count++;
+	}
+	if (countp) *countp = count;
+
+	return child;
+}
+
+static struct emsmdbp_object *folder_new(TALLOC_CTX *ctx, struct emsmdbp_object *parent, uint64_t fid)
+{
+	struct emsmdbp_object	*folder;
+
+	folder = talloc_zero(ctx, struct emsmdbp_object);
+	ck_assert(folder != NULL);
+	folder->type = EMSMDBP_OBJECT_FOLDER;
+	folder->parent_object = parent;
+	folder->emsmdbp_ctx = emsmdbp_ctx;
+	folder->object.folder = talloc_zero(folder, struct emsmdbp_object_folder);
+	ck_assert(folder->object.folder != NULL);
+	folder->object.folder->folderID = fid;
+
+	return folder;
+}
+
+enum MAPISTATUS emsmdbp_folder_get_folder_count(struct emsmdbp_context *ctx, struct emsmdbp_object *folder,
+						uint32_t *row_countp)
+{
+	fetch_count++;
+	tree_child(folder->object.folder->folderID, 0, row_countp);
+
+	return MAPI_E_SUCCESS;
+}
+
+struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *ctx, struct emsmdbp_object *folder,
+						 uint32_t table_type, uint32_t handle_id)
+{
+	struct emsmdbp_object	*table;
+
+	table = talloc_zero(ctx, struct emsmdbp_object);
+	if (!table) return NULL;
+	table->type = EMSMDBP_OBJECT_TABLE;
+	table->parent_object = folder;
+	table->object.table = talloc_zero(table, struct emsmdbp_object_table);
+	if (!table->object.table) {
+		talloc_free(table);
+		return NULL;
+	}
+	table->object.table->ulType = table_type;
+
+	return table;
+}
+
+void **emsmdbp_object_table_get_row_props(TALLOC_CTX *ctx, struct emsmdbp_context *ctx_unused,
+					  struct emsmdbp_object *table, uint32_t row,
+					  enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
+{
+	void		**data_pointers;
+	enum MAPISTATUS	*retvals;
+	uint64_t	*fid;
+
+	data_pointers = talloc_array(ctx, void *, 1);
+	retvals = talloc_array(ctx, enum MAPISTATUS, 1);
+	fid = talloc(data_pointers, uint64_t);
+	if (!data_pointers || !retvals || !fid) return NULL;
+
+	*fid = tree_child(table->parent_object->object.folder->folderID, row, NULL);
+	data_pointers[0] = fid;
+	retvals[0] = *fid ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+	*retvalsp = retvals;
+
+	return data_pointers;
+}
+
+enum mapistore_error emsmdbp_object_open_folder(TALLOC_CTX *ctx, struct emsmdbp_context *ctx_unused,
+						struct emsmdbp_object *parent, uint64_t fid,
+						struct emsmdbp_object **folder_object_p)
+{
+	if (fid >= HIERARCHY_TEST_FOLDERS || tree[fid] != parent->object.folder->folderID) {
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+	*folder_object_p = folder_new(ctx, parent, fid);
+
+	return MAPISTORE_SUCCESS;
+}
+
+static uint32_t count_folders(struct emsmdbp_object *folder)
+{
+	uint32_t	count = 0;
+
+	ck_assert_int_eq(emsmdbp_folder_get_recursive_folder_count(emsmdbp_ctx, folder, &count), MAPI_E_SUCCESS);
+
+	return count;
+}
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_count_cached) {
+	struct emsmdbp_object	*root;
+	uint32_t		fetched;
+
+	/* 1 -> { 2 -> { 4 }, 3 } */
+	tree[2] = 1;
+	tree[3] = 1;
+	tree[4] = 2;
+
+	root = folder_new(mem_ctx, NULL, 1);
+	ck_assert_int_eq(count_folders(root), 3);
+	fetched = fetch_count;
+	ck_assert_int_eq(fetched, 4);
+
+	/* Counted again from the cached tree */
+	ck_assert_int_eq(count_folders(root), 3);
+	ck_assert_int_eq(fetch_count, fetched);
+
+	/* Changes are only seen once the folder is invalidated */
+	tree[5] = 4;
+	ck_assert_int_eq(count_folders(root), 3);
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, 4);
+	ck_assert_int_eq(count_folders(root), 4);
+} END_TEST
+
+START_TEST (test_invalidate_child_counted_first) {
+	struct emsmdbp_object	*root;
+	struct emsmdbp_object	*child;
+
+	/* 1 -> 2 -> 3 -> 4 */
+	tree[2] = 1;
+	tree[3] = 2;
+	tree[4] = 3;
+
+	/* The subfolder is counted first, without its parent opened */
+	child = folder_new(mem_ctx, NULL, 3);
+	ck_assert_int_eq(count_folders(child), 1);
+
+	root = folder_new(mem_ctx, NULL, 1);
+	ck_assert_int_eq(count_folders(root), 3);
+
+	/* A folder created in the subfolder must reach the root count */
+	tree[5] = 3;
+	emsmdbp_hierarchy_invalidate(emsmdbp_ctx, 3);
+	ck_assert_int_eq(count_folders(child), 2);
+	ck_assert_int_eq(count_folders(root), 4);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void hierarchy_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "emsmdbp_hierarchy_suite");
+	emsmdbp_ctx = talloc_zero(mem_ctx, struct emsmdbp_context);
+	ck_assert(emsmdbp_ctx != NULL);
+	emsmdbp_ctx->mem_ctx = mem_ctx;
+
+	memset(tree, 0, sizeof (tree));
+	fetch_count = 0;
+}
+
+static void hierarchy_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_hierarchy_suite(void)
+{
+	Suite *s = suite_create("Mapiproxy/servers/emsmdb/emsmdbp_hierarchy");
+
+	TCase *tc = tcase_create("Folder hierarchy cache");
+	tcase_add_checked_fixture(tc, hierarchy_setup, hierarchy_teardown);
+
+	tcase_add_test(tc, test_count_cached);
+	tcase_add_test(tc, test_invalidate_child_counted_first);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
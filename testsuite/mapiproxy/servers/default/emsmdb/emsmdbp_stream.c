@@ -0,0 +1,188 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+
+#define	STREAM_TEST_SIZE	(3 * EMSMDBP_STREAM_CHUNK_SIZE)
+
+static TALLOC_CTX		*mem_ctx;
+static struct emsmdbp_stream	stream;
+
+static uint8_t pattern(size_t offset)
+{
+	return (offset * 7 + 3) & 0xFF;
+}
+
+static void check_pattern(DATA_BLOB data, size_t offset, size_t length)
+{
+	size_t	i;
+
+	ck_assert_int_eq(data.length, length);
+	ck_assert(data.data != NULL);
+	for (i = 0; i < length; i++) {
+		ck_assert_int_eq(data.data[i], pattern(offset + i));
+	}
+}
+
+static void overwrite(size_t offset, size_t length)
+{
+	DATA_BLOB	data;
+
+	data.length = length;
+	data.data = talloc_array(mem_ctx, uint8_t, length);
+	memset(data.data, 0xEE, length);
+	stream.position = offset;
+	ck_assert_int_eq(emsmdbp_stream_write_buffer(mem_ctx, &stream, data), MAPI_E_SUCCESS);
+	talloc_free(data.data);
+}
+
+/* Two reads and a write handled within the same EcDoRpc request: both
+   replies are only pushed afterwards */
+static void check_reads_then_write(void)
+{
+	TALLOC_CTX	*rop_ctx;
+	DATA_BLOB	in_chunk;
+	DATA_BLOB	across;
+
+	rop_ctx = talloc_new(mem_ctx);
+
+	stream.position = 100;
+	in_chunk = emsmdbp_stream_read_buffer(rop_ctx, &stream, 50);
+	ck_assert_int_eq(stream.position, 150);
+	stream.position = EMSMDBP_STREAM_CHUNK_SIZE - 10;
+	across = emsmdbp_stream_read_buffer(rop_ctx, &stream, 20);
+	ck_assert_int_eq(stream.position, EMSMDBP_STREAM_CHUNK_SIZE + 10);
+
+	overwrite(0, EMSMDBP_STREAM_CHUNK_SIZE + 100);
+
+	check_pattern(in_chunk, 100, 50);
+	check_pattern(across, EMSMDBP_STREAM_CHUNK_SIZE - 10, 20);
+
+	talloc_free(rop_ctx);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_read_buffer) {
+	TALLOC_CTX	*rop_ctx;
+	DATA_BLOB	first;
+	DATA_BLOB	second;
+	DATA_BLOB	last;
+
+	rop_ctx = talloc_new(mem_ctx);
+
+	first = emsmdbp_stream_read_buffer(rop_ctx, &stream, 1000);
+	second = emsmdbp_stream_read_buffer(rop_ctx, &stream, 1000);
+	check_pattern(first, 0, 1000);
+	check_pattern(second, 1000, 1000);
+
+	/* A stream never written is read in place */
+	ck_assert(first.data == stream.buffer.data);
+	ck_assert(second.data == stream.buffer.data + 1000);
+
+	stream.position = STREAM_TEST_SIZE - 10;
+	last = emsmdbp_stream_read_buffer(rop_ctx, &stream, 1000);
+	check_pattern(last, STREAM_TEST_SIZE - 10, 10);
+	ck_assert_int_eq(stream.position, STREAM_TEST_SIZE);
+
+	last = emsmdbp_stream_read_buffer(rop_ctx, &stream, 1000);
+	ck_assert_int_eq(last.length, 0);
+
+	talloc_free(rop_ctx);
+} END_TEST
+
+START_TEST (test_buffer_reads_then_write) {
+	uint8_t	*buffer = stream.buffer.data;
+
+	check_reads_then_write();
+
+	/* The buffer the stream was read from is released with the storage */
+	ck_assert(stream.buffer.data == NULL);
+	ck_assert(talloc_parent(buffer) == stream.storage);
+} END_TEST
+
+START_TEST (test_chunked_reads_then_write) {
+	/* Move the stream to chunked storage, rewriting the same data */
+	DATA_BLOB	data;
+
+	data.length = 1;
+	data.data = talloc_memdup(mem_ctx, stream.buffer.data, 1);
+	ck_assert_int_eq(emsmdbp_stream_write_buffer(mem_ctx, &stream, data), MAPI_E_SUCCESS);
+	ck_assert(stream.storage != NULL);
+	ck_assert(stream.storage->fd == -1);
+
+	check_reads_then_write();
+} END_TEST
+
+START_TEST (test_spilled_reads_then_write) {
+	DATA_BLOB	data;
+
+	stream.spill_size = EMSMDBP_STREAM_CHUNK_SIZE;
+	stream.position = STREAM_TEST_SIZE - 1;
+	data.length = 1;
+	data.data = talloc_memdup(mem_ctx, stream.buffer.data + STREAM_TEST_SIZE - 1, 1);
+	ck_assert_int_eq(emsmdbp_stream_write_buffer(mem_ctx, &stream, data), MAPI_E_SUCCESS);
+	ck_assert(stream.storage != NULL);
+	ck_assert(stream.storage->fd != -1);
+
+	check_reads_then_write();
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void stream_setup(void)
+{
+	size_t	i;
+
+	mem_ctx = talloc_named(NULL, 0, "emsmdbp_stream_suite");
+	memset(&stream, 0, sizeof (stream));
+	stream.buffer.length = STREAM_TEST_SIZE;
+	stream.buffer.data = talloc_array(mem_ctx, uint8_t, STREAM_TEST_SIZE);
+	for (i = 0; i < STREAM_TEST_SIZE; i++) {
+		stream.buffer.data[i] = pattern(i);
+	}
+}
+
+static void stream_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_stream_suite(void)
+{
+	Suite *s = suite_create("Mapiproxy/servers/default/emsmdb/emsmdbp_stream");
+
+	TCase *tc = tcase_create("Stream read and write");
+	tcase_add_checked_fixture(tc, stream_setup, stream_teardown);
+
+	tcase_add_test(tc, test_read_buffer);
+	tcase_add_test(tc, test_buffer_reads_then_write);
+	tcase_add_test(tc, test_chunked_reads_then_write);
+	tcase_add_test(tc, test_spilled_reads_then_write);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
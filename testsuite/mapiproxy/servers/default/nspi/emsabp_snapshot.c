@@ -0,0 +1,185 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#define	EMSABP_SNAPSHOT_DN_FMT		"CN=user%.5d,CN=Recipients,OU=First Administrative Group,O=OpenChange"
+
+static TALLOC_CTX		*mem_ctx;
+static struct emsabp_context	*emsabp_ctx;
+
+/* Records are handed to emsabp_snapshot_index directly, the directory
+ * is never enumerated by this suite */
+enum MAPISTATUS emsabp_ab_container_enum(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx,
+					 uint32_t ContainerID, struct ldb_result **ldb_resp)
+{
+	return MAPI_E_NO_SUPPORT;
+}
+
+static struct emsabp_snapshot *build_snapshot(const char **names, uint32_t count)
+{
+	struct emsabp_snapshot	*snapshot;
+	struct ldb_result	*res;
+	struct ldb_message	*msg;
+	uint32_t		i;
+
+	res = talloc_zero(mem_ctx, struct ldb_result);
+	res->msgs = talloc_array(res, struct ldb_message *, count);
+	res->count = count;
+	for (i = 0; i < count; i++) {
+		msg = ldb_msg_new(res->msgs);
+		ck_assert(msg != NULL);
+		ck_assert_int_eq(ldb_msg_add_string(msg, "displayName", names[i]), LDB_SUCCESS);
+		ck_assert_int_eq(ldb_msg_add_string(msg, "distinguishedName",
+						    talloc_asprintf(msg, EMSABP_SNAPSHOT_DN_FMT, i)),
+				 LDB_SUCCESS);
+		res->msgs[i] = msg;
+	}
+
+	snapshot = talloc_zero(mem_ctx, struct emsabp_snapshot);
+	ck_assert(snapshot != NULL);
+	ck_assert_int_eq(emsabp_snapshot_index(emsabp_ctx, snapshot, res), MAPI_E_SUCCESS);
+
+	return snapshot;
+}
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_sort_order) {
+	const char		*names[] = { "delta", "Alpha", "charlie", "BRAVO", "alpha" };
+	const char		*sorted[] = { "Alpha", "alpha", "BRAVO", "charlie", "delta" };
+	struct emsabp_snapshot	*snapshot;
+	uint32_t		i;
+
+	snapshot = build_snapshot(names, 5);
+	ck_assert_int_eq(snapshot->count, 5);
+	ck_assert_int_eq(snapshot->mids.cValues, 5);
+
+	for (i = 0; i < snapshot->count; i++) {
+		ck_assert_str_eq(snapshot->entries[i].sort_key, sorted[i]);
+		ck_assert_int_eq(snapshot->entries[i].row, i);
+		ck_assert_int_eq(snapshot->mids.aulPropTag[i], snapshot->entries[i].MId);
+	}
+
+	/* Equal display names are ordered by MId */
+	ck_assert_int_lt(snapshot->entries[0].MId, snapshot->entries[1].MId);
+} END_TEST
+
+START_TEST (test_find_row) {
+	const char		*names[] = { "delta", "Alpha", "charlie", "BRAVO" };
+	struct emsabp_snapshot	*snapshot;
+	uint32_t		MId;
+	uint32_t		row;
+	uint32_t		i;
+
+	snapshot = build_snapshot(names, 4);
+
+	for (i = 0; i < snapshot->count; i++) {
+		ck_assert(emsabp_snapshot_find_row(snapshot, snapshot->entries[i].MId, &row));
+		ck_assert_int_eq(row, i);
+	}
+
+	/* MIds allocated in the temporary TDB are found back */
+	ck_assert_int_eq(emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, talloc_asprintf(mem_ctx, EMSABP_SNAPSHOT_DN_FMT, 1),
+					      &MId), MAPI_E_SUCCESS);
+	ck_assert(emsabp_snapshot_find_row(snapshot, MId, &row));
+	ck_assert_str_eq(snapshot->entries[row].sort_key, "Alpha");
+
+	ck_assert(!emsabp_snapshot_find_row(snapshot, 0, &row));
+	ck_assert(!emsabp_snapshot_find_row(snapshot, EMSABP_TDB_TMP_MID_START + 100, &row));
+	ck_assert(!emsabp_snapshot_find_row(NULL, MId, &row));
+	ck_assert(!emsabp_snapshot_find_row(snapshot, MId, NULL));
+} END_TEST
+
+START_TEST (test_seek) {
+	const char		*names[] = { "delta", "Alpha", "charlie", "BRAVO", "alpha" };
+	struct emsabp_snapshot	*snapshot;
+
+	snapshot = build_snapshot(names, 5);
+
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, ""), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "ALPHA"), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "alphb"), 2);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "b"), 2);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "bravo"), 2);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "Charlie"), 3);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "d"), 4);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "zulu"), 5);
+
+	/* Leading spaces are ignored by the directory string syntax,
+	 * seeking must follow the collation the records are sorted with */
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "  charlie"), 3);
+} END_TEST
+
+START_TEST (test_seek_empty) {
+	struct emsabp_snapshot	*snapshot;
+
+	snapshot = build_snapshot(NULL, 0);
+	ck_assert_int_eq(snapshot->count, 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "alpha"), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(NULL, "alpha"), 0);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void emsabp_snapshot_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "emsabp_snapshot_suite");
+	emsabp_ctx = talloc_zero(mem_ctx, struct emsabp_context);
+	ck_assert(emsabp_ctx != NULL);
+	emsabp_ctx->mem_ctx = mem_ctx;
+
+	emsabp_ctx->ttdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	ck_assert(emsabp_ctx->ttdb_ctx != NULL);
+
+	emsabp_ctx->samdb_ctx = ldb_init(mem_ctx, NULL);
+	ck_assert(emsabp_ctx->samdb_ctx != NULL);
+	ck_assert_int_eq(ldb_schema_attribute_add(emsabp_ctx->samdb_ctx, "displayName", 0,
+						  LDB_SYNTAX_DIRECTORY_STRING), LDB_SUCCESS);
+}
+
+static void emsabp_snapshot_teardown(void)
+{
+	emsabp_tdb_close(emsabp_ctx->ttdb_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_snapshot_suite(void)
+{
+	Suite *s = suite_create("Mapiproxy/servers/nspi/emsabp_snapshot");
+
+	TCase *tc = tcase_create("Snapshot sort and seek");
+	tcase_add_checked_fixture(tc, emsabp_snapshot_setup, emsabp_snapshot_teardown);
+
+	tcase_add_test(tc, test_sort_order);
+	tcase_add_test(tc, test_find_row);
+	tcase_add_test(tc, test_seek);
+	tcase_add_test(tc, test_seek_empty);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
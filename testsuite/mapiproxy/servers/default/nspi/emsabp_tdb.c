@@ -0,0 +1,139 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#define	EMSABP_TDB_DN_FMT		"CN=user%.5d,CN=Recipients,OU=First Administrative Group,O=OpenChange"
+
+static TALLOC_CTX	*mem_ctx;
+static TDB_CONTEXT	*tdb_ctx;
+
+static void insert_users(uint32_t count)
+{
+	char		*dn;
+	uint32_t	i;
+
+	for (i = 0; i < count; i++) {
+		dn = talloc_asprintf(mem_ctx, EMSABP_TDB_DN_FMT, i);
+		ck_assert_int_eq(emsabp_tdb_insert(tdb_ctx, dn), MAPI_E_SUCCESS);
+		talloc_free(dn);
+	}
+}
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_index_roundtrip) {
+	char		*dn;
+	char		*expected;
+	uint32_t	MId;
+	uint32_t	i;
+
+	insert_users(100);
+
+	for (i = 0; i < 100; i++) {
+		expected = talloc_asprintf(mem_ctx, EMSABP_TDB_DN_FMT, i);
+		ck_assert_int_eq(emsabp_tdb_fetch_MId(tdb_ctx, expected, &MId), MAPI_E_SUCCESS);
+		ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + i + 1);
+		ck_assert(emsabp_tdb_lookup_MId(tdb_ctx, MId));
+		ck_assert_int_eq(emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &dn), MAPI_E_SUCCESS);
+		ck_assert_str_eq(dn, expected);
+		talloc_free(expected);
+		talloc_free(dn);
+	}
+
+	/* Inserting an existing DN must not allocate a new MId */
+	expected = talloc_asprintf(mem_ctx, EMSABP_TDB_DN_FMT, 0);
+	ck_assert_int_ne(emsabp_tdb_insert(tdb_ctx, expected), MAPI_E_SUCCESS);
+	talloc_free(expected);
+
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, EMSABP_TDB_TMP_MID_START + 101));
+	ck_assert_int_eq(emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, EMSABP_TDB_TMP_MID_START + 101, &dn),
+			 MAPI_E_NOT_FOUND);
+	ck_assert(dn == NULL);
+	ck_assert_int_eq(emsabp_tdb_fetch_MId(tdb_ctx, "CN=unknown", &MId), MAPI_E_NOT_FOUND);
+} END_TEST
+
+START_TEST (test_index_external_insert) {
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*dn;
+	uint32_t	MId;
+
+	insert_users(10);
+
+	/* Simulate a record inserted by another server process */
+	MId = EMSABP_TDB_TMP_MID_START + 11;
+	key.dptr = (unsigned char *) "CN=external";
+	key.dsize = strlen((const char *)key.dptr);
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", MId);
+	dbuf.dsize = strlen((const char *)dbuf.dptr);
+	ck_assert_int_eq(tdb_store(tdb_ctx, key, dbuf, TDB_INSERT), 0);
+
+	key.dptr = (unsigned char *) EMSABP_TDB_DATA_REC;
+	key.dsize = strlen(EMSABP_TDB_DATA_REC);
+	ck_assert_int_eq(tdb_store(tdb_ctx, key, dbuf, TDB_MODIFY), 0);
+
+	ck_assert(emsabp_tdb_lookup_MId(tdb_ctx, MId));
+	ck_assert_int_eq(emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &dn), MAPI_E_SUCCESS);
+	ck_assert_str_eq(dn, "CN=external");
+
+	/* Next local insert must not reuse the external MId */
+	ck_assert_int_eq(emsabp_tdb_insert(tdb_ctx, "CN=local"), MAPI_E_SUCCESS);
+	ck_assert_int_eq(emsabp_tdb_fetch_MId(tdb_ctx, "CN=local", &MId), MAPI_E_SUCCESS);
+	ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + 12);
+	ck_assert_int_eq(emsabp_tdb_fetch_MId(tdb_ctx, "CN=external", &MId), MAPI_E_SUCCESS);
+	ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + 11);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void emsabp_tdb_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_suite");
+	tdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	ck_assert(tdb_ctx != NULL);
+}
+
+static void emsabp_tdb_teardown(void)
+{
+	emsabp_tdb_close(tdb_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_tdb_suite(void)
+{
+	Suite *s = suite_create("Mapiproxy/servers/nspi/emsabp_tdb");
+
+	TCase *tc = tcase_create("MId index");
+	tcase_add_checked_fixture(tc, emsabp_tdb_setup, emsabp_tdb_teardown);
+
+	tcase_add_test(tc, test_index_roundtrip);
+	tcase_add_test(tc, test_index_external_insert);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
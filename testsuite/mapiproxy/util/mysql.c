@@ -244,6 +244,76 @@ START_TEST (test_create_schema) {
 
 } END_TEST
 
+START_TEST (test_prepared_statements) {
+	enum MYSQLRESULT	ret;
+	uint64_t		n = 0, values[2];
+	uint64_t		prepared, prepared_after;
+	const char		*str = NULL;
+	char			*long_value, *sql;
+
+	ck_assert_int_eq(execute_query(conn, "CREATE TABLE IF NOT EXISTS `stmt_test` ("
+				       "`id` BIGINT UNSIGNED NOT NULL, `name` VARCHAR(255) NOT NULL,"
+				       "`value` TEXT NULL) ENGINE=InnoDB CHARSET=utf8"), MYSQL_SUCCESS);
+
+	long_value = talloc_array(mem_ctx, char, 1025);
+	memset(long_value, 'x', 1024);
+	long_value[1024] = '\0';
+	sql = talloc_asprintf(mem_ctx, "INSERT INTO stmt_test VALUES "
+			      "(18446744073709551615, 'max', 'short'), "
+			      "(2, 'it''s', '%s'), (3, 'null', NULL)", long_value);
+	ck_assert_int_eq(execute_query(conn, sql), MYSQL_SUCCESS);
+
+	/* Integer and string parameters, 64 bits results */
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "s", "max");
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert(n == 18446744073709551615ul);
+
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "s", "it's");
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert(n == 2);
+
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "s", "none");
+	ck_assert_int_eq(ret, MYSQL_NOT_FOUND);
+
+	ret = stmt_select_first_uints(conn, "SELECT id, id + ? FROM stmt_test WHERE id = ?",
+				      values, 2, "iu", 40, (uint64_t) 2);
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert(values[0] == 2 && values[1] == 42);
+
+	/* Short, long and NULL strings */
+	ret = stmt_select_first_string(mem_ctx, conn, "SELECT value FROM stmt_test WHERE id = ?",
+				       &str, "u", 18446744073709551615ul);
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert_str_eq(str, "short");
+
+	ret = stmt_select_first_string(mem_ctx, conn, "SELECT value FROM stmt_test WHERE id = ?",
+				       &str, "u", (uint64_t) 2);
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert_str_eq(str, long_value);
+
+	ret = stmt_select_first_string(mem_ctx, conn, "SELECT value FROM stmt_test WHERE id = ?",
+				       &str, "u", (uint64_t) 3);
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	ck_assert(str == NULL);
+
+	/* Statements are prepared once per template */
+	stmt_cache_stats(&prepared, NULL);
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "s", "max");
+	ck_assert_int_eq(ret, MYSQL_SUCCESS);
+	stmt_cache_stats(&prepared_after, NULL);
+	ck_assert(prepared_after == prepared);
+
+	/* Parameter mismatch and invalid queries */
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "");
+	ck_assert_int_eq(ret, MYSQL_ERROR);
+	ret = stmt_select_first_uint(conn, "SELECT id FROM stmt_test WHERE name = ?", &n, "x", "max");
+	ck_assert_int_eq(ret, MYSQL_ERROR);
+	ret = stmt_select_first_uint(conn, "SELECT id FROM missing_table WHERE name = ?", &n, "s", "max");
+	ck_assert_int_eq(ret, MYSQL_ERROR);
+
+	ck_assert_int_eq(execute_query(conn, "DROP TABLE stmt_test"), MYSQL_SUCCESS);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -285,6 +355,7 @@ Suite *mapiproxy_util_mysql_suite(void)
 	tcase_add_test(tc, test_parse_connection_string_fail);
 	tcase_add_test(tc, test_parse_connection_string_success);
 	tcase_add_test(tc, test_create_schema);
+	tcase_add_test(tc, test_prepared_statements);
 
 	suite_add_tcase(s, tc);
 
@@ -0,0 +1,193 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/util/oc_rop_stats.h"
+
+#define	ROP_STATS_DUMP_PATH	"/tmp/oc_rop_stats_testsuite.stats"
+#define	ROP_STATS_DUMP_DIR	"/tmp/oc_rop_stats_testsuite"
+
+static void write_file(const char *path)
+{
+	FILE	*f;
+
+	f = fopen(path, "w");
+	ck_assert(f != NULL);
+	fprintf(f, "# OpenChange ROP statistics\n");
+	fclose(f);
+}
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_bucket_bounds) {
+	uint64_t	usec;
+	uint32_t	idx;
+
+	for (usec = 0; usec < 100000000; usec = usec * 3 / 2 + 1) {
+		idx = oc_rop_stats_bucket_index(usec);
+		ck_assert(idx < OC_ROP_STATS_BUCKETS);
+		ck_assert(oc_rop_stats_bucket_lower(idx) <= usec);
+		ck_assert(oc_rop_stats_bucket_lower(idx + 1) > usec);
+	}
+
+	for (idx = 0; idx < OC_ROP_STATS_BUCKETS; idx++) {
+		ck_assert_int_eq(oc_rop_stats_bucket_index(oc_rop_stats_bucket_lower(idx)), idx);
+	}
+
+	/* Latencies past the last bucket are clamped */
+	ck_assert_int_eq(oc_rop_stats_bucket_index(UINT64_MAX), OC_ROP_STATS_BUCKETS - 1);
+} END_TEST
+
+START_TEST (test_rop_accounting) {
+	const struct oc_rop_stats_entry	*entry;
+	struct oc_rop_stats_call	call;
+	uint64_t			total = 0;
+	int				i;
+
+	for (i = 0; i < 10; i++) {
+		oc_rop_stats_rop_start(&call);
+		OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_MAPISTORE, usleep(1000));
+		/* Nested calls are only accounted once */
+		OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB,
+					  OC_ROP_STATS_BACKEND_CALL(OC_ROP_STATS_OPENCHANGEDB, usleep(500)));
+		oc_rop_stats_rop_end(&call, 0x07, i == 0, 100);
+	}
+
+	entry = oc_rop_stats_get(0x07);
+	ck_assert_int_eq(entry->calls, 10);
+	ck_assert_int_eq(entry->errors, 1);
+	ck_assert_int_eq(entry->response_bytes, 1000);
+	ck_assert(entry->backend_usec[OC_ROP_STATS_MAPISTORE] >= 10000);
+	ck_assert(entry->backend_usec[OC_ROP_STATS_OPENCHANGEDB] >= 5000);
+	ck_assert(entry->backend_usec[OC_ROP_STATS_OPENCHANGEDB] < entry->backend_usec[OC_ROP_STATS_MAPISTORE]);
+	ck_assert(entry->usec >= entry->backend_usec[OC_ROP_STATS_MAPISTORE] +
+		  entry->backend_usec[OC_ROP_STATS_OPENCHANGEDB]);
+	ck_assert(entry->max_usec >= 1500);
+
+	for (i = 0; i < OC_ROP_STATS_BUCKETS; i++) {
+		total += entry->buckets[i];
+	}
+	ck_assert_int_eq(total, 10);
+
+	ck_assert_int_eq(oc_rop_stats_get(0x15)->calls, 0);
+
+	oc_rop_stats_reset();
+	ck_assert_int_eq(oc_rop_stats_get(0x07)->calls, 0);
+} END_TEST
+
+START_TEST (test_dump) {
+	struct oc_rop_stats_call	call;
+	FILE				*f;
+	char				line[4096];
+	bool				found = false;
+
+	oc_rop_stats_rop_start(&call);
+	oc_rop_stats_rop_end(&call, 0x02, false, 42);
+
+	ck_assert_int_eq(oc_rop_stats_dump(ROP_STATS_DUMP_PATH), 0);
+
+	f = fopen(ROP_STATS_DUMP_PATH, "r");
+	ck_assert(f != NULL);
+	while (fgets(line, sizeof (line), f)) {
+		if (!strncmp(line, "rop 0x02 calls 1 errors 0 ", 26)) {
+			ck_assert(strstr(line, " bytes 42 ") != NULL);
+			ck_assert(strstr(line, " buckets ") != NULL);
+			found = true;
+		}
+	}
+	fclose(f);
+
+	ck_assert(found);
+} END_TEST
+
+START_TEST (test_cleanup) {
+	char	*live;
+	char	*stale;
+	char	*stale_tmp;
+	char	*other;
+
+	ck_assert(mkdir(ROP_STATS_DUMP_DIR, 0700) == 0 || errno == EEXIST);
+
+	/* pids above pid_max never run */
+	live = talloc_asprintf(NULL, ROP_STATS_DUMP_DIR "/%d" OC_ROP_STATS_SUFFIX, (int)getpid());
+	stale = talloc_asprintf(NULL, ROP_STATS_DUMP_DIR "/%d" OC_ROP_STATS_SUFFIX, INT_MAX - 1);
+	stale_tmp = talloc_asprintf(NULL, ROP_STATS_DUMP_DIR "/%d" OC_ROP_STATS_SUFFIX ".tmp", INT_MAX - 2);
+	other = talloc_strdup(NULL, ROP_STATS_DUMP_DIR "/notes.txt");
+	write_file(live);
+	write_file(stale);
+	write_file(stale_tmp);
+	write_file(other);
+
+	ck_assert_int_eq(oc_rop_stats_cleanup(ROP_STATS_DUMP_DIR), 2);
+	ck_assert_int_eq(access(live, F_OK), 0);
+	ck_assert_int_ne(access(stale, F_OK), 0);
+	ck_assert_int_ne(access(stale_tmp, F_OK), 0);
+	ck_assert_int_eq(access(other, F_OK), 0);
+
+	ck_assert_int_eq(oc_rop_stats_cleanup(ROP_STATS_DUMP_DIR "/missing"), -1);
+
+	unlink(live);
+	unlink(other);
+	rmdir(ROP_STATS_DUMP_DIR);
+	talloc_free(live);
+	talloc_free(stale);
+	talloc_free(stale_tmp);
+	talloc_free(other);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void rop_stats_setup(void)
+{
+	ck_assert(oc_rop_stats_init(NULL, 0));
+	oc_rop_stats_reset();
+}
+
+static void rop_stats_teardown(void)
+{
+	unlink(ROP_STATS_DUMP_PATH);
+}
+
+Suite *mapiproxy_util_rop_stats_suite(void)
+{
+	Suite *s = suite_create("Mapiproxy/util/oc_rop_stats");
+
+	TCase *tc = tcase_create("ROP statistics");
+	tcase_add_checked_fixture(tc, rop_stats_setup, rop_stats_teardown);
+
+	tcase_add_test(tc, test_bucket_bounds);
+	tcase_add_test(tc, test_rop_accounting);
+	tcase_add_test(tc, test_dump);
+	tcase_add_test(tc, test_cleanup);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -108,6 +108,7 @@ int main(int argc, const char *argv[])
 	srunner_add_suite(sr, mapiproxy_openchangedb_multitenancy_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_logger_suite());
 	srunner_add_suite(sr, mapiproxy_logon_table_suite());
+	srunner_add_suite(sr, mapiproxy_mapi_handles_suite());
 	/* libmapistore */
 	srunner_add_suite(sr, mapistore_namedprops_suite());
 	srunner_add_suite(sr, mapistore_namedprops_mysql_suite());
@@ -118,6 +119,11 @@ int main(int argc, const char *argv[])
 	/* mapiproxy */
 	srunner_add_suite(sr, mapiproxy_util_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_util_schema_migration_suite());
+	srunner_add_suite(sr, mapiproxy_util_rop_stats_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_tdb_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_snapshot_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_stream_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_hierarchy_suite());
 
 	srunner_run_all(sr, CK_ENV);
 	nf = srunner_ntests_failed(sr);
@@ -52,6 +52,7 @@ Suite *mapiproxy_openchangedb_ldb_suite(void);
 Suite *mapiproxy_openchangedb_multitenancy_mysql_suite(void);
 Suite *mapiproxy_openchangedb_logger_suite(void);
 Suite *mapiproxy_logon_table_suite(void);
+Suite *mapiproxy_mapi_handles_suite(void);
 /* libmapistore */
 Suite *mapistore_namedprops_suite(void);
 Suite *mapistore_namedprops_mysql_suite(void);
@@ -62,6 +63,11 @@ Suite *mapistore_notification_suite(void);
 /* mapiproxy */
 Suite *mapiproxy_util_mysql_suite(void);
 Suite *mapiproxy_util_schema_migration_suite(void);
+Suite *mapiproxy_util_rop_stats_suite(void);
+Suite *mapiproxy_emsabp_tdb_suite(void);
+Suite *mapiproxy_emsabp_snapshot_suite(void);
+Suite *mapiproxy_emsmdbp_stream_suite(void);
+Suite *mapiproxy_emsmdbp_hierarchy_suite(void);
 
 __END_DECLS
 
@@ -28,6 +28,7 @@
 
 #include <errno.h>
 #include <err.h>
+#include <time.h>
 
 /* forward declaration */
 struct mapitest;
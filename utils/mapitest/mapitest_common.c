@@ -542,3 +542,63 @@ _PUBLIC_ void mapitest_common_cleanup(struct mapitest *mt)
 	talloc_free(mt->priv);
 }
 
+
+/**
+   Seconds elapsed since a CLOCK_MONOTONIC time, for benchmarks
+
+   \param start the time returned by clock_gettime(CLOCK_MONOTONIC)
+
+   \return the elapsed time in seconds
+*/
+_PUBLIC_ double mapitest_common_elapsed(const struct timespec *start)
+{
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+   Fill a benchmark buffer with reproducible pseudo-random content
+
+   Words are picked with a linear congruential generator, so the same
+   seed always gives the same data. Without words, the buffer is
+   filled with pseudo-random bytes instead.
+
+   \param data the buffer to fill
+   \param size the number of bytes to write
+   \param words NULL terminated list of words, or NULL
+   \param separate whether a pseudo-random byte follows every word
+   \param seed the generator state to start from
+
+   \return the generator state after the last byte, to carry on with
+   another call
+*/
+_PUBLIC_ uint32_t mapitest_common_bench_fill(uint8_t *data, size_t size,
+					     const char **words, bool separate,
+					     uint32_t seed)
+{
+	const char	*word;
+	uint32_t	count = 0;
+	size_t		i = 0;
+
+	if (words) {
+		for (count = 0; words[count]; count++);
+	}
+
+	while (i < size) {
+		seed = seed * 1103515245 + 12345;
+		if (!count) {
+			data[i++] = seed >> 16;
+			continue;
+		}
+		for (word = words[(seed >> 16) % count]; *word && i < size; word++) {
+			data[i++] = *word;
+		}
+		if (separate && i < size) {
+			data[i++] = seed >> 24;
+		}
+	}
+
+	return seed;
+}
@@ -518,7 +518,9 @@ _PUBLIC_ uint32_t module_noserver_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "LZFU-DECOMPRESS", "Test Compressed RTF decompression operations", mapitest_noserver_lzfu);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS", "Test Compressed RTF compression operations", mapitest_noserver_rtfcp);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS-LARGE", "Test RTF (de)compression operations on larger file", mapitest_noserver_rtfcp_large);
+	mapitest_suite_add_test(suite, "LZFU-BENCHMARK", "Test RTF (de)compression round trips and throughput", mapitest_noserver_rtfcp_bench);
 	mapitest_suite_add_test(suite, "SROWSET", "Test SRowSet parsing", mapitest_noserver_srowset);
+	mapitest_suite_add_test(suite, "SROWSET-BENCHMARK", "Test arena SRowSet decoding and throughput", mapitest_noserver_srowset_bench);
 	mapitest_suite_add_test(suite, "GETSETPROPS", "Test Property handling", mapitest_noserver_properties);
 	mapitest_suite_add_test(suite, "MAPIPROPS", "Test MAPI Property handling", mapitest_noserver_mapi_properties);
 	mapitest_suite_add_test(suite, "PROPTAGVALUE", "Test MAPI PropTag value handling", mapitest_noserver_proptagvalue);
@@ -622,6 +624,7 @@ _PUBLIC_ uint32_t module_lzxpress_init(struct mapitest *mt)
 	suite = mapitest_suite_init(mt, "LZXPRESS", "lzxpress algorithm test suite", false);
 
 	mapitest_suite_add_test_flagged(suite, "VALIDATE-001", "Validate LZXPRESS implementation using sample file 001", mapitest_lzxpress_validate_test_001, ExpectedFail);
+	mapitest_suite_add_test(suite, "BENCHMARK", "Check LZXPRESS payload framing and measure throughput", mapitest_lzxpress_benchmark);
 
 	mapitest_suite_register(mt, suite);
 
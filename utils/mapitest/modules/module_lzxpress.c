@@ -19,6 +19,8 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <time.h>
+
 #include "utils/mapitest/mapitest.h"
 #include "utils/mapitest/proto.h"
 #include "gen_ndr/ndr_exchange.h"
@@ -149,3 +151,176 @@ _PUBLIC_ bool mapitest_lzxpress_validate_test_001(struct mapitest *mt)
 
 	return ret;
 }
+
+#define	LZXPRESS_BENCH_SIZE	0x7F00
+#define	LZXPRESS_BENCH_ROUNDS	2000
+
+/* Build a FastTransfer-like buffer: property tags, small integers and
+   repeated strings, with a random tail of random_size bytes */
+static uint8_t *lzxpress_bench_data(TALLOC_CTX *mem_ctx, uint32_t size, uint32_t random_size)
+{
+	static const char	*words[] = { "\x1f\x00\x37\x00", "\x03\x00\x0e\x0e", "\x40\x00\x08\x30",
+					     "OpenChange ", "Subject: ", "\x00\x00\x00\x00", "message body ",
+					     "\x02\x01\xf9\x0f\x16\x00\x00\x00", "IPM.Note", NULL };
+	uint8_t			*data;
+	uint32_t		seed;
+
+	data = talloc_array(mem_ctx, uint8_t, size);
+	if (!data) return NULL;
+
+	seed = mapitest_common_bench_fill(data, size - random_size, words, true, 0x58505253);
+	mapitest_common_bench_fill(data + size - random_size, random_size, NULL, false, seed);
+
+	return data;
+}
+
+/* Push data as a response payload and pull it back */
+static bool lzxpress_roundtrip(struct mapitest *mt, const uint8_t *data, uint32_t size,
+			       uint16_t flags, uint16_t *out_flags, uint32_t *out_size)
+{
+	struct ndr_push		*ndr_push;
+	struct ndr_pull		*ndr_pull;
+	struct ndr_pull		*ndr_data;
+	struct RPC_HEADER_EXT	header;
+	DATA_BLOB		blob;
+	bool			ret = false;
+
+	ndr_push = ndr_push_init_ctx(mt->mem_ctx);
+	ndr_set_flags(&ndr_push->flags, LIBNDR_FLAG_NOALIGN);
+	if (ndr_push_mapi2k7_payload(ndr_push, flags, data, size) != NDR_ERR_SUCCESS) {
+		mapitest_print(mt, "* %-40s: push failed for %u bytes\n", "LZXPRESS-BENCHMARK", size);
+		goto end;
+	}
+
+	blob.data = ndr_push->data;
+	blob.length = ndr_push->offset;
+	ndr_pull = ndr_pull_init_blob(&blob, ndr_push);
+	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN);
+	if (ndr_pull_RPC_HEADER_EXT(ndr_pull, NDR_SCALARS, &header) != NDR_ERR_SUCCESS ||
+	    header.Size != ndr_pull->data_size - ndr_pull->offset || header.SizeActual != size) {
+		mapitest_print(mt, "* %-40s: bad header for %u bytes\n", "LZXPRESS-BENCHMARK", size);
+		goto end;
+	}
+
+	if (header.Flags & RHEF_XorMagic) {
+		obfuscate_data(ndr_pull->data + ndr_pull->offset, header.Size, 0xA5);
+	}
+
+	if (header.Flags & RHEF_Compressed) {
+		if (ndr_pull_lzxpress_decompress(ndr_pull, &ndr_data, header.SizeActual) != NDR_ERR_SUCCESS) {
+			mapitest_print(mt, "* %-40s: decompression failed for %u bytes\n", "LZXPRESS-BENCHMARK", size);
+			goto end;
+		}
+	} else {
+		ndr_data = ndr_pull;
+	}
+
+	if (ndr_data->data_size - ndr_data->offset != size ||
+	    (size && memcmp(ndr_data->data + ndr_data->offset, data, size))) {
+		mapitest_print(mt, "* %-40s: round trip mismatch for %u bytes\n", "LZXPRESS-BENCHMARK", size);
+		goto end;
+	}
+
+	*out_flags = header.Flags;
+	*out_size = header.Size;
+	ret = true;
+end:
+	talloc_free(ndr_push);
+	return ret;
+}
+
+/**
+     \details Test LZXPRESS payload framing and measure throughput
+
+   This function:
+   -# Pushes and pulls back compressible, incompressible and
+   obfuscated payloads from empty up to 64KB
+   -# Checks that compression is skipped on random data and used on
+   FastTransfer-like data
+   -# Reports compression, decompression and probe throughput on a
+   32KB FastTransfer-like buffer
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_lzxpress_benchmark(struct mapitest *mt)
+{
+	uint8_t			*data;
+	uint8_t			*noise;
+	struct ndr_push		*ndr_push;
+	struct ndr_pull		*ndr_pull;
+	struct ndr_pull		*ndr_data;
+	struct timespec		start;
+	DATA_BLOB		blob;
+	double			compress_time;
+	double			decompress_time;
+	double			probe_time;
+	uint32_t		comp_size = 0;
+	uint32_t		size;
+	uint16_t		flags;
+	bool			probe = false;
+	int			i;
+
+	data = lzxpress_bench_data(mt->mem_ctx, 0xFFFF, 0);
+	noise = lzxpress_bench_data(mt->mem_ctx, 0xFFFF, 0xFFFF);
+	if (!data || !noise) return false;
+
+	for (size = 0; size <= 0xFFFF; size = size < 300 ? size + 1 : size + 4099) {
+		if (!lzxpress_roundtrip(mt, data, size, RHEF_Compressed|RHEF_Last, &flags, &comp_size)) return false;
+		if (size >= 1024 && !(flags & RHEF_Compressed)) {
+			mapitest_print(mt, "* %-40s: %u bytes not compressed\n", "LZXPRESS-BENCHMARK", size);
+			return false;
+		}
+		if (!lzxpress_roundtrip(mt, data, size, RHEF_Compressed|RHEF_XorMagic|RHEF_Last, &flags, &comp_size)) return false;
+		if (!lzxpress_roundtrip(mt, noise, size, RHEF_Compressed|RHEF_Last, &flags, &comp_size)) return false;
+		if ((flags & RHEF_Compressed) || comp_size != size) {
+			mapitest_print(mt, "* %-40s: random %u bytes compressed\n", "LZXPRESS-BENCHMARK", size);
+			return false;
+		}
+	}
+	mapitest_print(mt, "* %-40s: round trips - match\n", "LZXPRESS-BENCHMARK");
+
+	ndr_push = ndr_push_init_ctx(mt->mem_ctx);
+	ndr_set_flags(&ndr_push->flags, LIBNDR_FLAG_NOALIGN);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LZXPRESS_BENCH_ROUNDS; i++) {
+		ndr_push->offset = 0;
+		ndr_push_mapi2k7_payload(ndr_push, RHEF_Compressed|RHEF_Last, data, LZXPRESS_BENCH_SIZE);
+	}
+	compress_time = mapitest_common_elapsed(&start) / LZXPRESS_BENCH_ROUNDS;
+
+	/* Skip the RPC_HEADER_EXT */
+	blob.data = ndr_push->data + 8;
+	blob.length = ndr_push->offset - 8;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LZXPRESS_BENCH_ROUNDS; i++) {
+		ndr_pull = ndr_pull_init_blob(&blob, ndr_push);
+		if (ndr_pull_lzxpress_decompress(ndr_pull, &ndr_data, LZXPRESS_BENCH_SIZE) != NDR_ERR_SUCCESS) {
+			mapitest_print(mt, "* %-40s: decompression failed\n", "LZXPRESS-BENCHMARK");
+			return false;
+		}
+		talloc_free(ndr_pull);
+	}
+	decompress_time = mapitest_common_elapsed(&start) / LZXPRESS_BENCH_ROUNDS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LZXPRESS_BENCH_ROUNDS; i++) {
+		probe |= lzxpress_probe(noise, LZXPRESS_BENCH_SIZE);
+	}
+	probe_time = mapitest_common_elapsed(&start) / LZXPRESS_BENCH_ROUNDS;
+
+	mapitest_print(mt, "* %-40s: %d bytes compressed to %zu bytes\n", "LZXPRESS-BENCHMARK",
+		       LZXPRESS_BENCH_SIZE, (size_t)blob.length);
+	mapitest_print(mt, "* %-40s: compress %.1f MB/s, decompress %.1f MB/s, skip random data in %.1f us%s\n",
+		       "LZXPRESS-BENCHMARK",
+		       LZXPRESS_BENCH_SIZE / compress_time / 1e6,
+		       LZXPRESS_BENCH_SIZE / decompress_time / 1e6,
+		       probe_time * 1e6, probe ? " (probe failed)" : "");
+
+	talloc_free(ndr_push);
+	talloc_free(noise);
+	talloc_free(data);
+
+	return !probe;
+}
@@ -19,6 +19,8 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <time.h>
+
 #include "utils/mapitest/mapitest.h"
 #include "utils/mapitest/proto.h"
 
@@ -265,6 +267,173 @@ _PUBLIC_ bool mapitest_noserver_rtfcp_large(struct mapitest *mt)
 	return true;
 }
 
+#define	RTFCP_BENCH_SIZE	(4 * 1024 * 1024)
+#define	RTFCP_BENCH_ROUNDS	4
+
+static const char *rtfcp_bench_words[] = {
+	"{\\rtf1\\ansi\\ansicpg1252\\fromhtml1 ", "\\par ", "{\\*\\htmltag64 <div>}", "{\\*\\htmltag72 </div>}",
+	"\\htmlrtf {\\b\\htmlrtf0 ", "}\\htmlrtf0 ", "hello ", "world ", "OpenChange ", "the ", "\r\n",
+	"{\\*\\htmltag84 &nbsp;}", "\\'e9", "Lorem ipsum dolor sit amet, ", NULL
+};
+
+/* Bitwise CRC used by the compressed RTF header */
+static uint32_t rtfcp_reference_crc(const uint8_t *data, size_t length)
+{
+	uint32_t	crc = 0;
+	size_t		i;
+	int		bit;
+
+	for (i = 0; i < length; i++) {
+		crc ^= data[i];
+		for (bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+
+	return crc;
+}
+
+static char *rtfcp_bench_data(TALLOC_CTX *mem_ctx, size_t size)
+{
+	char		*data;
+
+	data = talloc_array(mem_ctx, char, size + 1);
+	if (!data) return NULL;
+
+	mapitest_common_bench_fill((uint8_t *)data, size, rtfcp_bench_words, false, 0x4c5a4675);
+	data[size] = '\0';
+
+	return data;
+}
+
+static bool rtfcp_roundtrip(struct mapitest *mt, const char *data, size_t size)
+{
+	enum MAPISTATUS		retval;
+	uint8_t			*compressed;
+	size_t			compressed_length;
+	DATA_BLOB		decompressed;
+	uint32_t		crc;
+	bool			ret = true;
+
+	retval = compress_rtf(mt->mem_ctx, data, size, &compressed, &compressed_length);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "compress_rtf", retval);
+		return false;
+	}
+
+	crc = compressed[12] | (compressed[13] << 8) | (compressed[14] << 16) | ((uint32_t)compressed[15] << 24);
+	if (crc != rtfcp_reference_crc(compressed + 16, compressed_length - 16)) {
+		mapitest_print(mt, "* %-40s: bad CRC for %zu bytes\n", "LZFU-BENCHMARK", size);
+		ret = false;
+	}
+
+	retval = uncompress_rtf(mt->mem_ctx, compressed, compressed_length, &decompressed);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval_clean(mt, "uncompress_rtf", retval);
+		talloc_free(compressed);
+		return false;
+	}
+
+	if (decompressed.length < size || memcmp(decompressed.data, data, size)) {
+		mapitest_print(mt, "* %-40s: round trip mismatch for %zu bytes\n", "LZFU-BENCHMARK", size);
+		ret = false;
+	}
+
+	talloc_free(decompressed.data);
+	talloc_free(compressed);
+
+	return ret;
+}
+
+/**
+     \details Test Compressed RTF round trips and measure throughput
+
+   This function:
+   -# Compresses and decompresses inputs of every size up to 64 bytes
+   and inputs large enough to wrap the 4096 bytes dictionary
+   -# Checks the header CRC against a bitwise implementation
+   -# Reports compression, decompression and CRC throughput on a 4MB
+   HTML-converted RTF body
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_noserver_rtfcp_bench(struct mapitest *mt)
+{
+	enum MAPISTATUS		retval;
+	char			*data;
+	uint8_t			*compressed = NULL;
+	size_t			compressed_length = 0;
+	DATA_BLOB		decompressed;
+	struct timespec		start;
+	double			compress_time;
+	double			uncompress_time;
+	double			crc_time;
+	uint32_t		crc = 0;
+	size_t			size;
+	int			i;
+
+	data = rtfcp_bench_data(mt->mem_ctx, RTFCP_BENCH_SIZE);
+	if (!data) return false;
+
+	for (size = 0; size <= 64; size++) {
+		if (!rtfcp_roundtrip(mt, data, size)) goto fail;
+	}
+	for (size = 4000; size <= 70000; size += 6607) {
+		if (!rtfcp_roundtrip(mt, data + size % 997, size)) goto fail;
+	}
+	mapitest_print(mt, "* %-40s: round trips - match\n", "LZFU-BENCHMARK");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < RTFCP_BENCH_ROUNDS; i++) {
+		talloc_free(compressed);
+		compressed = NULL;
+		retval = compress_rtf(mt->mem_ctx, data, RTFCP_BENCH_SIZE, &compressed, &compressed_length);
+		if (retval != MAPI_E_SUCCESS) {
+			mapitest_print_retval_clean(mt, "compress_rtf", retval);
+			goto fail;
+		}
+	}
+	compress_time = mapitest_common_elapsed(&start) / RTFCP_BENCH_ROUNDS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < RTFCP_BENCH_ROUNDS; i++) {
+		retval = uncompress_rtf(mt->mem_ctx, compressed, compressed_length, &decompressed);
+		if (retval != MAPI_E_SUCCESS) {
+			mapitest_print_retval_clean(mt, "uncompress_rtf", retval);
+			goto fail;
+		}
+		talloc_free(decompressed.data);
+	}
+	uncompress_time = mapitest_common_elapsed(&start) / RTFCP_BENCH_ROUNDS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < RTFCP_BENCH_ROUNDS; i++) {
+		crc = calculateCRC(compressed, 16, compressed_length - 16);
+	}
+	crc_time = mapitest_common_elapsed(&start) / RTFCP_BENCH_ROUNDS;
+
+	mapitest_print(mt, "* %-40s: %d bytes compressed to %zu bytes\n", "LZFU-BENCHMARK",
+		       RTFCP_BENCH_SIZE, compressed_length);
+	mapitest_print(mt, "* %-40s: compress %.1f MB/s, uncompress %.1f MB/s, CRC %.1f MB/s (0x%.8x)\n",
+		       "LZFU-BENCHMARK",
+		       RTFCP_BENCH_SIZE / compress_time / 1e6,
+		       RTFCP_BENCH_SIZE / uncompress_time / 1e6,
+		       (compressed_length - 16) / crc_time / 1e6, crc);
+
+	talloc_free(compressed);
+	talloc_free(data);
+
+	return true;
+
+fail:
+	talloc_free(compressed);
+	talloc_free(data);
+
+	return false;
+}
+
 #define SROWSET_UNTAGGED "004d542044756d6d792046726f6d00426f6479206f66206d657373616765203800004d542044756d6d792046726f6d00426f6479206f66206d657373616765203900004d542044756d6d792046726f6d00426f6479206f66206d657373616765203700004d542044756d6d792046726f6d00426f6479206f66206d657373616765203600004d542044756d6d793400426f6479206f66206d657373616765203400004d542044756d6d792046726f6d00426f6479206f66206d657373616765203500004d542044756d6d793300426f6479206f66206d657373616765203300004d542044756d6d793100426f6479206f66206d657373616765203100004d542044756d6d793200426f6479206f66206d657373616765203200004d542044756d6d793000426f6479206f66206d657373616765203000"
 #define SROWSET_UNTAGGED_LEN 310
 
@@ -513,6 +682,289 @@ _PUBLIC_ bool mapitest_noserver_srowset(struct mapitest *mt)
 	return true;
 }
 
+#define	SROWSET_BENCH_ROWS	2000
+#define	SROWSET_BENCH_ROUNDS	20
+#define	SROWSET_BENCH_COLUMNS	10
+#define	SROWSET_BENCH_SUBJECT0	"Subject 0 \xc3\xa9\xe2\x82\xac\xf0\x9d\x84\x9e"
+
+static uint8_t *srowset_bench_le16(uint8_t *p, uint16_t value)
+{
+	p[0] = value & 0xFF;
+	p[1] = value >> 8;
+	return p + 2;
+}
+
+static uint8_t *srowset_bench_le32(uint8_t *p, uint32_t value)
+{
+	p = srowset_bench_le16(p, value & 0xFFFF);
+	return srowset_bench_le16(p, value >> 16);
+}
+
+/* ASCII prefix followed by e acute, euro sign and a surrogate pair */
+static uint8_t *srowset_bench_utf16(uint8_t *p, const char *prefix)
+{
+	static const uint16_t	suffix[] = { 0x20, 0x00E9, 0x20AC, 0xD834, 0xDD1E, 0x0 };
+	uint32_t		i;
+
+	for (; *prefix; prefix++) {
+		p = srowset_bench_le16(p, *prefix);
+	}
+	for (i = 0; i < sizeof (suffix) / sizeof (suffix[0]); i++) {
+		p = srowset_bench_le16(p, suffix[i]);
+	}
+	return p;
+}
+
+/* Flagged rows carry an error PR_BODY and no PR_HASATTACH value */
+static bool srowset_bench_flagged(uint32_t row)
+{
+	return (row % 3) == 1;
+}
+
+static struct SPropTagArray *srowset_bench_columns(TALLOC_CTX *mem_ctx)
+{
+	return set_SPropTagArray(mem_ctx, SROWSET_BENCH_COLUMNS,
+				 PR_MID, PR_MESSAGE_FLAGS, PR_HASATTACH,
+				 PR_LAST_MODIFICATION_TIME, PR_SENDER_NAME,
+				 PR_SUBJECT_UNICODE, PR_ENTRYID, PR_BODY,
+				 PROP_TAG(PT_MV_LONG, 0x6801),
+				 PROP_TAG(PT_MV_UNICODE, 0x6802));
+}
+
+static void srowset_bench_data(TALLOC_CTX *mem_ctx, DATA_BLOB *blob)
+{
+	uint8_t		*p;
+	char		buf[64];
+	uint32_t	row;
+	uint32_t	i;
+	uint8_t		flag;
+	bool		flagged;
+
+	blob->data = talloc_array(mem_ctx, uint8_t, SROWSET_BENCH_ROWS * 512);
+	p = blob->data;
+
+	for (row = 0; row < SROWSET_BENCH_ROWS; row++) {
+		flagged = srowset_bench_flagged(row);
+		*p++ = flagged;
+		flag = 0x0;
+
+		/* PR_MID */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le32(p, row);
+		p = srowset_bench_le32(p, 0x01000000);
+		/* PR_MESSAGE_FLAGS */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le32(p, row * 7);
+		/* PR_HASATTACH */
+		if (flagged) {
+			*p++ = 0x1;
+		} else {
+			*p++ = row & 1;
+		}
+		/* PR_LAST_MODIFICATION_TIME */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le32(p, 0xd53e8000 + row);
+		p = srowset_bench_le32(p, 0x01cbd6b2);
+		/* PR_SENDER_NAME */
+		if (flagged) *p++ = flag;
+		snprintf(buf, sizeof (buf), "Sender %u", row);
+		memcpy(p, buf, strlen(buf) + 1);
+		p += strlen(buf) + 1;
+		/* PR_SUBJECT_UNICODE */
+		if (flagged) *p++ = flag;
+		snprintf(buf, sizeof (buf), "Subject %u", row);
+		p = srowset_bench_utf16(p, buf);
+		/* PR_ENTRYID */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le16(p, 46);
+		for (i = 0; i < 46; i++) {
+			*p++ = row + i;
+		}
+		/* PR_BODY */
+		if (flagged) {
+			*p++ = PT_ERROR;
+			p = srowset_bench_le32(p, MAPI_E_NOT_FOUND);
+		} else {
+			snprintf(buf, sizeof (buf), "Body of message %u", row);
+			memcpy(p, buf, strlen(buf) + 1);
+			p += strlen(buf) + 1;
+		}
+		/* PT_MV_LONG */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le32(p, 3);
+		for (i = 0; i < 3; i++) {
+			p = srowset_bench_le32(p, row << i);
+		}
+		/* PT_MV_UNICODE */
+		if (flagged) *p++ = flag;
+		p = srowset_bench_le32(p, 2);
+		p = srowset_bench_utf16(p, "keyword");
+		snprintf(buf, sizeof (buf), "category %u", row % 10);
+		p = srowset_bench_utf16(p, buf);
+	}
+
+	blob->length = p - blob->data;
+}
+
+static bool srowset_bench_compare(struct mapitest *mt, struct SRowSet *expected, struct SRowSet *rowSet)
+{
+	struct SPropValue	*a;
+	struct SPropValue	*b;
+	uint32_t		row;
+	uint32_t		prop;
+	uint32_t		i;
+	bool			same;
+
+	for (row = 0; row < expected->cRows; row++) {
+		if (rowSet->aRow[row].cValues != expected->aRow[row].cValues) {
+			mapitest_print(mt, "* %-40s: unexpected props count, row %u\n", "SROWSET-BENCHMARK", row);
+			return false;
+		}
+		for (prop = 0; prop < expected->aRow[row].cValues; prop++) {
+			a = &expected->aRow[row].lpProps[prop];
+			b = &rowSet->aRow[row].lpProps[prop];
+			if (a->ulPropTag != b->ulPropTag) {
+				mapitest_print(mt, "* %-40s: unexpected proptag (%u/%u): 0x%08x\n", "SROWSET-BENCHMARK", row, prop, b->ulPropTag);
+				return false;
+			}
+			/* absent value */
+			if (srowset_bench_flagged(row) && a->ulPropTag == PR_HASATTACH) continue;
+
+			switch (a->ulPropTag & 0xFFFF) {
+			case PT_ERROR:
+				same = (a->value.err == b->value.err);
+				break;
+			case PT_I8:
+				same = (a->value.d == b->value.d);
+				break;
+			case PT_LONG:
+				same = (a->value.l == b->value.l);
+				break;
+			case PT_BOOLEAN:
+				same = (a->value.b == b->value.b);
+				break;
+			case PT_SYSTIME:
+				same = (a->value.ft.dwLowDateTime == b->value.ft.dwLowDateTime &&
+					a->value.ft.dwHighDateTime == b->value.ft.dwHighDateTime);
+				break;
+			case PT_STRING8:
+				same = !strcmp((const char *)a->value.lpszA, (const char *)b->value.lpszA);
+				break;
+			case PT_UNICODE:
+				same = !strcmp(a->value.lpszW, b->value.lpszW);
+				break;
+			case PT_BINARY:
+				same = (a->value.bin.cb == b->value.bin.cb &&
+					!memcmp(a->value.bin.lpb, b->value.bin.lpb, a->value.bin.cb));
+				break;
+			case PT_MV_LONG:
+				same = (a->value.MVl.cValues == b->value.MVl.cValues &&
+					!memcmp(a->value.MVl.lpl, b->value.MVl.lpl, a->value.MVl.cValues * sizeof (uint32_t)));
+				break;
+			case PT_MV_UNICODE:
+				same = (a->value.MVszW.cValues == b->value.MVszW.cValues);
+				for (i = 0; same && i < a->value.MVszW.cValues; i++) {
+					same = !strcmp(a->value.MVszW.lppszW[i], b->value.MVszW.lppszW[i]);
+				}
+				break;
+			default:
+				same = false;
+				break;
+			}
+			if (!same) {
+				mapitest_print(mt, "* %-40s: unexpected property value (%u/%u)\n", "SROWSET-BENCHMARK", row, prop);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+     \details Test arena SRowSet decoding and measure throughput
+
+   This function:
+   -# Builds a QueryRows row data buffer mixing fixed size, string,
+   binary, error, absent and multi-valued properties
+   -# Checks emsmdb_get_SRowSet_arena() decodes it as
+   emsmdb_get_SRowSet() does
+   -# Reports the decoding rate and talloc blocks count of both
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+*/
+_PUBLIC_ bool mapitest_noserver_srowset_bench(struct mapitest *mt)
+{
+	DATA_BLOB		rawData;
+	struct SPropTagArray	*proptags;
+	struct SRowSet		expected;
+	struct SRowSet		rowSet;
+	struct timespec		start;
+	double			legacy_time;
+	double			arena_time;
+	size_t			legacy_blocks;
+	size_t			arena_blocks;
+	int			i;
+	bool			ret;
+
+	proptags = srowset_bench_columns(mt->mem_ctx);
+	srowset_bench_data(mt->mem_ctx, &rawData);
+
+	expected.cRows = SROWSET_BENCH_ROWS;
+	expected.aRow = talloc_array(mt->mem_ctx, struct SRow, expected.cRows);
+	emsmdb_get_SRowSet(expected.aRow, &expected, proptags, &rawData);
+	legacy_blocks = talloc_total_blocks(expected.aRow);
+
+	rowSet.cRows = SROWSET_BENCH_ROWS;
+	rowSet.aRow = talloc_array(mt->mem_ctx, struct SRow, rowSet.cRows);
+	emsmdb_get_SRowSet_arena(rowSet.aRow, &rowSet, proptags, &rawData);
+	arena_blocks = talloc_total_blocks(rowSet.aRow);
+
+	ret = srowset_bench_compare(mt, &expected, &rowSet);
+	if (ret && strcmp(rowSet.aRow[0].lpProps[5].value.lpszW, SROWSET_BENCH_SUBJECT0)) {
+		mapitest_print(mt, "* %-40s: unexpected UTF-8 conversion: %s\n", "SROWSET-BENCHMARK",
+			       rowSet.aRow[0].lpProps[5].value.lpszW);
+		ret = false;
+	}
+	talloc_free(expected.aRow);
+	talloc_free(rowSet.aRow);
+	if (!ret) {
+		talloc_free(rawData.data);
+		talloc_free(proptags);
+		return false;
+	}
+	mapitest_print(mt, "* %-40s: %u rows, %zu bytes - match\n", "SROWSET-BENCHMARK",
+		       SROWSET_BENCH_ROWS, rawData.length);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < SROWSET_BENCH_ROUNDS; i++) {
+		rowSet.aRow = talloc_array(mt->mem_ctx, struct SRow, rowSet.cRows);
+		emsmdb_get_SRowSet(rowSet.aRow, &rowSet, proptags, &rawData);
+		talloc_free(rowSet.aRow);
+	}
+	legacy_time = mapitest_common_elapsed(&start) / SROWSET_BENCH_ROUNDS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < SROWSET_BENCH_ROUNDS; i++) {
+		rowSet.aRow = talloc_array(mt->mem_ctx, struct SRow, rowSet.cRows);
+		emsmdb_get_SRowSet_arena(rowSet.aRow, &rowSet, proptags, &rawData);
+		talloc_free(rowSet.aRow);
+	}
+	arena_time = mapitest_common_elapsed(&start) / SROWSET_BENCH_ROUNDS;
+
+	mapitest_print(mt, "* %-40s: per value %.0f rows/s (%zu blocks), arena %.0f rows/s (%zu blocks)\n",
+		       "SROWSET-BENCHMARK",
+		       SROWSET_BENCH_ROWS / legacy_time, legacy_blocks,
+		       SROWSET_BENCH_ROWS / arena_time, arena_blocks);
+
+	talloc_free(rawData.data);
+	talloc_free(proptags);
+
+	return true;
+}
+
 static bool mapitest_no_server_props_i2(struct mapitest *mt)
 {
 	struct SPropValue propvalue;
@@ -0,0 +1,529 @@
+/*
+   Render the ROP statistics dumped by the EMSMDB server
+
+   OpenChange Project
+
+   Copyright (C) agent <agent@local> 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <talloc.h>
+#include <param.h>
+#include <popt.h>
+
+#include "mapiproxy/util/oc_rop_stats.h"
+
+#define	ROPSTATS_LINE_MAX	8192
+#define	ROPSTATS_BAR_WIDTH	50
+
+enum ropstats_sort {
+	ROPSTATS_SORT_TIME = 0,
+	ROPSTATS_SORT_CALLS,
+	ROPSTATS_SORT_BYTES,
+	ROPSTATS_SORT_MAX
+};
+
+struct ropstats {
+	struct oc_rop_stats_entry	rops[OC_ROP_STATS_OPNUM_MAX];
+	uint32_t			files;
+	time_t				since;
+	time_t				time;
+};
+
+static const char *rop_names[OC_ROP_STATS_OPNUM_MAX] = {
+	[0x01] = "Release",
+	[0x02] = "OpenFolder",
+	[0x03] = "OpenMessage",
+	[0x04] = "GetHierarchyTable",
+	[0x05] = "GetContentsTable",
+	[0x06] = "CreateMessage",
+	[0x07] = "GetProps",
+	[0x0a] = "SetProps",
+	[0x0b] = "DeleteProps",
+	[0x0c] = "SaveChangesMessage",
+	[0x0f] = "ReadRecipients",
+	[0x10] = "ReloadCachedInformation",
+	[0x11] = "SetMessageReadFlag",
+	[0x12] = "SetColumns",
+	[0x13] = "SortTable",
+	[0x14] = "Restrict",
+	[0x15] = "QueryRows",
+	[0x16] = "GetStatus",
+	[0x17] = "QueryPosition",
+	[0x18] = "SeekRow",
+	[0x19] = "SeekRowBookmark",
+	[0x1a] = "SeekRowApprox",
+	[0x1b] = "CreateBookmark",
+	[0x1c] = "CreateFolder",
+	[0x1d] = "DeleteFolder",
+	[0x1e] = "DeleteMessages",
+	[0x1f] = "GetMessageStatus",
+	[0x20] = "SetMessageStatus",
+	[0x21] = "GetAttachmentTable",
+	[0x22] = "OpenAttach",
+	[0x23] = "CreateAttach",
+	[0x24] = "DeleteAttach",
+	[0x25] = "SaveChangesAttachment",
+	[0x26] = "SetReceiveFolder",
+	[0x27] = "GetReceiveFolder",
+	[0x29] = "RegisterNotification",
+	[0x2a] = "Notify",
+	[0x2b] = "OpenStream",
+	[0x2c] = "ReadStream",
+	[0x2d] = "WriteStream",
+	[0x2e] = "SeekStream",
+	[0x2f] = "SetStreamSize",
+	[0x30] = "SetSearchCriteria",
+	[0x31] = "GetSearchCriteria",
+	[0x32] = "SubmitMessage",
+	[0x33] = "MoveCopyMessages",
+	[0x34] = "AbortSubmit",
+	[0x35] = "MoveFolder",
+	[0x36] = "CopyFolder",
+	[0x37] = "QueryColumnsAll",
+	[0x38] = "Abort",
+	[0x39] = "CopyTo",
+	[0x3a] = "CopyToStream",
+	[0x3b] = "CloneStream",
+	[0x3e] = "GetPermissionsTable",
+	[0x3f] = "GetRulesTable",
+	[0x40] = "ModifyPermissions",
+	[0x41] = "ModifyRules",
+	[0x42] = "GetOwningServers",
+	[0x43] = "LongTermIdFromId",
+	[0x44] = "IdFromLongTermId",
+	[0x45] = "PublicFolderIsGhosted",
+	[0x46] = "OpenEmbeddedMessage",
+	[0x47] = "SetSpooler",
+	[0x48] = "SpoolerLockMessage",
+	[0x4a] = "TransportSend",
+	[0x4b] = "FastTransferSourceCopyMessages",
+	[0x4c] = "FastTransferSourceCopyFolder",
+	[0x4d] = "FastTransferSourceCopyTo",
+	[0x4e] = "FastTransferSourceGetBuffer",
+	[0x4f] = "FindRow",
+	[0x50] = "Progress",
+	[0x51] = "TransportNewMail",
+	[0x52] = "GetValidAttachments",
+	[0x55] = "GetNamesFromIDs",
+	[0x56] = "GetIDsFromNames",
+	[0x57] = "UpdateDeferredActionMessages",
+	[0x58] = "EmptyFolder",
+	[0x59] = "ExpandRow",
+	[0x5a] = "CollapseRow",
+	[0x5b] = "LockRegionStream",
+	[0x5c] = "UnlockRegionStream",
+	[0x5d] = "CommitStream",
+	[0x5e] = "GetStreamSize",
+	[0x5f] = "QueryNamedProperties",
+	[0x60] = "GetPerUserLongTermIds",
+	[0x61] = "GetPerUserGuid",
+	[0x63] = "ReadPerUserInformation",
+	[0x66] = "SetReadFlags",
+	[0x67] = "CopyProperties",
+	[0x68] = "GetReceiveFolderTable",
+	[0x6b] = "GetCollapseState",
+	[0x6c] = "SetCollapseState",
+	[0x6d] = "GetTransportFolder",
+	[0x6e] = "Pending",
+	[0x6f] = "OptionsData",
+	[0x70] = "SyncConfigure",
+	[0x72] = "SyncImportMessageChange",
+	[0x73] = "SyncImportHierarchyChange",
+	[0x74] = "SyncImportDeletes",
+	[0x75] = "SyncUploadStateStreamBegin",
+	[0x76] = "SyncUploadStateStreamContinue",
+	[0x77] = "SyncUploadStateStreamEnd",
+	[0x78] = "SyncImportMessageMove",
+	[0x79] = "SetPropertiesNoReplicate",
+	[0x7a] = "DeletePropertiesNoReplicate",
+	[0x7b] = "GetStoreState",
+	[0x7e] = "SyncOpenCollector",
+	[0x7f] = "GetLocalReplicaIds",
+	[0x8] = "GetPropsAll",
+	[0x80] = "SyncImportReadStateChanges",
+	[0x81] = "ResetTable",
+	[0x82] = "SyncGetTransferState",
+	[0x87] = "OpenPublicFolderByName",
+	[0x88] = "SetSyncNotificationGuid",
+	[0x89] = "FreeBookmark",
+	[0x9] = "GetPropList",
+	[0x90] = "WriteAndCommitStream",
+	[0x91] = "HardDeleteMessages",
+	[0x92] = "HardDeleteMessagesAndSubfolders",
+	[0x93] = "SetLocalReplicaMidsetDeleted",
+	[0xd] = "RemoveAllRecipients",
+	[0xe] = "ModifyRecipients",
+	[0xfe] = "Logon",
+};
+
+static enum ropstats_sort	sort_key = ROPSTATS_SORT_TIME;
+static struct ropstats		*sort_stats = NULL;
+
+static uint64_t ropstats_sort_value(const struct oc_rop_stats_entry *entry)
+{
+	switch (sort_key) {
+	case ROPSTATS_SORT_CALLS:
+		return entry->calls;
+	case ROPSTATS_SORT_BYTES:
+		return entry->response_bytes;
+	case ROPSTATS_SORT_MAX:
+		return entry->max_usec;
+	default:
+		return entry->usec;
+	}
+}
+
+static int ropstats_cmp(const void *a, const void *b)
+{
+	uint64_t	va = ropstats_sort_value(&sort_stats->rops[*(const int *)a]);
+	uint64_t	vb = ropstats_sort_value(&sort_stats->rops[*(const int *)b]);
+
+	if (va == vb) return *(const int *)a - *(const int *)b;
+	return (va < vb) ? 1 : -1;
+}
+
+static bool ropstats_parse_rop(struct ropstats *stats, char *line)
+{
+	struct oc_rop_stats_entry	*entry;
+	char				*saveptr = NULL;
+	char				*key;
+	char				*value;
+	unsigned long			opnum;
+	uint64_t			lower;
+	uint64_t			count;
+	bool				buckets = false;
+
+	key = strtok_r(line, " \n", &saveptr);
+	value = strtok_r(NULL, " \n", &saveptr);
+	if (!key || !value || strcmp(key, "rop")) return false;
+
+	opnum = strtoul(value, NULL, 16);
+	if (opnum >= OC_ROP_STATS_OPNUM_MAX) return false;
+	entry = &stats->rops[opnum];
+
+	while ((key = strtok_r(NULL, " \n", &saveptr)) != NULL) {
+		if (!strcmp(key, "buckets")) {
+			buckets = true;
+			continue;
+		}
+		if (buckets) {
+			if (sscanf(key, "%"SCNu64":%"SCNu64, &lower, &count) == 2) {
+				entry->buckets[oc_rop_stats_bucket_index(lower)] += count;
+			}
+			continue;
+		}
+
+		value = strtok_r(NULL, " \n", &saveptr);
+		if (!value) return false;
+
+		if (!strcmp(key, "calls")) {
+			entry->calls += strtoull(value, NULL, 10);
+		} else if (!strcmp(key, "errors")) {
+			entry->errors += strtoull(value, NULL, 10);
+		} else if (!strcmp(key, "usec")) {
+			entry->usec += strtoull(value, NULL, 10);
+		} else if (!strcmp(key, "max_usec")) {
+			count = strtoull(value, NULL, 10);
+			if (count > entry->max_usec) {
+				entry->max_usec = count;
+			}
+		} else if (!strcmp(key, "bytes")) {
+			entry->response_bytes += strtoull(value, NULL, 10);
+		} else if (!strcmp(key, "mapistore_usec")) {
+			entry->backend_usec[OC_ROP_STATS_MAPISTORE] += strtoull(value, NULL, 10);
+		} else if (!strcmp(key, "openchangedb_usec")) {
+			entry->backend_usec[OC_ROP_STATS_OPENCHANGEDB] += strtoull(value, NULL, 10);
+		}
+	}
+
+	return true;
+}
+
+static bool ropstats_load_file(struct ropstats *stats, const char *path)
+{
+	FILE	*f;
+	char	*line;
+	long	value;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "[ERR] Unable to open %s\n", path);
+		return false;
+	}
+
+	line = talloc_size(NULL, ROPSTATS_LINE_MAX);
+	if (!line) {
+		fclose(f);
+		return false;
+	}
+
+	while (fgets(line, ROPSTATS_LINE_MAX, f)) {
+		if (line[0] == '#') continue;
+		if (sscanf(line, "version %ld", &value) == 1) {
+			if (value != OC_ROP_STATS_VERSION) {
+				fprintf(stderr, "[ERR] %s: unsupported version %ld\n", path, value);
+				break;
+			}
+		} else if (sscanf(line, "since %ld", &value) == 1) {
+			if (!stats->since || value < stats->since) {
+				stats->since = value;
+			}
+		} else if (sscanf(line, "time %ld", &value) == 1) {
+			if (value > stats->time) {
+				stats->time = value;
+			}
+		} else if (!strncmp(line, "rop ", 4)) {
+			if (!ropstats_parse_rop(stats, line)) {
+				fprintf(stderr, "[WARN] %s: skipping malformed line\n", path);
+			}
+		}
+	}
+
+	stats->files++;
+	talloc_free(line);
+	fclose(f);
+
+	return true;
+}
+
+static bool ropstats_load(struct ropstats *stats, const char *path)
+{
+	struct stat	st;
+	DIR		*dir;
+	struct dirent	*de;
+	size_t		len;
+	size_t		suffix_len = strlen(OC_ROP_STATS_SUFFIX);
+	char		*file;
+	bool		ret = true;
+
+	if (stat(path, &st) == -1) {
+		fprintf(stderr, "[ERR] Unable to stat %s\n", path);
+		return false;
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		return ropstats_load_file(stats, path);
+	}
+
+	dir = opendir(path);
+	if (!dir) {
+		fprintf(stderr, "[ERR] Unable to open directory %s\n", path);
+		return false;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		len = strlen(de->d_name);
+		if (len <= suffix_len || strcmp(de->d_name + len - suffix_len, OC_ROP_STATS_SUFFIX)) {
+			continue;
+		}
+		file = talloc_asprintf(NULL, "%s/%s", path, de->d_name);
+		if (!file) {
+			ret = false;
+			break;
+		}
+		ret &= ropstats_load_file(stats, file);
+		talloc_free(file);
+	}
+	closedir(dir);
+
+	return ret;
+}
+
+/**
+   \details Return an upper bound of the latency below which the given
+   percentage of calls completed
+ */
+static uint64_t ropstats_percentile(const struct oc_rop_stats_entry *entry, double pct)
+{
+	uint64_t	threshold;
+	uint64_t	seen = 0;
+	uint64_t	upper;
+	uint32_t	i;
+
+	threshold = (uint64_t)(entry->calls * pct / 100.0);
+	if (threshold == 0) threshold = 1;
+
+	for (i = 0; i < OC_ROP_STATS_BUCKETS; i++) {
+		seen += entry->buckets[i];
+		if (seen >= threshold) {
+			if (i + 1 == OC_ROP_STATS_BUCKETS) break;
+			upper = oc_rop_stats_bucket_lower(i + 1) - 1;
+			return (upper < entry->max_usec) ? upper : entry->max_usec;
+		}
+	}
+
+	return entry->max_usec;
+}
+
+static void ropstats_print_histogram(const struct oc_rop_stats_entry *entry)
+{
+	uint64_t	peak = 0;
+	uint32_t	i;
+	uint32_t	first = OC_ROP_STATS_BUCKETS;
+	uint32_t	last = 0;
+	int		width;
+
+	for (i = 0; i < OC_ROP_STATS_BUCKETS; i++) {
+		if (!entry->buckets[i]) continue;
+		if (first == OC_ROP_STATS_BUCKETS) first = i;
+		last = i;
+		if (entry->buckets[i] > peak) peak = entry->buckets[i];
+	}
+	if (!peak) return;
+
+	for (i = first; i <= last; i++) {
+		width = (int)(entry->buckets[i] * ROPSTATS_BAR_WIDTH / peak);
+		printf("    >= %10"PRIu64" us %10"PRIu64" |%.*s\n", oc_rop_stats_bucket_lower(i),
+		       entry->buckets[i], width, "##################################################");
+	}
+}
+
+static void ropstats_print(struct ropstats *stats, int limit, bool histogram)
+{
+	const struct oc_rop_stats_entry	*entry;
+	const char			*name;
+	char				since[64];
+	char				now[64];
+	int				order[OC_ROP_STATS_OPNUM_MAX];
+	int				count = 0;
+	int				i;
+
+	for (i = 0; i < OC_ROP_STATS_OPNUM_MAX; i++) {
+		if (stats->rops[i].calls) {
+			order[count++] = i;
+		}
+	}
+
+	sort_stats = stats;
+	qsort(order, count, sizeof (int), ropstats_cmp);
+
+	strftime(since, sizeof (since), "%Y-%m-%d %H:%M:%S", localtime(&stats->since));
+	strftime(now, sizeof (now), "%Y-%m-%d %H:%M:%S", localtime(&stats->time));
+	printf("%u process(es), %s -> %s\n\n", stats->files, since, now);
+
+	printf("%-4s %-32s %10s %7s %12s %9s %9s %9s %9s %10s %10s %6s %6s\n",
+	       "ROP", "Name", "Calls", "Errors", "Total(ms)", "Avg(us)", "p50(us)",
+	       "p90(us)", "p99(us)", "Max(us)", "Bytes/call", "mstr%", "ocdb%");
+
+	for (i = 0; i < count && (limit <= 0 || i < limit); i++) {
+		entry = &stats->rops[order[i]];
+		name = rop_names[order[i]] ? rop_names[order[i]] : "Unknown";
+		printf("0x%.2x %-32s %10"PRIu64" %7"PRIu64" %12.3f %9"PRIu64" %9"PRIu64
+		       " %9"PRIu64" %9"PRIu64" %10"PRIu64" %10"PRIu64" %6.1f %6.1f\n",
+		       order[i], name, entry->calls, entry->errors, entry->usec / 1000.0,
+		       entry->usec / entry->calls,
+		       ropstats_percentile(entry, 50), ropstats_percentile(entry, 90),
+		       ropstats_percentile(entry, 99), entry->max_usec,
+		       entry->response_bytes / entry->calls,
+		       entry->usec ? 100.0 * entry->backend_usec[OC_ROP_STATS_MAPISTORE] / entry->usec : 0.0,
+		       entry->usec ? 100.0 * entry->backend_usec[OC_ROP_STATS_OPENCHANGEDB] / entry->usec : 0.0);
+		if (histogram) {
+			ropstats_print_histogram(entry);
+		}
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	poptContext		pc;
+	int			opt;
+	struct loadparm_context	*lp_ctx;
+	struct ropstats		*stats;
+	const char		*path;
+	const char		*opt_sort = NULL;
+	int			opt_limit = 0;
+	bool			opt_histogram = false;
+	bool			loaded = false;
+
+	enum { OPT_SORT=1000, OPT_LIMIT, OPT_HISTOGRAM };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "sort", 's', POPT_ARG_STRING, NULL, OPT_SORT, "sort by time, calls, bytes or max", NULL },
+		{ "limit", 'l', POPT_ARG_INT, &opt_limit, OPT_LIMIT, "only display the first N ROPs", NULL },
+		{ "histogram", 0, POPT_ARG_NONE, NULL, OPT_HISTOGRAM, "display latency histograms", NULL },
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	mem_ctx = talloc_new(NULL);
+	if (!mem_ctx) return 1;
+
+	stats = talloc_zero(mem_ctx, struct ropstats);
+	if (!stats) return 1;
+
+	pc = poptGetContext("ropstats", argc, argv, long_options, 0);
+	poptSetOtherOptionHelp(pc, "[FILE|DIRECTORY ...]");
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_SORT:
+			opt_sort = poptGetOptArg(pc);
+			break;
+		case OPT_HISTOGRAM:
+			opt_histogram = true;
+			break;
+		}
+	}
+
+	if (opt_sort) {
+		if (!strcmp(opt_sort, "calls")) {
+			sort_key = ROPSTATS_SORT_CALLS;
+		} else if (!strcmp(opt_sort, "bytes")) {
+			sort_key = ROPSTATS_SORT_BYTES;
+		} else if (!strcmp(opt_sort, "max")) {
+			sort_key = ROPSTATS_SORT_MAX;
+		} else if (strcmp(opt_sort, "time")) {
+			fprintf(stderr, "[ERR] invalid sort key: %s\n", opt_sort);
+			exit (1);
+		}
+	}
+
+	while ((path = poptGetArg(pc)) != NULL) {
+		ropstats_load(stats, path);
+		loaded = true;
+	}
+
+	/* Default to the statistics directory of the samba private dir */
+	if (!loaded) {
+		lp_ctx = loadparm_init_global(true);
+		if (!lp_ctx) return 1;
+		path = talloc_asprintf(mem_ctx, "%s/%s", lpcfg_private_dir(lp_ctx), OC_ROP_STATS_DIRNAME);
+		if (!path) return 1;
+		ropstats_load(stats, path);
+	}
+
+	if (!stats->files) {
+		fprintf(stderr, "[ERR] no statistics found\n");
+		exit (1);
+	}
+
+	ropstats_print(stats, opt_limit, opt_histogram);
+
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}